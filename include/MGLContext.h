@@ -8,6 +8,8 @@
 #ifndef MGLContext_h
 #define MGLContext_h
 
+#include <stddef.h>
+
 // probably a reason for this... can't remember
 #ifndef __GLM_CONTEXT_
 #define __GLM_CONTEXT_
@@ -22,9 +24,39 @@ enum
     MGL_DEPTH_TYPE,
     MGL_STENCIL_FORMAT,
     MGL_STENCIL_TYPE,
-    MGL_CONTEXT_FLAGS
+    MGL_CONTEXT_FLAGS,
+    MGL_BUFFER_SUBALLOCATION, // small buffers share backing slabs, on by default
+    MGL_SHADOW_MEMORY_BUDGET, // kilobytes of cpu texture copies kept once uploaded, 0 (default) keeps all
+    MGL_SHADOW_MEMORY,        // kilobytes of cpu texture copies held now, read only
+    MGL_SHADOW_EVICTIONS      // cpu texture copies dropped to stay in budget so far, read only
 };
 
+// per object type allocation stats, see MGLgetObjectPoolStats. the object pools keep theirs in this
+typedef struct MGLObjectPoolStats_t
+{
+    size_t object_size;
+    size_t slabs;
+    size_t bytes;
+    size_t live;
+    size_t peak;
+    size_t allocs;
+    size_t frees;
+} MGLObjectPoolStats;
+
+// bytes held for one object type, see MGLgetMemoryStats
+typedef struct MGLMemoryStats_t
+{
+    size_t objects;
+    size_t cpu_bytes; // cpu copies and backings
+    size_t shared_bytes;
+    size_t managed_bytes;
+    size_t private_bytes;
+    size_t evicted_objects; // cpu copy dropped, only on the gpu
+} MGLMemoryStats;
+
+// called when MGL is done with memory adopted by MGLbufferStorageClientMemory
+typedef void (*MGLreleaseMemoryProc)(void *ptr, size_t size, void *user);
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -45,6 +77,24 @@ extern "C"
     // MGLget can take NULL for the ctx, in this case it will use the current ctx
     void MGLget(GLMContext ctx, GLenum param, GLuint *data);
 
+    // MGL_BUFFER_SUBALLOCATION applies to buffers given storage afterwards, lowering
+    // MGL_SHADOW_MEMORY_BUDGET drops least recently used texture copies right away
+    void MGLset(GLMContext ctx, GLenum param, GLuint data);
+
+    // type is GL_BUFFER, GL_TEXTURE, GL_PROGRAM, GL_SHADER, GL_VERTEX_ARRAY, GL_SAMPLER,
+    // GL_FRAMEBUFFER or GL_RENDERBUFFER, can take NULL for the ctx like MGLget
+    void MGLgetObjectPoolStats(GLMContext ctx, GLenum type, MGLObjectPoolStats *stats);
+
+    // type is GL_BUFFER or GL_TEXTURE, walks every object so it's not for per frame use
+    void MGLgetMemoryStats(GLMContext ctx, GLenum type, MGLMemoryStats *stats);
+
+    // immutable GL_CLIENT_STORAGE_BIT storage for buffer that is the app's memory rather than a copy,
+    // e.g. an mmap'ed asset file. ptr must be page aligned and readable (writable too if the buffer is
+    // ever written) for size rounded up to whole pages. release is called with user once neither GL
+    // nor the GPU refer to it, NULL leaves freeing it to the app after the buffer is deleted and idle.
+    void MGLbufferStorageClientMemory(GLMContext ctx, GLuint buffer, GLsizeiptr size, void *ptr,
+                                      GLbitfield storage_flags, MGLreleaseMemoryProc release, void *user);
+
 #ifdef __cplusplus
 };
 #endif
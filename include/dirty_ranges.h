@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * dirty_ranges.h
+ * MGL
+ *
+ */
+
+
+#ifndef dirty_ranges_h
+#define dirty_ranges_h
+
+#include <stddef.h>
+
+// modified byte ranges of a buffer waiting to be flushed to the GPU copy
+//
+// ranges are kept sorted, disjoint and non adjacent, overlapping or touching
+// writes are merged as they come in. once the set is full the two ranges with
+// the smallest gap between them are joined, so the set stays fixed size and
+// over flushes by the smallest amount it can.
+
+#define MAX_DIRTY_RANGES 8
+
+typedef struct DirtyRange_t
+{
+    size_t start;
+    size_t end; // exclusive
+} DirtyRange;
+
+typedef struct DirtyRangeSet_t
+{
+    unsigned count;
+    DirtyRange ranges[MAX_DIRTY_RANGES];
+} DirtyRangeSet;
+
+void clearDirtyRanges(DirtyRangeSet *set);
+void addDirtyRange(DirtyRangeSet *set, size_t offset, size_t length);
+// the bytes no longer need flushing, invalidated contents
+void removeDirtyRange(DirtyRangeSet *set, size_t offset, size_t length);
+size_t getDirtyRangeBytes(const DirtyRangeSet *set);
+
+#endif /* dirty_ranges_h */
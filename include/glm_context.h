@@ -31,6 +31,12 @@
 #include "glm_dispatch.h"
 
 #include "hash_table.h"
+#include "object_pool.h"
+#include "page_allocator.h"
+#include "dirty_ranges.h"
+#include "sub_allocator.h"
+#include "mem_budget.h"
+#include "pixel_store.h"
 
 // defines above set sizes in glm_params
 #include "glm_params.h"
@@ -228,8 +234,36 @@ typedef struct BufferData_t
     size_t buffer_size;
     vm_address_t buffer_data;
     void *mtl_data;
+    GLuint64 serial; // last command buffer to reference mtl_data
+    GLuint64 write_serial; // last command buffer the gpu writes it in, cpu reads wait on it
+    GLboolean gpu_written; // managed storage the gpu wrote, cpu reads synchronize it first
+    DirtyRangeSet dirty_ranges; // what DIRTY_BUFFER_DATA covers, only set through setBufferDataDirty
+    // last copy of a buffer without an mtl buffer in the renderer's upload arena
+    GLuint upload_arena;
+    GLuint64 upload_generation;
+    size_t upload_offset;
+    // app memory adopted by MGLbufferStorageClientMemory, goes back through
+    // client_release instead of being freed
+    GLboolean client_memory;
+    void (*client_release)(void *ptr, size_t size, void *user);
+    void *client_release_user;
+    // small buffers packed into a shared slab, buffer_data points into it
+    SubAllocSlab *slab;
+    size_t slab_offset;
 } BufferData;
 
+// stores a buffer was renamed away from while the GPU still had them queued,
+// reused once their command buffer completes. the ring starts with MIN_BUFFER_RENAMES
+// stores and doubles while every one of them is queued
+#define MIN_BUFFER_RENAMES 3
+#define MAX_BUFFER_RENAMES 48
+
+typedef struct BufferStore_t
+{
+    void *mtl_data;
+    GLuint64 serial;
+} BufferStore;
+
 #define BUFFER_IMMUTABLE_STORAGE_FLAG 0x1
 #define BUFFER_MAP_PERSISTENT_BIT (BUFFER_IMMUTABLE_STORAGE_FLAG << 1)
 
@@ -248,6 +282,8 @@ typedef struct Buffer_t
     GLsizeiptr mapped_offset;
     GLsizeiptr mapped_length;
     BufferData data;
+    BufferStore *renames;
+    GLuint num_renames;
 } Buffer;
 
 typedef struct BufferBaseTarget_t
@@ -300,7 +336,16 @@ typedef struct TextureLevel_t
     size_t pitch;
     GLuint mtl_format;
     size_t data_size;
+    size_t data_alloc_size; // for freePages, 0 when data is in the texture's shadow allocation
     vm_address_t data;
+
+    // where the level goes in the texture's shadow allocation
+    size_t offset;
+    size_t slot_size;
+
+    // bit per layer or 3d slice, contents undefined until next written. layers past 64 are
+    // always kept, a cube map face has its own level
+    uint64_t invalidated_images;
 } TextureLevel;
 
 enum
@@ -340,11 +385,14 @@ typedef struct Texture_t
     GLuint index;
     GLuint mipmapped;
     GLboolean genmipmaps;
+    GLboolean gpu_written; // copied or cleared into on the gpu, or through a view, shadows are read back
     GLboolean mtl_requires_private_storage; // depth, multi sample
     TextureParameter params;
 
     // base level params
     GLenum internalformat;
+    GLboolean compressed;   // levels hold blocks, see texture_compression.h
+    GLenum decoded_format;  // what the blocks are decoded to for metal, 0 passes them through
     GLuint width;
     GLuint height;
     GLuint depth;
@@ -354,6 +402,39 @@ typedef struct Texture_t
     GLuint mipmap_levels;
     TextureFace faces[6];
     void *mtl_data;
+    size_t mtl_alloc_size;
+    GLuint mtl_generation; // bumped each time mtl_data is made, views are made again with it
+
+    // its name and every view of it hold a reference, the storage goes with the last one
+    GLuint ref_count;
+
+    // glTextureView, levels and layers of another texture's storage. the parent is never a view
+    struct Texture_t *view_parent;
+    GLuint view_min_level;
+    GLuint view_num_levels;
+    GLuint view_min_layer;
+    GLuint view_num_layers;
+    GLuint view_generation; // the parent's mtl_generation the mtl view was made from
+    GLboolean has_views;    // made with usage for views from the first one on
+
+    // GL_TEXTURE_BUFFER, texels are a range of a buffer's storage and nothing is copied
+    Buffer *tex_buffer;
+    GLintptr tex_buffer_offset;
+    GLsizeiptr tex_buffer_size; // 0 follows the buffer's size
+    void *tex_buffer_mtl_data;  // the mtl buffer and offset mtl_data was made over
+    size_t tex_buffer_mtl_offset;
+
+    // level data is a shadow of the mtl texture once uploaded, see evictTextureShadows
+    MemLRUNode shadow_lru;
+    GLboolean shadow_evicted;
+    GLboolean shadow_deferred; // levels have a size but no data yet, see backTextureShadow
+
+    // the levels share one allocation laid out level by level, the faces of a level
+    // side by side. it covers the first shadow_levels levels
+    vm_address_t shadow_data;
+    size_t shadow_alloc_size;
+    size_t shadow_layout_size; // every level
+    GLuint shadow_levels;
 } Texture;
 
 typedef struct TextureUnit_t
@@ -424,6 +505,7 @@ typedef struct Shader_t
     const char *entry_point;
     char *log;
     int delete_pending;
+    GLuint attach_count; // programs it's attached to, a pending delete waits for the last one
     struct
     {
         void *function;
@@ -477,6 +559,7 @@ typedef struct BufferMap_t
     GLuint attribute_mask;
     Buffer *buf;
     GLintptr offset;
+    GLboolean gpu_writes; // shader storage and atomic counters
 } BufferMap;
 
 typedef struct BufferMapList_t
@@ -548,7 +631,7 @@ typedef struct Framebuffer_t
 typedef struct __GLsync
 {
     GLsizei name;
-    void *mtl_event;
+    GLuint64 serial; // command buffer the fence was inserted in
 #ifdef __cplusplus
 } Sync;
 #else
@@ -665,6 +748,15 @@ typedef struct
     HashTable framebuffer_table;
     HashTable sampler_table;
 
+    ObjectPool vao_pool;
+    ObjectPool buffer_pool;
+    ObjectPool texture_pool;
+    ObjectPool shader_pool;
+    ObjectPool program_pool;
+    ObjectPool renderbuffer_pool;
+    ObjectPool framebuffer_pool;
+    ObjectPool sampler_pool;
+
     Shader *shaders[_MAX_SHADER_TYPES];
     Program *program;
 
@@ -696,6 +788,18 @@ static_assert(TEXTURE_UNITS == 128, "active_texture_mask relies on this");
 
 typedef struct GLMContextRec_t *GLMContext;
 
+// one end of a glCopyImageSubData, the region is in its own texels. layers and cube faces
+// are counted the gl way, as rows of 1d arrays and images of the others
+typedef struct CopyImageRegion_t
+{
+    Texture *tex;
+    GLuint level;
+    GLuint x, y, z;
+    GLuint width, height, depth;
+    GLuint block_width, block_height; // 1 unless compressed
+    size_t unit_size;                 // bytes a texel or block
+} CopyImageRegion;
+
 struct GLMMetalFuncs
 {
     void *mtlObj;
@@ -708,7 +812,7 @@ struct GLMMetalFuncs
     void (*mtlDeleteMTLObj)(GLMContext glm_ctx, void *obj);
 
     void (*mtlGetSync)(GLMContext glm_ctx, Sync *sync);
-    void (*mtlWaitForSync)(GLMContext glm_ctx, Sync *sync);
+    GLenum (*mtlWaitForSync)(GLMContext glm_ctx, Sync *sync, bool flush, GLuint64 timeout);
 
     void (*mtlFlush)(GLMContext glm_ctx, bool finish);
     void (*mtlSwapBuffers)(GLMContext glm_ctx);
@@ -718,18 +822,29 @@ struct GLMMetalFuncs
                                GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
 
     void (*mtlBufferSubData)(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t size, const void *ptr);
-    void *(*mtlMapUnmapBuffer)(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t size, GLenum access, bool map);
-    void (*mtlFlushBufferRange)(GLMContext glm_ctx, Buffer *buf, GLintptr offset, GLsizeiptr length);
-
-    void (*mtlReadDrawable)(GLMContext glm_ctx, void *pixelBytes, GLuint bytesPerRow, GLuint bytesPerImage, GLint x,
-                            GLint y, GLsizei width, GLsizei height);
+    void *(*mtlMapUnmapBuffer)(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t size, GLbitfield access,
+                               bool map);
+    bool (*mtlRenameBuffer)(GLMContext glm_ctx, Buffer *buf, bool preserve);
+    bool (*mtlSubAllocBuffer)(GLMContext glm_ctx, Buffer *buf);
+    void (*mtlFreeBufferSubAlloc)(GLMContext glm_ctx, Buffer *buf);
+
+    bool (*mtlReadPixels)(GLMContext glm_ctx, void *pixelBytes, const PixelStoreLayout *layout,
+                          PixelLayout pixel_layout, GLint x, GLint y, GLsizei width, GLsizei height, bool depth);
     void (*mtlGetTexImage)(GLMContext glm_ctx, Texture *tex, void *pixelBytes, GLuint bytesPerRow, GLuint bytesPerImage,
-                           GLint x, GLint y, GLsizei width, GLsizei height, GLuint level, GLuint slice);
+                           GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLuint level);
+    bool (*mtlReadPixelsToBuffer)(GLMContext glm_ctx, Buffer *buf, size_t offset, GLuint bytesPerRow, GLint x,
+                                  GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type);
+    bool (*mtlReadTextureShadow)(GLMContext glm_ctx, Texture *tex);
 
     void (*mtlGenerateMipmaps)(GLMContext glm_ctx, Texture *tex);
     void (*mtlTexSubImage)(GLMContext glm_ctx, Texture *tex, Buffer *buf, size_t src_offset, size_t src_pitch,
                            size_t src_image_size, size_t src_size, GLuint slice, GLuint level, size_t width,
                            size_t height, size_t depth, size_t xoffset, size_t yoffset, size_t zoffset);
+    void (*mtlClearTexImage)(GLMContext glm_ctx, Texture *tex, GLuint level, size_t xoffset, size_t yoffset,
+                             size_t zoffset, size_t width, size_t height, size_t depth, const void *value,
+                             size_t value_size);
+    void (*mtlCopyImageSubData)(GLMContext glm_ctx, const CopyImageRegion *src, const CopyImageRegion *dst);
+    bool (*mtlSupportsCompressedFormat)(GLMContext glm_ctx, GLenum internalformat);
 
     // draw arrays / elements
     void (*mtlDrawArrays)(GLMContext ctx, GLenum mode, GLint first, GLsizei count);
@@ -789,6 +904,8 @@ typedef struct GLMContextRec_t
 
     GLMState state;
     GLboolean assert_on_error;
+    GLboolean buffer_suballocation; // MGL_BUFFER_SUBALLOCATION
+    MemBudget shadow_budget;        // MGL_SHADOW_MEMORY_BUDGET
 
     PixelFormat pixel_format;
     PixelFormat depth_format;
@@ -804,17 +921,8 @@ GLMContext createGLMContext(GLenum format, GLenum type, GLenum depth_format, GLe
 GLMContext ensureContext(void);
 
 void MGLsetCurrentContext(GLMContext ctx);
-
-enum
-{
-    MGL_PIXEL_FORMAT,
-    MGL_PIXEL_TYPE,
-    MGL_DEPTH_FORMAT,
-    MGL_DEPTH_TYPE,
-    MGL_STENCIL_FORMAT,
-    MGL_STENCIL_TYPE,
-    MGL_CONTEXT_FLAGS
-};
+void MGLgetObjectPoolStats(GLMContext ctx, GLenum type, MGLObjectPoolStats *stats);
+void MGLgetMemoryStats(GLMContext ctx, GLenum type, MGLMemoryStats *stats);
 
 #ifdef __cplusplus
 extern "C"
@@ -825,13 +933,28 @@ extern "C"
     GLuint bicountForFormatType(GLenum format, GLenum type, GLenum component);
     GLMContext MGLgetCurrentContext(void);
     void MGLget(GLMContext ctx, GLenum param, GLuint *data);
+    void MGLset(GLMContext ctx, GLenum param, GLuint data);
     bool pixelConvertToInternalFormat(GLMContext ctx, GLenum internalformat, GLenum format, GLenum type,
                                       const void *src, void *dst, size_t len);
+    void getPackLayout(GLMContext ctx, GLenum format, GLenum type, bool is_3d, size_t width, size_t height,
+                       size_t depth, PixelStoreLayout *layout);
 
     bool createTextureLevel(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLboolean is_array,
                             GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLenum format,
                             GLenum type, void *pixels, GLboolean proxy);
 
+    vm_address_t allocTextureLevelData(GLMContext ctx, Texture *tex, GLuint face, GLint level, size_t size);
+    void touchTextureShadow(GLMContext ctx, Texture *tex);
+    void evictTextureShadows(GLMContext ctx);
+    bool restoreTextureShadow(GLMContext ctx, Texture *tex);
+    bool readBackTextureShadow(GLMContext ctx, Texture *tex);
+    void keepTextureGPUWrites(GLMContext ctx, Texture *tex);
+    GLuint getTexLevelImages(Texture *tex, GLint level);
+    void invalidateTexImages(Texture *tex, GLint level, GLuint first, GLuint count);
+    bool writeTexImages(Texture *tex, GLint level, GLuint first, GLuint count);
+    bool isTexLevelInvalidated(Texture *tex, GLuint face, GLint level);
+    void getTextureMemory(Texture *tex, MemoryStats *stats);
+
 #ifdef __cplusplus
 };
 #endif
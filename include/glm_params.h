@@ -25,12 +25,18 @@
 
 #include "glm_limits.h"
 
+// compatibility profile only, selects how glGenerateMipmap builds the levels here
+#ifndef GL_GENERATE_MIPMAP_HINT
+#define GL_GENERATE_MIPMAP_HINT 0x8192
+#endif
+
 typedef struct GLMHints_t
 {
     GLuint line_smooth_hint;
     GLuint polygon_smooth_hint;
     GLuint texture_compression_hint;
     GLuint fragment_shader_derivative_hint;
+    GLuint generate_mipmap_hint;
 } GLMHints;
 
 typedef struct GLMCaps_t
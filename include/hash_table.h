@@ -23,9 +23,19 @@
 
 #include "glcorearb.h"
 
+// names below MAX_DENSE_HASH_SIZE live in a directly indexed array that grows
+// by doubling, anything larger or too far past the end of the array goes into
+// an open addressed table so sparse app chosen names don't cost memory
+#define MAX_DENSE_HASH_SIZE (64 * 1024)
+
+// deleted names aren't handed out again until this many more have been deleted,
+// keeps a stale handle from silently aliasing the next object created
+#define HASH_NAME_REUSE_DELAY 64
+
 typedef struct
 {
     GLuint name;
+    GLuint generation; // dense names, odd while deleted and waiting for reuse
     void *data;
 } HashObj;
 
@@ -34,13 +44,30 @@ typedef struct
     unsigned size;
     GLuint current_name;
     HashObj *keys;
+
+    // sparse names, linear probing, power of 2 sized
+    unsigned sparse_size;
+    unsigned sparse_count;
+    unsigned sparse_used; // includes deleted slots
+    HashObj *sparse_keys;
+
+    // deleted names, reused oldest first
+    GLuint *free_names;
+    unsigned free_size;
+    unsigned free_head;
+    unsigned free_count;
+
+    unsigned stale_lookups; // debug builds, searches for deleted names
 } HashTable;
 
 HashTable *createHashTable(GLuint size);
 void initHashTable(HashTable *ptr, GLuint size);
+void freeHashTable(HashTable *ptr);
 GLuint getNewName(HashTable *table);
 void insertHashElement(HashTable *table, GLuint name, void *data);
 void *searchHashTable(HashTable *table, GLuint name);
 void deleteHashElement(HashTable *table, GLuint name);
+GLuint getNameGeneration(HashTable *table, GLuint name);
+void iterateHashTable(HashTable *table, void (*func)(void *data, void *arg), void *arg);
 
 #endif /* hash_table_h */
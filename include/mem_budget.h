@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * mem_budget.h
+ * MGL
+ *
+ */
+
+#ifndef mem_budget_h
+#define mem_budget_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "glcorearb.h"
+#include "MGLContext.h"
+
+// cpu shadow copies of objects that also live on the gpu
+//
+// every shadow byte is counted as resident. once an object's gpu copy is up to date
+// its shadow goes on the lru, when resident goes over the budget the least recently
+// used ones are handed back to the caller to drop. the caller reads a dropped shadow
+// back from the gpu if it's ever needed again.
+
+typedef struct MemLRUNode_t
+{
+    struct MemLRUNode_t *prev;
+    struct MemLRUNode_t *next; // NULL when not on the lru
+    size_t size;
+} MemLRUNode;
+
+typedef struct MemBudgetStats_t
+{
+    size_t resident;  // shadow bytes held
+    size_t evictable; // of those, on the lru
+    size_t evictions;
+    size_t evicted_bytes;
+    size_t restores;
+    size_t restored_bytes;
+} MemBudgetStats;
+
+// bytes held by one object type, the public MGLMemoryStats
+typedef MGLMemoryStats MemoryStats;
+
+typedef struct MemBudget_t
+{
+    MemLRUNode lru; // lru.next is the least recently used
+    size_t budget;  // 0 is no limit
+    MemBudgetStats stats;
+} MemBudget;
+
+void initMemBudget(MemBudget *mb, size_t budget);
+void setMemBudget(MemBudget *mb, size_t budget);
+
+void addMemResident(MemBudget *mb, size_t size);
+void removeMemResident(MemBudget *mb, size_t size);
+
+// inserts or moves node to the most recently used end
+void touchMemLRU(MemBudget *mb, MemLRUNode *node, size_t size);
+void removeMemLRU(MemBudget *mb, MemLRUNode *node);
+
+static inline bool isOnMemLRU(MemLRUNode *node)
+{
+    return node->next != NULL;
+}
+
+// least recently used node while resident is over budget, still on the lru
+MemLRUNode *findMemEvictCandidate(MemBudget *mb);
+
+void recordMemEviction(MemBudget *mb, size_t size);
+void recordMemRestore(MemBudget *mb, size_t size);
+
+void getMemBudgetStats(MemBudget *mb, MemBudgetStats *stats);
+
+#endif /* mem_budget_h */
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * mipmap_filter.h
+ * MGL
+ *
+ */
+
+#ifndef mipmap_filter_h
+#define mipmap_filter_h
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "pixel_convert.h"
+
+// builds mipmap levels on the cpu out of texture level shadows
+//
+// each dimension halves, rounding down and never below 1. an even dimension
+// is a 2 tap box, an odd one takes a 3 tap filter so every texel of the level
+// above still weighs the same in the level below. 8 and 16 bit unorm, half
+// and float layouts are filtered, packed layouts aren't.
+
+// max(size / 2, 1)
+size_t getMipmapSize(size_t size);
+
+bool canFilterMipmap(PixelLayout layout);
+
+// writes the level below a src_width x src_height x src_depth image. depth
+// halves like the other dimensions, array layers are filtered one at a time
+// with a depth of 1. srgb filters the color channels of 8 bit layouts in linear
+// space, alpha stays linear. false if the layout can't be filtered.
+bool filterMipmapLevel(PixelLayout layout, bool srgb, void *dst, size_t dst_pitch, size_t dst_image_pitch,
+                       const void *src, size_t src_pitch, size_t src_image_pitch, size_t src_width, size_t src_height,
+                       size_t src_depth);
+// the same without the vector kernels, the reference they're checked against
+bool filterMipmapLevelGeneric(PixelLayout layout, bool srgb, void *dst, size_t dst_pitch, size_t dst_image_pitch,
+                              const void *src, size_t src_pitch, size_t src_image_pitch, size_t src_width,
+                              size_t src_height, size_t src_depth);
+
+#endif /* mipmap_filter_h */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * object_pool.h
+ * MGL
+ *
+ */
+
+#ifndef object_pool_h
+#define object_pool_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "glcorearb.h"
+#include "MGLContext.h"
+
+#define OBJECT_POOL_ALIGN 64
+#define OBJECT_POOL_MAX_SLAB_OBJS 256
+#define OBJECT_POOL_MIN_SLAB_SIZE (16 * 1024)
+
+// the public MGLObjectPoolStats
+typedef MGLObjectPoolStats ObjectPoolStats;
+
+// slabs are allocated aligned to their own size so an object finds its slab by
+// masking its address
+typedef struct ObjectSlab_t
+{
+    struct ObjectSlab_t *next;
+    unsigned num_objs;
+    unsigned used; // objects handed out from this slab at least once
+    uint64_t live_mask[OBJECT_POOL_MAX_SLAB_OBJS / 64];
+} ObjectSlab;
+
+typedef struct ObjectPool_t
+{
+    size_t obj_size; // rounded up to OBJECT_POOL_ALIGN
+    size_t slab_size;
+    size_t slab_header_size;
+    unsigned objs_per_slab;
+    ObjectSlab *slabs; // newest first, only the head has unused objects
+    void *free_list;   // recycled objects, first word links to the next
+    ObjectPoolStats stats;
+} ObjectPool;
+
+void initObjectPool(ObjectPool *pool, size_t obj_size);
+void freeObjectPool(ObjectPool *pool);
+void *newPoolObject(ObjectPool *pool);
+void freePoolObject(ObjectPool *pool, void *obj);
+void iterateObjectPool(ObjectPool *pool, void (*func)(void *obj, void *arg), void *arg);
+void getObjectPoolStats(ObjectPool *pool, ObjectPoolStats *stats);
+
+#endif /* object_pool_h */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * page_allocator.h
+ * MGL
+ *
+ */
+
+#ifndef page_allocator_h
+#define page_allocator_h
+
+#include <stddef.h>
+
+// backing store for buffer, texture level and readback data
+//
+// small requests come from power of 2 size classes carved out of shared chunks,
+// medium requests from the heap and large ones are mapped directly. the size
+// returned in alloc_size is what has to be passed back to freePages, it also
+// picks the path so callers just keep it next to the pointer like they kept the
+// vm_allocate size. memory always comes back zeroed, like vm_allocate.
+
+#define PAGE_ALLOC_MIN_CLASS 16
+#define PAGE_ALLOC_MAX_CLASS 2048
+#define PAGE_ALLOC_CHUNK_SIZE (64 * 1024)
+#define PAGE_ALLOC_LARGE_SIZE (256 * 1024)
+#define PAGE_ALLOC_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// page aligned and padded to whole pages, for memory that gets wrapped by
+// newBufferWithBytesNoCopy
+#define PAGE_ALLOC_ZERO_COPY 0x1
+// ask the OS for huge pages on large allocations where it supports it
+#define PAGE_ALLOC_HUGE_PAGES 0x2
+
+typedef struct PageAllocatorStats_t
+{
+    size_t small_bytes;  // handed out from size classes
+    size_t small_chunks; // chunks backing the size classes
+    size_t heap_bytes;
+    size_t mapped_bytes;
+    size_t allocs;
+    size_t frees;
+} PageAllocatorStats;
+
+size_t getPageSize(void);
+size_t page_size_align(size_t size);
+
+void *allocPages(size_t size, unsigned flags, size_t *alloc_size);
+void freePages(void *ptr, size_t alloc_size);
+
+void getPageAllocatorStats(PageAllocatorStats *stats);
+
+#endif /* page_allocator_h */
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pattern_fill.h
+ * MGL
+ *
+ */
+
+
+#ifndef pattern_fill_h
+#define pattern_fill_h
+
+#include <stddef.h>
+
+// fill size bytes at dst with a repeating pattern, size is expected to be a
+// multiple of pattern_size. 1, 2, 4, 8, 12 and 16 byte patterns are stored a
+// vector at a time, anything else falls back to a copy per element.
+void patternFill(void *dst, size_t size, const void *pattern, size_t pattern_size);
+
+#endif /* pattern_fill_h */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_convert.h
+ * MGL
+ *
+ */
+
+#ifndef pixel_convert_h
+#define pixel_convert_h
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// converts rows of pixels between the memory layouts of GL format / type pairs
+// and the layouts textures are stored in, both ways
+//
+// common pairs (rgb8 / bgra8 / 565 into rgba8, float into half, and back out
+// for reads..) have vector kernels, everything else goes through rgba floats a
+// chunk at a time. layouts are named by byte order in memory, the packed 16 bit
+// ones by bit order from the high bit down like GL names them.
+
+typedef enum
+{
+    PIXEL_LAYOUT_INVALID = 0,
+
+    // 8 bit unorm
+    PIXEL_LAYOUT_R8,
+    PIXEL_LAYOUT_RG8,
+    PIXEL_LAYOUT_RGB8,
+    PIXEL_LAYOUT_BGR8,
+    PIXEL_LAYOUT_RGBA8,
+    PIXEL_LAYOUT_BGRA8,
+    PIXEL_LAYOUT_ABGR8, // GL_RGBA + GL_UNSIGNED_INT_8_8_8_8 on little endian
+    PIXEL_LAYOUT_ARGB8, // GL_BGRA + GL_UNSIGNED_INT_8_8_8_8
+
+    // packed 16 bit unorm
+    PIXEL_LAYOUT_RGB565,
+    PIXEL_LAYOUT_BGR565, // GL_UNSIGNED_SHORT_5_6_5_REV
+    PIXEL_LAYOUT_RGBA4444,
+    PIXEL_LAYOUT_RGBA5551,
+
+    // 16 bit unorm
+    PIXEL_LAYOUT_R16,
+    PIXEL_LAYOUT_RG16,
+    PIXEL_LAYOUT_RGB16,
+    PIXEL_LAYOUT_RGBA16,
+
+    // 32 bit unorm, depth read as GL_UNSIGNED_INT
+    PIXEL_LAYOUT_R32,
+
+    // half float
+    PIXEL_LAYOUT_R16F,
+    PIXEL_LAYOUT_RG16F,
+    PIXEL_LAYOUT_RGB16F,
+    PIXEL_LAYOUT_RGBA16F,
+
+    // float
+    PIXEL_LAYOUT_R32F,
+    PIXEL_LAYOUT_RG32F,
+    PIXEL_LAYOUT_RGB32F,
+    PIXEL_LAYOUT_RGBA32F,
+
+    PIXEL_LAYOUT_COUNT
+} PixelLayout;
+
+// bytes per pixel, 0 for PIXEL_LAYOUT_INVALID
+size_t getPixelLayoutSize(PixelLayout layout);
+
+// missing green / blue come out as 0 and missing alpha as 1, extra channels are dropped.
+// false only for PIXEL_LAYOUT_INVALID.
+bool canConvertPixels(PixelLayout dst_layout, PixelLayout src_layout);
+
+// count pixels from src to dst, a row at a time is the intended use. false if
+// the pair can't be converted. dst and src must not overlap.
+bool convertPixels(PixelLayout dst_layout, void *dst, PixelLayout src_layout, const void *src, size_t count);
+// the same without the vector kernels, the reference they're checked against
+bool convertPixelsGeneric(PixelLayout dst_layout, void *dst, PixelLayout src_layout, const void *src, size_t count);
+
+uint16_t floatToHalf(float f);
+float halfToFloat(uint16_t h);
+
+#endif /* pixel_convert_h */
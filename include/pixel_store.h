@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_store.h
+ * MGL
+ *
+ */
+
+#ifndef pixel_store_h
+#define pixel_store_h
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "pixel_convert.h"
+
+// where an image's rows are in client memory under the glPixelStore rules, and
+// the strided row copy used to move them in and out of texture levels
+
+typedef struct PixelStoreParams_t
+{
+    size_t alignment; // 1, 2, 4 or 8
+    size_t row_length;
+    size_t image_height;
+    size_t skip_pixels;
+    size_t skip_rows;
+    size_t skip_images;
+    bool swap_bytes;
+} PixelStoreParams;
+
+typedef struct PixelStoreLayout_t
+{
+    size_t offset;      // to the first pixel, the skips
+    size_t row_pitch;   // row_length (or width) pixels rounded up to alignment
+    size_t image_pitch; // row_pitch * image_height (or height)
+    size_t row_size;    // bytes of pixels in a row, width * pixel_size
+    size_t size;        // offset to the end of the last row, what has to be readable
+    size_t swap_size;   // element size to byte swap, 0 if no swapping
+} PixelStoreLayout;
+
+// element_size is the size of a component or of the whole packed pixel, it's
+// what gets byte swapped. skip_images and image_height are used only when
+// is_3d, the 2d calls ignore them.
+void getPixelStoreLayout(const PixelStoreParams *params, size_t pixel_size, size_t element_size, bool is_3d,
+                         size_t width, size_t height, size_t depth, PixelStoreLayout *layout);
+
+// copies depth images of height rows of row_size bytes, rows that are back to
+// back on both sides go as one memcpy. swap_size 2, 4 or 8 byte swaps each
+// element on the way, anything else copies as is.
+void copyPixelRows(void *dst, size_t dst_pitch, size_t dst_image_pitch, const void *src, size_t src_pitch,
+                   size_t src_image_pitch, size_t row_size, size_t height, size_t depth, size_t swap_size);
+
+// writes width x height x depth src pixels into dst laid out by layout, the
+// skips included, converting them from src_pixels to dst_pixels and byte
+// swapping last. the pack side of an upload, false if the pair can't be converted.
+bool packPixelRows(void *dst, const PixelStoreLayout *layout, PixelLayout dst_pixels, const void *src,
+                   size_t src_pitch, size_t src_image_pitch, PixelLayout src_pixels, size_t width, size_t height,
+                   size_t depth);
+
+// size bytes, in place is fine
+void swapPixelBytes(void *dst, const void *src, size_t size, size_t swap_size);
+
+#endif /* pixel_store_h */
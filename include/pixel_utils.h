@@ -23,6 +23,7 @@
 
 #include <os/availability.h>
 #include "glcorearb.h"
+#include "pixel_convert.h"
 
 typedef enum MTLPixelFormat_t MTLPixelFormat;
 
@@ -44,6 +45,17 @@ GLenum internalFormatForGLFormatType(GLenum format, GLenum type);
 MTLPixelFormat mtlFormatForGLInternalFormat(GLenum internal_format);
 MTLPixelFormat mtlPixelFormatForGLFormatType(GLenum gl_format, GLenum gl_type);
 
+// memory layouts for pixel conversion, PIXEL_LAYOUT_INVALID when there's no conversion for it
+PixelLayout pixelLayoutForFormatType(GLenum format, GLenum type);
+PixelLayout pixelLayoutForInternalFormat(GLenum internalformat);
+PixelLayout pixelLayoutForMTLPixelFormat(MTLPixelFormat pixel_format);
+bool canPixelConvertToInternalFormat(GLenum internalformat, GLenum format, GLenum type);
+
+// GL_VIEW_CLASS_* of an internal format, 0 when it isn't in a class. glTextureView
+// reinterprets storage with any format of the same class
+GLenum viewClassForInternalFormat(GLenum internalformat);
+bool isViewCompatibleFormat(GLenum internalformat, GLenum view_internalformat);
+
 #ifndef API_AVAILABLE
 #define API_AVAILABLE(...)                                                                                             \
     __API_AVAILABLE_GET_MACRO(__VA_ARGS__, __API_AVAILABLE7, __API_AVAILABLE6, __API_AVAILABLE5, __API_AVAILABLE4,     \
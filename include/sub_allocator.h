@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * sub_allocator.h
+ * MGL
+ *
+ */
+
+#ifndef sub_allocator_h
+#define sub_allocator_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// places small buffers at offsets in a few large backing slabs instead of one
+// mtl buffer each
+//
+// each slab holds slots of a single power of 2 size class. the backing itself is
+// created by the caller through new_backing, the renderer makes an mtl buffer.
+// slots can still be read by queued command buffers when they're freed, they are
+// only reused once the serial they were freed at has completed.
+
+#define SUB_ALLOC_MIN_SIZE 256 // also the slot alignment, metal wants 256 for buffer offsets
+#define SUB_ALLOC_MAX_SIZE (64 * 1024)
+#define SUB_ALLOC_NUM_CLASSES 9 // 256 .. 64k
+#define SUB_ALLOC_SLAB_SIZE (1024 * 1024)
+
+typedef struct SubAllocSlab_t
+{
+    struct SubAllocSlab_t *next;
+    void *backing;  // from new_backing
+    char *contents; // cpu address of offset 0
+    unsigned size_class;
+    unsigned num_slots;
+    unsigned used;
+    uint64_t *free_mask; // set bits are free slots
+} SubAllocSlab;
+
+typedef struct SubAllocPending_t
+{
+    SubAllocSlab *slab;
+    size_t offset;
+    uint64_t serial;
+} SubAllocPending;
+
+typedef struct SubAllocatorStats_t
+{
+    size_t slabs;
+    size_t bytes;      // backing held by slabs
+    size_t live;       // slots handed out
+    size_t live_bytes; // slot bytes of those
+    size_t pending;    // freed slots waiting on the gpu
+    size_t allocs;
+    size_t frees;
+} SubAllocatorStats;
+
+typedef struct SubAllocator_t
+{
+    SubAllocSlab *slabs[SUB_ALLOC_NUM_CLASSES];
+    SubAllocPending *pending;
+    size_t pending_count;
+    size_t pending_size;
+    void *(*new_backing)(void *arg, size_t size, void **contents);
+    void (*free_backing)(void *arg, void *backing);
+    void *arg;
+    SubAllocatorStats stats;
+} SubAllocator;
+
+void initSubAllocator(SubAllocator *alloc, void *(*new_backing)(void *arg, size_t size, void **contents),
+                      void (*free_backing)(void *arg, void *backing), void *arg);
+void freeSubAllocator(SubAllocator *alloc);
+
+// NULL if size is over SUB_ALLOC_MAX_SIZE or there's no backing for a new slab
+SubAllocSlab *newSubAllocation(SubAllocator *alloc, size_t size, size_t *offset);
+// the slot can be reused once serial has completed
+void freeSubAllocation(SubAllocator *alloc, SubAllocSlab *slab, size_t offset, uint64_t serial, uint64_t completed);
+void reclaimSubAllocations(SubAllocator *alloc, uint64_t completed);
+
+size_t getSubAllocationSize(SubAllocSlab *slab);
+void getSubAllocatorStats(SubAllocator *alloc, SubAllocatorStats *stats);
+
+#endif /* sub_allocator_h */
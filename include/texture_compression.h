@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * texture_compression.h
+ * MGL
+ *
+ */
+
+#ifndef texture_compression_h
+#define texture_compression_h
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "glcorearb.h"
+
+// block compressed internal formats, their block sizes and a cpu decoder for
+// the ones a device might not sample
+//
+// texture levels keep the blocks as they were uploaded. s3tc, rgtc and
+// etc2 / eac decode to a plain format when the device can't take them, bptc
+// and astc are passed through or refused. block rows are tightly packed, a
+// level is whole blocks so edges round up to the block size.
+
+typedef enum
+{
+    COMPRESSED_BLOCKS_INVALID = 0,
+
+    COMPRESSED_BLOCKS_BC1,       // rgb, 1 bit alpha in the 3 color mode
+    COMPRESSED_BLOCKS_BC1_RGB,   // the same, opaque black instead of clear
+    COMPRESSED_BLOCKS_BC2,       // bc1 color, 4 bit alpha
+    COMPRESSED_BLOCKS_BC3,       // bc1 color, bc4 alpha
+    COMPRESSED_BLOCKS_BC4,       // red
+    COMPRESSED_BLOCKS_BC4_SNORM,
+    COMPRESSED_BLOCKS_BC5,       // red, green
+    COMPRESSED_BLOCKS_BC5_SNORM,
+    COMPRESSED_BLOCKS_BC6H,
+    COMPRESSED_BLOCKS_BC7,
+    COMPRESSED_BLOCKS_ETC2_RGB8,
+    COMPRESSED_BLOCKS_ETC2_RGB8A1,
+    COMPRESSED_BLOCKS_ETC2_RGBA8, // eac alpha, etc2 color
+    COMPRESSED_BLOCKS_EAC_R11,
+    COMPRESSED_BLOCKS_EAC_R11_SNORM,
+    COMPRESSED_BLOCKS_EAC_RG11,
+    COMPRESSED_BLOCKS_EAC_RG11_SNORM,
+    COMPRESSED_BLOCKS_ASTC,
+
+    COMPRESSED_BLOCKS_COUNT
+} CompressedBlocks;
+
+typedef struct CompressedFormat_t
+{
+    CompressedBlocks blocks;
+    GLuint block_width;
+    GLuint block_height;
+    GLuint block_size; // bytes
+    bool srgb;
+
+    // what the blocks decode to, 0 when there's no decoder for them
+    GLenum decoded_format;
+    GLuint decoded_size; // bytes per texel
+} CompressedFormat;
+
+// false for anything that isn't a block compressed internal format, the generic
+// GL_COMPRESSED_RGB.. are the driver's choice and aren't uploaded as blocks
+bool getCompressedFormat(GLenum internalformat, CompressedFormat *format);
+
+size_t getCompressedRowSize(const CompressedFormat *format, size_t width);
+size_t getCompressedImageSize(const CompressedFormat *format, size_t width, size_t height, size_t depth);
+
+// decodes a width x height image, block rows are src_pitch apart. the texels
+// land in dst in decoded_format rows dst_pitch apart, false without a decoder
+bool decodeCompressedBlocks(const CompressedFormat *format, void *dst, size_t dst_pitch, const void *src,
+                            size_t src_pitch, size_t width, size_t height);
+
+// the same for every image of a level, larger levels split their block rows
+// over a few threads
+bool decodeCompressedImage(const CompressedFormat *format, void *dst, size_t dst_pitch, size_t dst_image_pitch,
+                           const void *src, size_t src_pitch, size_t src_image_pitch, size_t width, size_t height,
+                           size_t depth);
+
+#endif /* texture_compression_h */
@@ -28,6 +28,8 @@
 #include <mach/mach_init.h>
 #include <mach/vm_map.h>
 #include <execinfo.h>
+#include <pthread.h>
+#include <time.h>
 
 // Header shared between C code here, which executes Metal API commands, and .metal files, which
 // uses these types as inputs to the shaders.
@@ -36,6 +38,8 @@
 #import "MGLRenderer.h"
 #import "glm_context.h"
 #import "buffers.h"
+#import "texture_compression.h"
+#import "pattern_fill.h"
 
 #define TRACE_FUNCTION() DEBUG_PRINT("%s\n", __FUNCTION__);
 
@@ -46,14 +50,23 @@ extern void mglDrawBuffer(GLMContext ctx, GLenum buf);
 // for resource types SPVC_RESOURCE_TYPE_UNIFORM_BUFFER..
 #import "spirv_cross_c.h"
 
-typedef struct SyncList_t
-{
-    GLuint count;
-    GLuint size;
-    Sync **list;
-} SyncList;
-
 MTLPixelFormat mtlPixelFormatForGLTex(Texture *gl_tex);
+PixelLayout pixelLayoutForMTLPixelFormat(MTLPixelFormat pixel_format);
+GLuint sizeForInternalFormat(GLenum internalformat, GLenum format, GLenum type);
+
+// buffers under 4k, uniforms and element data without an mtl buffer are bump
+// allocated out of a few large shared buffers instead of being copied inline
+// with set*Bytes or into a new MTLBuffer per draw
+#define MAX_UPLOAD_ARENAS 8
+#define UPLOAD_ARENA_SIZE (4 * 1024 * 1024)
+#define UPLOAD_ARENA_ALIGN 256 // constant buffer offsets
+
+typedef struct UploadArena_t
+{
+    void *mtl_data;
+    GLuint64 serial;     // last command buffer to reference it
+    GLuint64 generation; // bumped on reset, invalidates offsets handed out before
+} UploadArena;
 
 typedef struct MGLDrawable_t
 {
@@ -108,14 +121,28 @@ enum
 
     // each pass a new command buffer is created
     id<MTLCommandBuffer> _currentCommandBuffer;
-    SyncList *_currentCommandBufferSyncList;
+
+    // buffers and fences are tagged with the serial of the last command buffer using them
+    GLuint64 _commandBufferSerial;
+    GLuint64 _completedSerial;
+    pthread_mutex_t _completedLock;
+    pthread_cond_t _completedCond;
+
+    UploadArena _uploadArenas[MAX_UPLOAD_ARENAS];
+    GLuint _numUploadArenas;
+    GLuint _currentUploadArena;
+    size_t _uploadArenaOffset;
+    GLuint64 _uploadGeneration;
+
+    // slabs small gl buffers are packed into
+    SubAllocator _bufferSubAllocator;
 
     id<MTLRenderCommandEncoder> _currentRenderEncoder;
 
-    GLuint _blitOperationComplete;
+    // glCopyImageSubData blits in a row go in one encoder, ended with the render encoder
+    id<MTLBlitCommandEncoder> _copyEncoder;
 
-    id<MTLEvent> _currentEvent;
-    GLsizei _currentSyncName;
+    GLuint _blitOperationComplete;
 
     NSMutableDictionary<NSNumber *, id<MTLRenderPipelineState>> *_pipelineStateCache;
     
@@ -402,7 +429,17 @@ void logDirtyBits(GLMContext ctx)
 {
     MTLResourceOptions options;
 
-    options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeManaged;
+    // lives in a slab, already has its mtl buffer
+    if (ptr->data.slab)
+        return;
+
+    // persistent mappings are handed straight to the app, shared storage needs no
+    // didModifyRange so coherent writes are visible to the gpu without per draw flushes.
+    // client storage lives in app visible memory, a managed copy would defeat the point
+    if (ptr->storage_flags & (GL_MAP_PERSISTENT_BIT | GL_CLIENT_STORAGE_BIT))
+        options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
+    else
+        options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeManaged;
 
     // ways we will only write to this
     if ((ptr->storage_flags & GL_MAP_READ_BIT) == 0)
@@ -412,15 +449,35 @@ void logDirtyBits(GLMContext ctx)
 
     if (ptr->storage_flags & GL_CLIENT_STORAGE_BIT)
     {
-        id<MTLBuffer> buffer =
-            [_device newBufferWithBytesNoCopy:(void *)(ptr->data.buffer_data)
-                                       length:ptr->size // allocate only size since this is what will be transferred
-                                      options:options
-                                  deallocator:^(void *pointer, NSUInteger length) {
-                                    kern_return_t err;
-                                    err = vm_deallocate((vm_map_t)mach_task_self(), (vm_address_t)pointer, length);
-                                    assert(err == 0);
-                                  }];
+        // length passed to the deallocator is the mtl length, not what was allocated
+        size_t alloc_size = ptr->data.buffer_size;
+        void (^deallocator)(void *pointer, NSUInteger length);
+
+        // the mtl buffer owns the backing from here on, it's released once the
+        // gpu is done with it rather than when the gl object goes away
+        if (ptr->data.client_memory)
+        {
+            void (*release)(void *ptr, size_t size, void *user) = ptr->data.client_release;
+            void *user = ptr->data.client_release_user;
+
+            deallocator = ^(void *pointer, NSUInteger length) {
+              if (release)
+                  release(pointer, alloc_size, user);
+            };
+        }
+        else
+        {
+            deallocator = ^(void *pointer, NSUInteger length) {
+              freePages(pointer, alloc_size);
+            };
+        }
+
+        // wrap whole pages, the backing is page aligned and padded
+        id<MTLBuffer> buffer = [_device newBufferWithBytesNoCopy:(void *)(ptr->data.buffer_data)
+                                                          length:alloc_size
+                                                         options:options
+                                                     deallocator:deallocator];
+        RETURN_ON_NULL(buffer);
 
         ptr->data.mtl_data = (void *)CFBridgingRetain(buffer);
     }
@@ -432,18 +489,16 @@ void logDirtyBits(GLMContext ctx)
         // backing data to the MTL buffer
         if (ptr->data.buffer_data)
         {
-            // check the GL allocated size, not the vm_allocated size as these are page aligned
-            if (ptr->size > 4095)
+            // check the GL allocated size, not the allocation size as these are rounded up
+            // persistent buffers always need a pointer that stays put
+            if (ptr->size > 4095 || (ptr->storage_flags & GL_MAP_PERSISTENT_BIT))
             {
                 buffer = [_device newBufferWithBytes:(void *)ptr->data.buffer_data
                                               length:ptr->data.buffer_size
                                              options:options];
                 assert(buffer);
 
-                kern_return_t err;
-                err = vm_deallocate((vm_map_t)mach_task_self(), (vm_address_t)ptr->data.buffer_data,
-                                    ptr->data.buffer_size);
-                assert(err == 0);
+                freePages((void *)ptr->data.buffer_data, ptr->data.buffer_size);
 
                 ptr->data.buffer_data = (vm_address_t)buffer.contents;
             }
@@ -461,7 +516,8 @@ void logDirtyBits(GLMContext ctx)
                                           options:options];
             assert(buffer);
 
-            ptr->data.buffer_data = (vm_address_t)NULL;
+            ptr->data.buffer_data = (vm_address_t)buffer.contents;
+            ptr->data.buffer_size = buffer.length;
         }
 
         ptr->data.mtl_data = (void *)CFBridgingRetain(buffer);
@@ -525,6 +581,8 @@ void logDirtyBits(GLMContext ctx)
                 if (buf)
                 {
                     buffer_map->buffers[buffer_map->count].attribute_mask = 0; // non attribute.. no bits set
+                    buffer_map->buffers[buffer_map->count].gpu_writes =
+                        (gl_buffer_type == _SHADER_STORAGE_BUFFER || gl_buffer_type == _ATOMIC_COUNTER_BUFFER);
                     buffer_map->buffers[buffer_map->count].buffer_base_index = spirv_binding;
                     buffer_map->buffers[buffer_map->count].buf = buf;
                     buffer_map->buffers[buffer_map->count].offset = buffers[spirv_binding].offset;
@@ -574,6 +632,7 @@ void logDirtyBits(GLMContext ctx)
         }
 
         buffer_map->buffers[buffer_map->count].attribute_mask = 0;
+        buffer_map->buffers[buffer_map->count].gpu_writes = false;
         buffer_map->buffers[buffer_map->count].buffer_base_index = binding;
         buffer_map->buffers[buffer_map->count].buf = buf;
         buffer_map->buffers[buffer_map->count].offset = ctx->state.buffer_base[_UNIFORM_BUFFER].buffers[location].offset;
@@ -649,6 +708,7 @@ void logDirtyBits(GLMContext ctx)
                         // map the next buffer object to a metal vertex index
                         assert(buffer_map->count < ctx->state.max_vertex_attribs);
                         buffer_map->buffers[buffer_map->count].attribute_mask = (0x1 << att);
+                        buffer_map->buffers[buffer_map->count].gpu_writes = false;
                         buffer_map->buffers[buffer_map->count].buf = gl_buffer;
                         buffer_map->count++;
 
@@ -689,26 +749,229 @@ void logDirtyBits(GLMContext ctx)
     return true;
 }
 
+- (bool)nextUploadArena
+{
+    UploadArena *arena;
+    GLuint64 completed;
+    GLuint index;
+
+    completed = __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE);
+
+    arena = NULL;
+
+    // oldest first, the one after the current arena was filled longest ago
+    for (GLuint i = 1; i <= _numUploadArenas; i++)
+    {
+        index = (_currentUploadArena + i) % _numUploadArenas;
+
+        if (_uploadArenas[index].serial <= completed)
+        {
+            arena = &_uploadArenas[index];
+            break;
+        }
+    }
+
+    if (arena == NULL)
+    {
+        if (_numUploadArenas == MAX_UPLOAD_ARENAS)
+            return false;
+
+        id<MTLBuffer> buffer =
+            [_device newBufferWithLength:UPLOAD_ARENA_SIZE
+                                 options:MTLResourceStorageModeShared | MTLResourceCPUCacheModeWriteCombined];
+        RETURN_FALSE_ON_NULL(buffer);
+
+        index = _numUploadArenas++;
+        arena = &_uploadArenas[index];
+        arena->mtl_data = (void *)CFBridgingRetain(buffer);
+    }
+
+    arena->serial = 0;
+    arena->generation = ++_uploadGeneration;
+
+    _currentUploadArena = index;
+    _uploadArenaOffset = 0;
+
+    return true;
+}
+
+- (id<MTLBuffer>)uploadBytes:(const void *)bytes length:(size_t)length offset:(NSUInteger *)offset
+{
+    UploadArena *arena;
+    size_t start;
+
+    if (length > UPLOAD_ARENA_SIZE)
+        return nil;
+
+    start = (_uploadArenaOffset + UPLOAD_ARENA_ALIGN - 1) & ~(size_t)(UPLOAD_ARENA_ALIGN - 1);
+
+    if (_numUploadArenas == 0 || start + length > UPLOAD_ARENA_SIZE)
+    {
+        if ([self nextUploadArena] == false)
+            return nil;
+
+        start = 0;
+    }
+
+    arena = &_uploadArenas[_currentUploadArena];
+
+    id<MTLBuffer> buffer = (__bridge id<MTLBuffer>)(arena->mtl_data);
+
+    if (length)
+        memcpy((char *)buffer.contents + start, bytes, length);
+
+    arena->serial = _commandBufferSerial;
+    _uploadArenaOffset = start + length;
+
+    *offset = start;
+
+    return buffer;
+}
+
+// the mtl buffer and base offset to bind for a gl buffer, buffers without an mtl
+// buffer or a slab slot are copied to the upload arena once per modification
+- (id<MTLBuffer>)getMTLBuffer:(Buffer *)ptr offset:(NSUInteger *)offset
+{
+    id<MTLBuffer> buffer;
+
+    if (ptr->data.slab)
+    {
+        ptr->data.serial = _commandBufferSerial;
+
+        *offset = ptr->data.slab_offset;
+
+        return (__bridge id<MTLBuffer>)(ptr->data.slab->backing);
+    }
+
+    if (ptr->data.mtl_data)
+    {
+        ptr->data.serial = _commandBufferSerial;
+
+        *offset = 0;
+
+        return (__bridge id<MTLBuffer>)(ptr->data.mtl_data);
+    }
+
+    // still where it went last time
+    if ((ptr->data.dirty_bits & DIRTY_BUFFER_DATA) == 0 && ptr->data.upload_generation)
+    {
+        UploadArena *arena;
+
+        arena = &_uploadArenas[ptr->data.upload_arena];
+
+        if (arena->generation == ptr->data.upload_generation)
+        {
+            arena->serial = _commandBufferSerial;
+
+            *offset = ptr->data.upload_offset;
+
+            return (__bridge id<MTLBuffer>)(arena->mtl_data);
+        }
+    }
+
+    buffer = [self uploadBytes:(const void *)ptr->data.buffer_data length:ptr->size offset:offset];
+
+    if (buffer)
+    {
+        ptr->data.upload_arena = _currentUploadArena;
+        ptr->data.upload_generation = _uploadArenas[_currentUploadArena].generation;
+        ptr->data.upload_offset = *offset;
+    }
+    else
+    {
+        // every arena is still queued on the GPU, one off copy
+        buffer = [_device newBufferWithBytes:(void *)ptr->data.buffer_data
+                                      length:ptr->size
+                                     options:MTLResourceStorageModeShared];
+        assert(buffer);
+
+        ptr->data.upload_generation = 0;
+
+        *offset = 0;
+    }
+
+    // clear buffer data dirty bits
+    ptr->data.dirty_bits &= ~DIRTY_BUFFER_DATA;
+    clearDirtyRanges(&ptr->data.dirty_ranges);
+
+    return buffer;
+}
+
+- (void)flushDirtyRanges:(Buffer *)ptr buffer:(id<MTLBuffer>)buffer
+{
+    DirtyRangeSet *set;
+    size_t base, length;
+
+    set = &ptr->data.dirty_ranges;
+    base = 0;
+    length = buffer.length;
+
+    // ranges are relative to the slot, not the slab
+    if (ptr->data.slab)
+    {
+        base = ptr->data.slab_offset;
+        length = getSubAllocationSize(ptr->data.slab);
+    }
+
+    // the gpu sees shared storage as it's written
+    if (buffer.storageMode != MTLStorageModeManaged)
+    {
+        clearDirtyRanges(set);
+
+        return;
+    }
+
+    // nothing recorded, somebody dirtied the whole thing
+    if (set->count == 0)
+    {
+        [buffer didModifyRange:NSMakeRange(base, MIN(ptr->size, length))];
+
+        return;
+    }
+
+    for (unsigned i = 0; i < set->count; i++)
+    {
+        size_t start, end;
+
+        start = set->ranges[i].start;
+        end = MIN(set->ranges[i].end, length);
+
+        if (start < end)
+            [buffer didModifyRange:NSMakeRange(base + start, end - start)];
+    }
+
+    clearDirtyRanges(set);
+}
+
 - (bool)updateDirtyBuffer:(Buffer *)ptr
 {
-    // buffers less than 4k will be uploaded using setVertexBytes
-    if (ptr->size < 4096)
+    // the slab was mapped when it was created, only the written ranges need flushing
+    if (ptr->data.slab)
+    {
+        if (ptr->data.dirty_bits & DIRTY_BUFFER_DATA)
+            [self flushDirtyRanges:ptr buffer:(__bridge id<MTLBuffer>)(ptr->data.slab->backing)];
+
+        ptr->data.dirty_bits = 0;
+
+        return true;
+    }
+
+    // buffers less than 4k are copied to the upload arena when bound
+    if (ptr->size < 4096 && ptr->data.mtl_data == NULL)
     {
         ptr->data.dirty_bits &= ~DIRTY_BUFFER_ADDR;
 
         return true;
     }
 
-    if (ptr->data.dirty_bits & DIRTY_BUFFER_ADDR)
+    if ((ptr->data.dirty_bits & DIRTY_BUFFER_ADDR) && ptr->data.mtl_data == NULL)
     {
-        if (ptr->data.mtl_data == NULL)
-        {
-            [self bindMTLBuffer:ptr];
-            RETURN_FALSE_ON_NULL(ptr->data.mtl_data);
+        [self bindMTLBuffer:ptr];
+        RETURN_FALSE_ON_NULL(ptr->data.mtl_data);
 
-            // clear dirty bits
-            ptr->data.dirty_bits = 0;
-        }
+        // clear dirty bits
+        ptr->data.dirty_bits = 0;
+        clearDirtyRanges(&ptr->data.dirty_ranges);
     }
     else if (ptr->data.dirty_bits & DIRTY_BUFFER_DATA)
     {
@@ -719,6 +982,7 @@ void logDirtyBits(GLMContext ctx)
 
             // clear dirty bits
             ptr->data.dirty_bits = 0;
+            clearDirtyRanges(&ptr->data.dirty_ranges);
 
             // we had to create a buffer so no need to update data
             return true;
@@ -727,25 +991,16 @@ void logDirtyBits(GLMContext ctx)
         id<MTLBuffer> buffer = (__bridge id<MTLBuffer>)(ptr->data.mtl_data);
         assert(buffer);
 
-        // clear dirty bits if not mapped as coherent
-        // this will cause us to keep loading the buffer and keep the GPU
-        // contents in check for EVERY drawing operation
-        if (ptr->access & GL_MAP_COHERENT_BIT)
-        {
-            [buffer didModifyRange:NSMakeRange(ptr->mapped_offset, ptr->mapped_length)];
-
-            ptr->data.dirty_bits = DIRTY_BUFFER_DATA;
-        }
-        else
-        {
-            [buffer didModifyRange:NSMakeRange(0, ptr->data.buffer_size)];
+        // only what was written since the last flush, persistent buffers are shared
+        // and coherent writes never need one
+        [self flushDirtyRanges:ptr buffer:buffer];
 
-            ptr->data.dirty_bits = 0;
-        }
+        ptr->data.dirty_bits = 0;
     }
     else
     {
-        assert(0);
+        // storage came with its mtl buffer, nothing left to bind
+        ptr->data.dirty_bits &= ~DIRTY_BUFFER_ADDR;
     }
 
     return true;
@@ -814,33 +1069,20 @@ void logDirtyBits(GLMContext ctx)
 
         fprintf(stderr, "  Buffer %d: size=%lu, offset=%lld\n", i, ptr->size, (long long)offset);
 
-        // for buffers less than 4k we should use this call
-        if (ptr->size < 4096)
+        // Print first few floats from vertex data
+        if (ptr->data.buffer_data && ptr->size >= sizeof(float) * 3)
         {
-            assert(ptr->data.mtl_data == NULL);
-
-            // Print first few floats from vertex data
-            if (ptr->data.buffer_data && ptr->size >= sizeof(float) * 3)
-            {
-                float *verts = (float *)ptr->data.buffer_data;
-                fprintf(stderr, "    Vertex data (first 9 floats): %.2f %.2f %.2f, %.2f %.2f %.2f, %.2f %.2f %.2f\n",
-                        verts[0], verts[1], verts[2], verts[3], verts[4], verts[5], verts[6], verts[7], verts[8]);
-            }
-
-            [_currentRenderEncoder setVertexBytes:(const void *)ptr->data.buffer_data length:ptr->size atIndex:i];
-
-            // clear buffer data dirty bits
-            ptr->data.dirty_bits &= ~DIRTY_BUFFER_DATA;
+            float *verts = (float *)ptr->data.buffer_data;
+            fprintf(stderr, "    Vertex data (first 9 floats): %.2f %.2f %.2f, %.2f %.2f %.2f, %.2f %.2f %.2f\n",
+                    verts[0], verts[1], verts[2], verts[3], verts[4], verts[5], verts[6], verts[7], verts[8]);
         }
-        else
-        {
-            assert(ptr->data.mtl_data);
 
-            id<MTLBuffer> buffer = (__bridge id<MTLBuffer>)(ptr->data.mtl_data);
-            assert(buffer);
+        // small buffers sit in a slab or the upload arena, either way at a base offset
+        NSUInteger base;
+        id<MTLBuffer> buffer = [self getMTLBuffer:ptr offset:&base];
+        RETURN_FALSE_ON_NULL(buffer);
 
-            [_currentRenderEncoder setVertexBuffer:buffer offset:offset atIndex:i];
-        }
+        [_currentRenderEncoder setVertexBuffer:buffer offset:base + offset atIndex:i];
     }
 
     return true;
@@ -863,24 +1105,11 @@ void logDirtyBits(GLMContext ctx)
 
         assert(ptr);
 
-        if (ptr->size < 4096)
-        {
-            assert(ptr->data.mtl_data == NULL);
-
-            [_currentRenderEncoder setFragmentBytes:(const void *)ptr->data.buffer_data length:ptr->size atIndex:i];
-
-            // clear buffer data dirty bits
-            ptr->data.dirty_bits &= ~DIRTY_BUFFER_DATA;
-        }
-        else
-        {
-            assert(ptr->data.mtl_data);
-
-            id<MTLBuffer> buffer = (__bridge id<MTLBuffer>)(ptr->data.mtl_data);
-            assert(buffer);
+        NSUInteger base;
+        id<MTLBuffer> buffer = [self getMTLBuffer:ptr offset:&base];
+        RETURN_FALSE_ON_NULL(buffer);
 
-            [_currentRenderEncoder setFragmentBuffer:buffer offset:offset atIndex:i];
-        }
+        [_currentRenderEncoder setFragmentBuffer:buffer offset:base + offset atIndex:i];
     }
 
     return true;
@@ -986,63 +1215,144 @@ void logDirtyBits(GLMContext ctx)
     tex_desc.swizzle = MTLTextureSwizzleChannelsMake(channel_r, channel_g, channel_b, channel_a);
 }
 
-- (id<MTLTexture>)createMTLTextureFromGLTexture:(Texture *)tex
+// decodes a level of blocks into a malloc'd copy in the texture's decoded format
+- (void *)decodeTextureLevel:(TextureLevel *)tex_level
+                      forTex:(Texture *)tex
+                       pitch:(NSUInteger *)pitch
+                        size:(NSUInteger *)size
 {
-    NSUInteger width, height, depth;
+    CompressedFormat format;
+    size_t dst_pitch, dst_image_size;
+    void *dst;
 
-    MTLTextureDescriptor *tex_desc;
-    MTLTextureType tex_type;
-    MTLPixelFormat pixelFormat;
-    uint num_faces;
-    BOOL mipmapped;
-    BOOL is_array;
+    if (tex_level->data == NULL || getCompressedFormat(tex->internalformat, &format) == false)
+        return NULL;
+
+    dst_pitch = tex_level->width * format.decoded_size;
+    dst_image_size = dst_pitch * tex_level->height;
+
+    dst = malloc(dst_image_size * tex_level->depth);
+    if (dst == NULL)
+        return NULL;
+
+    if (decodeCompressedImage(&format, dst, dst_pitch, dst_image_size, tex_level->data, tex_level->pitch,
+                              tex_level->data_size / tex_level->depth, tex_level->width, tex_level->height,
+                              tex_level->depth) == false)
+    {
+        free(dst);
+        return NULL;
+    }
 
-    num_faces = 1;
-    is_array = false;
+    *pitch = dst_pitch;
+    *size = dst_image_size * tex_level->depth;
 
-    switch (tex->target)
+    return dst;
+}
+
+- (MTLTextureType)mtlTextureTypeForTarget:(GLenum)target
+{
+    switch (target)
     {
-        //        case GL_TEXTURE_1D: tex_type = MTLTextureType1D; break;
+        //        case GL_TEXTURE_1D: return MTLTextureType1D;
     case GL_TEXTURE_1D:
-        tex_type = MTLTextureType2D;
-        break;
+        return MTLTextureType2D;
     case GL_RENDERBUFFER:
-        tex_type = MTLTextureType2D;
-        break;
+        return MTLTextureType2D;
     case GL_TEXTURE_1D_ARRAY:
-        tex_type = MTLTextureType1DArray;
-        is_array = true;
-        break;
+        return MTLTextureType1DArray;
     case GL_TEXTURE_2D:
-        tex_type = MTLTextureType2D;
-        break;
+        return MTLTextureType2D;
     case GL_TEXTURE_2D_ARRAY:
-        tex_type = MTLTextureType2DArray;
-        is_array = true;
-        break;
-        // case GL_TEXTURE_2D_MULTISAMPLE: tex_type = MTLTextureType2DMultisample; break;
+        return MTLTextureType2DArray;
+        // case GL_TEXTURE_2D_MULTISAMPLE: return MTLTextureType2DMultisample;
 
     case GL_TEXTURE_CUBE_MAP:
-        num_faces = 6;
-        tex_type = MTLTextureTypeCube;
-        break;
+        return MTLTextureTypeCube;
 
     case GL_TEXTURE_CUBE_MAP_ARRAY:
-        num_faces = 6;
-        tex_type = MTLTextureTypeCubeArray;
-        break;
+        return MTLTextureTypeCubeArray;
 
     case GL_TEXTURE_3D:
-        tex_type = MTLTextureType3D;
-        break;
-        // case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: tex_type = MTLTextureType2DMultisampleArray;  is_array = true; break;
-        // case GL_TEXTURE_BUFFER: tex_type = MTLTextureTypeTextureBuffer; break;
+        return MTLTextureType3D;
+        // case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return MTLTextureType2DMultisampleArray;
+
+    case GL_TEXTURE_BUFFER:
+        return MTLTextureTypeTextureBuffer;
 
     default:
         assert(0);
         break;
     }
 
+    return MTLTextureType2D;
+}
+
+// what a view of the texture can be used for beyond sampling, only what the format allows on
+// the device. compressed blocks are only sampled, depth, stencil and multisample textures are
+// never written by a shader, and mac family gpus neither write srgb nor draw to or write rgb9e5
+- (MTLTextureUsage)viewUsageForPixelFormat:(MTLPixelFormat)pixelFormat tex:(Texture *)tex
+{
+    bool apple_gpu;
+
+    if (tex->compressed)
+        return MTLTextureUsageShaderRead;
+
+    if (tex->target == GL_TEXTURE_2D_MULTISAMPLE || tex->target == GL_TEXTURE_2D_MULTISAMPLE_ARRAY)
+        return MTLTextureUsageShaderRead | MTLTextureUsageRenderTarget;
+
+    apple_gpu = false;
+    if (@available(macOS 11.0, *))
+        apple_gpu = [_device supportsFamily:MTLGPUFamilyApple2];
+
+    switch (pixelFormat)
+    {
+    case MTLPixelFormatDepth16Unorm:
+    case MTLPixelFormatDepth32Float:
+    case MTLPixelFormatDepth24Unorm_Stencil8:
+    case MTLPixelFormatDepth32Float_Stencil8:
+    case MTLPixelFormatStencil8:
+    case MTLPixelFormatX24_Stencil8:
+    case MTLPixelFormatX32_Stencil8:
+        return MTLTextureUsageShaderRead | MTLTextureUsageRenderTarget;
+
+    case MTLPixelFormatR8Unorm_sRGB:
+    case MTLPixelFormatRG8Unorm_sRGB:
+    case MTLPixelFormatRGBA8Unorm_sRGB:
+    case MTLPixelFormatBGRA8Unorm_sRGB:
+        if (apple_gpu)
+            break;
+
+        return MTLTextureUsageShaderRead | MTLTextureUsageRenderTarget;
+
+    case MTLPixelFormatRGB9E5Float:
+        if (apple_gpu)
+            break;
+
+        return MTLTextureUsageShaderRead;
+
+    default:
+        break;
+    }
+
+    return MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite | MTLTextureUsageRenderTarget;
+}
+
+- (id<MTLTexture>)createMTLTextureFromGLTexture:(Texture *)tex
+{
+    NSUInteger width, height, depth;
+
+    MTLTextureDescriptor *tex_desc;
+    MTLTextureType tex_type;
+    MTLPixelFormat pixelFormat;
+    uint num_faces;
+    BOOL mipmapped;
+    BOOL is_array;
+
+    tex_type = [self mtlTextureTypeForTarget:tex->target];
+
+    num_faces = (tex_type == MTLTextureTypeCube || tex_type == MTLTextureTypeCubeArray) ? 6 : 1;
+    is_array = (tex_type == MTLTextureType1DArray || tex_type == MTLTextureType2DArray);
+
     // verify completeness of texture when used
     if (tex->num_levels > 1)
     {
@@ -1137,6 +1447,14 @@ void logDirtyBits(GLMContext ctx)
         tex_desc.usage |= MTLTextureUsageRenderTarget;
     }
 
+    // views may be in another format and drawn to or written where the texture isn't, the usage
+    // is widened once the first view is made. it costs lossless compression so textures without
+    // views don't get it, other than private storage that can't be read back to make it again
+    if (tex->has_views || (tex->immutable_storage && tex->mtl_requires_private_storage))
+    {
+        tex_desc.usage |= MTLTextureUsagePixelFormatView | [self viewUsageForPixelFormat:pixelFormat tex:tex];
+    }
+
     assert(tex_desc);
 
     if (tex->params.swizzled)
@@ -1147,6 +1465,8 @@ void logDirtyBits(GLMContext ctx)
     id<MTLTexture> texture = [_device newTextureWithDescriptor:tex_desc];
     assert(texture);
 
+    tex->mtl_alloc_size = texture.allocatedSize;
+
     if (tex->dirty_bits & DIRTY_TEXTURE_DATA)
     {
         MTLRegion region;
@@ -1155,6 +1475,38 @@ void logDirtyBits(GLMContext ctx)
         {
             for (int level = 0; level < tex->num_levels; level++)
             {
+                // glInvalidateTexImage, whatever the shadow holds doesn't matter
+                if (isTexLevelInvalidated(tex, face, level))
+                    continue;
+
+                // never given a shadow, there's nothing the gpu copy doesn't have
+                if (tex->faces[face].levels[level].data == 0)
+                    continue;
+
+                GLubyte *level_data;
+                NSUInteger level_pitch, level_size;
+                void *decoded;
+
+                level_data = (GLubyte *)tex->faces[face].levels[level].data;
+                level_pitch = tex->faces[face].levels[level].pitch;
+                level_size = tex->faces[face].levels[level].data_size;
+                decoded = NULL;
+
+                // the device can't sample these blocks, upload a decoded copy
+                if (tex->decoded_format)
+                {
+                    decoded = [self decodeTextureLevel:&tex->faces[face].levels[level]
+                                                forTex:tex
+                                                 pitch:&level_pitch
+                                                  size:&level_size];
+
+                    // out of memory, the level stays undefined
+                    if (decoded == NULL)
+                        continue;
+
+                    level_data = (GLubyte *)decoded;
+                }
+
                 width = tex->faces[face].levels[level].width;
                 height = tex->faces[face].levels[level].height;
                 depth = tex->faces[face].levels[level].depth;
@@ -1172,24 +1524,24 @@ void logDirtyBits(GLMContext ctx)
                 if (tex_type == MTLTextureType3D)
                 {
                     // ogl considers an image a "row".. metal must be different
-                    bytesPerRow = tex->faces[face].levels[level].pitch;
+                    bytesPerRow = level_pitch;
                     assert(bytesPerRow);
 
-                    bytesPerImage = bytesPerRow * height;
+                    bytesPerImage = level_size / depth;
 
                     [texture replaceRegion:region
                                mipmapLevel:level
                                      slice:0
-                                 withBytes:(void *)tex->faces[face].levels[level].data
+                                 withBytes:(void *)level_data
                                bytesPerRow:bytesPerRow
                              bytesPerImage:bytesPerImage];
                 }
                 else
                 {
-                    bytesPerRow = tex->faces[face].levels[level].pitch;
+                    bytesPerRow = level_pitch;
                     assert(bytesPerRow);
 
-                    bytesPerImage = tex->faces[face].levels[level].data_size;
+                    bytesPerImage = level_size;
                     assert(bytesPerImage);
 
                     if (is_array)
@@ -1212,9 +1564,13 @@ void logDirtyBits(GLMContext ctx)
 
                         for (int layer = 0; layer < num_layers; layer++)
                         {
+                            // an invalidated layer, the others still go up
+                            if (layer < 64 && (tex->faces[face].levels[level].invalidated_images & (1ull << layer)))
+                                continue;
+
                             offset = bytesPerImage * layer;
 
-                            tex_data = (GLubyte *)tex->faces[face].levels[level].data;
+                            tex_data = level_data;
                             tex_data += offset;
 
                             [texture replaceRegion:region
@@ -1232,11 +1588,13 @@ void logDirtyBits(GLMContext ctx)
                         [texture replaceRegion:region
                                    mipmapLevel:level
                                          slice:face
-                                     withBytes:(void *)tex->faces[face].levels[level].data
+                                     withBytes:(void *)level_data
                                    bytesPerRow:bytesPerRow
                                  bytesPerImage:(NSUInteger)bytesPerImage];
                     }
                 }
+
+                free(decoded);
             }
         }
     }
@@ -1545,6 +1903,7 @@ void logDirtyBits(GLMContext ctx)
 
 extern bool isColorAttachment(GLMContext ctx, GLuint attachment);
 extern FBOAttachment *getFBOAttachment(GLMContext ctx, Framebuffer *fbo, GLenum attachment);
+extern GLuint getFBOAttachmentImage(FBOAttachment *fbo_attachment);
 
 - (void)mtlBlitFramebuffer:(GLMContext)glm_ctx
                      srcX0:(size_t)srcX0
@@ -1615,6 +1974,8 @@ extern FBOAttachment *getFBOAttachment(GLMContext ctx, Framebuffer *fbo, GLenum
         assert(drawtexobj);
         drawtexid = (__bridge id<MTLTexture>)(drawtexobj->mtl_data);
         assert(drawtexid);
+
+        writeTexImages(drawtexobj, fboa->level, getFBOAttachmentImage(fboa), 1);
     }
 
     // end encoding on current render encoder
@@ -1669,37 +2030,402 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
     return tex;
 }
 
-- (bool)bindMTLTexture:(Texture *)tex
+// the pass writes the attachment's face or layer, its contents are defined again after it
+- (bool)takeInvalidatedAttachment:(FBOAttachment *)fbo_attachment
 {
-    if (tex->dirty_bits)
-    {
-        // release mtl data
-        if (tex->mtl_data)
-        {
-            CFBridgingRelease(tex->mtl_data);
-            tex->mtl_data = NULL;
-        }
+    Texture *tex;
 
-        if (tex->params.mtl_data)
-        {
-            CFBridgingRelease(tex->params.mtl_data);
-            tex->params.mtl_data = NULL;
-        }
-    }
+    tex = [self framebufferAttachmentTexture:fbo_attachment];
+
+    return writeTexImages(tex, fbo_attachment->level, getFBOAttachmentImage(fbo_attachment), 1);
+}
+
+// a draw writes the framebuffer's attachments, an invalidate since the pass began no longer
+// holds for them and the next pass loads what was drawn
+- (void)writeFramebufferAttachments
+{
+    Framebuffer *fbo;
+
+    fbo = ctx->state.framebuffer;
+    if (fbo == NULL)
+        return;
+
+    for (int i = 0; i < MAX_COLOR_ATTACHMENTS; i++)
+    {
+        if (fbo->color_attachments[i].texture)
+            [self takeInvalidatedAttachment:&fbo->color_attachments[i]];
+    }
+
+    if (fbo->depth.texture)
+        [self takeInvalidatedAttachment:&fbo->depth];
+
+    if (fbo->stencil.texture)
+        [self takeInvalidatedAttachment:&fbo->stencil];
+}
+
+- (bool)bindMTLTexture:(Texture *)tex
+{
+    if (tex->view_parent)
+        return [self bindMTLTextureView:tex];
+
+    if (tex->target == GL_TEXTURE_BUFFER)
+        return [self bindMTLTextureBuffer:tex];
+
+    if (tex->dirty_bits)
+    {
+        // a parameter change only needs a new sampler, a new swizzle needs the texture made again
+        if (tex->dirty_bits == DIRTY_TEX_PARAM && tex->mtl_data && [self isTextureSwizzleCurrent:tex])
+        {
+            if (tex->params.mtl_data)
+                CFBridgingRelease(tex->params.mtl_data);
+
+            tex->params.mtl_data = (void *)CFBridgingRetain([self createMTLSamplerForTexParam:&tex->params
+                                                                                       target:tex->target]);
+            assert(tex->params.mtl_data);
+
+            tex->dirty_bits = 0;
+        }
+    }
+
+    if (tex->dirty_bits)
+    {
+        // the texture is made again from the shadow, a dropped or stale one comes back from the gpu
+        // copy before it goes. gl calls that make it again have finished the gpu's queued work and read
+        // it back already, this only sees what was committed as a draw can be encoding here
+        if (tex->mtl_data)
+        {
+            RETURN_FALSE_ON_FAILURE(readBackTextureShadow(ctx, tex));
+
+            tex->dirty_bits |= DIRTY_TEXTURE_DATA;
+        }
+
+        // release mtl data
+        if (tex->mtl_data)
+        {
+            CFBridgingRelease(tex->mtl_data);
+            tex->mtl_data = NULL;
+        }
+
+        if (tex->params.mtl_data)
+        {
+            CFBridgingRelease(tex->params.mtl_data);
+            tex->params.mtl_data = NULL;
+        }
+    }
 
     if (tex->mtl_data == NULL)
     {
         tex->mtl_data = (void *)CFBridgingRetain([self createMTLTextureFromGLTexture:tex]);
         assert(tex->mtl_data);
 
+        tex->mtl_generation++;
+
+        tex->params.mtl_data = (void *)CFBridgingRetain([self createMTLSamplerForTexParam:&tex->params
+                                                                                   target:tex->target]);
+        assert(tex->params.mtl_data);
+
+        touchTextureShadow(ctx, tex);
+
+        // a newly uploaded texture can push older shadows over the budget
+        evictTextureShadows(ctx);
+    }
+    else
+    {
+        touchTextureShadow(ctx, tex);
+    }
+
+    return true;
+}
+
+// the swizzle is part of the mtl texture, anything else in the parameters is in the sampler
+- (bool)isTextureSwizzleCurrent:(Texture *)tex
+{
+    id<MTLTexture> texture;
+    MTLTextureDescriptor *swizzle_desc;
+    MTLTextureSwizzleChannels swizzle;
+
+    texture = (__bridge id<MTLTexture>)(tex->mtl_data);
+
+    swizzle_desc = [[MTLTextureDescriptor alloc] init];
+
+    if (tex->params.swizzled)
+    {
+        [self swizzleTexDesc:swizzle_desc forTex:tex];
+    }
+
+    swizzle = texture.swizzle;
+
+    return (swizzle.red == swizzle_desc.swizzle.red && swizzle.green == swizzle_desc.swizzle.green &&
+            swizzle.blue == swizzle_desc.swizzle.blue && swizzle.alpha == swizzle_desc.swizzle.alpha);
+}
+
+// a view is a mtl texture view of its parent, the parent is bound first so anything it has
+// waiting goes up and a parent made again takes its views with it
+- (bool)bindMTLTextureView:(Texture *)tex
+{
+    Texture *parent;
+    id<MTLTexture> parent_texture, texture;
+    MTLTextureDescriptor *swizzle_desc;
+
+    parent = tex->view_parent;
+
+    // the parent was made with what usage its format has for views, what they draw or write is
+    // in the parent's storage and its shadows are read back from then on
+    if (tex->is_render_target || tex->access != GL_READ_ONLY)
+    {
+        parent->gpu_written = true;
+    }
+
+    RETURN_FALSE_ON_FAILURE([self bindMTLTexture:parent]);
+
+    if (tex->dirty_bits || tex->view_generation != parent->mtl_generation)
+    {
+        if (tex->mtl_data)
+        {
+            CFBridgingRelease(tex->mtl_data);
+            tex->mtl_data = NULL;
+        }
+
+        if (tex->params.mtl_data)
+        {
+            CFBridgingRelease(tex->params.mtl_data);
+            tex->params.mtl_data = NULL;
+        }
+    }
+
+    if (tex->mtl_data)
+        return true;
+
+    parent_texture = (__bridge id<MTLTexture>)(parent->mtl_data);
+    RETURN_FALSE_ON_NULL(parent_texture);
+
+    swizzle_desc = [[MTLTextureDescriptor alloc] init];
+
+    if (tex->params.swizzled)
+    {
+        [self swizzleTexDesc:swizzle_desc forTex:tex];
+    }
+
+    texture = [parent_texture newTextureViewWithPixelFormat:mtlPixelFormatForGLTex(tex)
+                                                textureType:[self mtlTextureTypeForTarget:tex->target]
+                                                     levels:NSMakeRange(tex->view_min_level, tex->view_num_levels)
+                                                     slices:NSMakeRange(tex->view_min_layer, tex->view_num_layers)
+                                                    swizzle:swizzle_desc.swizzle];
+    RETURN_FALSE_ON_NULL(texture);
+
+    tex->mtl_data = (void *)CFBridgingRetain(texture);
+    tex->view_generation = parent->mtl_generation;
+    tex->complete = true;
+
+    tex->params.mtl_data = (void *)CFBridgingRetain([self createMTLSamplerForTexParam:&tex->params
+                                                                               target:tex->target]);
+    assert(tex->params.mtl_data);
+
+    tex->dirty_bits = 0;
+
+    return true;
+}
+
+// a buffer texture is a mtl texture made over the buffer's mtl buffer, it's made again only
+// when the buffer is renamed or moved to another mtl buffer
+- (bool)bindMTLTextureBuffer:(Texture *)tex
+{
+    Buffer *buf;
+    id<MTLBuffer> buffer;
+    id<MTLTexture> texture;
+    MTLTextureDescriptor *tex_desc;
+    MTLPixelFormat pixelFormat;
+    MTLTextureUsage usage;
+    NSUInteger base, offset, size, texel_size, width;
+
+    buf = tex->tex_buffer;
+    RETURN_FALSE_ON_NULL(buf);
+
+    // writes since the last bind are flushed, the texture sees them in place
+    if (buf->data.dirty_bits)
+    {
+        RETURN_FALSE_ON_FAILURE([self updateDirtyBuffer:buf]);
+    }
+
+    buffer = [self getMTLBuffer:buf offset:&base];
+    RETURN_FALSE_ON_NULL(buffer);
+
+    if (tex->dirty_bits && tex->params.mtl_data)
+    {
+        CFBridgingRelease(tex->params.mtl_data);
+        tex->params.mtl_data = NULL;
+    }
+
+    if (tex->mtl_data)
+    {
+        if (tex->dirty_bits == 0 && tex->tex_buffer_mtl_data == (__bridge void *)buffer &&
+            tex->tex_buffer_mtl_offset == base)
+        {
+            return true;
+        }
+
+        CFBridgingRelease(tex->mtl_data);
+        tex->mtl_data = NULL;
+    }
+
+    pixelFormat = mtlPixelFormatForGLTex(tex);
+    RETURN_FALSE_ON_FAILURE((pixelFormat != MTLPixelFormatInvalid));
+
+    offset = base + tex->tex_buffer_offset;
+    RETURN_FALSE_ON_FAILURE((offset % [_device minimumTextureBufferAlignmentForPixelFormat:pixelFormat] == 0));
+
+    size = tex->tex_buffer_size ? tex->tex_buffer_size : buf->size - tex->tex_buffer_offset;
+    texel_size = sizeForInternalFormat(tex->internalformat, 0, 0);
+    assert(texel_size);
+
+    width = MIN(size / texel_size, (NSUInteger)STATE(var.max_texture_buffer_size));
+    RETURN_FALSE_ON_FAILURE((width > 0));
+
+    usage = MTLTextureUsageShaderRead;
+    if (tex->access != GL_READ_ONLY)
+        usage |= MTLTextureUsageShaderWrite;
+
+    tex_desc = [MTLTextureDescriptor textureBufferDescriptorWithPixelFormat:pixelFormat
+                                                                      width:width
+                                                            resourceOptions:buffer.resourceOptions
+                                                                      usage:usage];
+    RETURN_FALSE_ON_NULL(tex_desc);
+
+    texture = [buffer newTextureWithDescriptor:tex_desc offset:offset bytesPerRow:width * texel_size];
+    RETURN_FALSE_ON_NULL(texture);
+
+    tex->mtl_data = (void *)CFBridgingRetain(texture);
+    tex->tex_buffer_mtl_data = (__bridge void *)buffer;
+    tex->tex_buffer_mtl_offset = base;
+    tex->width = (GLuint)width;
+    tex->complete = true;
+
+    if (tex->params.mtl_data == NULL)
+    {
         tex->params.mtl_data = (void *)CFBridgingRetain([self createMTLSamplerForTexParam:&tex->params
                                                                                    target:tex->target]);
         assert(tex->params.mtl_data);
     }
 
+    tex->dirty_bits = 0;
+
+    return true;
+}
+
+// allocates the level data of an evicted texture again and reads it back, the reverse of
+// the upload in createMTLTextureFromGLTexture
+- (bool)readTextureShadow:(Texture *)tex
+{
+    id<MTLTexture> texture;
+    uint num_faces;
+    BOOL is_array;
+
+    texture = (__bridge id<MTLTexture>)(tex->mtl_data);
+    RETURN_FALSE_ON_NULL(texture);
+
+    num_faces = (texture.textureType == MTLTextureTypeCube || texture.textureType == MTLTextureTypeCubeArray) ? 6 : 1;
+    is_array = (texture.textureType == MTLTextureType1DArray || texture.textureType == MTLTextureType2DArray);
+
+    // the cpu side of a managed texture is stale once the gpu has written it. this can run in
+    // the middle of binding for a draw so it can't end the current encoder, it syncs behind
+    // whatever was committed on a command buffer of its own. the gl calls that read it back
+    // finish the current command buffer before they get here
+    if (texture.storageMode == MTLStorageModeManaged &&
+        (tex->is_render_target || tex->access != GL_READ_ONLY || tex->genmipmaps || tex->gpu_written))
+    {
+        id<MTLCommandBuffer> commandBuffer = [_commandQueue commandBuffer];
+        RETURN_FALSE_ON_NULL(commandBuffer);
+
+        id<MTLBlitCommandEncoder> blitCommandEncoder = [commandBuffer blitCommandEncoder];
+        [blitCommandEncoder synchronizeResource:texture];
+        [blitCommandEncoder endEncoding];
+
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
+    }
+
+    for (int face = 0; face < num_faces; face++)
+    {
+        for (int level = 0; level < tex->num_levels; level++)
+        {
+            TextureLevel *tex_level;
+            NSUInteger width, height, depth;
+            NSUInteger bytesPerRow, bytesPerImage;
+            MTLRegion region;
+            GLubyte *tex_data;
+
+            tex_level = &tex->faces[face].levels[level];
+
+            // never had data, nothing was dropped
+            if (tex_level->data_size == 0)
+                continue;
+
+            tex_data = (GLubyte *)allocTextureLevelData(ctx, tex, face, level, tex_level->data_size);
+            RETURN_FALSE_ON_NULL(tex_data);
+
+            width = tex_level->width;
+            height = tex_level->height;
+            depth = tex_level->depth;
+            bytesPerRow = tex_level->pitch;
+
+            if (texture.textureType == MTLTextureType3D)
+            {
+                [texture getBytes:tex_data
+                      bytesPerRow:bytesPerRow
+                    bytesPerImage:tex_level->data_size / depth
+                       fromRegion:MTLRegionMake3D(0, 0, 0, width, height, depth)
+                      mipmapLevel:level
+                            slice:0];
+            }
+            else if (is_array)
+            {
+                GLuint num_layers;
+
+                num_layers = tex->depth;
+                bytesPerImage = tex_level->data_size / num_layers;
+
+                if (depth > 1)
+                    region = MTLRegionMake3D(0, 0, 0, width, height, 1);
+                else
+                    region = MTLRegionMake2D(0, 0, width, 1);
+
+                for (int layer = 0; layer < num_layers; layer++)
+                {
+                    [texture getBytes:tex_data + bytesPerImage * layer
+                          bytesPerRow:bytesPerRow
+                        bytesPerImage:bytesPerImage
+                           fromRegion:region
+                          mipmapLevel:level
+                                slice:layer];
+                }
+            }
+            else
+            {
+                if (height > 1)
+                    region = MTLRegionMake2D(0, 0, width, height);
+                else
+                    region = MTLRegionMake1D(0, width);
+
+                [texture getBytes:tex_data
+                      bytesPerRow:bytesPerRow
+                    bytesPerImage:tex_level->data_size
+                       fromRegion:region
+                      mipmapLevel:level
+                            slice:face];
+            }
+        }
+    }
+
     return true;
 }
 
+#pragma mark C interface to mtlReadTextureShadow
+bool mtlReadTextureShadow(GLMContext glm_ctx, Texture *tex)
+{
+    // Call the Objective-C method using Objective-C syntax
+    return [(__bridge id)glm_ctx->mtl_funcs.mtlObj readTextureShadow:tex];
+}
+
 - (bool)bindActiveTexturesToMTL
 {
     // search through active_texture_mask for enabled bits
@@ -2409,6 +3135,41 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
             _renderPassDescriptor.stencilAttachment.loadAction = MTLLoadActionLoad;
         }
 
+        // invalidated attachments are undefined, don't load them
+        if (ctx->state.framebuffer)
+        {
+            Framebuffer *fbo;
+
+            fbo = ctx->state.framebuffer;
+
+            for (int i = 0; i < MAX_COLOR_ATTACHMENTS; i++)
+            {
+                if (fbo->color_attachments[i].texture &&
+                    [self takeInvalidatedAttachment:&fbo->color_attachments[i]] &&
+                    _renderPassDescriptor.colorAttachments[i].loadAction == MTLLoadActionLoad)
+                {
+                    _renderPassDescriptor.colorAttachments[i].loadAction = MTLLoadActionDontCare;
+                }
+            }
+
+            bool depth_invalid, stencil_invalid;
+
+            depth_invalid = fbo->depth.texture && [self takeInvalidatedAttachment:&fbo->depth];
+
+            // packed depth stencil shares the bit with depth
+            if (fbo->stencil.texture && fbo->stencil.texture == fbo->depth.texture &&
+                fbo->stencil.textarget == fbo->depth.textarget && fbo->stencil.level == fbo->depth.level)
+                stencil_invalid = depth_invalid;
+            else
+                stencil_invalid = fbo->stencil.texture && [self takeInvalidatedAttachment:&fbo->stencil];
+
+            if (depth_invalid && _renderPassDescriptor.depthAttachment.loadAction == MTLLoadActionLoad)
+                _renderPassDescriptor.depthAttachment.loadAction = MTLLoadActionDontCare;
+
+            if (stencil_invalid && _renderPassDescriptor.stencilAttachment.loadAction == MTLLoadActionLoad)
+                _renderPassDescriptor.stencilAttachment.loadAction = MTLLoadActionDontCare;
+        }
+
         _renderPassDescriptor.colorAttachments[0].storeAction = MTLStoreActionStore;
 
         fprintf(stderr, "DEBUG: Creating render encoder, loadAction=%lu, texture=%p\n",
@@ -2455,37 +3216,29 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
 
 - (bool)newCommandBuffer
 {
-    if (_currentEvent)
-    {
-        assert(_currentSyncName);
-
-        [_currentCommandBuffer encodeWaitForEvent:_currentEvent value:_currentSyncName];
-
-        _currentEvent = NULL;
-        _currentSyncName = 0;
-    }
-
-    // remove any events waiting on current command buffer
-    if (_currentCommandBufferSyncList)
-    {
-        GLuint count;
+    _currentCommandBuffer = [_commandQueue commandBuffer];
+    assert(_currentCommandBuffer);
 
-        count = _currentCommandBufferSyncList->count;
+    GLuint64 serial = ++_commandBufferSerial;
 
-        for (GLuint i = 0; i < count; i++)
-        {
-            Sync *sync;
+    // slab slots freed under earlier command buffers
+    reclaimSubAllocations(&_bufferSubAllocator, __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE));
 
-            sync = _currentCommandBufferSyncList->list[i];
+    [_currentCommandBuffer addCompletedHandler:^(id<MTLCommandBuffer> cmdBuffer) {
+      GLuint64 completed;
 
-            CFBridgingRelease(sync->mtl_event);
-        }
+      completed = __atomic_load_n(&self->_completedSerial, __ATOMIC_ACQUIRE);
 
-        _currentCommandBufferSyncList->count = 0;
-    }
+      while (completed < serial &&
+             !__atomic_compare_exchange_n(&self->_completedSerial, &completed, serial, false, __ATOMIC_RELEASE,
+                                          __ATOMIC_ACQUIRE))
+        ;
 
-    _currentCommandBuffer = [_commandQueue commandBuffer];
-    assert(_currentCommandBuffer);
+      // wake up client waits on fences
+      pthread_mutex_lock(&self->_completedLock);
+      pthread_cond_broadcast(&self->_completedCond);
+      pthread_mutex_unlock(&self->_completedLock);
+    }];
 
     return true;
 }
@@ -2886,6 +3639,12 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
 
 - (void)endRenderEncoding
 {
+    if (_copyEncoder)
+    {
+        [_copyEncoder endEncoding];
+        _copyEncoder = nil;
+    }
+
     if (_currentRenderEncoder)
     {
         fprintf(stderr, "DEBUG: endRenderEncoding - ending encoder %p\n", (__bridge void*)_currentRenderEncoder);
@@ -3046,6 +3805,13 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
             RETURN_FALSE_ON_FAILURE([self updateDirtyBaseBufferList:&ctx->state.vertex_buffer_map_list]);
             RETURN_FALSE_ON_FAILURE([self updateDirtyBaseBufferList:&ctx->state.fragment_buffer_map_list]);
 
+            // a renamed buffer has a new mtl buffer behind the same binding
+            if (_currentRenderEncoder)
+            {
+                RETURN_FALSE_ON_FAILURE([self bindVertexBuffersToCurrentRenderEncoder]);
+                RETURN_FALSE_ON_FAILURE([self bindFragmentBuffersToCurrentRenderEncoder]);
+            }
+
             ctx->state.dirty_bits &= ~DIRTY_BUFFER;
         }
         else if (ctx->state.dirty_bits & DIRTY_RENDER_STATE)
@@ -3163,6 +3929,8 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
         }
     }
 
+    [self writeFramebufferAttachments];
+
     // Create a render command encoder.
     if (_pipelineState == NULL) {
         fprintf(stderr, "ERROR: Pipeline state is NULL!\n");
@@ -3222,34 +3990,31 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
 
         assert(ptr);
 
-        if (ptr->size < 4096)
+        // Debug: print the first float value if it's a float buffer
+        if (ptr->size == sizeof(float))
         {
-            assert(ptr->data.mtl_data == NULL);
-
-            // Debug: print the first float value if it's a float buffer
-            if (ptr->size == sizeof(float))
+            float value = *(float *)ptr->data.buffer_data;
+            static int debug_count = 0;
+            if (debug_count++ % 60 == 0)
             {
-                float value = *(float *)ptr->data.buffer_data;
-                static int debug_count = 0;
-                if (debug_count++ % 60 == 0)
-                {
-                    NSLog(@"Setting compute buffer %d with float value: %f", i, value);
-                }
+                NSLog(@"Setting compute buffer %d with float value: %f", i, value);
             }
+        }
 
-            [computeCommandEncoder setBytes:(const void *)ptr->data.buffer_data length:ptr->size atIndex:i];
+        NSUInteger base;
+        id<MTLBuffer> buffer = [self getMTLBuffer:ptr offset:&base];
+        RETURN_FALSE_ON_NULL(buffer);
 
-            // clear buffer data dirty bits
-            ptr->data.dirty_bits &= ~DIRTY_BUFFER_DATA;
-        }
-        else
-        {
-            assert(ptr->data.mtl_data);
+        [computeCommandEncoder setBuffer:buffer offset:base + offset atIndex:i];
 
-            id<MTLBuffer> buffer = (__bridge id<MTLBuffer>)(ptr->data.mtl_data);
-            assert(buffer);
+        // what the dispatch stores, cpu reads wait for it and managed storage is synchronized.
+        // an upload arena copy is only the buffer's for this dispatch
+        if (map->gpu_writes && (ptr->data.mtl_data || ptr->data.slab))
+        {
+            ptr->data.write_serial = _commandBufferSerial;
 
-            [computeCommandEncoder setBuffer:buffer offset:offset atIndex:i];
+            if (buffer.storageMode == MTLStorageModeManaged)
+                ptr->data.gpu_written = true;
         }
     }
 
@@ -3306,6 +4071,19 @@ void mtlBlitFramebuffer(GLMContext glm_ctx, GLint srcX0, GLint srcY0, GLint srcX
                     break;
                 case _IMAGE_TEXTURE:
                     ptr = STATE(image_units[spirv_binding].tex);
+
+                    // what the dispatch stores defines the images again
+                    if (ptr && STATE(image_units[spirv_binding].access) != GL_READ_ONLY)
+                    {
+                        ImageUnit *unit;
+
+                        unit = &STATE(image_units[spirv_binding]);
+
+                        if (unit->layered)
+                            writeTexImages(ptr, unit->level, 0, UINT32_MAX);
+                        else
+                            writeTexImages(ptr, unit->level, unit->layer, 1);
+                    }
                     break;
                 default:
                     ptr = NULL;
@@ -3501,7 +4279,7 @@ void mtlDispatchComputeIndirect(GLMContext glm_ctx, GLintptr indirect)
         return false;
     }
 
-    if (ptr->data.mtl_data == NULL)
+    if (ptr->data.mtl_data == NULL && ptr->data.slab == NULL)
     {
         [self bindMTLBuffer:ptr];
         // For small buffers (size <= 4095), mtl_data remains NULL intentionally
@@ -3516,6 +4294,10 @@ void mtlDispatchComputeIndirect(GLMContext glm_ctx, GLintptr indirect)
         [self updateDirtyBuffer:ptr];
     }
 
+    // element and indirect buffers are used by the draw that follows
+    if (ptr->data.mtl_data || ptr->data.slab)
+        ptr->data.serial = _commandBufferSerial;
+
     return true;
 }
 
@@ -3596,62 +4378,92 @@ void mtlDeleteMTLObj(GLMContext glm_ctx, void *obj)
 {
     RETURN_ON_FAILURE([self processGLState:false]);
 
-    if (_currentEvent == NULL)
-    {
-        _currentEvent = [_device newEvent];
-        assert(_currentEvent);
-    }
+    // everything issued so far is in the current command buffer
+    sync->serial = _commandBufferSerial;
+}
+
+void mtlGetSync(GLMContext glm_ctx, Sync *sync)
+{
+    // Call the Objective-C method using Objective-C syntax
+    [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlGetSync:glm_ctx sync:sync];
+}
 
-    _currentSyncName = sync->name;
+// block until the command buffer with serial has completed, timeout in nanoseconds
+- (bool)waitForSerial:(GLuint64)serial timeout:(GLuint64)timeout
+{
+    struct timespec deadline;
+    bool forever;
+
+    if (serial <= __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE))
+        return true;
+
+    // it would never complete
+    if (serial == _commandBufferSerial)
+    {
+        [self flushCommandBuffer:false];
+    }
 
-    sync->mtl_event = (void *)CFBridgingRetain(_currentEvent);
+    // anything past a day might as well be forever, and won't overflow the deadline
+    forever = (timeout >= 86400ull * 1000000000ull);
 
-    if (_currentCommandBufferSyncList == NULL)
+    if (!forever)
     {
-        _currentCommandBufferSyncList = (SyncList *)malloc(sizeof(SyncList));
-        assert(_currentCommandBufferSyncList);
+        clock_gettime(CLOCK_REALTIME, &deadline);
 
-        _currentCommandBufferSyncList->size = 8;
-        _currentCommandBufferSyncList->list = (Sync **)malloc(sizeof(Sync *) * 8);
-        assert(_currentCommandBufferSyncList->list);
+        deadline.tv_sec += timeout / 1000000000ull;
+        deadline.tv_nsec += timeout % 1000000000ull;
 
-        _currentCommandBufferSyncList->count = 0;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
     }
 
-    _currentCommandBufferSyncList->list[_currentCommandBufferSyncList->count] = sync;
-    _currentCommandBufferSyncList->count++;
+    pthread_mutex_lock(&_completedLock);
 
-    if (_currentCommandBufferSyncList->count >= _currentCommandBufferSyncList->size)
+    while (serial > __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE))
     {
-        _currentCommandBufferSyncList->size *= 2;
-        _currentCommandBufferSyncList->list =
-            (Sync **)realloc(_currentCommandBufferSyncList->list, sizeof(Sync *) * _currentCommandBufferSyncList->size);
-        assert(_currentCommandBufferSyncList->list);
+        if (forever)
+        {
+            pthread_cond_wait(&_completedCond, &_completedLock);
+        }
+        else if (pthread_cond_timedwait(&_completedCond, &_completedLock, &deadline))
+        {
+            break;
+        }
     }
-}
 
-void mtlGetSync(GLMContext glm_ctx, Sync *sync)
-{
-    // Call the Objective-C method using Objective-C syntax
-    [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlGetSync:glm_ctx sync:sync];
+    pthread_mutex_unlock(&_completedLock);
+
+    return serial <= __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE);
 }
 
 #pragma mark C interface to mtlWaitForSync
-- (void)mtlWaitForSync:(GLMContext)glm_ctx sync:(Sync *)sync
+- (GLenum)mtlWaitForSync:(GLMContext)glm_ctx sync:(Sync *)sync flush:(bool)flush timeout:(GLuint64)timeout
 {
-    RETURN_ON_FAILURE([self processGLState:false]);
+    if (sync->serial <= __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE))
+        return GL_ALREADY_SIGNALED;
 
-    assert(sync->mtl_event);
+    // a poll only pushes the fence to the gpu if asked to
+    if (timeout == 0)
+    {
+        if (flush && sync->serial == _commandBufferSerial)
+            [self flushCommandBuffer:false];
+
+        return GL_TIMEOUT_EXPIRED;
+    }
 
-    CFBridgingRelease(sync->mtl_event);
+    if ([self waitForSerial:sync->serial timeout:timeout])
+        return GL_CONDITION_SATISFIED;
 
-    sync->mtl_event = NULL;
+    return GL_TIMEOUT_EXPIRED;
 }
 
-void mtlWaitForSync(GLMContext glm_ctx, Sync *sync)
+GLenum mtlWaitForSync(GLMContext glm_ctx, Sync *sync, bool flush, GLuint64 timeout)
 {
     // Call the Objective-C method using Objective-C syntax
-    [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlWaitForSync:glm_ctx sync:sync];
+    return [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlWaitForSync:glm_ctx sync:sync flush:flush timeout:timeout];
 }
 
 #pragma mark C interface to mtlFlush
@@ -3724,6 +4536,233 @@ void mtlClearBuffer(GLMContext glm_ctx, GLuint type, GLbitfield mask)
     [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlClearBuffer:glm_ctx type:type mask:mask];
 }
 
+#pragma mark buffer renaming
+- (bool)renameBuffer:(Buffer *)buf preserve:(bool)preserve
+{
+    id<MTLBuffer> old_buffer, new_buffer;
+    BufferStore *slot;
+    GLuint64 completed;
+    void *new_data;
+
+    if (buf->data.mtl_data == NULL && buf->data.slab == NULL)
+        return false;
+
+    // the app holds a pointer to these, they can't move
+    if (buf->mapped || (buf->storage_flags & (GL_CLIENT_STORAGE_BIT | GL_MAP_PERSISTENT_BIT)))
+        return false;
+
+    completed = __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE);
+
+    // nothing queued reads it, write in place
+    if (buf->data.serial <= completed)
+        return false;
+
+    // the copy below has to see what the gpu wrote, managed storage is synchronized for it
+    if (preserve && buf->data.gpu_written)
+        [self synchronizeBuffer:buf];
+
+    if (preserve && buf->data.write_serial > completed)
+    {
+        [self waitForSerial:buf->data.write_serial timeout:GL_TIMEOUT_IGNORED];
+
+        completed = __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE);
+        if (buf->data.serial <= completed)
+            return false;
+    }
+
+    if (buf->data.slab)
+        return [self renameSubAllocBuffer:buf preserve:preserve completed:completed];
+
+    old_buffer = (__bridge id<MTLBuffer>)(buf->data.mtl_data);
+    new_data = NULL;
+    slot = NULL;
+
+    // an earlier store the GPU is done with, else an empty slot, else the oldest store
+    for (GLuint i = 0; i < buf->num_renames; i++)
+    {
+        BufferStore *store = &buf->renames[i];
+
+        if (store->mtl_data && store->serial <= completed)
+        {
+            slot = store;
+            new_data = store->mtl_data;
+            break;
+        }
+
+        if (slot == NULL || (slot->mtl_data && (store->mtl_data == NULL || store->serial < slot->serial)))
+            slot = store;
+    }
+
+    // every store is still queued, grow the ring rather than wait on the gpu
+    if (new_data == NULL && (slot == NULL || slot->mtl_data) && buf->num_renames < MAX_BUFFER_RENAMES)
+    {
+        BufferStore *renames;
+        GLuint num_renames;
+
+        num_renames = buf->num_renames ? MIN(buf->num_renames * 2, MAX_BUFFER_RENAMES) : MIN_BUFFER_RENAMES;
+
+        renames = (BufferStore *)realloc(buf->renames, num_renames * sizeof(BufferStore));
+        RETURN_FALSE_ON_NULL(renames);
+
+        bzero(&renames[buf->num_renames], (num_renames - buf->num_renames) * sizeof(BufferStore));
+
+        slot = &renames[buf->num_renames];
+
+        buf->renames = renames;
+        buf->num_renames = num_renames;
+    }
+
+    if (new_data == NULL)
+    {
+        new_buffer = [_device newBufferWithLength:old_buffer.length options:old_buffer.resourceOptions];
+        RETURN_FALSE_ON_NULL(new_buffer);
+
+        // a full ring at its limit drops the oldest store, the command buffers still using it
+        // hold their own reference
+        if (slot->mtl_data)
+            CFBridgingRelease(slot->mtl_data);
+
+        new_data = (void *)CFBridgingRetain(new_buffer);
+    }
+    else
+    {
+        new_buffer = (__bridge id<MTLBuffer>)(new_data);
+    }
+
+    if (preserve)
+    {
+        memcpy(new_buffer.contents, old_buffer.contents, buf->size);
+    }
+
+    // retire the old store to the ring
+    slot->mtl_data = buf->data.mtl_data;
+    slot->serial = buf->data.serial;
+
+    buf->data.mtl_data = new_data;
+    buf->data.buffer_data = (vm_address_t)new_buffer.contents;
+    buf->data.serial = 0;
+
+    // the gpu hasn't written the new store
+    buf->data.gpu_written = false;
+
+    // a managed buffer only uploads what it's told about, ranges recorded for the old store
+    // don't cover the new one
+    setBufferDataDirty(buf, 0, buf->size);
+
+    // bindings still point at the old mtl buffer
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
+
+    return true;
+}
+
+// a slab buffer moves to another slot, the old one is reused once the gpu is done with it
+- (bool)renameSubAllocBuffer:(Buffer *)buf preserve:(bool)preserve completed:(GLuint64)completed
+{
+    SubAllocSlab *slab;
+    size_t offset;
+
+    slab = newSubAllocation(&_bufferSubAllocator, buf->size, &offset);
+    RETURN_FALSE_ON_NULL(slab);
+
+    if (preserve)
+    {
+        memcpy(slab->contents + offset, (void *)buf->data.buffer_data, buf->size);
+    }
+
+    freeSubAllocation(&_bufferSubAllocator, buf->data.slab, buf->data.slab_offset, buf->data.serial, completed);
+
+    buf->data.slab = slab;
+    buf->data.slab_offset = offset;
+    buf->data.buffer_data = (vm_address_t)(slab->contents + offset);
+    buf->data.buffer_size = getSubAllocationSize(slab);
+    buf->data.serial = 0;
+    buf->data.gpu_written = false;
+
+    // ranges recorded for the old slot don't cover the new one
+    setBufferDataDirty(buf, 0, buf->size);
+
+    // bindings still point at the old offset
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
+
+    return true;
+}
+
+- (void *)createBufferSlab:(size_t)size contents:(void **)contents
+{
+    id<MTLBuffer> buffer;
+
+    buffer = [_device newBufferWithLength:size
+                                  options:MTLResourceCPUCacheModeWriteCombined | MTLResourceStorageModeManaged];
+    if (buffer == nil)
+        return NULL;
+
+    *contents = buffer.contents;
+
+    return (void *)CFBridgingRetain(buffer);
+}
+
+static void *newBufferSlab(void *arg, size_t size, void **contents)
+{
+    MGLRenderer *renderer = (__bridge MGLRenderer *)arg;
+
+    return [renderer createBufferSlab:size contents:contents];
+}
+
+static void freeBufferSlab(void *arg, void *backing)
+{
+    // the command buffers using it hold their own reference
+    CFBridgingRelease(backing);
+}
+
+- (bool)subAllocBuffer:(Buffer *)ptr
+{
+    SubAllocSlab *slab;
+    size_t offset;
+
+    assert(ptr->data.slab == NULL && ptr->data.mtl_data == NULL);
+
+    reclaimSubAllocations(&_bufferSubAllocator, __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE));
+
+    slab = newSubAllocation(&_bufferSubAllocator, ptr->size, &offset);
+    if (slab == NULL)
+        return false;
+
+    ptr->data.slab = slab;
+    ptr->data.slab_offset = offset;
+    ptr->data.buffer_data = (vm_address_t)(slab->contents + offset);
+    ptr->data.buffer_size = getSubAllocationSize(slab);
+    ptr->data.serial = 0;
+
+    return true;
+}
+
+- (void)freeBufferSubAlloc:(Buffer *)ptr
+{
+    assert(ptr->data.slab);
+
+    freeSubAllocation(&_bufferSubAllocator, ptr->data.slab, ptr->data.slab_offset, ptr->data.serial,
+                      __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE));
+
+    ptr->data.slab = NULL;
+    ptr->data.slab_offset = 0;
+    ptr->data.buffer_data = 0;
+    ptr->data.buffer_size = 0;
+}
+
+#pragma mark C interface to mtlSubAllocBuffer
+bool mtlSubAllocBuffer(GLMContext glm_ctx, Buffer *ptr)
+{
+    // Call the Objective-C method using Objective-C syntax
+    return [(__bridge id)glm_ctx->mtl_funcs.mtlObj subAllocBuffer:ptr];
+}
+
+#pragma mark C interface to mtlFreeBufferSubAlloc
+void mtlFreeBufferSubAlloc(GLMContext glm_ctx, Buffer *ptr)
+{
+    // Call the Objective-C method using Objective-C syntax
+    [(__bridge id)glm_ctx->mtl_funcs.mtlObj freeBufferSubAlloc:ptr];
+}
+
 #pragma mark C interface to mtlBufferSubData
 
 - (void)mtlBufferSubData:(GLMContext)glm_ctx
@@ -3735,6 +4774,19 @@ void mtlClearBuffer(GLMContext glm_ctx, GLuint type, GLbitfield mask)
     id<MTLBuffer> mtl_buffer;
     void *data;
 
+    if (buf->data.slab)
+    {
+        // don't write under a command buffer that hasn't completed
+        [self renameBuffer:buf preserve:(offset > 0 || size < buf->size)];
+
+        memcpy((void *)(buf->data.buffer_data + offset), ptr, size);
+
+        mtl_buffer = (__bridge id<MTLBuffer>)(buf->data.slab->backing);
+        [mtl_buffer didModifyRange:NSMakeRange(buf->data.slab_offset + offset, size)];
+
+        return;
+    }
+
     if (buf->data.mtl_data == NULL)
     {
         [self bindMTLBuffer:buf];
@@ -3752,13 +4804,20 @@ void mtlClearBuffer(GLMContext glm_ctx, GLuint type, GLbitfield mask)
         return;
     }
 
+    // don't write under a command buffer that hasn't completed
+    if (offset > 0 || size < buf->size)
+        [self renameBuffer:buf preserve:true];
+    else
+        [self renameBuffer:buf preserve:false];
+
     mtl_buffer = (__bridge id<MTLBuffer>)(buf->data.mtl_data);
     assert(mtl_buffer);
 
     data = mtl_buffer.contents;
     memcpy(data + offset, ptr, size);
 
-    [mtl_buffer didModifyRange:NSMakeRange(offset, size)];
+    if (mtl_buffer.storageMode == MTLStorageModeManaged)
+        [mtl_buffer didModifyRange:NSMakeRange(offset, size)];
 }
 
 void mtlBufferSubData(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t size, const void *ptr)
@@ -3768,11 +4827,34 @@ void mtlBufferSubData(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t siz
 }
 
 #pragma mark C interface to mtlMapUnmapBuffer
+// the gpu's writes to managed storage are copied back to the cpu side after what's encoded,
+// the map waits on write_serial for them
+- (void)synchronizeBuffer:(Buffer *)buf
+{
+    id<MTLBuffer> buffer;
+    NSUInteger base;
+
+    buffer = [self getMTLBuffer:buf offset:&base];
+    if (buffer == nil)
+        return;
+
+    [self endRenderEncoding];
+
+    id<MTLBlitCommandEncoder> blitCommandEncoder;
+    blitCommandEncoder = [_currentCommandBuffer blitCommandEncoder];
+
+    [blitCommandEncoder synchronizeResource:buffer];
+    [blitCommandEncoder endEncoding];
+
+    buf->data.write_serial = _commandBufferSerial;
+    buf->data.gpu_written = false;
+}
+
 - (void *)mtlMapUnmapBuffer:(GLMContext)glm_ctx
                         buf:(Buffer *)buf
                      offset:(size_t)offset
                        size:(size_t)size
-                     access:(GLenum)access
+                     access:(GLbitfield)access
                         map:(bool)map
 {
     id<MTLBuffer> mtl_buffer;
@@ -3782,19 +4864,61 @@ void mtlBufferSubData(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t siz
         [self bindMTLBuffer:buf];
     }
 
-    mtl_buffer = (__bridge id<MTLBuffer>)(buf->data.mtl_data);
-
     if (map)
     {
-        return mtl_buffer.contents + offset;
+        GLuint64 serial;
+
+        // reading only has to wait for gpu writes, writing has to wait for gpu reads too
+        serial = (access & GL_MAP_WRITE_BIT) ? buf->data.serial : buf->data.write_serial;
+
+        // the app synchronizes persistent and unsynchronized mappings itself
+        if ((access & (GL_MAP_PERSISTENT_BIT | GL_MAP_UNSYNCHRONIZED_BIT)) == 0 && (access & GL_MAP_READ_BIT) &&
+            buf->data.gpu_written)
+        {
+            [self synchronizeBuffer:buf];
+
+            serial = MAX(serial, buf->data.write_serial);
+        }
+
+        if ((access & (GL_MAP_PERSISTENT_BIT | GL_MAP_UNSYNCHRONIZED_BIT)) == 0 &&
+            (buf->data.mtl_data || buf->data.slab) &&
+            serial > __atomic_load_n(&_completedSerial, __ATOMIC_ACQUIRE))
+        {
+            bool renamed;
+
+            // discarding the contents can move to a fresh store instead of waiting for the gpu
+            if (access & GL_MAP_INVALIDATE_BUFFER_BIT)
+                renamed = [self renameBuffer:buf preserve:false];
+            else if (access & GL_MAP_INVALIDATE_RANGE_BIT)
+                renamed = [self renameBuffer:buf preserve:true];
+            else
+                renamed = false;
+
+            if (renamed == false)
+                [self waitForSerial:serial timeout:GL_TIMEOUT_IGNORED];
+        }
+
+        // small buffers map their cpu copy, it goes to the upload arena when next bound
+        return (void *)(buf->data.buffer_data + offset);
     }
 
-    [mtl_buffer didModifyRange:NSMakeRange(offset, size)];
+    // whatever unmap or explicit flushes marked as written
+    if ((buf->data.mtl_data || buf->data.slab) && (buf->data.dirty_bits & DIRTY_BUFFER_DATA))
+    {
+        if (buf->data.slab)
+            mtl_buffer = (__bridge id<MTLBuffer>)(buf->data.slab->backing);
+        else
+            mtl_buffer = (__bridge id<MTLBuffer>)(buf->data.mtl_data);
+
+        [self flushDirtyRanges:buf buffer:mtl_buffer];
+
+        buf->data.dirty_bits &= ~DIRTY_BUFFER_DATA;
+    }
 
     return NULL;
 }
 
-void *mtlMapUnmapBuffer(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t size, GLenum access, bool map)
+void *mtlMapUnmapBuffer(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t size, GLbitfield access, bool map)
 {
     // Call the Objective-C method using Objective-C syntax
     return [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlMapUnmapBuffer:glm_ctx
@@ -3805,226 +4929,338 @@ void *mtlMapUnmapBuffer(GLMContext glm_ctx, Buffer *buf, size_t offset, size_t s
                                                                  map:map];
 }
 
-#pragma mark C interface to mtlFlushMappedBufferRange
-- (void)mtlFlushMappedBufferRange:(GLMContext)glm_ctx buf:(Buffer *)buf offset:(size_t)offset length:(size_t)length
+bool mtlRenameBuffer(GLMContext glm_ctx, Buffer *buf, bool preserve)
 {
-    id<MTLBuffer> mtl_buffer;
-
-    mtl_buffer = (__bridge id<MTLBuffer>)(buf->data.mtl_data);
-
-    [mtl_buffer didModifyRange:NSMakeRange(offset, length)];
+    return [(__bridge id)glm_ctx->mtl_funcs.mtlObj renameBuffer:buf preserve:preserve];
 }
 
-void mtlFlushBufferRange(GLMContext glm_ctx, Buffer *buf, GLintptr offset, GLsizeiptr length)
+// the blit copies texels as they are, only layouts the app asked for byte for byte
+static NSUInteger readPixelsTexelSize(MTLPixelFormat pixel_format, GLenum format, GLenum type)
 {
-    // Call the Objective-C method using Objective-C syntax
-    [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlFlushMappedBufferRange:glm_ctx buf:buf offset:offset length:length];
-}
+    switch (pixel_format)
+    {
+    case MTLPixelFormatBGRA8Unorm:
+    case MTLPixelFormatBGRA8Unorm_sRGB:
+        if (format == GL_BGRA && (type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_INT_8_8_8_8_REV))
+            return 4;
+        break;
 
-#pragma mark C interface to mtlReadDrawable
-- (void)mtlReadDrawable:(GLMContext)glm_ctx
-             pixelBytes:(void *)pixelBytes
-            bytesPerRow:(NSUInteger)bytesPerRow
-          bytesPerImage:(NSUInteger)bytesPerImage
-             fromRegion:(MTLRegion)region
-{
-    id<MTLTexture> texture;
+    case MTLPixelFormatRGBA8Unorm:
+    case MTLPixelFormatRGBA8Unorm_sRGB:
+        if (format == GL_RGBA && (type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_INT_8_8_8_8_REV))
+            return 4;
+        break;
 
-    // if tex is null we are pulling from a readbuffer or a drawable
-    if (glm_ctx->state.readbuffer)
-    {
-        Framebuffer *fbo;
-        GLuint drawbuffer;
+    case MTLPixelFormatRGBA16Float:
+        if (format == GL_RGBA && type == GL_HALF_FLOAT)
+            return 8;
+        break;
 
-        fbo = ctx->state.readbuffer;
-        drawbuffer = ctx->state.read_buffer - GL_COLOR_ATTACHMENT0;
-        assert(drawbuffer >= 0);
-        assert(drawbuffer <= STATE(max_color_attachments));
+    case MTLPixelFormatRGBA32Float:
+        if (format == GL_RGBA && type == GL_FLOAT)
+            return 16;
+        break;
 
-        assert(0);
+    case MTLPixelFormatR8Unorm:
+        if (format == GL_RED && type == GL_UNSIGNED_BYTE)
+            return 1;
+        break;
 
-        // tex = [self framebufferAttachmentTexture: &fbo->color_attachments[drawbuffer]];
-        // assert(tex);
+    case MTLPixelFormatR32Float:
+        if (format == GL_RED && type == GL_FLOAT)
+            return 4;
+        break;
 
-        // texture = (__bridge id<MTLTexture>)(tex->mtl_data);
-        // assert(texture);
+    default:
+        break;
     }
-    else
-    {
-        GLuint mgl_drawbuffer;
-        id<MTLTexture> texture;
 
-        // reading from the drawbuffer
-        switch (ctx->state.read_buffer)
-        {
-        case GL_FRONT:
-            mgl_drawbuffer = _FRONT;
-            break;
-        case GL_BACK:
-            mgl_drawbuffer = _BACK;
-            break;
-        case GL_FRONT_LEFT:
-            mgl_drawbuffer = _FRONT_LEFT;
-            break;
-        case GL_FRONT_RIGHT:
-            mgl_drawbuffer = _FRONT_RIGHT;
-            break;
-        case GL_BACK_LEFT:
-            mgl_drawbuffer = _BACK_LEFT;
-            break;
-        case GL_BACK_RIGHT:
-            mgl_drawbuffer = _BACK_RIGHT;
-            break;
-        default:
-            assert(0);
-        }
+    return 0;
+}
 
-        if (mgl_drawbuffer == _FRONT)
-        {
-            [self endRenderEncoding];
+// the color (or depth) buffer glReadPixels reads, nil if there isn't one to blit from
+- (id<MTLTexture>)readFramebufferTexture:(NSUInteger *)level depth:(bool)depth
+{
+    GLuint mgl_drawbuffer;
 
-            assert(_currentCommandBuffer);
-            if (_currentCommandBuffer.status < MTLCommandBufferStatusCommitted)
-            {
-                [_currentCommandBuffer commit];
-            }
+    *level = 0;
 
-            id<MTLTexture> drawableTexture = _drawable.texture;
-            assert(drawableTexture);
-
-            // Create a downscale texture
-            MTLTextureDescriptor *downScaleTextureDescriptor =
-                [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:drawableTexture.pixelFormat
-                                                                   width:region.size.width
-                                                                  height:region.size.height
-                                                               mipmapped:NO];
-            downScaleTextureDescriptor.usage = MTLTextureUsageShaderRead | MTLTextureUsageRenderTarget;
-            id<MTLTexture> downscaledTexture = [_device newTextureWithDescriptor:downScaleTextureDescriptor];
-
-            // Create a command buffer
-            [self newCommandBuffer];
-
-            // Use a blit command encoder to copy texture data to the buffer
-            id<MTLBlitCommandEncoder> blitEncoder = [_currentCommandBuffer blitCommandEncoder];
-
-            // Set up the source and destination sizes
-            MTLOrigin sourceOrigin = MTLOriginMake(0, 0, 0);
-            MTLSize sourceSize = MTLSizeMake(drawableTexture.width, drawableTexture.height, 1);
-            MTLOrigin destinationOrigin = MTLOriginMake(region.origin.x, region.origin.y, 0);
-
-            // Perform the scaling operation
-            [blitEncoder copyFromTexture:drawableTexture
-                             sourceSlice:0
-                             sourceLevel:0
-                            sourceOrigin:sourceOrigin
-                              sourceSize:sourceSize
-                               toTexture:downscaledTexture
-                        destinationSlice:0
-                        destinationLevel:0
-                       destinationOrigin:destinationOrigin];
-            [blitEncoder endEncoding];
-
-            // Create a CPU-accessible buffer
-            NSUInteger bytesPerPixel = 4; // For RGBA8Unorm format
-            NSUInteger bytesPerRow = region.size.width * bytesPerPixel;
-
-            id<MTLBuffer> readBuffer = [_device newBufferWithLength:bytesPerRow * region.size.height
-                                                            options:MTLResourceStorageModeShared];
-
-            // Use another blit command encoder to copy the texture into the buffer
-            id<MTLBlitCommandEncoder> readBlitEncoder = [_currentCommandBuffer blitCommandEncoder];
-            [readBlitEncoder copyFromTexture:downscaledTexture
-                                 sourceSlice:0
-                                 sourceLevel:0
-                                sourceOrigin:MTLOriginMake(0, 0, 0)
-                                  sourceSize:MTLSizeMake(region.size.width, region.size.height, 1)
-                                    toBuffer:readBuffer
-                           destinationOffset:0
-                      destinationBytesPerRow:bytesPerRow
-                    destinationBytesPerImage:bytesPerRow * region.size.height];
-            [readBlitEncoder endEncoding];
-
-            // Commit and wait for completion
-            [_currentCommandBuffer commit];
-            [_currentCommandBuffer waitUntilCompleted];
-
-            // copy the data
-            void *data = [readBuffer contents];
-            memcpy(pixelBytes, data, bytesPerRow * region.size.height);
+    if (ctx->state.readbuffer)
+    {
+        FBOAttachment *fbo_attachment;
+        Texture *tex;
+        GLuint index;
 
-            // get a new command buffer
-            [self newCommandBuffer];
-        }
-        else if (_drawBuffers[mgl_drawbuffer].drawbuffer)
+        if (depth)
         {
-            texture = _drawBuffers[mgl_drawbuffer].drawbuffer;
+            fbo_attachment = &ctx->state.readbuffer->depth;
         }
         else
         {
-            assert(0);
+            if (ctx->state.read_buffer < GL_COLOR_ATTACHMENT0)
+                return nil;
+
+            index = ctx->state.read_buffer - GL_COLOR_ATTACHMENT0;
+            if (index >= MAX_COLOR_ATTACHMENTS)
+                return nil;
+
+            fbo_attachment = &ctx->state.readbuffer->color_attachments[index];
         }
+
+        if (fbo_attachment->texture == 0)
+            return nil;
+
+        tex = [self framebufferAttachmentTexture:fbo_attachment];
+        if (tex->mtl_data == NULL)
+            return nil;
+
+        *level = fbo_attachment->level;
+
+        return (__bridge id<MTLTexture>)(tex->mtl_data);
+    }
+
+    switch (ctx->state.read_buffer)
+    {
+    case GL_FRONT:
+        mgl_drawbuffer = _FRONT;
+        break;
+    case GL_BACK:
+        mgl_drawbuffer = _BACK;
+        break;
+    case GL_FRONT_LEFT:
+        mgl_drawbuffer = _FRONT_LEFT;
+        break;
+    case GL_FRONT_RIGHT:
+        mgl_drawbuffer = _FRONT_RIGHT;
+        break;
+    case GL_BACK_LEFT:
+        mgl_drawbuffer = _BACK_LEFT;
+        break;
+    case GL_BACK_RIGHT:
+        mgl_drawbuffer = _BACK_RIGHT;
+        break;
+    default:
+        return nil;
     }
+
+    if (depth)
+        return _drawBuffers[mgl_drawbuffer].depthbuffer;
+
+    if (mgl_drawbuffer == _FRONT)
+        return _drawable.texture;
+
+    return _drawBuffers[mgl_drawbuffer].drawbuffer;
+}
+
+#pragma mark C interface to mtlReadPixelsToBuffer
+- (bool)readPixelsToBuffer:(Buffer *)buf
+                    offset:(size_t)offset
+               bytesPerRow:(NSUInteger)bytesPerRow
+                fromRegion:(MTLRegion)region
+                    format:(GLenum)format
+                      type:(GLenum)type
+{
+    id<MTLTexture> texture;
+    id<MTLBuffer> buffer;
+    NSUInteger level, base, texel_size;
+
+    texture = [self readFramebufferTexture:&level depth:false];
+    if (texture == nil || texture.framebufferOnly || texture.sampleCount > 1)
+        return false;
+
+    texel_size = readPixelsTexelSize(texture.pixelFormat, format, type);
+    if (texel_size == 0)
+        return false;
+
+    // blit destinations are texel aligned
+    if ((offset % texel_size) || (bytesPerRow % texel_size))
+        return false;
+
+    if (region.origin.x + region.size.width > texture.width >> level ||
+        region.origin.y + region.size.height > texture.height >> level)
+        return false;
+
+    RETURN_FALSE_ON_FAILURE([self processBuffer:buf]);
+
+    // small buffers only live in the upload arena, the gpu can't write those back. syncing a slab
+    // slot back to the cpu syncs the whole slab, over writes made to the other slots meanwhile
+    if (buf->data.mtl_data == NULL || buf->data.slab)
+        return false;
+
+    // ordered after the draws already encoded
+    [self endRenderEncoding];
+
+    buffer = [self getMTLBuffer:buf offset:&base];
+    RETURN_FALSE_ON_NULL(buffer);
+
+    id<MTLBlitCommandEncoder> blitCommandEncoder;
+    blitCommandEncoder = [_currentCommandBuffer blitCommandEncoder];
+
+    [blitCommandEncoder copyFromTexture:texture
+                            sourceSlice:0
+                            sourceLevel:level
+                           sourceOrigin:region.origin
+                             sourceSize:region.size
+                               toBuffer:buffer
+                      destinationOffset:base + offset
+                 destinationBytesPerRow:bytesPerRow
+               destinationBytesPerImage:bytesPerRow * region.size.height];
+
+    // managed buffers need the gpu copy brought back to the cpu side
+    if (buffer.storageMode == MTLStorageModeManaged)
+        [blitCommandEncoder synchronizeResource:buffer];
+
+    [blitCommandEncoder endEncoding];
+
+    // the fence mapping and glGetBufferSubData wait on
+    buf->data.write_serial = _commandBufferSerial;
+
+    return true;
+}
+
+bool mtlReadPixelsToBuffer(GLMContext glm_ctx, Buffer *buf, size_t offset, GLuint bytesPerRow, GLint x, GLint y,
+                           GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    // Call the Objective-C method using Objective-C syntax
+    return [(__bridge id)glm_ctx->mtl_funcs.mtlObj readPixelsToBuffer:buf
+                                                               offset:offset
+                                                          bytesPerRow:bytesPerRow
+                                                           fromRegion:MTLRegionMake2D(x, y, width, height)
+                                                               format:format
+                                                                 type:type];
+}
+
+#pragma mark C interface to mtlReadPixels
+- (bool)readPixels:(void *)pixelBytes
+            layout:(const PixelStoreLayout *)layout
+       pixelLayout:(PixelLayout)pixel_layout
+        fromRegion:(MTLRegion)region
+             depth:(bool)depth
+{
+    id<MTLTexture> texture;
+    id<MTLBuffer> staging;
+    PixelLayout src_layout;
+    NSUInteger level, texel_size, bytesPerRow;
+
+    texture = [self readFramebufferTexture:&level depth:depth];
+    if (texture == nil || texture.framebufferOnly || texture.sampleCount > 1)
+        return false;
+
+    src_layout = pixelLayoutForMTLPixelFormat(texture.pixelFormat);
+    texel_size = getPixelLayoutSize(src_layout);
+    if (texel_size == 0 || canConvertPixels(pixel_layout, src_layout) == false)
+        return false;
+
+    if (region.origin.x + region.size.width > texture.width >> level ||
+        region.origin.y + region.size.height > texture.height >> level)
+        return false;
+
+    // texels come back tight and get packed straight into the destination
+    bytesPerRow = region.size.width * texel_size;
+
+    staging = [_device newBufferWithLength:bytesPerRow * region.size.height options:MTLResourceStorageModeShared];
+    RETURN_FALSE_ON_NULL(staging);
+
+    [self endRenderEncoding];
+
+    id<MTLBlitCommandEncoder> blitCommandEncoder;
+    blitCommandEncoder = [_currentCommandBuffer blitCommandEncoder];
+
+    [blitCommandEncoder copyFromTexture:texture
+                            sourceSlice:0
+                            sourceLevel:level
+                           sourceOrigin:region.origin
+                             sourceSize:region.size
+                               toBuffer:staging
+                      destinationOffset:0
+                 destinationBytesPerRow:bytesPerRow
+               destinationBytesPerImage:bytesPerRow * region.size.height];
+
+    [blitCommandEncoder endEncoding];
+
+    [self flushCommandBuffer:true];
+
+    return packPixelRows(pixelBytes, layout, pixel_layout, staging.contents, bytesPerRow,
+                         bytesPerRow * region.size.height, src_layout, region.size.width, region.size.height, 1);
+}
+
+bool mtlReadPixels(GLMContext glm_ctx, void *pixelBytes, const PixelStoreLayout *layout, PixelLayout pixel_layout,
+                   GLint x, GLint y, GLsizei width, GLsizei height, bool depth)
+{
+    // Call the Objective-C method using Objective-C syntax
+    return [(__bridge id)glm_ctx->mtl_funcs.mtlObj readPixels:pixelBytes
+                                                       layout:layout
+                                                  pixelLayout:pixel_layout
+                                                   fromRegion:MTLRegionMake2D(x, y, width, height)
+                                                        depth:depth];
 }
 
 #pragma mark C interface to mtlGetTexImage
+// the region is in gl terms, z is the layer, face or slice of a 3d texture like y is the layer of
+// a 1d array. images land bytesPerImage apart, 1d array layers a row apart
 - (void)mtlGetTexImage:(GLMContext)glm_ctx
                    tex:(Texture *)tex
             pixelBytes:(void *)pixelBytes
            bytesPerRow:(NSUInteger)bytesPerRow
          bytesPerImage:(NSUInteger)bytesPerImage
-            fromRegion:(MTLRegion)region
+                origin:(MTLOrigin)origin
+                  size:(MTLSize)size
            mipmapLevel:(NSUInteger)level
-                 slice:(NSUInteger)slice
 {
     id<MTLTexture> texture;
+    NSRange slices;
+    NSUInteger slice_pitch;
+
+    texture = (__bridge id<MTLTexture>)(tex->mtl_data);
+    assert(texture);
 
-    if (tex)
+    if ([texture isFramebufferOnly] == YES)
     {
-        texture = (__bridge id<MTLTexture>)(tex->mtl_data);
-        assert(texture);
+        // issue a gl error as we can't read a framebuffer only texture
+        NSLog(@"Cannot read from framebuffer only texture\n");
+        ctx->error_func(ctx, __FUNCTION__, GL_INVALID_OPERATION);
+        return;
     }
-    else
+
+    // what the gpu wrote is only in the private copy until it's synchronized
+    if (texture.storageMode == MTLStorageModeManaged)
     {
+        id<MTLCommandBuffer> commandBuffer = [_commandQueue commandBuffer];
+        assert(commandBuffer);
+
+        id<MTLBlitCommandEncoder> blitCommandEncoder = [commandBuffer blitCommandEncoder];
+        [blitCommandEncoder synchronizeResource:texture];
+        [blitCommandEncoder endEncoding];
+
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
     }
 
-    if ([texture isFramebufferOnly] == NO)
+    slices = [self slicesOfTexture:texture origin:&origin size:&size];
+    slice_pitch = (texture.textureType == MTLTextureType1DArray) ? bytesPerRow : bytesPerImage;
+
+    for (NSUInteger i = 0; i < slices.length; i++)
     {
-        [texture getBytes:pixelBytes
+        [texture getBytes:(GLubyte *)pixelBytes + i * slice_pitch
               bytesPerRow:bytesPerRow
-            bytesPerImage:bytesPerImage
-               fromRegion:region
+            bytesPerImage:(texture.textureType == MTLTextureType3D) ? bytesPerImage : 0
+               fromRegion:MTLRegionMake3D(origin.x, origin.y, origin.z, size.width, size.height, size.depth)
               mipmapLevel:level
-                    slice:slice];
-    }
-    else
-    {
-        // issue a gl error as we can't read a framebuffer only texture
-        NSLog(@"Cannot read from framebuffer only texture\n");
-        ctx->error_func(ctx, __FUNCTION__, GL_INVALID_OPERATION);
+                    slice:slices.location + i];
     }
 }
 
-void mtlReadDrawable(GLMContext glm_ctx, void *pixelBytes, GLuint bytesPerRow, GLuint bytesPerImage, GLint x, GLint y,
-                     GLsizei width, GLsizei height)
-{
-    [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlReadDrawable:glm_ctx
-                                                 pixelBytes:pixelBytes
-                                                bytesPerRow:bytesPerRow
-                                              bytesPerImage:bytesPerImage
-                                                 fromRegion:MTLRegionMake2D(x, y, width, height)];
-}
-
 void mtlGetTexImage(GLMContext glm_ctx, Texture *tex, void *pixelBytes, GLuint bytesPerRow, GLuint bytesPerImage,
-                    GLint x, GLint y, GLsizei width, GLsizei height, GLuint level, GLuint slice)
+                    GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLuint level)
 {
     [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlGetTexImage:glm_ctx
                                                        tex:tex
                                                 pixelBytes:pixelBytes
                                                bytesPerRow:bytesPerRow
                                              bytesPerImage:bytesPerImage
-                                                fromRegion:MTLRegionMake2D(x, y, width, height)
-                                               mipmapLevel:level
-                                                     slice:slice];
+                                                    origin:MTLOriginMake(x, y, z)
+                                                      size:MTLSizeMake(width, height, depth)
+                                               mipmapLevel:level];
 }
 
 #pragma mark C interface to mtlGenerateMipmaps
@@ -4041,10 +5277,34 @@ void mtlGetTexImage(GLMContext glm_ctx, Texture *tex, void *pixelBytes, GLuint b
     assert(tex->mtl_data);
 
     id<MTLTexture> texture;
+    NSUInteger last_level, base_level, max_level, slices;
 
     texture = (__bridge id<MTLTexture>)(tex->mtl_data);
     assert(texture);
 
+    // only GL_TEXTURE_BASE_LEVEL through GL_TEXTURE_MAX_LEVEL, a view of those levels is filtered
+    // when that isn't the whole chain
+    last_level = texture.mipmapLevelCount - 1;
+    base_level = MIN(tex->params.base_level, last_level);
+    max_level = MIN(tex->params.max_level, last_level);
+
+    if (base_level >= max_level)
+        return;
+
+    if (base_level > 0 || max_level < last_level)
+    {
+        slices = texture.arrayLength;
+
+        if (texture.textureType == MTLTextureTypeCube || texture.textureType == MTLTextureTypeCubeArray)
+            slices *= 6;
+
+        texture = [texture newTextureViewWithPixelFormat:texture.pixelFormat
+                                             textureType:texture.textureType
+                                                  levels:NSMakeRange(base_level, max_level - base_level + 1)
+                                                  slices:NSMakeRange(0, slices)];
+        RETURN_ON_NULL(texture);
+    }
+
     // start blit encoder
     id<MTLBlitCommandEncoder> blitCommandEncoder;
     blitCommandEncoder = [_currentCommandBuffer blitCommandEncoder];
@@ -4077,15 +5337,12 @@ void mtlGenerateMipmaps(GLMContext glm_ctx, Texture *tex)
                zoffset:(size_t)zoffset
 {
     // we can deal with a null buffer but we need a texture
-    if (buf->data.mtl_data == NULL)
-    {
-        [self bindMTLBuffer:buf];
-        RETURN_ON_NULL(buf->data.mtl_data);
-    }
+    RETURN_ON_FAILURE([self processBuffer:buf]);
 
-    id<MTLBuffer> buffer;
-    buffer = (__bridge id<MTLBuffer>)(buf->data.mtl_data);
-    assert(buffer);
+    // pbo can be a slab slot or in the upload arena
+    NSUInteger base;
+    id<MTLBuffer> buffer = [self getMTLBuffer:buf offset:&base];
+    RETURN_ON_NULL(buffer);
 
     if (tex->mtl_data == NULL)
     {
@@ -4097,6 +5354,22 @@ void mtlGenerateMipmaps(GLMContext glm_ctx, Texture *tex)
     texture = (__bridge id<MTLTexture>)(tex->mtl_data);
     assert(texture);
 
+    // slice is the face of a cube map, layers are the zoffset or yoffset of the region and a 3d
+    // texture's zoffset stays in the origin
+    MTLOrigin origin;
+    MTLSize size;
+    NSRange slices;
+    NSUInteger slice_pitch;
+
+    origin = MTLOriginMake(xoffset, yoffset, zoffset);
+    size = MTLSizeMake(width, height, depth);
+
+    if (texture.textureType == MTLTextureTypeCube)
+        origin.z += slice;
+
+    slices = [self slicesOfTexture:texture origin:&origin size:&size];
+    slice_pitch = (texture.textureType == MTLTextureType1DArray) ? src_pitch : src_image_size;
+
     // end encoding on current render encoder
     [self endRenderEncoding];
 
@@ -4104,16 +5377,19 @@ void mtlGenerateMipmaps(GLMContext glm_ctx, Texture *tex)
     id<MTLBlitCommandEncoder> blitCommandEncoder;
     blitCommandEncoder = [_currentCommandBuffer blitCommandEncoder];
 
-    [blitCommandEncoder copyFromBuffer:buffer
-                          sourceOffset:src_offset
-                     sourceBytesPerRow:src_pitch
-                   sourceBytesPerImage:src_image_size
-                            sourceSize:MTLSizeMake(width, height, depth)
-                             toTexture:texture
-                      destinationSlice:zoffset
-                      destinationLevel:level
-                     destinationOrigin:MTLOriginMake(xoffset, yoffset, 0)
-                               options:MTLBlitOptionNone];
+    for (NSUInteger i = 0; i < slices.length; i++)
+    {
+        [blitCommandEncoder copyFromBuffer:buffer
+                              sourceOffset:base + src_offset + i * slice_pitch
+                         sourceBytesPerRow:src_pitch
+                       sourceBytesPerImage:src_image_size
+                                sourceSize:size
+                                 toTexture:texture
+                          destinationSlice:slices.location + i
+                          destinationLevel:level
+                         destinationOrigin:origin
+                                   options:MTLBlitOptionNone];
+    }
 
     [blitCommandEncoder endEncoding];
 }
@@ -4139,6 +5415,263 @@ void mtlTexSubImage(GLMContext glm_ctx, Texture *tex, Buffer *buf, size_t src_of
                                                    zoffset:zoffset];
 }
 
+#pragma mark C interface to mtlClearTexImage
+
+// gl counts layers and cube faces as rows or images of a region, metal as slices. the slices
+// come back and the origin and size are left within one
+- (NSRange)slicesOfTexture:(id<MTLTexture>)texture origin:(MTLOrigin *)origin size:(MTLSize *)size
+{
+    NSRange slices;
+
+    slices = NSMakeRange(0, 1);
+
+    switch (texture.textureType)
+    {
+    case MTLTextureType1DArray:
+        slices = NSMakeRange(origin->y, size->height);
+        origin->y = 0;
+        size->height = 1;
+        break;
+
+    case MTLTextureType2DArray:
+    case MTLTextureTypeCube:
+    case MTLTextureTypeCubeArray:
+        slices = NSMakeRange(origin->z, size->depth);
+        origin->z = 0;
+        size->depth = 1;
+        break;
+
+    default:
+        break;
+    }
+
+    return slices;
+}
+
+// one image of the clear value is staged and copied over every slice and image of the
+// region. the texture is bound first so anything waiting to go up lands under the clear
+- (void)mtlClearTexImage:(GLMContext)glm_ctx
+                     tex:(Texture *)tex
+                   level:(GLuint)level
+                 xoffset:(size_t)xoffset
+                 yoffset:(size_t)yoffset
+                 zoffset:(size_t)zoffset
+                   width:(size_t)width
+                  height:(size_t)height
+                   depth:(size_t)depth
+                   value:(const void *)value
+              value_size:(size_t)value_size
+{
+    MTLOrigin origin;
+    MTLSize size;
+    NSRange slices;
+    size_t row_size, image_size;
+
+    RETURN_ON_FAILURE([self bindMTLTexture:tex]);
+
+    id<MTLTexture> texture;
+    texture = (__bridge id<MTLTexture>)(tex->mtl_data);
+    RETURN_ON_NULL(texture);
+
+    origin = MTLOriginMake(xoffset, yoffset, zoffset);
+    size = MTLSizeMake(width, height, depth);
+    slices = [self slicesOfTexture:texture origin:&origin size:&size];
+
+    row_size = size.width * value_size;
+    image_size = row_size * size.height;
+
+    id<MTLBuffer> staging;
+    staging = [_device newBufferWithLength:image_size options:MTLResourceStorageModeShared];
+    RETURN_ON_NULL(staging);
+
+    patternFill(staging.contents, image_size, value, value_size);
+
+    // end encoding on current render encoder
+    [self endRenderEncoding];
+
+    // start blit encoder
+    id<MTLBlitCommandEncoder> blitCommandEncoder;
+    blitCommandEncoder = [_currentCommandBuffer blitCommandEncoder];
+
+    for (NSUInteger slice = 0; slice < slices.length; slice++)
+    {
+        for (NSUInteger z = 0; z < size.depth; z++)
+        {
+            [blitCommandEncoder copyFromBuffer:staging
+                                  sourceOffset:0
+                             sourceBytesPerRow:row_size
+                           sourceBytesPerImage:image_size
+                                    sourceSize:MTLSizeMake(size.width, size.height, 1)
+                                     toTexture:texture
+                              destinationSlice:slices.location + slice
+                              destinationLevel:level
+                             destinationOrigin:MTLOriginMake(origin.x, origin.y, origin.z + z)];
+        }
+    }
+
+    [blitCommandEncoder endEncoding];
+}
+
+void mtlClearTexImage(GLMContext glm_ctx, Texture *tex, GLuint level, size_t xoffset, size_t yoffset, size_t zoffset,
+                      size_t width, size_t height, size_t depth, const void *value, size_t value_size)
+{
+    [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlClearTexImage:glm_ctx
+                                                         tex:tex
+                                                       level:level
+                                                     xoffset:xoffset
+                                                     yoffset:yoffset
+                                                     zoffset:zoffset
+                                                       width:width
+                                                      height:height
+                                                       depth:depth
+                                                       value:value
+                                                  value_size:value_size];
+}
+
+#pragma mark C interface to mtlCopyImageSubData
+
+// texels of one format copy slice to slice. other formats, and layers that are slices on one
+// end and rows or images on the other, go through a buffer as bytes. both ends have the same
+// bytes a texel or block
+- (void)mtlCopyImageSubData:(GLMContext)glm_ctx src:(const CopyImageRegion *)src dst:(const CopyImageRegion *)dst
+{
+    id<MTLTexture> src_texture, dst_texture;
+    MTLOrigin src_origin, dst_origin;
+    MTLSize src_size, dst_size;
+    NSRange src_slices, dst_slices;
+    size_t row_size, src_image_size, dst_image_size, offset;
+
+    RETURN_ON_FAILURE([self bindMTLTexture:src->tex]);
+    RETURN_ON_FAILURE([self bindMTLTexture:dst->tex]);
+
+    src_texture = (__bridge id<MTLTexture>)(src->tex->mtl_data);
+    dst_texture = (__bridge id<MTLTexture>)(dst->tex->mtl_data);
+    RETURN_ON_NULL(src_texture);
+    RETURN_ON_NULL(dst_texture);
+
+    src_origin = MTLOriginMake(src->x, src->y, src->z);
+    src_size = MTLSizeMake(src->width, src->height, src->depth);
+    src_slices = [self slicesOfTexture:src_texture origin:&src_origin size:&src_size];
+
+    dst_origin = MTLOriginMake(dst->x, dst->y, dst->z);
+    dst_size = MTLSizeMake(dst->width, dst->height, dst->depth);
+    dst_slices = [self slicesOfTexture:dst_texture origin:&dst_origin size:&dst_size];
+
+    // binding can encode, the copy encoder starts after it
+    if (_copyEncoder == nil)
+    {
+        [self endRenderEncoding];
+
+        _copyEncoder = [_currentCommandBuffer blitCommandEncoder];
+        RETURN_ON_NULL(_copyEncoder);
+    }
+
+    if (src_texture.pixelFormat == dst_texture.pixelFormat && src_slices.length == dst_slices.length)
+    {
+        for (NSUInteger slice = 0; slice < src_slices.length; slice++)
+        {
+            [_copyEncoder copyFromTexture:src_texture
+                              sourceSlice:src_slices.location + slice
+                              sourceLevel:src->level
+                             sourceOrigin:src_origin
+                               sourceSize:src_size
+                                toTexture:dst_texture
+                         destinationSlice:dst_slices.location + slice
+                         destinationLevel:dst->level
+                        destinationOrigin:dst_origin];
+        }
+
+        return;
+    }
+
+    row_size = (src->width + src->block_width - 1) / src->block_width * src->unit_size;
+    src_image_size = row_size * ((src_size.height + src->block_height - 1) / src->block_height);
+    dst_image_size = row_size * ((dst_size.height + dst->block_height - 1) / dst->block_height);
+
+    id<MTLBuffer> staging;
+    staging = [_device newBufferWithLength:src_image_size * src_size.depth * src_slices.length
+                                   options:MTLResourceStorageModePrivate];
+    RETURN_ON_NULL(staging);
+
+    offset = 0;
+    for (NSUInteger slice = 0; slice < src_slices.length; slice++)
+    {
+        [_copyEncoder copyFromTexture:src_texture
+                          sourceSlice:src_slices.location + slice
+                          sourceLevel:src->level
+                         sourceOrigin:src_origin
+                           sourceSize:src_size
+                             toBuffer:staging
+                    destinationOffset:offset
+               destinationBytesPerRow:row_size
+             destinationBytesPerImage:src_image_size];
+
+        offset += src_image_size * src_size.depth;
+    }
+
+    offset = 0;
+    for (NSUInteger slice = 0; slice < dst_slices.length; slice++)
+    {
+        [_copyEncoder copyFromBuffer:staging
+                        sourceOffset:offset
+                   sourceBytesPerRow:row_size
+                 sourceBytesPerImage:dst_image_size
+                          sourceSize:dst_size
+                           toTexture:dst_texture
+                    destinationSlice:dst_slices.location + slice
+                    destinationLevel:dst->level
+                   destinationOrigin:dst_origin];
+
+        offset += dst_image_size * dst_size.depth;
+    }
+}
+
+void mtlCopyImageSubData(GLMContext glm_ctx, const CopyImageRegion *src, const CopyImageRegion *dst)
+{
+    [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlCopyImageSubData:glm_ctx src:src dst:dst];
+}
+
+#pragma mark C interface to mtlSupportsCompressedFormat
+
+- (bool)mtlSupportsCompressedFormat:(GLMContext)glm_ctx internalformat:(GLenum)internalformat
+{
+    CompressedFormat format;
+
+    if (getCompressedFormat(internalformat, &format) == false)
+        return false;
+
+    switch (format.blocks)
+    {
+    case COMPRESSED_BLOCKS_BC1:
+    case COMPRESSED_BLOCKS_BC1_RGB:
+    case COMPRESSED_BLOCKS_BC2:
+    case COMPRESSED_BLOCKS_BC3:
+    case COMPRESSED_BLOCKS_BC4:
+    case COMPRESSED_BLOCKS_BC4_SNORM:
+    case COMPRESSED_BLOCKS_BC5:
+    case COMPRESSED_BLOCKS_BC5_SNORM:
+    case COMPRESSED_BLOCKS_BC6H:
+    case COMPRESSED_BLOCKS_BC7:
+        if (@available(macOS 11.0, *))
+            return _device.supportsBCTextureCompression;
+
+        // every mac gpu before apple silicon samples bc
+        return true;
+
+    default:
+        // etc2, eac and astc are apple gpu formats
+        if (@available(macOS 11.0, *))
+            return [_device supportsFamily:MTLGPUFamilyApple2];
+
+        return false;
+    }
+}
+
+bool mtlSupportsCompressedFormat(GLMContext glm_ctx, GLenum internalformat)
+{
+    return [(__bridge id)glm_ctx->mtl_funcs.mtlObj mtlSupportsCompressedFormat:glm_ctx internalformat:internalformat];
+}
+
 #pragma mark utility functions for draw commands
 MTLPrimitiveType getMTLPrimitiveType(GLenum mode)
 {
@@ -4268,18 +5801,9 @@ void mtlDrawArrays(GLMContext glm_ctx, GLenum mode, GLint first, GLsizei count)
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer;
-    if (gl_element_buffer->data.mtl_data != NULL)
-    {
-        indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-    }
-    else
-    {
-        // For small buffers, create a temporary MTL buffer from buffer_data
-        indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                           length:gl_element_buffer->size
-                                          options:MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeManaged];
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
     assert(indexBuffer);
 
     // indices parameter is a byte offset into the index buffer (when using VBO)
@@ -4289,7 +5813,7 @@ void mtlDrawArrays(GLMContext glm_ctx, GLenum mode, GLint first, GLsizei count)
                                       indexCount:count
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset
+                               indexBufferOffset:indexBufferBase + offset
                                    instanceCount:1];
     fprintf(stderr, "DEBUG: mtlDrawElements Metal draw complete\n");
 }
@@ -4330,18 +5854,9 @@ void mtlDrawElements(GLMContext glm_ctx, GLenum mode, GLsizei count, GLenum type
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer;
-    if (gl_element_buffer->data.mtl_data != NULL)
-    {
-        indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-    }
-    else
-    {
-        // For small buffers, create a temporary MTL buffer from buffer_data
-        indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                           length:gl_element_buffer->size
-                                          options:MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeManaged];
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
     assert(indexBuffer);
 
     size_t offset = (char *)indices - (char *)NULL;
@@ -4363,7 +5878,7 @@ void mtlDrawElements(GLMContext glm_ctx, GLenum mode, GLsizei count, GLenum type
                                       indexCount:count
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset
+                               indexBufferOffset:indexBufferBase + offset
                                    instanceCount:1];
 }
 
@@ -4433,19 +5948,9 @@ void mtlDrawArraysInstanced(GLMContext glm_ctx, GLenum mode, GLint first, GLsize
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -4460,7 +5965,7 @@ void mtlDrawArraysInstanced(GLMContext glm_ctx, GLenum mode, GLint first, GLsize
                                       indexCount:count
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset
+                               indexBufferOffset:indexBufferBase + offset
                                    instanceCount:instancecount];
 }
 
@@ -4500,19 +6005,9 @@ void mtlDrawElementsInstanced(GLMContext glm_ctx, GLenum mode, GLsizei count, GL
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -4522,7 +6017,7 @@ void mtlDrawElementsInstanced(GLMContext glm_ctx, GLenum mode, GLsizei count, GL
                                       indexCount:count
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset
+                               indexBufferOffset:indexBufferBase + offset
                                    instanceCount:1
                                       baseVertex:basevertex
                                     baseInstance:0];
@@ -4565,19 +6060,9 @@ void mtlDrawElementsBaseVertex(GLMContext glm_ctx, GLenum mode, GLsizei count, G
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -4598,7 +6083,7 @@ void mtlDrawElementsBaseVertex(GLMContext glm_ctx, GLenum mode, GLsizei count, G
                                       indexCount:end - start
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset + start
+                               indexBufferOffset:indexBufferBase + offset + start
                                    instanceCount:1
                                       baseVertex:basevertex
                                     baseInstance:0];
@@ -4642,19 +6127,9 @@ void mtlDrawRangeElementsBaseVertex(GLMContext glm_ctx, GLenum mode, GLuint star
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -4664,7 +6139,7 @@ void mtlDrawRangeElementsBaseVertex(GLMContext glm_ctx, GLenum mode, GLuint star
                                       indexCount:count
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset
+                               indexBufferOffset:indexBufferBase + offset
                                    instanceCount:instancecount
                                       baseVertex:basevertex
                                     baseInstance:0];
@@ -4698,12 +6173,13 @@ void mtlDrawElementsInstancedBaseVertex(GLMContext glm_ctx, GLenum mode, GLsizei
     if ([self processBuffer:gl_indirect_buffer] == false)
         return;
 
-    id<MTLBuffer> indirectBuffer = (__bridge id<MTLBuffer>)(gl_indirect_buffer->data.mtl_data);
+    NSUInteger indirectBufferBase;
+    id<MTLBuffer> indirectBuffer = [self getMTLBuffer:gl_indirect_buffer offset:&indirectBufferBase];
     assert(indirectBuffer);
 
     [_currentRenderEncoder drawPrimitives:primitiveType
                            indirectBuffer:indirectBuffer
-                     indirectBufferOffset:(DrawArraysIndirectCommand *)indirect - (DrawArraysIndirectCommand *)NULL];
+                     indirectBufferOffset:indirectBufferBase + ((char *)indirect - (char *)NULL)];
 }
 
 void mtlDrawArraysIndirect(GLMContext glm_ctx, GLenum mode, const void *indirect)
@@ -4732,19 +6208,9 @@ void mtlDrawArraysIndirect(GLMContext glm_ctx, GLenum mode, const void *indirect
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -4755,7 +6221,8 @@ void mtlDrawArraysIndirect(GLMContext glm_ctx, GLenum mode, const void *indirect
     if ([self processBuffer:gl_indirect_buffer] == false)
         return;
 
-    id<MTLBuffer> indirectBuffer = (__bridge id<MTLBuffer>)(gl_indirect_buffer->data.mtl_data);
+    NSUInteger indirectBufferBase;
+    id<MTLBuffer> indirectBuffer = [self getMTLBuffer:gl_indirect_buffer offset:&indirectBufferBase];
     assert(indirectBuffer);
 
     // draw indexed primitive
@@ -4763,9 +6230,9 @@ void mtlDrawArraysIndirect(GLMContext glm_ctx, GLenum mode, const void *indirect
         drawIndexedPrimitives:primitiveType
                     indexType:indexType
                   indexBuffer:indexBuffer
-            indexBufferOffset:0
+            indexBufferOffset:indexBufferBase
                indirectBuffer:indirectBuffer
-         indirectBufferOffset:(DrawElementsIndirectCommand *)indirect - (DrawElementsIndirectCommand *)NULL];
+         indirectBufferOffset:indirectBufferBase + ((char *)indirect - (char *)NULL)];
 }
 
 void mtlDrawElementsIndirect(GLMContext glm_ctx, GLenum mode, GLenum type, const void *indirect)
@@ -4832,19 +6299,9 @@ void mtlDrawArraysInstancedBaseInstance(GLMContext glm_ctx, GLenum mode, GLint f
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -4859,7 +6316,7 @@ void mtlDrawArraysInstancedBaseInstance(GLMContext glm_ctx, GLenum mode, GLint f
                                       indexCount:count
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset
+                               indexBufferOffset:indexBufferBase + offset
                                    instanceCount:instancecount
                                       baseVertex:0
                                     baseInstance:baseinstance];
@@ -4904,19 +6361,9 @@ void mtlDrawElementsInstancedBaseInstance(GLMContext glm_ctx, GLenum mode, GLsiz
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -4931,7 +6378,7 @@ void mtlDrawElementsInstancedBaseInstance(GLMContext glm_ctx, GLenum mode, GLsiz
                                       indexCount:count
                                        indexType:indexType
                                      indexBuffer:indexBuffer
-                               indexBufferOffset:offset
+                               indexBufferOffset:indexBufferBase + offset
                                    instanceCount:instancecount
                                       baseVertex:basevertex
                                     baseInstance:baseinstance];
@@ -5005,19 +6452,9 @@ void mtlMultiDrawArrays(GLMContext glm_ctx, GLenum mode, const GLint *first, con
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -5031,7 +6468,7 @@ void mtlMultiDrawArrays(GLMContext glm_ctx, GLenum mode, const GLint *first, con
                                           indexCount:count[i]
                                            indexType:indexType
                                          indexBuffer:indexBuffer
-                                   indexBufferOffset:offset
+                                   indexBufferOffset:indexBufferBase + offset
                                        instanceCount:1];
     }
 }
@@ -5075,19 +6512,9 @@ void mtlMultiDrawElements(GLMContext glm_ctx, GLenum mode, const GLsizei *count,
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -5101,7 +6528,7 @@ void mtlMultiDrawElements(GLMContext glm_ctx, GLenum mode, const GLsizei *count,
                                           indexCount:count[i]
                                            indexType:indexType
                                          indexBuffer:indexBuffer
-                                   indexBufferOffset:offset
+                                   indexBufferOffset:indexBufferBase + offset
                                        instanceCount:count[i]
                                           baseVertex:basevertex[i]
                                         baseInstance:1];
@@ -5139,7 +6566,8 @@ void mtlMultiDrawElementsBaseVertex(GLMContext glm_ctx, GLenum mode, const GLsiz
     if ([self processBuffer:gl_indirect_buffer] == false)
         return;
 
-    id<MTLBuffer> indirectBuffer = (__bridge id<MTLBuffer>)(gl_indirect_buffer->data.mtl_data);
+    NSUInteger indirectBufferBase;
+    id<MTLBuffer> indirectBuffer = [self getMTLBuffer:gl_indirect_buffer offset:&indirectBufferBase];
     assert(indirectBuffer);
 
     for (int i = 0; i < drawcount; i++)
@@ -5155,7 +6583,9 @@ void mtlMultiDrawElementsBaseVertex(GLMContext glm_ctx, GLenum mode, const GLsiz
             offset = (char *)indirect + i - (char *)NULL;
         }
 
-        [_currentRenderEncoder drawPrimitives:primitiveType indirectBuffer:indirectBuffer indirectBufferOffset:offset];
+        [_currentRenderEncoder drawPrimitives:primitiveType
+                               indirectBuffer:indirectBuffer
+                         indirectBufferOffset:indirectBufferBase + offset];
     }
 }
 
@@ -5194,19 +6624,9 @@ void mtlMultiDrawArraysIndirect(GLMContext glm_ctx, GLenum mode, const void *ind
     if ([self processBuffer:gl_element_buffer] == false)
         return;
 
-    id<MTLBuffer> indexBuffer = (__bridge id<MTLBuffer>)(gl_element_buffer->data.mtl_data);
-
-    // Handle small buffers (size <= 4095) that don't have MTL buffer objects
-    if (indexBuffer == nil && gl_element_buffer->size <= 4095)
-    {
-        // For small buffers, create a temporary Metal buffer from buffer_data
-        if (gl_element_buffer->data.buffer_data)
-        {
-            indexBuffer = [_device newBufferWithBytes:(void *)gl_element_buffer->data.buffer_data
-                                               length:gl_element_buffer->size
-                                              options:MTLResourceStorageModeManaged];
-        }
-    }
+    // small element buffers come out of the upload arena
+    NSUInteger indexBufferBase;
+    id<MTLBuffer> indexBuffer = [self getMTLBuffer:gl_element_buffer offset:&indexBufferBase];
 
     assert(indexBuffer);
 
@@ -5217,7 +6637,8 @@ void mtlMultiDrawArraysIndirect(GLMContext glm_ctx, GLenum mode, const void *ind
     if ([self processBuffer:gl_indirect_buffer] == false)
         return;
 
-    id<MTLBuffer> indirectBuffer = (__bridge id<MTLBuffer>)(gl_indirect_buffer->data.mtl_data);
+    NSUInteger indirectBufferBase;
+    id<MTLBuffer> indirectBuffer = [self getMTLBuffer:gl_indirect_buffer offset:&indirectBufferBase];
     assert(indirectBuffer);
 
     for (int i = 0; i < drawcount; i++)
@@ -5237,9 +6658,9 @@ void mtlMultiDrawArraysIndirect(GLMContext glm_ctx, GLenum mode, const void *ind
         [_currentRenderEncoder drawIndexedPrimitives:primitiveType
                                            indexType:indexType
                                          indexBuffer:indexBuffer
-                                   indexBufferOffset:0
+                                   indexBufferOffset:indexBufferBase
                                       indirectBuffer:indirectBuffer
-                                indirectBufferOffset:offset];
+                                indirectBufferOffset:indirectBufferBase + offset];
     }
 }
 
@@ -5275,13 +6696,20 @@ void mtlMultiDrawElementsIndirect(GLMContext glm_ctx, GLenum mode, GLenum type,
 
     glm_ctx->mtl_funcs.mtlBufferSubData = mtlBufferSubData;
     glm_ctx->mtl_funcs.mtlMapUnmapBuffer = mtlMapUnmapBuffer;
-    glm_ctx->mtl_funcs.mtlFlushBufferRange = mtlFlushBufferRange;
+    glm_ctx->mtl_funcs.mtlRenameBuffer = mtlRenameBuffer;
+    glm_ctx->mtl_funcs.mtlSubAllocBuffer = mtlSubAllocBuffer;
+    glm_ctx->mtl_funcs.mtlFreeBufferSubAlloc = mtlFreeBufferSubAlloc;
 
-    glm_ctx->mtl_funcs.mtlReadDrawable = mtlReadDrawable;
+    glm_ctx->mtl_funcs.mtlReadPixels = mtlReadPixels;
+    glm_ctx->mtl_funcs.mtlReadPixelsToBuffer = mtlReadPixelsToBuffer;
     glm_ctx->mtl_funcs.mtlGetTexImage = mtlGetTexImage;
+    glm_ctx->mtl_funcs.mtlReadTextureShadow = mtlReadTextureShadow;
 
     glm_ctx->mtl_funcs.mtlGenerateMipmaps = mtlGenerateMipmaps;
     glm_ctx->mtl_funcs.mtlTexSubImage = mtlTexSubImage;
+    glm_ctx->mtl_funcs.mtlClearTexImage = mtlClearTexImage;
+    glm_ctx->mtl_funcs.mtlCopyImageSubData = mtlCopyImageSubData;
+    glm_ctx->mtl_funcs.mtlSupportsCompressedFormat = mtlSupportsCompressedFormat;
 
     glm_ctx->mtl_funcs.mtlDrawArrays = mtlDrawArrays;
     glm_ctx->mtl_funcs.mtlDrawElements = mtlDrawElements;
@@ -5379,6 +6807,11 @@ void *CppCreateMGLRendererFromContextAndBindToWindow(void *glm_ctx, void *window
     _commandQueue = [_device newCommandQueue];
     assert(_commandQueue);
 
+    pthread_mutex_init(&_completedLock, NULL);
+    pthread_cond_init(&_completedCond, NULL);
+
+    initSubAllocator(&_bufferSubAllocator, newBufferSlab, freeBufferSlab, (__bridge void *)self);
+
     _pipelineStateCache = [[NSMutableDictionary alloc] init];
 
     _view = view;
@@ -18,14 +18,13 @@
  *
  */
 
-#include <mach/mach_vm.h>
-#include <mach/mach_init.h>
-#include <mach/vm_map.h>
 #include <limits.h>
+#include <math.h>
 
 #include "glm_context.h"
 #include "buffers.h"
 #include "pixel_utils.h"
+#include "pattern_fill.h"
 
 #pragma mark Utility Functions
 
@@ -75,11 +74,9 @@ Buffer *newBuffer(GLMContext ctx, GLenum target, GLuint name)
 {
     Buffer *ptr;
 
-    ptr = (Buffer *)malloc(sizeof(Buffer));
+    ptr = (Buffer *)newPoolObject(&STATE(buffer_pool));
     assert(ptr);
 
-    bzero(ptr, sizeof(Buffer));
-
     ptr->name = name;
     ptr->target = target;
 
@@ -172,18 +169,62 @@ bool checkUsage(GLMContext ctx, GLenum usage)
     return false;
 }
 
-size_t page_size_align(size_t size)
+void setBufferDataDirty(Buffer *ptr, size_t offset, size_t length)
 {
-    if (size & (4096 - 1))
+    addDirtyRange(&ptr->data.dirty_ranges, offset, length);
+
+    ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
+}
+
+void releaseBufferRenames(GLMContext ctx, Buffer *ptr)
+{
+    for (GLuint i = 0; i < ptr->num_renames; i++)
     {
-        size_t pad_size = 0;
+        if (ptr->renames[i].mtl_data)
+        {
+            ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->renames[i].mtl_data);
+        }
+    }
+
+    free(ptr->renames);
 
-        pad_size = 4096 - (size & (4096 - 1));
+    ptr->renames = NULL;
+    ptr->num_renames = 0;
+}
 
-        size += pad_size;
+void releaseBufferStorage(GLMContext ctx, Buffer *ptr)
+{
+    if (ptr->data.slab)
+    {
+        // slot goes back once the gpu is done with it
+        ctx->mtl_funcs.mtlFreeBufferSubAlloc(ctx, ptr);
+    }
+    else if (ptr->data.mtl_data)
+    {
+        // client storage mtl buffers have a deallocator for the backing
+        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->data.mtl_data);
+    }
+    else if (ptr->data.client_memory)
+    {
+        // never wrapped, hand it straight back
+        if (ptr->data.client_release)
+            ptr->data.client_release((void *)ptr->data.buffer_data, ptr->data.buffer_size,
+                                     ptr->data.client_release_user);
+    }
+    else if (ptr->data.buffer_data)
+    {
+        // never got an mtl buffer, the backing is still ours
+        freePages((void *)ptr->data.buffer_data, ptr->data.buffer_size);
     }
 
-    return size;
+    releaseBufferRenames(ctx, ptr);
+
+    ptr->data.mtl_data = NULL;
+    ptr->data.buffer_data = 0;
+    ptr->data.buffer_size = 0;
+    ptr->data.client_memory = GL_FALSE;
+    ptr->data.client_release = NULL;
+    ptr->data.client_release_user = NULL;
 }
 
 void *getBufferData(GLMContext ctx, Buffer *ptr)
@@ -201,35 +242,62 @@ void *getBufferData(GLMContext ctx, Buffer *ptr)
     return buffer_data;
 }
 
-void bufferStorage(GLMContext ctx, Buffer *ptr, GLenum target, GLuint index, GLsizeiptr size, const void *data,
-                   GLbitfield storage_flags, GLenum usage)
+void getBufferMemory(Buffer *ptr, MemoryStats *stats)
 {
-    kern_return_t err;
-    vm_address_t buffer_data;
-    size_t buffer_size;
+    size_t size;
 
-    buffer_size = page_size_align(size);
+    stats->objects++;
 
-    // Allocate directly from VM
-    err = vm_allocate((vm_map_t)mach_task_self(), (vm_address_t *)&buffer_data, buffer_size, VM_FLAGS_ANYWHERE);
-    if (err)
+    // what was allocated, the gl size until storage is made
+    size = MAX(ptr->data.buffer_size, (size_t)ptr->size);
+
+    if (ptr->data.slab)
     {
-        ERROR_RETURN(GL_OUT_OF_MEMORY);
+        stats->managed_bytes += size;
     }
+    else if (ptr->data.mtl_data)
+    {
+        size_t bytes;
 
-    ptr->data.buffer_data = buffer_data;
+        bytes = size;
 
-    // copy to new buffer
-    if (data)
-    {
-        memcpy((void *)ptr->data.buffer_data, data, size);
+        // stores retired by renaming are the same size
+        for (GLuint i = 0; i < ptr->num_renames; i++)
+        {
+            if (ptr->renames[i].mtl_data)
+                bytes += size;
+        }
 
-        ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
+        if (ptr->storage_flags & (GL_MAP_PERSISTENT_BIT | GL_CLIENT_STORAGE_BIT))
+            stats->shared_bytes += bytes;
+        else
+            stats->managed_bytes += bytes;
+    }
+    else if (ptr->data.buffer_data)
+    {
+        stats->cpu_bytes += ptr->data.buffer_size;
     }
+}
 
-    // init
-    ptr->data.buffer_data = buffer_data;
-    ptr->data.buffer_size = buffer_size;
+static bool useBufferSubAlloc(GLMContext ctx, GLenum target, GLsizeiptr size, GLbitfield storage_flags)
+{
+    if (ctx->buffer_suballocation == GL_FALSE)
+        return false;
+
+    // readbacks blit into pack buffers, syncing one slot back syncs the whole slab
+    if (target == GL_PIXEL_PACK_BUFFER)
+        return false;
+
+    // persistent and client storage want a buffer of their own
+    if (storage_flags & (GL_CLIENT_STORAGE_BIT | GL_MAP_PERSISTENT_BIT))
+        return false;
+
+    return (size > 0 && size <= SUB_ALLOC_MAX_SIZE);
+}
+
+static void initBufferStorage(Buffer *ptr, GLenum target, GLuint index, GLsizeiptr size, GLbitfield storage_flags,
+                              GLenum usage)
+{
     ptr->index = index;
     ptr->target = target;
     ptr->size = size;
@@ -248,87 +316,436 @@ void bufferStorage(GLMContext ctx, Buffer *ptr, GLenum target, GLuint index, GLs
     ptr->access = 0;
     ptr->access_flags = 0;
     ptr->storage_flags = storage_flags;
+}
 
-    ptr->data.dirty_bits |= DIRTY_BUFFER_ADDR;
+void bufferStorage(GLMContext ctx, Buffer *ptr, GLenum target, GLuint index, GLsizeiptr size, const void *data,
+                   GLbitfield storage_flags, GLenum usage)
+{
+    vm_address_t buffer_data;
+    size_t buffer_size;
 
-    if (data)
+    // GL_INVALID_OPERATION is generated if the GL_BUFFER_IMMUTABLE_STORAGE flag of the buffer is GL_TRUE
+    if (ptr->immutable_storage)
     {
-        if (storage_flags & (GL_CLIENT_STORAGE_BIT | GL_DYNAMIC_STORAGE_BIT))
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // anything glBufferData gave it
+    releaseBufferStorage(ctx, ptr);
+
+    initBufferStorage(ptr, target, index, size, storage_flags, usage);
+
+    // small buffers get a slot in a shared slab
+    if (useBufferSubAlloc(ctx, target, size, storage_flags) && ctx->mtl_funcs.mtlSubAllocBuffer(ctx, ptr))
+    {
+        if (data)
         {
-            memcpy((void *)ptr->data.buffer_data, data, ptr->size);
+            memcpy((void *)ptr->data.buffer_data, data, size);
+
+            setBufferDataDirty(ptr, 0, size);
         }
-        else
+
+        ctx->state.dirty_bits |= DIRTY_BUFFER;
+
+        return;
+    }
+
+    // large buffers go straight into their mtl buffer, no cpu copy to build it from.
+    // client storage stays in our pages and gets wrapped with newBufferWithBytesNoCopy
+    // when first used, small buffers stay in the upload arena path
+    if (!(storage_flags & GL_CLIENT_STORAGE_BIT) && (size > 4095 || (storage_flags & GL_MAP_PERSISTENT_BIT)))
+    {
+        ctx->mtl_funcs.mtlBindBuffer(ctx, ptr);
+
+        if (ptr->data.mtl_data == NULL)
         {
-            ctx->mtl_funcs.mtlBufferSubData(ctx, ptr, 0, ptr->size, data);
+            ERROR_RETURN(GL_OUT_OF_MEMORY);
+            return;
         }
+
+        // the store covers the gl size, it can be rounded up past it
+        assert(ptr->data.buffer_size >= size);
+
+        if (data)
+        {
+            memcpy((void *)ptr->data.buffer_data, data, size);
+
+            setBufferDataDirty(ptr, 0, size);
+        }
+
+        ctx->state.dirty_bits |= DIRTY_BUFFER;
+
+        return;
+    }
+
+    buffer_data = (vm_address_t)allocPages(size, ((storage_flags & GL_CLIENT_STORAGE_BIT) ? PAGE_ALLOC_ZERO_COPY : 0) |
+                                                     PAGE_ALLOC_HUGE_PAGES,
+                                           &buffer_size);
+    if (buffer_data == 0)
+    {
+        ERROR_RETURN(GL_OUT_OF_MEMORY);
+    }
+
+    ptr->data.buffer_data = buffer_data;
+    ptr->data.buffer_size = buffer_size;
+
+    if (data)
+    {
+        memcpy((void *)ptr->data.buffer_data, data, size);
+
+        setBufferDataDirty(ptr, 0, size);
     }
+
+    ptr->data.dirty_bits |= DIRTY_BUFFER_ADDR;
+
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
 }
 
-bool clearBufferData(GLMContext ctx, Buffer *ptr, GLenum internalformat, GLintptr offset, GLsizeiptr size,
-                     GLenum format, GLenum type, const void *data)
+bool bufferStorageClientMemory(GLMContext ctx, Buffer *ptr, GLsizeiptr size, void *memory, GLbitfield storage_flags,
+                               void (*release)(void *ptr, size_t size, void *user), void *user)
+{
+    // GL_INVALID_OPERATION is generated if the GL_BUFFER_IMMUTABLE_STORAGE flag of the buffer is GL_TRUE
+    ERROR_CHECK_RETURN_VALUE(ptr->immutable_storage == 0, GL_INVALID_OPERATION, false);
+
+    // newBufferWithBytesNoCopy wants whole pages
+    if (size <= 0 || memory == NULL || ((uintptr_t)memory & (getPageSize() - 1)))
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_VALUE, false);
+    }
+
+    if (storage_flags & ~(GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                          GL_MAP_COHERENT_BIT | GL_CLIENT_STORAGE_BIT))
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_VALUE, false);
+    }
+
+    releaseBufferStorage(ctx, ptr);
+
+    initBufferStorage(ptr, ptr->target, ptr->index, size, storage_flags | GL_CLIENT_STORAGE_BIT, 0);
+
+    // the app's pages are the buffer, nothing to copy
+    ptr->data.buffer_data = (vm_address_t)memory;
+    ptr->data.buffer_size = page_size_align(size);
+    ptr->data.client_memory = GL_TRUE;
+    ptr->data.client_release = release;
+    ptr->data.client_release_user = user;
+
+    ptr->data.dirty_bits |= DIRTY_BUFFER_ADDR;
+
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
+
+    return true;
+}
+
+#pragma mark Buffer Clears
+
+// how a sized internal format a buffer can be cleared to is laid out
+typedef struct ClearFormat_t
+{
+    GLuint components;
+    GLenum type;
+    GLboolean normalized; // unsigned fixed point
+    GLboolean integer;    // has to come from an _INTEGER format
+} ClearFormat;
+
+static bool clearFormatForInternalFormat(GLenum internalformat, ClearFormat *fmt)
+{
+#define CLEAR_FORMAT(_components_, _type_, _normalized_, _integer_)                                                    \
+    fmt->components = _components_;                                                                                    \
+    fmt->type = _type_;                                                                                                \
+    fmt->normalized = _normalized_;                                                                                    \
+    fmt->integer = _integer_;                                                                                          \
+    return true
+
+    switch (internalformat)
+    {
+    case GL_R8: CLEAR_FORMAT(1, GL_UNSIGNED_BYTE, true, false);
+    case GL_R16: CLEAR_FORMAT(1, GL_UNSIGNED_SHORT, true, false);
+    case GL_R16F: CLEAR_FORMAT(1, GL_HALF_FLOAT, false, false);
+    case GL_R32F: CLEAR_FORMAT(1, GL_FLOAT, false, false);
+    case GL_R8I: CLEAR_FORMAT(1, GL_BYTE, false, true);
+    case GL_R16I: CLEAR_FORMAT(1, GL_SHORT, false, true);
+    case GL_R32I: CLEAR_FORMAT(1, GL_INT, false, true);
+    case GL_R8UI: CLEAR_FORMAT(1, GL_UNSIGNED_BYTE, false, true);
+    case GL_R16UI: CLEAR_FORMAT(1, GL_UNSIGNED_SHORT, false, true);
+    case GL_R32UI: CLEAR_FORMAT(1, GL_UNSIGNED_INT, false, true);
+
+    case GL_RG8: CLEAR_FORMAT(2, GL_UNSIGNED_BYTE, true, false);
+    case GL_RG16: CLEAR_FORMAT(2, GL_UNSIGNED_SHORT, true, false);
+    case GL_RG16F: CLEAR_FORMAT(2, GL_HALF_FLOAT, false, false);
+    case GL_RG32F: CLEAR_FORMAT(2, GL_FLOAT, false, false);
+    case GL_RG8I: CLEAR_FORMAT(2, GL_BYTE, false, true);
+    case GL_RG16I: CLEAR_FORMAT(2, GL_SHORT, false, true);
+    case GL_RG32I: CLEAR_FORMAT(2, GL_INT, false, true);
+    case GL_RG8UI: CLEAR_FORMAT(2, GL_UNSIGNED_BYTE, false, true);
+    case GL_RG16UI: CLEAR_FORMAT(2, GL_UNSIGNED_SHORT, false, true);
+    case GL_RG32UI: CLEAR_FORMAT(2, GL_UNSIGNED_INT, false, true);
+
+    case GL_RGB32F: CLEAR_FORMAT(3, GL_FLOAT, false, false);
+    case GL_RGB32I: CLEAR_FORMAT(3, GL_INT, false, true);
+    case GL_RGB32UI: CLEAR_FORMAT(3, GL_UNSIGNED_INT, false, true);
+
+    case GL_RGBA8: CLEAR_FORMAT(4, GL_UNSIGNED_BYTE, true, false);
+    case GL_RGBA16: CLEAR_FORMAT(4, GL_UNSIGNED_SHORT, true, false);
+    case GL_RGBA16F: CLEAR_FORMAT(4, GL_HALF_FLOAT, false, false);
+    case GL_RGBA32F: CLEAR_FORMAT(4, GL_FLOAT, false, false);
+    case GL_RGBA8I: CLEAR_FORMAT(4, GL_BYTE, false, true);
+    case GL_RGBA16I: CLEAR_FORMAT(4, GL_SHORT, false, true);
+    case GL_RGBA32I: CLEAR_FORMAT(4, GL_INT, false, true);
+    case GL_RGBA8UI: CLEAR_FORMAT(4, GL_UNSIGNED_BYTE, false, true);
+    case GL_RGBA16UI: CLEAR_FORMAT(4, GL_UNSIGNED_SHORT, false, true);
+    case GL_RGBA32UI: CLEAR_FORMAT(4, GL_UNSIGNED_INT, false, true);
+    }
+
+#undef CLEAR_FORMAT
+
+    return false;
+}
+
+static double readClearComponent(GLenum type, const void *data, GLuint index, bool normalize)
 {
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        return normalize ? ((const GLubyte *)data)[index] / 255.0 : ((const GLubyte *)data)[index];
+
+    case GL_BYTE:
+        return normalize ? fmax(((const GLbyte *)data)[index] / 127.0, -1.0) : ((const GLbyte *)data)[index];
+
+    case GL_UNSIGNED_SHORT:
+        return normalize ? ((const GLushort *)data)[index] / 65535.0 : ((const GLushort *)data)[index];
+
+    case GL_SHORT:
+        return normalize ? fmax(((const GLshort *)data)[index] / 32767.0, -1.0) : ((const GLshort *)data)[index];
+
+    case GL_UNSIGNED_INT:
+        return normalize ? ((const GLuint *)data)[index] / 4294967295.0 : ((const GLuint *)data)[index];
+
+    case GL_INT:
+        return normalize ? fmax(((const GLint *)data)[index] / 2147483647.0, -1.0) : ((const GLint *)data)[index];
+
+    case GL_HALF_FLOAT:
+        return halfToFloat(((const GLushort *)data)[index]);
+
+    case GL_FLOAT:
+        return ((const GLfloat *)data)[index];
+    }
+
+    assert(0);
+
+    return 0;
+}
+
+static double clampClearComponent(double value, double min, double max)
+{
+    // nan goes to 0 like the GL conversion rules say
+    if (!(value >= min))
+        return (value != value) ? 0 : min;
+
+    if (value > max)
+        return max;
+
+    return value;
+}
+
+static void writeClearComponent(const ClearFormat *fmt, double value, void *dst, GLuint index)
+{
+    if (fmt->normalized)
+        value = clampClearComponent(value, 0.0, 1.0);
+
+    switch (fmt->type)
+    {
+    case GL_UNSIGNED_BYTE:
+        ((GLubyte *)dst)[index] = (GLubyte)(fmt->normalized ? lround(value * 255.0) : clampClearComponent(value, 0, 255));
+        break;
+
+    case GL_BYTE:
+        ((GLbyte *)dst)[index] = (GLbyte)clampClearComponent(value, -128, 127);
+        break;
+
+    case GL_UNSIGNED_SHORT:
+        ((GLushort *)dst)[index] =
+            (GLushort)(fmt->normalized ? lround(value * 65535.0) : clampClearComponent(value, 0, 65535));
+        break;
+
+    case GL_SHORT:
+        ((GLshort *)dst)[index] = (GLshort)clampClearComponent(value, -32768, 32767);
+        break;
+
+    case GL_UNSIGNED_INT:
+        ((GLuint *)dst)[index] = (GLuint)clampClearComponent(value, 0, 4294967295.0);
+        break;
+
+    case GL_INT:
+        ((GLint *)dst)[index] = (GLint)clampClearComponent(value, -2147483648.0, 2147483647.0);
+        break;
+
+    case GL_HALF_FLOAT:
+        ((GLushort *)dst)[index] = floatToHalf((float)value);
+        break;
+
+    case GL_FLOAT:
+        ((GLfloat *)dst)[index] = (GLfloat)value;
+        break;
+
+    default:
+        assert(0);
+    }
+}
+
+// converts the app's clear value to one element of internalformat, done once per clear
+static GLenum convertClearValue(const ClearFormat *fmt, GLenum format, GLenum type, const void *data, void *value)
+{
+    double components[4] = {0.0, 0.0, 0.0, 1.0};
+    GLuint count;
+    bool integer, bgr;
+
+    integer = false;
+    bgr = false;
+
     switch (format)
     {
-    case GL_R8:
-    case GL_R16:
-    case GL_R16F:
-    case GL_R32F:
-    case GL_R8I:
-    case GL_R16I:
-    case GL_R32I:
-    case GL_R8UI:
-    case GL_R16UI:
-    case GL_R32UI:
-    case GL_RG8:
-    case GL_RG16:
-    case GL_RG16F:
-    case GL_RG32F:
-    case GL_RG8I:
-    case GL_RG16I:
-    case GL_RG32I:
-    case GL_RG8UI:
-    case GL_RG16UI:
-    case GL_RG32UI:
-    case GL_RGB32F:
-    case GL_RGB32I:
-    case GL_RGB32UI:
-    case GL_RGBA8:
-    case GL_RGBA16:
-    case GL_RGBA16F:
-    case GL_RGBA32F:
-    case GL_RGBA8I:
-    case GL_RGBA16I:
-    case GL_RGBA32I:
-    case GL_RGBA8UI:
-    case GL_RGBA16UI:
-    case GL_RGBA32UI:
+    case GL_RED_INTEGER:
+    case GL_RG_INTEGER:
+    case GL_RGB_INTEGER:
+    case GL_RGBA_INTEGER:
+        integer = true;
+        break;
+
+    case GL_BGR_INTEGER:
+    case GL_BGRA_INTEGER:
+        integer = true;
+        bgr = true;
+        break;
+
+    case GL_BGR:
+    case GL_BGRA:
+        bgr = true;
+        break;
+
+    case GL_RED:
+    case GL_RG:
+    case GL_RGB:
+    case GL_RGBA:
         break;
 
     default:
-        ERROR_RETURN_VALUE(GL_INVALID_ENUM, false);
+        return GL_INVALID_ENUM;
     }
 
-    if (offset + size > ptr->size)
+    switch (type)
     {
-        ERROR_RETURN_VALUE(GL_INVALID_VALUE, false);
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+        break;
+
+    case GL_HALF_FLOAT:
+    case GL_FLOAT:
+        if (integer)
+            return GL_INVALID_OPERATION;
+        break;
+
+    default:
+        return GL_INVALID_ENUM;
+    }
+
+    if (integer != fmt->integer)
+        return GL_INVALID_OPERATION;
+
+    count = numComponentsForFormat(format);
+    assert(count <= 4);
+
+    for (GLuint i = 0; i < count; i++)
+    {
+        GLuint dst;
+
+        // bgr(a) stores blue first
+        dst = (bgr && i < 3) ? 2 - i : i;
+
+        components[dst] = readClearComponent(type, data, i, !integer);
     }
 
-    size_t pixel_size = sizeForInternalFormat(internalformat, format, type);
-    assert(pixel_size);
+    for (GLuint i = 0; i < fmt->components; i++)
+        writeClearComponent(fmt, components[i], value, i);
 
-    size_t pixel_count;
-    pixel_count = size / pixel_size;
+    return GL_NO_ERROR;
+}
 
+bool clearBufferData(GLMContext ctx, Buffer *ptr, GLenum internalformat, GLintptr offset, GLsizeiptr size,
+                     GLenum format, GLenum type, const void *data)
+{
+    ClearFormat fmt;
+    GLubyte value[16];
+    size_t value_size;
     GLubyte *dst;
-    dst = (GLubyte *)data + offset;
+    GLenum err;
+
+    // GL_INVALID_ENUM is generated if internalformat is not one of the valid sized internal formats
+    if (clearFormatForInternalFormat(internalformat, &fmt) == false)
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_ENUM, false);
+    }
+
+    value_size = fmt.components * sizeForType(fmt.type);
 
-    for (int i = 0; i < pixel_count; i++)
+    // GL_INVALID_VALUE is generated if offset or size is negative, or if offset + size is greater than the value of
+    // GL_BUFFER_SIZE for buffer.
+    if (offset < 0 || size < 0 || offset + size > ptr->size)
     {
-        memcpy(dst, data, pixel_size);
-        dst += pixel_size;
+        ERROR_RETURN_VALUE(GL_INVALID_VALUE, false);
     }
 
-    assert(0);
+    // GL_INVALID_VALUE is generated if offset or size is not a multiple of the element size of internalformat
+    if ((offset % value_size) || (size % value_size))
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_VALUE, false);
+    }
+
+    // GL_INVALID_OPERATION is generated if any part of the range is mapped, unless it was mapped persistent
+    if (ptr->mapped && !(ptr->access_flags & GL_MAP_PERSISTENT_BIT))
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+    }
+
+    // a NULL value clears to zero
+    if (data)
+    {
+        err = convertClearValue(&fmt, format, type, data, value);
+        if (err)
+        {
+            ERROR_RETURN_VALUE(err, false);
+        }
+    }
+    else
+    {
+        bzero(value, value_size);
+    }
+
+    if (size == 0)
+        return true;
+
+    // don't fill under draws that still read the old contents, the map renames the buffer if it's in flight
+    // and waits on the gpu for client storage and persistent buffers that can't move
+    dst = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, offset, size,
+                                           GL_MAP_WRITE_BIT | ((offset > 0 || size < ptr->size)
+                                                                   ? GL_MAP_INVALIDATE_RANGE_BIT
+                                                                   : GL_MAP_INVALIDATE_BUFFER_BIT),
+                                           true);
+    assert(dst);
+
+    patternFill(dst, size, value, value_size);
+
+    setBufferDataDirty(ptr, offset, size);
+
+    ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, offset, size, GL_MAP_WRITE_BIT, false);
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
+
+    return true;
 }
 
 #pragma mark GL Buffer Functions
@@ -355,6 +772,19 @@ void mglCreateBuffers(GLMContext ctx, GLsizei n, GLuint *buffers)
     }
 }
 
+static void detachBufferFromTexture(void *data, void *arg)
+{
+    Texture *tex;
+
+    tex = (Texture *)data;
+
+    if (tex->tex_buffer == (Buffer *)arg)
+    {
+        tex->tex_buffer = NULL;
+        tex->dirty_bits |= DIRTY_TEXTURE_LEVEL;
+    }
+}
+
 void mglDeleteBuffers(GLMContext ctx, GLsizei n, const GLuint *buffers)
 {
     GLuint buffer;
@@ -373,30 +803,8 @@ void mglDeleteBuffers(GLMContext ctx, GLsizei n, const GLuint *buffers)
         {
             Buffer *ptr;
             ptr = (Buffer *)searchHashTable(&STATE(buffer_table), buffer);
-            if (ptr->data.buffer_data)
-            {
-                if (ptr->storage_flags & GL_CLIENT_STORAGE_BIT)
-                {
-                    if (ptr->data.mtl_data)
-                    {
-                        // the mtl buffer has a deallocator for the vm allocate
-                        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->data.mtl_data);
-                    }
-                    else
-                    {
-                        vm_deallocate(mach_host_self(), ptr->data.buffer_data, ptr->data.buffer_size);
-                    }
-                }
-                else
-                {
-                    if (ptr->data.mtl_data)
-                    {
-                        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->data.mtl_data);
-                    }
-                }
 
-                ptr->data.buffer_data = 0;
-            }
+            releaseBufferStorage(ctx, ptr);
 
             deleteHashElement(&STATE(buffer_table), buffer);
 
@@ -448,7 +856,11 @@ void mglDeleteBuffers(GLMContext ctx, GLsizei n, const GLuint *buffers)
             }
             }
 
-            free(ptr);
+            // buffer textures over it read nothing from here on
+            iterateHashTable(&STATE(texture_table), detachBufferFromTexture, ptr);
+            STATE(dirty_bits) |= DIRTY_TEX;
+
+            freePoolObject(&STATE(buffer_pool), ptr);
         } // if (isBuffer(ctx, buffer))
     } // while(--n)
 }
@@ -605,9 +1017,8 @@ void mglBindBufferRange(GLMContext ctx, GLenum target, GLuint index, GLuint buff
 }
 
 #pragma mark GL Buffer Data Functions
-kern_return_t initBufferData(GLMContext ctx, Buffer *ptr, GLsizeiptr size, const void *data, bool isUniformConstant)
+bool initBufferData(GLMContext ctx, Buffer *ptr, GLsizeiptr size, const void *data, bool isUniformConstant)
 {
-    kern_return_t err;
     vm_address_t buffer_data;
     size_t buffer_size;
 
@@ -623,60 +1034,57 @@ kern_return_t initBufferData(GLMContext ctx, Buffer *ptr, GLsizeiptr size, const
                 {
                     memcpy((void *)ptr->data.buffer_data, data, size);
 
-                    ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
+                    setBufferDataDirty(ptr, 0, size);
                 }
 
-                return 0;
+                return true;
             }
         }
-
-        if (ptr->storage_flags & GL_CLIENT_STORAGE_BIT)
+        else if ((ptr->data.slab || (ptr->data.mtl_data && size > 4095)) && (size_t)size <= ptr->data.buffer_size &&
+                 (size_t)size > ptr->data.buffer_size / 2 && !(ptr->storage_flags & GL_CLIENT_STORAGE_BIT))
         {
-            if (ptr->data.mtl_data)
-            {
-                // the mtl buffer has a deallocator for the vm allocate
-                ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->data.mtl_data);
+            // respecifying a buffer the same size is the classic orphan idiom, hand the
+            // old store to the GPU and keep going instead of tearing it down
+            ctx->mtl_funcs.mtlRenameBuffer(ctx, ptr, false);
 
-                if (isUniformConstant)
-                {
-                    ptr->data.mtl_data = NULL;
-                }
-            }
-            else
-            {
-                vm_deallocate(mach_host_self(), ptr->data.buffer_data, ptr->data.buffer_size);
-            }
+            ptr->size = size;
 
-            ptr->data.buffer_data = 0;
-            ptr->data.buffer_size = 0;
-        }
-        else
-        {
-            if (ptr->data.mtl_data)
+            if (data)
             {
-                ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->data.mtl_data);
+                memcpy((void *)ptr->data.buffer_data, data, size);
             }
 
-            if (isUniformConstant)
-            {
-                ptr->data.mtl_data = NULL;
-            }
+            setBufferDataDirty(ptr, 0, size);
 
-            ptr->data.buffer_data = 0;
-            ptr->data.buffer_size = 0;
+            return true;
         }
+
+        releaseBufferStorage(ctx, ptr);
     }
 
-    buffer_size = page_size_align(size);
+    ptr->size = size;
 
-    // Allocate directly from VM
-    err = vm_allocate((vm_map_t)mach_task_self(), (vm_address_t *)&buffer_data, buffer_size, VM_FLAGS_ANYWHERE);
-    if (err)
+    // uniform constants are rewritten all the time, they stay in the upload arena
+    if (!isUniformConstant && useBufferSubAlloc(ctx, ptr->target, size, 0) && ctx->mtl_funcs.mtlSubAllocBuffer(ctx, ptr))
     {
-        ERROR_RETURN_VALUE(GL_OUT_OF_MEMORY, err);
+        if (data)
+        {
+            memcpy((void *)ptr->data.buffer_data, data, size);
+        }
+
+        setBufferDataDirty(ptr, 0, size);
+
+        ctx->state.dirty_bits |= DIRTY_BUFFER;
+
+        return true;
+    }
+
+    buffer_data = (vm_address_t)allocPages(size, PAGE_ALLOC_HUGE_PAGES, &buffer_size);
+    if (buffer_data == 0)
+    {
+        ERROR_RETURN_VALUE(GL_OUT_OF_MEMORY, false);
     }
 
-    ptr->size = size;
     ptr->data.buffer_data = buffer_data;
     ptr->data.buffer_size = buffer_size;
 
@@ -687,10 +1095,10 @@ kern_return_t initBufferData(GLMContext ctx, Buffer *ptr, GLsizeiptr size, const
     {
         memcpy((void *)ptr->data.buffer_data, data, size);
 
-        ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
+        setBufferDataDirty(ptr, 0, size);
     }
 
-    return err;
+    return true;
 }
 
 void mglBufferData(GLMContext ctx, GLenum target, GLsizeiptr size, const void *data, GLenum usage)
@@ -792,7 +1200,7 @@ void mglBufferSubData(GLMContext ctx, GLenum target, GLintptr offset, GLsizeiptr
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    if (ptr->mapped && !(ptr->access & GL_MAP_PERSISTENT_BIT))
+    if (ptr->mapped && !(ptr->access_flags & GL_MAP_PERSISTENT_BIT))
     {
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
@@ -807,10 +1215,16 @@ void mglBufferSubData(GLMContext ctx, GLenum target, GLintptr offset, GLsizeiptr
 
     if (ptr->storage_flags & (GL_CLIENT_STORAGE_BIT | GL_DYNAMIC_STORAGE_BIT))
     {
+        // the GPU may still have draws queued against the mtl buffer
+        if (ptr->data.mtl_data || ptr->data.slab)
+        {
+            ctx->mtl_funcs.mtlRenameBuffer(ctx, ptr, (offset > 0 || size < ptr->size));
+        }
+
         // copy it to the backing and use processGLState to upload new data
         memcpy((char *)ptr->data.buffer_data + offset, data, size);
 
-        ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
+        setBufferDataDirty(ptr, offset, size);
         ctx->state.dirty_bits |= DIRTY_BUFFER;
     }
     else
@@ -843,7 +1257,7 @@ void mglNamedBufferSubData(GLMContext ctx, GLuint buffer, GLintptr offset, GLsiz
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    if (ptr->mapped && !(ptr->access & GL_MAP_PERSISTENT_BIT))
+    if (ptr->mapped && !(ptr->access_flags & GL_MAP_PERSISTENT_BIT))
     {
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
@@ -858,17 +1272,17 @@ void mglNamedBufferSubData(GLMContext ctx, GLuint buffer, GLintptr offset, GLsiz
 
     if (ptr->storage_flags & (GL_CLIENT_STORAGE_BIT | GL_DYNAMIC_STORAGE_BIT))
     {
-        // copy it to the backing and use processGLState to upload new data
-        memcpy((char *)ptr->data.buffer_data + offset, data, size);
-
-        if (ptr->data.mtl_data)
+        if (ptr->data.mtl_data || ptr->data.slab)
         {
-            // use use metal to do the subdata call
+            // use use metal to do the subdata call, it renames the buffer if it's in flight
             ctx->mtl_funcs.mtlBufferSubData(ctx, ptr, offset, size, data);
         }
         else
         {
-            ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
+            // copy it to the backing and use processGLState to upload new data
+            memcpy((char *)ptr->data.buffer_data + offset, data, size);
+
+            setBufferDataDirty(ptr, offset, size);
 
             // probably shouldn't have to do this... if its not bound its an excess
             ctx->state.dirty_bits |= DIRTY_BUFFER;
@@ -924,25 +1338,31 @@ void copyBufferSubData(GLMContext ctx, Buffer *src_buf, Buffer *dst_buf, GLintpt
         }
     }
 
-    if (src_buf->mapped && !(src_buf->access & GL_MAP_PERSISTENT_BIT))
+    if (src_buf->mapped && !(src_buf->access_flags & GL_MAP_PERSISTENT_BIT))
     {
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    if (dst_buf->mapped && !(dst_buf->access & GL_MAP_PERSISTENT_BIT))
+    if (dst_buf->mapped && !(dst_buf->access_flags & GL_MAP_PERSISTENT_BIT))
     {
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    src_data = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, src_buf, readOffset, size, GL_READ_ONLY, true);
+    // the source only waits for what the gpu writes to it, the destination is renamed if it's in flight
+    src_data = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, src_buf, readOffset, size, GL_MAP_READ_BIT, true);
     assert(src_data);
 
-    dst_data = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, dst_buf, writeOffset, size, GL_WRITE_ONLY, true);
+    dst_data = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, dst_buf, writeOffset, size,
+                                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT, true);
     assert(dst_data);
 
     memcpy(dst_data, src_data, size);
 
-    ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, dst_buf, writeOffset, size, GL_WRITE_ONLY, false);
+    setBufferDataDirty(dst_buf, writeOffset, size);
+
+    ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, dst_buf, writeOffset, size, GL_MAP_WRITE_BIT, false);
+
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
 }
 
 void mglCopyBufferSubData(GLMContext ctx, GLenum readTarget, GLenum writeTarget, GLintptr readOffset,
@@ -1019,7 +1439,6 @@ void mglClearBufferData(GLMContext ctx, GLenum target, GLenum internalformat, GL
 {
     GLuint index;
     Buffer *ptr;
-    GLboolean err;
 
     // GL_INVALID_ENUM is generated if target is not supported.
     ERROR_CHECK_RETURN(checkTarget(ctx, target), GL_INVALID_ENUM);
@@ -1032,8 +1451,7 @@ void mglClearBufferData(GLMContext ctx, GLenum target, GLenum internalformat, GL
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    err = clearBufferData(ctx, ptr, internalformat, 0, ptr->size, format, type, data);
-    ERROR_CHECK_RETURN(err == true, GL_INVALID_ENUM);
+    clearBufferData(ctx, ptr, internalformat, 0, ptr->size, format, type, data);
 }
 
 void mglClearBufferSubData(GLMContext ctx, GLenum target, GLenum internalformat, GLintptr offset, GLsizeiptr size,
@@ -1041,7 +1459,6 @@ void mglClearBufferSubData(GLMContext ctx, GLenum target, GLenum internalformat,
 {
     GLuint index;
     Buffer *ptr;
-    GLboolean err;
 
     // GL_INVALID_ENUM is generated if target is not supported.
     ERROR_CHECK_RETURN(checkTarget(ctx, target), GL_INVALID_ENUM);
@@ -1054,15 +1471,13 @@ void mglClearBufferSubData(GLMContext ctx, GLenum target, GLenum internalformat,
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    err = clearBufferData(ctx, ptr, internalformat, offset, ptr->size, format, type, data);
-    ERROR_CHECK_RETURN(err == true, GL_INVALID_ENUM);
+    clearBufferData(ctx, ptr, internalformat, offset, size, format, type, data);
 }
 
 void mglClearNamedBufferData(GLMContext ctx, GLuint buffer, GLenum internalformat, GLenum format, GLenum type,
                              const void *data)
 {
     Buffer *ptr;
-    GLboolean err;
 
     ptr = findBuffer(ctx, buffer);
 
@@ -1071,15 +1486,13 @@ void mglClearNamedBufferData(GLMContext ctx, GLuint buffer, GLenum internalforma
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    err = clearBufferData(ctx, ptr, internalformat, 0, ptr->size, format, type, data);
-    ERROR_CHECK_RETURN(err == true, GL_INVALID_ENUM);
+    clearBufferData(ctx, ptr, internalformat, 0, ptr->size, format, type, data);
 }
 
 void mglClearNamedBufferSubData(GLMContext ctx, GLuint buffer, GLenum internalformat, GLintptr offset, GLsizeiptr size,
                                 GLenum format, GLenum type, const void *data)
 {
     Buffer *ptr;
-    GLboolean err;
 
     ptr = findBuffer(ctx, buffer);
 
@@ -1088,8 +1501,7 @@ void mglClearNamedBufferSubData(GLMContext ctx, GLuint buffer, GLenum internalfo
         ERROR_RETURN(GL_INVALID_OPERATION);
     }
 
-    err = clearBufferData(ctx, ptr, internalformat, offset, ptr->size, format, type, data);
-    ERROR_CHECK_RETURN(err == true, GL_INVALID_ENUM);
+    clearBufferData(ctx, ptr, internalformat, offset, size, format, type, data);
 }
 
 #pragma mark GL Buffer Map Functions
@@ -1097,6 +1509,8 @@ void *mglMapBuffer(GLMContext ctx, GLenum target, GLenum access)
 {
     GLuint index;
     Buffer *ptr;
+    GLbitfield access_flags;
+    void *data;
 
     // GL_INVALID_ENUM is generated if target is not supported.
     ERROR_CHECK_RETURN_VALUE(checkTarget(ctx, target), GL_INVALID_ENUM, NULL);
@@ -1104,8 +1518,15 @@ void *mglMapBuffer(GLMContext ctx, GLenum target, GLenum access)
     switch (access)
     {
     case GL_READ_ONLY:
+        access_flags = GL_MAP_READ_BIT;
+        break;
+
     case GL_WRITE_ONLY:
+        access_flags = GL_MAP_WRITE_BIT;
+        break;
+
     case GL_READ_WRITE:
+        access_flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
         break;
 
     default:
@@ -1116,14 +1537,17 @@ void *mglMapBuffer(GLMContext ctx, GLenum target, GLenum access)
     ptr = STATE(buffers[index]);
 
     ERROR_CHECK_RETURN_VALUE((ptr != NULL), GL_INVALID_OPERATION, NULL);
+    ERROR_CHECK_RETURN_VALUE((ptr->mapped == GL_FALSE), GL_INVALID_OPERATION, NULL);
+
+    data = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, 0, ptr->size, access_flags, true);
 
     ptr->mapped = GL_TRUE;
     ptr->access = access;
-    ptr->access_flags = 0;
+    ptr->access_flags = access_flags;
     ptr->mapped_offset = 0;
     ptr->mapped_length = ptr->size;
 
-    return ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, 0, ptr->size, access, true);
+    return data;
 }
 
 void *mglMapNamedBuffer(GLMContext ctx, GLuint buffer, GLenum access)
@@ -1144,25 +1568,23 @@ GLboolean mglUnmapBuffer(GLMContext ctx, GLenum target)
     ptr = STATE(buffers[index]);
 
     ERROR_CHECK_RETURN_VALUE((ptr != NULL), GL_INVALID_OPERATION, GL_FALSE);
+    ERROR_CHECK_RETURN_VALUE((ptr->mapped == GL_TRUE), GL_INVALID_OPERATION, GL_FALSE);
 
-    if ((ptr->storage_flags & GL_MAP_PERSISTENT_BIT) && (ptr->access & GL_MAP_PERSISTENT_BIT))
+    // without explicit flushes any of the mapped range may have been written
+    if ((ptr->access_flags & GL_MAP_WRITE_BIT) && !(ptr->access_flags & GL_MAP_FLUSH_EXPLICIT_BIT))
     {
-        // this will cause the buffer to be flushed on next draw command
-        ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
-
-        assert(ptr->mapped == GL_FALSE);
-        ptr->access = 0;
-
-        return GL_TRUE;
+        setBufferDataDirty(ptr, ptr->mapped_offset, ptr->mapped_length);
     }
 
+    ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, ptr->mapped_offset, ptr->mapped_length, ptr->access_flags, false);
+
     ptr->mapped = GL_FALSE;
     ptr->access = 0;
     ptr->access_flags = 0;
     ptr->mapped_offset = 0;
     ptr->mapped_length = 0;
 
-    ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, 0, ptr->size, 0, false);
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
 
     return GL_TRUE;
 }
@@ -1180,6 +1602,7 @@ void *mglMapBufferRange(GLMContext ctx, GLenum target, GLintptr offset, GLsizeip
 {
     GLuint index;
     Buffer *ptr;
+    void *data;
 
     // GL_INVALID_ENUM is generated if target is not supported.
     ERROR_CHECK_RETURN_VALUE(checkTarget(ctx, target), GL_INVALID_ENUM, NULL);
@@ -1216,36 +1639,61 @@ void *mglMapBufferRange(GLMContext ctx, GLenum target, GLintptr offset, GLsizeip
         ERROR_RETURN_VALUE(GL_INVALID_OPERATION, NULL);
     }
 
-    ptr->access = 0;
-    ptr->mapped_offset = offset;
-    ptr->mapped_length = length;
-
-    if (access_flags & GL_MAP_PERSISTENT_BIT)
+    // GL_INVALID_OPERATION is generated if neither GL_MAP_READ_BIT or GL_MAP_WRITE_BIT is set, if GL_MAP_READ_BIT
+    // is set with any of the invalidate or unsynchronized bits, or GL_MAP_FLUSH_EXPLICIT_BIT without GL_MAP_WRITE_BIT
+    if ((access_flags & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT)) == 0)
     {
-        if (ptr->storage_flags & GL_MAP_PERSISTENT_BIT)
-        {
-            ptr->access_flags = access_flags;
+        ERROR_RETURN_VALUE(GL_INVALID_OPERATION, NULL);
+    }
 
-            ptr->data.dirty_bits |= DIRTY_BUFFER_DATA;
+    if ((access_flags & GL_MAP_READ_BIT) &&
+        (access_flags & (GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT)))
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_OPERATION, NULL);
+    }
 
-            // return a pointer to the backing data without marking it as mapped
-            return (void *)ptr->data.buffer_data;
-        }
+    if ((access_flags & GL_MAP_FLUSH_EXPLICIT_BIT) && !(access_flags & GL_MAP_WRITE_BIT))
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_OPERATION, NULL);
+    }
 
-        // if buffer was not marked with GL_MAP_PERSISTENT_BIT in storage flags
-        // it is an error to map with persistant
+    // if buffer was not marked with GL_MAP_PERSISTENT_BIT or GL_MAP_COHERENT_BIT in storage flags it is an error
+    // to map with them
+    if ((access_flags & GL_MAP_PERSISTENT_BIT) && !(ptr->storage_flags & GL_MAP_PERSISTENT_BIT))
+    {
         ERROR_RETURN_VALUE(GL_INVALID_OPERATION, NULL);
     }
-    else if (access_flags & GL_MAP_COHERENT_BIT)
+
+    if ((access_flags & GL_MAP_COHERENT_BIT) && !(ptr->storage_flags & GL_MAP_COHERENT_BIT))
     {
-        // GL_MAP_PERSISTENT_BIT and GL_MAP_COHERENT_BIT need to be together
         ERROR_RETURN_VALUE(GL_INVALID_OPERATION, NULL);
     }
 
-    ptr->access_flags = access_flags;
+    // persistent mappings alias the mtl buffer for as long as the app keeps them, the app
+    // fences its own writes against the gpu. everything else is synchronized by the map.
+    data = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, offset, length, access_flags, true);
+
     ptr->mapped = GL_TRUE;
+    ptr->access_flags = access_flags;
+    ptr->mapped_offset = offset;
+    ptr->mapped_length = length;
 
-    return ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, offset, length, access_flags, true);
+    switch (access_flags & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT))
+    {
+    case GL_MAP_READ_BIT:
+        ptr->access = GL_READ_ONLY;
+        break;
+
+    case GL_MAP_WRITE_BIT:
+        ptr->access = GL_WRITE_ONLY;
+        break;
+
+    default:
+        ptr->access = GL_READ_WRITE;
+        break;
+    }
+
+    return data;
 }
 
 void *mglMapNamedBufferRange(GLMContext ctx, GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
@@ -1260,49 +1708,45 @@ void mglFlushMappedBufferRange(GLMContext ctx, GLenum target, GLintptr offset, G
     Buffer *ptr;
 
     // GL_INVALID_ENUM is generated if target is not supported.
-    ERROR_CHECK_RETURN(checkTarget(ctx, target), GL_INVALID_ENUM);
-
-    if (offset < 0)
+    if (checkTarget(ctx, target) == false)
     {
-        ERROR_RETURN(GL_INVALID_VALUE);
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
     }
 
-    if (length < 0)
+    // GL_INVALID_VALUE is generated if offset or length is negative
+    if (offset < 0 || length < 0)
     {
         ERROR_RETURN(GL_INVALID_VALUE);
+        return;
     }
 
     index = bufferIndexFromTarget(ctx, target);
     ptr = STATE(buffers[index]);
 
-    ERROR_CHECK_RETURN((ptr != NULL), GL_INVALID_OPERATION);
-
-    bool isCoherent = ptr->access & GL_MAP_COHERENT_BIT;
-
-    if ((ptr->mapped == false) && (isCoherent == false))
+    if (ptr == NULL || ptr->mapped == GL_FALSE)
     {
-        // not mapped by map buffer range
         ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    if (offset < ptr->mapped_offset)
+    if ((ptr->access_flags & GL_MAP_FLUSH_EXPLICIT_BIT) == 0)
     {
-        ERROR_RETURN(GL_INVALID_VALUE);
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
+    // offset is relative to the start of the mapping
     if (offset + length > ptr->mapped_length)
     {
         ERROR_RETURN(GL_INVALID_VALUE);
+        return;
     }
 
-    if (ptr->access_flags & GL_MAP_FLUSH_EXPLICIT_BIT)
-    {
-        ctx->mtl_funcs.mtlFlushBufferRange(ctx, ptr, offset, length);
-    }
-    else
-    {
-        ERROR_RETURN(GL_INVALID_OPERATION);
-    }
+    // only the flushed ranges are uploaded, on unmap or on the next draw for persistent mappings
+    setBufferDataDirty(ptr, ptr->mapped_offset + offset, length);
+
+    ctx->state.dirty_bits |= DIRTY_BUFFER;
 }
 
 void mglFlushMappedNamedBufferRange(GLMContext ctx, GLuint buffer, GLintptr offset, GLsizeiptr length)
@@ -1369,16 +1813,89 @@ void mglNamedBufferStorage(GLMContext ctx, GLuint buffer, GLsizeiptr size, const
     bufferStorage(ctx, ptr, 0, 0, size, data, storage_flags, 0);
 }
 
+static void invalidateBufferRange(GLMContext ctx, Buffer *ptr, size_t offset, size_t length)
+{
+    if (offset == 0 && length >= (size_t)ptr->size)
+    {
+        // queued command buffers keep the old store, the next write lands in a fresh
+        // one without copying what it can't read anyway
+        if (ptr->data.mtl_data || ptr->data.slab)
+            ctx->mtl_funcs.mtlRenameBuffer(ctx, ptr, false);
+
+        clearDirtyRanges(&ptr->data.dirty_ranges);
+        ptr->data.dirty_bits &= ~DIRTY_BUFFER_DATA;
+
+        return;
+    }
+
+    // no ranges recorded means the whole buffer is dirty, that can't be trimmed
+    if (ptr->data.dirty_ranges.count == 0)
+        return;
+
+    removeDirtyRange(&ptr->data.dirty_ranges, offset, length);
+
+    if (ptr->data.dirty_ranges.count == 0)
+        ptr->data.dirty_bits &= ~DIRTY_BUFFER_DATA;
+}
+
 void mglInvalidateBufferData(GLMContext ctx, GLuint buffer)
 {
-    // Unimplemented function
-    assert(0);
+    Buffer *ptr;
+
+    ptr = findBuffer(ctx, buffer);
+
+    // GL_INVALID_VALUE is generated if buffer is not the name of an existing buffer object.
+    if (ptr == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    // GL_INVALID_OPERATION is generated if any part of buffer is currently mapped, unless
+    // it was mapped with GL_MAP_PERSISTENT_BIT.
+    if (ptr->mapped && (ptr->access_flags & GL_MAP_PERSISTENT_BIT) == 0)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    invalidateBufferRange(ctx, ptr, 0, ptr->size);
 }
 
 void mglInvalidateBufferSubData(GLMContext ctx, GLuint buffer, GLintptr offset, GLsizeiptr length)
 {
-    // Unimplemented function
-    assert(0);
+    Buffer *ptr;
+
+    ptr = findBuffer(ctx, buffer);
+
+    // GL_INVALID_VALUE is generated if buffer is not the name of an existing buffer object.
+    if (ptr == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    // GL_INVALID_VALUE is generated if offset or length is negative, or if offset + length is
+    // greater than the value of GL_BUFFER_SIZE for buffer.
+    if (offset < 0 || length < 0 || offset + length > ptr->size)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    // GL_INVALID_OPERATION is generated if any part of buffer in the range offset and length
+    // is currently mapped, unless it was mapped with GL_MAP_PERSISTENT_BIT.
+    if (ptr->mapped && (ptr->access_flags & GL_MAP_PERSISTENT_BIT) == 0 && offset < ptr->mapped_offset + ptr->mapped_length &&
+        ptr->mapped_offset < offset + length)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    if (length == 0)
+        return;
+
+    invalidateBufferRange(ctx, ptr, offset, length);
 }
 
 #pragma mark GL Buffer Get Functions
@@ -1478,22 +1995,41 @@ void mglGetBufferPointerv(GLMContext ctx, GLenum target, GLenum pname, void **pa
     }
 }
 
+static void getBufferSubData(GLMContext ctx, Buffer *ptr, size_t offset, size_t size, void *data)
+{
+    void *src;
+
+    if (size == 0)
+        return;
+
+    // only waits if a readback into the buffer is still queued on the gpu
+    src = ctx->mtl_funcs.mtlMapUnmapBuffer(ctx, ptr, offset, size, GL_MAP_READ_BIT, true);
+
+    memcpy(data, src, size);
+}
+
 void mglGetBufferSubData(GLMContext ctx, GLenum target, GLintptr offset, GLsizeiptr size, void *data)
 {
     GLuint index;
     Buffer *ptr;
 
     // GL_INVALID_ENUM is generated if target is not supported.
-    ERROR_CHECK_RETURN(checkTarget(ctx, target), GL_INVALID_ENUM);
+    if (checkTarget(ctx, target) == false)
+    {
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
 
     if (offset < 0)
     {
         ERROR_RETURN(GL_INVALID_VALUE);
+        return;
     }
 
     if (size < 0)
     {
         ERROR_RETURN(GL_INVALID_VALUE);
+        return;
     }
 
     index = bufferIndexFromTarget(ctx, target);
@@ -1502,20 +2038,22 @@ void mglGetBufferSubData(GLMContext ctx, GLenum target, GLintptr offset, GLsizei
     if (ptr == NULL)
     {
         ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
     if (offset + size > ptr->size)
     {
         ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    if (ptr->mapped && !(ptr->access & GL_MAP_PERSISTENT_BIT))
+    if (ptr->mapped && !(ptr->access_flags & GL_MAP_PERSISTENT_BIT))
     {
         ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    // copy to data at offset
-    memcpy(data, &((void *)ptr->data.buffer_data)[offset], ptr->data.buffer_size);
+    getBufferSubData(ctx, ptr, offset, size, data);
 }
 
 void mglGetNamedBufferParameteriv(GLMContext ctx, GLuint buffer, GLenum pname, GLint *params)
@@ -1612,6 +2150,32 @@ void mglGetNamedBufferPointerv(GLMContext ctx, GLuint buffer, GLenum pname, void
 
 void mglGetNamedBufferSubData(GLMContext ctx, GLuint buffer, GLintptr offset, GLsizeiptr size, void *data)
 {
-    // Unimplemented function
-    assert(0);
+    Buffer *ptr;
+
+    ptr = findBuffer(ctx, buffer);
+
+    // GL_INVALID_OPERATION is generated if buffer is not the name of an existing buffer object.
+    if (ptr == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // GL_INVALID_VALUE is generated if offset or size is negative, or if offset + size is greater than the value of
+    // GL_BUFFER_SIZE for the buffer object.
+    if (offset < 0 || size < 0 || offset + size > ptr->size)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    // GL_INVALID_OPERATION is generated if the buffer object is mapped with glMapBufferRange or glMapBuffer, unless it
+    // was mapped with the GL_MAP_PERSISTENT_BIT bit set in the glMapBufferRange access flags.
+    if (ptr->mapped && !(ptr->access_flags & GL_MAP_PERSISTENT_BIT))
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    getBufferSubData(ctx, ptr, offset, size, data);
 }
@@ -8,13 +8,14 @@
 #ifndef buffers_h
 #define buffers_h
 
-#if defined(__i386__) || defined(__x86_64__)
-#include <mach/i386/kern_return.h>
-#else
-#include <mach/arm/kern_return.h>
-#endif
-
-kern_return_t initBufferData(GLMContext ctx, Buffer *ptr, GLsizeiptr size, const void *data, bool isUniformConstant);
+bool initBufferData(GLMContext ctx, Buffer *ptr, GLsizeiptr size, const void *data, bool isUniformConstant);
 Buffer *newBuffer(GLMContext ctx, GLenum target, GLuint name);
+Buffer *findBuffer(GLMContext ctx, GLuint buffer);
+void releaseBufferRenames(GLMContext ctx, Buffer *ptr);
+void releaseBufferStorage(GLMContext ctx, Buffer *ptr);
+bool bufferStorageClientMemory(GLMContext ctx, Buffer *ptr, GLsizeiptr size, void *memory, GLbitfield storage_flags,
+                               void (*release)(void *ptr, size_t size, void *user), void *user);
+void setBufferDataDirty(Buffer *ptr, size_t offset, size_t length);
+void getBufferMemory(Buffer *ptr, MemoryStats *stats);
 
 #endif /* buffers_h */
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * dirty_ranges.c
+ * MGL
+ *
+ */
+
+
+#include <string.h>
+#include <assert.h>
+
+#include "dirty_ranges.h"
+
+void clearDirtyRanges(DirtyRangeSet *set)
+{
+    set->count = 0;
+}
+
+// first range that ends at or after offset, the only one that can touch it from below
+static unsigned findRange(const DirtyRangeSet *set, size_t offset)
+{
+    unsigned lo, hi;
+
+    lo = 0;
+    hi = set->count;
+
+    while (lo < hi)
+    {
+        unsigned mid;
+
+        mid = (lo + hi) / 2;
+
+        if (set->ranges[mid].end < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static void removeRanges(DirtyRangeSet *set, unsigned index, unsigned count)
+{
+    memmove(&set->ranges[index], &set->ranges[index + count],
+            sizeof(DirtyRange) * (set->count - index - count));
+
+    set->count -= count;
+}
+
+static unsigned findSmallestGap(const DirtyRangeSet *set, size_t *gap)
+{
+    unsigned best;
+
+    assert(set->count > 1);
+
+    best = 0;
+    *gap = set->ranges[1].start - set->ranges[0].end;
+
+    for (unsigned i = 1; i < set->count - 1; i++)
+    {
+        if (set->ranges[i + 1].start - set->ranges[i].end < *gap)
+        {
+            *gap = set->ranges[i + 1].start - set->ranges[i].end;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+void addDirtyRange(DirtyRangeSet *set, size_t offset, size_t length)
+{
+    size_t end;
+    unsigned index, last;
+
+    if (length == 0)
+        return;
+
+    end = offset + length;
+
+    // sequential writes land on or past the last range
+    if (set->count && set->ranges[set->count - 1].end >= offset && set->ranges[set->count - 1].start <= offset)
+    {
+        if (end > set->ranges[set->count - 1].end)
+            set->ranges[set->count - 1].end = end;
+
+        return;
+    }
+
+    index = findRange(set, offset);
+
+    // merge everything the new range overlaps or touches
+    last = index;
+    while (last < set->count && set->ranges[last].start <= end)
+        last++;
+
+    if (last > index)
+    {
+        DirtyRange *range;
+
+        range = &set->ranges[index];
+
+        if (offset < range->start)
+            range->start = offset;
+
+        if (set->ranges[last - 1].end > end)
+            end = set->ranges[last - 1].end;
+
+        range->end = end;
+
+        if (last - index > 1)
+            removeRanges(set, index + 1, last - index - 1);
+
+        return;
+    }
+
+    if (set->count == MAX_DIRTY_RANGES)
+    {
+        size_t gap, gap_below, gap_above;
+        unsigned best;
+
+        gap_below = index > 0 ? offset - set->ranges[index - 1].end : (size_t)-1;
+        gap_above = index < set->count ? set->ranges[index].start - end : (size_t)-1;
+
+        best = findSmallestGap(set, &gap);
+
+        // growing a neighbour over the new range is cheaper than joining two old ones
+        if (gap_below <= gap && gap_below <= gap_above)
+        {
+            set->ranges[index - 1].end = end;
+            return;
+        }
+
+        if (gap_above <= gap)
+        {
+            set->ranges[index].start = offset;
+            return;
+        }
+
+        // the new range can't sit in that gap, either neighbour would be closer
+        set->ranges[best].end = set->ranges[best + 1].end;
+        removeRanges(set, best + 1, 1);
+
+        if (best < index)
+            index--;
+    }
+
+    memmove(&set->ranges[index + 1], &set->ranges[index], sizeof(DirtyRange) * (set->count - index));
+
+    set->ranges[index].start = offset;
+    set->ranges[index].end = end;
+    set->count++;
+}
+
+void removeDirtyRange(DirtyRangeSet *set, size_t offset, size_t length)
+{
+    size_t end;
+    unsigned index;
+
+    if (length == 0)
+        return;
+
+    end = offset + length;
+
+    index = findRange(set, offset);
+
+    while (index < set->count && set->ranges[index].start < end)
+    {
+        DirtyRange *range;
+
+        range = &set->ranges[index];
+
+        if (range->end <= offset)
+        {
+            index++;
+            continue;
+        }
+
+        if (range->start >= offset && range->end <= end)
+        {
+            removeRanges(set, index, 1);
+            continue;
+        }
+
+        // a hole in the middle splits the range
+        if (range->start < offset && range->end > end)
+        {
+            // no room, flushing a little extra is harmless
+            if (set->count == MAX_DIRTY_RANGES)
+                return;
+
+            memmove(&set->ranges[index + 1], &set->ranges[index], sizeof(DirtyRange) * (set->count - index));
+            set->count++;
+
+            set->ranges[index].end = offset;
+            set->ranges[index + 1].start = end;
+
+            return;
+        }
+
+        if (range->start < offset)
+            range->end = offset;
+        else
+            range->start = end;
+
+        index++;
+    }
+}
+
+size_t getDirtyRangeBytes(const DirtyRangeSet *set)
+{
+    size_t bytes;
+
+    bytes = 0;
+
+    for (unsigned i = 0; i < set->count; i++)
+        bytes += set->ranges[i].end - set->ranges[i].start;
+
+    return bytes;
+}
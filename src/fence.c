@@ -86,14 +86,7 @@ void mglDeleteSync(GLMContext ctx, GLsync sync)
         return;
     }
 
-    if (sync->mtl_event)
-    {
-        ctx->mtl_funcs.mtlWaitForSync(ctx, sync);
-
-        // should be null
-        assert(sync->mtl_event == NULL);
-    }
-
+    // nothing on the gpu side refers to it, the serial is all there is
     free(sync);
 }
 
@@ -113,16 +106,7 @@ GLenum mglClientWaitSync(GLMContext ctx, GLsync sync, GLbitfield flags, GLuint64
         return GL_INVALID_VALUE;
     }
 
-    if (sync->mtl_event == NULL)
-    {
-        return GL_ALREADY_SIGNALED;
-    }
-
-    ctx->mtl_funcs.mtlWaitForSync(ctx, sync);
-
-    assert(sync->mtl_event == NULL);
-
-    return GL_CONDITION_SATISFIED;
+    return ctx->mtl_funcs.mtlWaitForSync(ctx, sync, (flags & GL_SYNC_FLUSH_COMMANDS_BIT) != 0, timeout);
 }
 
 void mglWaitSync(GLMContext ctx, GLsync sync, GLbitfield flags, GLuint64 timeout)
@@ -132,11 +116,13 @@ void mglWaitSync(GLMContext ctx, GLsync sync, GLbitfield flags, GLuint64 timeout
         assert(0);
     }
 
-    assert(timeout == GL_TIMEOUT_IGNORED);
-
-    ctx->mtl_funcs.mtlWaitForSync(ctx, sync);
+    if (flags != 0 || timeout != GL_TIMEOUT_IGNORED)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-    assert(sync->mtl_event == NULL);
+    // there is only one queue and it executes in order, the server already waits
 }
 
 void mglGetSynciv(GLMContext ctx, GLsync sync, GLenum pname, GLsizei count, GLsizei *length, GLint *values)
@@ -164,15 +150,14 @@ void mglGetSynciv(GLMContext ctx, GLsync sync, GLenum pname, GLsizei count, GLsi
             break;
 
         case GL_SYNC_STATUS:
-            if (sync->mtl_event)
-                *values = GL_UNSIGNALED;
-            else
+            if (ctx->mtl_funcs.mtlWaitForSync(ctx, sync, false, 0) == GL_ALREADY_SIGNALED)
                 *values = GL_SIGNALED;
+            else
+                *values = GL_UNSIGNALED;
             break;
 
         case GL_SYNC_CONDITION:
-            if (sync->mtl_event == NULL)
-                *values = GL_SYNC_GPU_COMMANDS_COMPLETE;
+            *values = GL_SYNC_GPU_COMMANDS_COMPLETE;
             break;
 
         case GL_SYNC_FLAGS:
@@ -37,11 +37,9 @@ static Renderbuffer *newRenderbuffer(GLMContext ctx, GLuint renderbuffer)
 {
     Renderbuffer *ptr;
 
-    ptr = (Renderbuffer *)malloc(sizeof(Renderbuffer));
+    ptr = (Renderbuffer *)newPoolObject(&STATE(renderbuffer_pool));
     assert(ptr);
 
-    bzero(ptr, sizeof(Renderbuffer));
-
     ptr->name = renderbuffer;
 
     return ptr;
@@ -108,11 +106,9 @@ static Framebuffer *newFramebuffer(GLMContext ctx, GLuint framebuffer)
 {
     Framebuffer *ptr;
 
-    ptr = (Framebuffer *)malloc(sizeof(Framebuffer));
+    ptr = (Framebuffer *)newPoolObject(&STATE(framebuffer_pool));
     assert(ptr);
 
-    bzero(ptr, sizeof(Framebuffer));
-
     ptr->name = framebuffer;
 
     return ptr;
@@ -426,6 +422,20 @@ bool isCubeMapTarget(GLMContext ctx, GLuint textarget)
     return ((textarget >= GL_TEXTURE_CUBE_MAP_POSITIVE_X) && (textarget <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z));
 }
 
+// the image of its level the attachment draws to, a cube map face or the layer. what
+// invalidation keeps track of, see getTexLevelImages
+GLuint getFBOAttachmentImage(FBOAttachment *fbo_attachment)
+{
+    if ((fbo_attachment->textarget >= GL_TEXTURE_CUBE_MAP_POSITIVE_X) &&
+        (fbo_attachment->textarget <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z))
+        return fbo_attachment->textarget - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+
+    if (fbo_attachment->textarget == GL_RENDERBUFFER)
+        return 0;
+
+    return fbo_attachment->layer;
+}
+
 void framebufferTexture(GLMContext ctx, GLenum target, GLenum attachment_type, GLenum attachment, GLenum textarget,
                         GLuint texture, GLint level, GLint layer)
 {
@@ -873,17 +883,135 @@ void mglGetFramebufferParameteriv(GLMContext ctx, GLenum target, GLenum pname, G
     assert(0);
 }
 
+static void invalidateFramebuffer(GLMContext ctx, Framebuffer *fbo, GLsizei numAttachments, const GLenum *attachments,
+                                  GLint x, GLint y, GLsizei width, GLsizei height, bool whole)
+{
+    // GL_INVALID_VALUE is generated if numAttachments, width or height is negative.
+    if (numAttachments < 0 || width < 0 || height < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    for (GLsizei i = 0; i < numAttachments; i++)
+    {
+        FBOAttachment *fbo_attachment;
+        TextureLevel *tex_level;
+        Texture *tex;
+        GLenum attachment;
+
+        attachment = attachments[i];
+
+        if (fbo == NULL)
+        {
+            switch (attachment)
+            {
+            case GL_COLOR:
+            case GL_DEPTH:
+            case GL_STENCIL:
+                break;
+            default:
+                ERROR_RETURN(GL_INVALID_ENUM);
+                return;
+            }
+
+            // the drawables are ours, they're cleared at the start of a frame anyway
+            continue;
+        }
+
+        switch (attachment)
+        {
+        case GL_DEPTH_ATTACHMENT:
+        case GL_STENCIL_ATTACHMENT:
+        case GL_DEPTH_STENCIL_ATTACHMENT:
+            break;
+        default:
+            if (attachment < GL_COLOR_ATTACHMENT0 || attachment > GL_COLOR_ATTACHMENT31)
+            {
+                ERROR_RETURN(GL_INVALID_ENUM);
+                return;
+            }
+
+            // GL_INVALID_OPERATION is generated if an element of attachments is GL_COLOR_ATTACHMENTm where m
+            // is greater than or equal to the value of GL_MAX_COLOR_ATTACHMENTS
+            if (attachment - GL_COLOR_ATTACHMENT0 >= STATE(max_color_attachments))
+            {
+                ERROR_RETURN(GL_INVALID_OPERATION);
+                return;
+            }
+            break;
+        }
+
+        fbo_attachment = getFBOAttachment(ctx, fbo, attachment);
+
+        if (fbo_attachment->texture == 0)
+            continue;
+
+        if (fbo_attachment->textarget == GL_RENDERBUFFER)
+            tex = fbo_attachment->buf.rbo->tex;
+        else
+            tex = fbo_attachment->buf.tex;
+
+        if (tex == NULL || fbo_attachment->level >= tex->mipmap_levels || tex->faces[0].levels == NULL)
+            continue;
+
+        tex_level = &tex->faces[0].levels[fbo_attachment->level];
+
+        // a partial region still has to be loaded
+        if (whole == false &&
+            (x > 0 || y > 0 || x + width < (GLint)tex_level->width || y + height < (GLint)tex_level->height))
+            continue;
+
+        // only the face or layer attached, the level's others keep their contents
+        invalidateTexImages(tex, fbo_attachment->level, getFBOAttachmentImage(fbo_attachment), 1);
+
+        if (attachment == GL_DEPTH_STENCIL_ATTACHMENT && fbo->stencil.texture)
+        {
+            fbo_attachment = &fbo->stencil;
+
+            if (fbo_attachment->textarget == GL_RENDERBUFFER)
+                tex = fbo_attachment->buf.rbo->tex;
+            else
+                tex = fbo_attachment->buf.tex;
+
+            if (tex)
+                invalidateTexImages(tex, fbo_attachment->level, getFBOAttachmentImage(fbo_attachment), 1);
+        }
+    }
+}
+
 void mglInvalidateFramebuffer(GLMContext ctx, GLenum target, GLsizei numAttachments, const GLenum *attachments)
 {
-    // Unimplemented function
-    assert(0);
+    switch (target)
+    {
+    case GL_FRAMEBUFFER:
+    case GL_DRAW_FRAMEBUFFER:
+    case GL_READ_FRAMEBUFFER:
+        break;
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
+
+    invalidateFramebuffer(ctx, currentFBOForType(ctx, target), numAttachments, attachments, 0, 0, 0, 0, true);
 }
 
 void mglInvalidateSubFramebuffer(GLMContext ctx, GLenum target, GLsizei numAttachments, const GLenum *attachments,
                                  GLint x, GLint y, GLsizei width, GLsizei height)
 {
-    // Unimplemented function
-    assert(0);
+    switch (target)
+    {
+    case GL_FRAMEBUFFER:
+    case GL_DRAW_FRAMEBUFFER:
+    case GL_READ_FRAMEBUFFER:
+        break;
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
+
+    invalidateFramebuffer(ctx, currentFBOForType(ctx, target), numAttachments, attachments, x, y, width, height,
+                          false);
 }
 
 void mglCreateFramebuffers(GLMContext ctx, GLsizei n, GLuint *framebuffers)
@@ -939,15 +1067,45 @@ void mglNamedFramebufferReadBuffer(GLMContext ctx, GLuint framebuffer, GLenum sr
 void mglInvalidateNamedFramebufferData(GLMContext ctx, GLuint framebuffer, GLsizei numAttachments,
                                        const GLenum *attachments)
 {
-    // Unimplemented function
-    assert(0);
+    Framebuffer *fbo;
+
+    fbo = NULL;
+
+    if (framebuffer)
+    {
+        fbo = findFrameBuffer(ctx, framebuffer);
+
+        // GL_INVALID_OPERATION is generated if framebuffer is not zero or the name of an existing framebuffer object.
+        if (fbo == NULL)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
+    }
+
+    invalidateFramebuffer(ctx, fbo, numAttachments, attachments, 0, 0, 0, 0, true);
 }
 
 void mglInvalidateNamedFramebufferSubData(GLMContext ctx, GLuint framebuffer, GLsizei numAttachments,
                                           const GLenum *attachments, GLint x, GLint y, GLsizei width, GLsizei height)
 {
-    // Unimplemented function
-    assert(0);
+    Framebuffer *fbo;
+
+    fbo = NULL;
+
+    if (framebuffer)
+    {
+        fbo = findFrameBuffer(ctx, framebuffer);
+
+        // GL_INVALID_OPERATION is generated if framebuffer is not zero or the name of an existing framebuffer object.
+        if (fbo == NULL)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
+    }
+
+    invalidateFramebuffer(ctx, fbo, numAttachments, attachments, x, y, width, height, false);
 }
 
 void mglClearNamedFramebufferiv(GLMContext ctx, GLuint framebuffer, GLenum buffer, GLint drawbuffer, const GLint *value)
@@ -25,6 +25,7 @@
 
 #include "glm_context.h"
 #include "vertex_arrays.h"
+#include "buffers.h"
 #include "MGLRenderer.h"
 #include "error.h"
 
@@ -150,6 +151,7 @@ GLMContext createGLMContext(GLenum format, GLenum type, GLenum depth_format, GLe
     STATE(hints.polygon_smooth_hint) = GL_DONT_CARE;
     STATE(hints.texture_compression_hint) = GL_DONT_CARE;
     STATE(hints.fragment_shader_derivative_hint) = GL_DONT_CARE;
+    STATE(hints.generate_mipmap_hint) = GL_DONT_CARE;
 
     STATE(var.line_width) = 1.0f;
     STATE(var.point_size) = 1.0f;
@@ -235,9 +237,20 @@ GLMContext createGLMContext(GLenum format, GLenum type, GLenum depth_format, GLe
     initHashTable(&STATE(framebuffer_table), hash_table_size);
     initHashTable(&STATE(sampler_table), hash_table_size);
 
+    initObjectPool(&STATE(vao_pool), sizeof(VertexArray));
+    initObjectPool(&STATE(buffer_pool), sizeof(Buffer));
+    initObjectPool(&STATE(texture_pool), sizeof(Texture));
+    initObjectPool(&STATE(shader_pool), sizeof(Shader));
+    initObjectPool(&STATE(program_pool), sizeof(Program));
+    initObjectPool(&STATE(renderbuffer_pool), sizeof(Renderbuffer));
+    initObjectPool(&STATE(framebuffer_pool), sizeof(Framebuffer));
+    initObjectPool(&STATE(sampler_pool), sizeof(Sampler));
+
     init_dispatch(ctx);
 
     ctx->assert_on_error = GL_TRUE;
+    ctx->buffer_suballocation = GL_TRUE;
+    initMemBudget(&ctx->shadow_budget, 0);
     ctx->error_func = error_func;
 
     ctx->temp_element_buffer = NULL;
@@ -291,11 +304,123 @@ void MGLget(GLMContext ctx, GLenum param, GLuint *data)
     case MGL_CONTEXT_FLAGS:
         *data = ctx->context_flags;
         break;
+    case MGL_BUFFER_SUBALLOCATION:
+        *data = ctx->buffer_suballocation;
+        break;
+    case MGL_SHADOW_MEMORY_BUDGET:
+        *data = (GLuint)(ctx->shadow_budget.budget / 1024);
+        break;
+    case MGL_SHADOW_MEMORY:
+        *data = (GLuint)((ctx->shadow_budget.stats.resident + 1023) / 1024);
+        break;
+    case MGL_SHADOW_EVICTIONS:
+        *data = (GLuint)ctx->shadow_budget.stats.evictions;
+        break;
+    default:
+        assert(0);
+    }
+}
+
+void MGLset(GLMContext ctx, GLenum param, GLuint data)
+{
+    if (ctx == NULL)
+        ctx = _ctx;
+
+    if (ctx == NULL)
+        return;
+
+    switch (param)
+    {
+    case MGL_BUFFER_SUBALLOCATION:
+        ctx->buffer_suballocation = (data != 0);
+        break;
+    case MGL_SHADOW_MEMORY_BUDGET:
+        setMemBudget(&ctx->shadow_budget, (size_t)data * 1024);
+        evictTextureShadows(ctx);
+        break;
     default:
         assert(0);
     }
 }
 
+void MGLgetObjectPoolStats(GLMContext ctx, GLenum type, MGLObjectPoolStats *stats)
+{
+    ObjectPool *pool;
+
+    if (ctx == NULL)
+        ctx = _ctx;
+
+    if (ctx == NULL)
+        return;
+
+    switch (type)
+    {
+    case GL_BUFFER:
+        pool = &STATE(buffer_pool);
+        break;
+    case GL_TEXTURE:
+        pool = &STATE(texture_pool);
+        break;
+    case GL_PROGRAM:
+        pool = &STATE(program_pool);
+        break;
+    case GL_SHADER:
+        pool = &STATE(shader_pool);
+        break;
+    case GL_VERTEX_ARRAY:
+        pool = &STATE(vao_pool);
+        break;
+    case GL_SAMPLER:
+        pool = &STATE(sampler_pool);
+        break;
+    case GL_FRAMEBUFFER:
+        pool = &STATE(framebuffer_pool);
+        break;
+    case GL_RENDERBUFFER:
+        pool = &STATE(renderbuffer_pool);
+        break;
+    default:
+        assert(0);
+        return;
+    }
+
+    getObjectPoolStats(pool, stats);
+}
+
+static void addBufferMemory(void *data, void *arg)
+{
+    getBufferMemory((Buffer *)data, (MemoryStats *)arg);
+}
+
+static void addTextureMemory(void *data, void *arg)
+{
+    getTextureMemory((Texture *)data, (MemoryStats *)arg);
+}
+
+void MGLgetMemoryStats(GLMContext ctx, GLenum type, MGLMemoryStats *stats)
+{
+    if (ctx == NULL)
+        ctx = _ctx;
+
+    if (ctx == NULL)
+        return;
+
+    bzero(stats, sizeof(MGLMemoryStats));
+
+    switch (type)
+    {
+    case GL_BUFFER:
+        iterateHashTable(&STATE(buffer_table), addBufferMemory, stats);
+        break;
+    case GL_TEXTURE:
+        iterateHashTable(&STATE(texture_table), addTextureMemory, stats);
+        break;
+    default:
+        assert(0);
+        return;
+    }
+}
+
 void MGLswapBuffers(GLMContext ctx)
 {
     fprintf(stderr, "\n===== MGLswapBuffers called from application =====\n");
@@ -308,3 +433,25 @@ void MGLswapBuffers(GLMContext ctx)
     ctx->mtl_funcs.mtlSwapBuffers(ctx);
     fprintf(stderr, "===== MGLswapBuffers finished =====\n\n");
 }
+
+void MGLbufferStorageClientMemory(GLMContext ctx, GLuint buffer, GLsizeiptr size, void *ptr, GLbitfield storage_flags,
+                                  void (*release)(void *ptr, size_t size, void *user), void *user)
+{
+    Buffer *buf;
+
+    if (ctx == NULL)
+        ctx = _ctx;
+
+    if (ctx == NULL)
+        return;
+
+    buf = findBuffer(ctx, buffer);
+
+    if (buf == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    bufferStorageClientMemory(ctx, buf, size, ptr, storage_flags, release, user);
+}
@@ -24,10 +24,169 @@
 
 #include "hash_table.h"
 
+#define MIN_SPARSE_HASH_SIZE 16
+
+// a deleted sparse slot has name 0 and this as data, name 0 never goes sparse
+#define SPARSE_DELETED ((void *)1)
+
+static inline unsigned hashName(GLuint name)
+{
+    // murmur3 finalizer, app names tend to be sequential or have low bits clear
+    name ^= name >> 16;
+    name *= 0x85ebca6b;
+    name ^= name >> 13;
+    name *= 0xc2b2ae35;
+    name ^= name >> 16;
+
+    return name;
+}
+
+static HashObj *findSparseSlot(HashTable *table, GLuint name)
+{
+    unsigned mask, index;
+
+    if (table->sparse_count == 0)
+        return NULL;
+
+    mask = table->sparse_size - 1;
+    index = hashName(name) & mask;
+
+    for (;;)
+    {
+        HashObj *slot;
+
+        slot = &table->sparse_keys[index];
+
+        if (slot->name == name)
+            return slot;
+
+        if (slot->name == 0 && slot->data == NULL)
+            return NULL;
+
+        index = (index + 1) & mask;
+    }
+}
+
+static void insertSparse(HashTable *table, GLuint name, void *data)
+{
+    unsigned mask, index;
+
+    mask = table->sparse_size - 1;
+    index = hashName(name) & mask;
+
+    for (;;)
+    {
+        HashObj *slot;
+
+        slot = &table->sparse_keys[index];
+
+        if (slot->name == 0)
+        {
+            if (slot->data == NULL)
+                table->sparse_used++;
+
+            slot->name = name;
+            slot->data = data;
+            table->sparse_count++;
+
+            return;
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+static void resizeSparse(HashTable *table, unsigned new_size)
+{
+    HashObj *old_keys;
+    unsigned old_size;
+
+    old_keys = table->sparse_keys;
+    old_size = table->sparse_size;
+
+    table->sparse_keys = (HashObj *)calloc(new_size, sizeof(HashObj));
+    assert(table->sparse_keys);
+
+    table->sparse_size = new_size;
+    table->sparse_count = 0;
+    table->sparse_used = 0;
+
+    for (unsigned i = 0; i < old_size; i++)
+    {
+        if (old_keys[i].name)
+        {
+            insertSparse(table, old_keys[i].name, old_keys[i].data);
+        }
+    }
+
+    free(old_keys);
+}
+
+static void growDense(HashTable *table, GLuint name)
+{
+    unsigned new_size;
+
+    new_size = table->size;
+    while (new_size <= name)
+        new_size *= 2;
+
+    if (new_size > MAX_DENSE_HASH_SIZE)
+        new_size = MAX_DENSE_HASH_SIZE;
+
+    table->keys = (HashObj *)realloc(table->keys, sizeof(HashObj) * new_size);
+    assert(table->keys);
+
+    bzero(&table->keys[table->size], sizeof(HashObj) * (new_size - table->size));
+
+    // pull any sparse names that now fall in the dense range
+    if (table->sparse_count)
+    {
+        for (unsigned i = 0; i < table->sparse_size; i++)
+        {
+            HashObj *slot;
+
+            slot = &table->sparse_keys[i];
+
+            if (slot->name && slot->name < new_size)
+            {
+                table->keys[slot->name].name = slot->name;
+                table->keys[slot->name].data = slot->data;
+
+                slot->name = 0;
+                slot->data = SPARSE_DELETED;
+                table->sparse_count--;
+            }
+        }
+    }
+
+    table->size = new_size;
+}
+
+HashTable *createHashTable(GLuint size)
+{
+    HashTable *ptr;
+
+    ptr = (HashTable *)malloc(sizeof(HashTable));
+    assert(ptr);
+
+    initHashTable(ptr, size);
+
+    return ptr;
+}
+
 void initHashTable(HashTable *ptr, GLuint size)
 {
     size_t len;
 
+    // dense array size is kept a power of 2
+    if (size < 2)
+        size = 2;
+
+    if (size > MAX_DENSE_HASH_SIZE)
+        size = MAX_DENSE_HASH_SIZE;
+
+    size = 1u << (32 - __builtin_clz(size - 1));
+
     len = sizeof(HashObj) * size;
 
     ptr->current_name = 1;
@@ -36,46 +195,232 @@ void initHashTable(HashTable *ptr, GLuint size)
     assert(ptr->keys);
 
     bzero(ptr->keys, len);
+
+    ptr->sparse_size = 0;
+    ptr->sparse_count = 0;
+    ptr->sparse_used = 0;
+    ptr->sparse_keys = NULL;
+
+    ptr->free_names = NULL;
+    ptr->free_size = 0;
+    ptr->free_head = 0;
+    ptr->free_count = 0;
+
+    ptr->stale_lookups = 0;
+}
+
+void freeHashTable(HashTable *ptr)
+{
+    free(ptr->keys);
+    free(ptr->sparse_keys);
+    free(ptr->free_names);
+
+    bzero(ptr, sizeof(HashTable));
+}
+
+static inline void *findHashElement(HashTable *table, GLuint name)
+{
+    HashObj *slot;
+
+    if (name < table->size)
+        return table->keys[name].data;
+
+    slot = findSparseSlot(table, name);
+
+    if (slot)
+        return slot->data;
+
+    return NULL;
+}
+
+static void pushFreeName(HashTable *table, GLuint name)
+{
+    if (table->free_count == table->free_size)
+    {
+        GLuint *names;
+        unsigned new_size;
+
+        new_size = table->free_size ? table->free_size * 2 : HASH_NAME_REUSE_DELAY * 2;
+
+        names = (GLuint *)malloc(sizeof(GLuint) * new_size);
+        assert(names);
+
+        // unwrap the ring
+        for (unsigned i = 0; i < table->free_count; i++)
+            names[i] = table->free_names[(table->free_head + i) % table->free_size];
+
+        free(table->free_names);
+
+        table->free_names = names;
+        table->free_size = new_size;
+        table->free_head = 0;
+    }
+
+    table->free_names[(table->free_head + table->free_count) % table->free_size] = name;
+    table->free_count++;
+}
+
+static GLuint popFreeName(HashTable *table)
+{
+    while (table->free_count > HASH_NAME_REUSE_DELAY)
+    {
+        GLuint name;
+
+        name = table->free_names[table->free_head];
+        table->free_head = (table->free_head + 1) % table->free_size;
+        table->free_count--;
+
+        // the app bound it again by hand since it was deleted
+        if (findHashElement(table, name))
+            continue;
+
+        // already handed out from an earlier entry for the same name
+        if (name < table->size && (table->keys[name].generation & 1) == 0)
+            continue;
+
+        return name;
+    }
+
+    return 0;
+}
+
+static inline void reviveName(HashTable *table, GLuint name)
+{
+    if (name < table->size && (table->keys[name].generation & 1))
+        table->keys[name].generation++;
 }
 
 GLuint getNewName(HashTable *table)
 {
+    GLuint name;
+
+    name = popFreeName(table);
+
+    if (name)
+    {
+        reviveName(table, name);
+
+        return name;
+    }
+
+    // apps can bind names they never generated, don't hand those out again
+    while (findHashElement(table, table->current_name))
+        table->current_name++;
+
     return table->current_name++;
 }
 
+GLuint getNameGeneration(HashTable *table, GLuint name)
+{
+    assert(table);
+
+    if (name < table->size)
+        return table->keys[name].generation >> 1;
+
+    return 0;
+}
+
 void *searchHashTable(HashTable *table, GLuint name)
 {
     assert(table);
-    assert(name < table->size);
 
-    return table->keys[name].data;
+#ifdef DEBUG
+    if (name < table->size && (table->keys[name].generation & 1))
+        table->stale_lookups++;
+#endif
+
+    return findHashElement(table, name);
 }
 
 void insertHashElement(HashTable *table, GLuint name, void *data)
 {
     assert(table);
+    assert(data);
+
+    // some calls allow the user to specifiy a name... only grow the dense
+    // array if the name is close enough to the end of it
+    if (name >= table->size && name < MAX_DENSE_HASH_SIZE && name < table->size * 2)
+    {
+        growDense(table, name);
+    }
 
     if (name < table->size)
     {
         assert(table->keys[name].data == NULL);
+        reviveName(table, name);
+        table->keys[name].name = name;
         table->keys[name].data = data;
         return;
     }
 
-    // some calls allow the user to specifiy a name...
-    while (table->size < name)
+    assert(findSparseSlot(table, name) == NULL);
+
+    if (table->sparse_keys == NULL)
+    {
+        table->sparse_keys = (HashObj *)calloc(MIN_SPARSE_HASH_SIZE, sizeof(HashObj));
+        assert(table->sparse_keys);
+
+        table->sparse_size = MIN_SPARSE_HASH_SIZE;
+    }
+    else if ((table->sparse_used + 1) * 4 > table->sparse_size * 3)
     {
-        table->size *= 2;
-        table->keys = (HashObj *)realloc(table->keys, table->size);
+        // rehash in place if most of the load is deleted slots
+        if ((table->sparse_count + 1) * 2 > table->sparse_size)
+            resizeSparse(table, table->sparse_size * 2);
+        else
+            resizeSparse(table, table->sparse_size);
     }
 
-    table->keys[name].data = data;
+    insertSparse(table, name, data);
 }
 
 void deleteHashElement(HashTable *table, GLuint name)
+{
+    HashObj *slot;
+
+    assert(table);
+
+    if (name < table->size)
+    {
+        if (table->keys[name].data == NULL)
+            return;
+
+        table->keys[name].data = NULL;
+        table->keys[name].generation |= 1;
+    }
+    else
+    {
+        slot = findSparseSlot(table, name);
+
+        if (slot == NULL)
+            return;
+
+        slot->name = 0;
+        slot->data = SPARSE_DELETED;
+        table->sparse_count--;
+    }
+
+    // only names we could have generated go back on the free list, app chosen
+    // names past current_name would just spread the name space out
+    if (name && name < table->current_name)
+    {
+        pushFreeName(table, name);
+    }
+}
+
+void iterateHashTable(HashTable *table, void (*func)(void *data, void *arg), void *arg)
 {
     assert(table);
-    assert(name < table->size);
 
-    table->keys[name].data = NULL;
+    for (unsigned i = 0; i < table->size; i++)
+    {
+        if (table->keys[i].data)
+            func(table->keys[i].data, arg);
+    }
+
+    for (unsigned i = 0; i < table->sparse_size; i++)
+    {
+        if (table->sparse_keys[i].name)
+            func(table->sparse_keys[i].data, arg);
+    }
 }
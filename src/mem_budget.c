@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * mem_budget.c
+ * MGL
+ *
+ */
+
+#include <strings.h>
+#include <assert.h>
+
+#include "mem_budget.h"
+
+void initMemBudget(MemBudget *mb, size_t budget)
+{
+    bzero(mb, sizeof(MemBudget));
+
+    mb->lru.prev = &mb->lru;
+    mb->lru.next = &mb->lru;
+    mb->budget = budget;
+}
+
+void setMemBudget(MemBudget *mb, size_t budget)
+{
+    mb->budget = budget;
+}
+
+void addMemResident(MemBudget *mb, size_t size)
+{
+    mb->stats.resident += size;
+}
+
+void removeMemResident(MemBudget *mb, size_t size)
+{
+    assert(mb->stats.resident >= size);
+
+    mb->stats.resident -= size;
+}
+
+void touchMemLRU(MemBudget *mb, MemLRUNode *node, size_t size)
+{
+    if (isOnMemLRU(node))
+    {
+        // already the most recent
+        if (node->next == &mb->lru && node->size == size)
+            return;
+
+        removeMemLRU(mb, node);
+    }
+
+    node->size = size;
+    node->prev = mb->lru.prev;
+    node->next = &mb->lru;
+    mb->lru.prev->next = node;
+    mb->lru.prev = node;
+
+    mb->stats.evictable += size;
+}
+
+void removeMemLRU(MemBudget *mb, MemLRUNode *node)
+{
+    if (isOnMemLRU(node) == false)
+        return;
+
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+
+    assert(mb->stats.evictable >= node->size);
+    mb->stats.evictable -= node->size;
+}
+
+MemLRUNode *findMemEvictCandidate(MemBudget *mb)
+{
+    if (mb->budget == 0 || mb->stats.resident <= mb->budget)
+        return NULL;
+
+    if (mb->lru.next == &mb->lru)
+        return NULL;
+
+    return mb->lru.next;
+}
+
+void recordMemEviction(MemBudget *mb, size_t size)
+{
+    mb->stats.evictions++;
+    mb->stats.evicted_bytes += size;
+}
+
+void recordMemRestore(MemBudget *mb, size_t size)
+{
+    mb->stats.restores++;
+    mb->stats.restored_bytes += size;
+}
+
+void getMemBudgetStats(MemBudget *mb, MemBudgetStats *stats)
+{
+    *stats = mb->stats;
+}
@@ -95,13 +95,6 @@ void mglColorP4uiv(GLMContext ctx, GLenum type, const GLuint *color)
     assert(0);
 }
 
-void mglCopyImageSubData(GLMContext ctx, GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX, GLint srcY,
-                         GLint srcZ, GLuint dstName, GLenum dstTarget, GLint dstLevel, GLint dstX, GLint dstY,
-                         GLint dstZ, GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth)
-{
-    assert(0);
-}
-
 void mglCreateProgramPipelines(GLMContext ctx, GLsizei n, GLuint *pipelines)
 {
     assert(0);
@@ -493,12 +486,6 @@ void mglGetnPixelMapusv(GLMContext ctx, GLenum map, GLsizei bufSize, GLushort *v
     assert(0);
 }
 
-void mglGetnTexImage(GLMContext ctx, GLenum target, GLint level, GLenum format, GLenum type, GLsizei bufSize,
-                     void *pixels)
-{
-    assert(0);
-}
-
 void mglGetnUniformdv(GLMContext ctx, GLuint program, GLint location, GLsizei bufSize, GLdouble *params)
 {
     assert(0);
@@ -953,17 +940,6 @@ void mglSpecializeShader(GLMContext ctx, GLuint shader, const GLchar *pEntryPoin
     assert(0);
 }
 
-void mglTexBuffer(GLMContext ctx, GLenum target, GLenum internalformat, GLuint buffer)
-{
-    assert(0);
-}
-
-void mglTexBufferRange(GLMContext ctx, GLenum target, GLenum internalformat, GLuint buffer, GLintptr offset,
-                       GLsizeiptr size)
-{
-    assert(0);
-}
-
 void mglTexStorage2DMultisample(GLMContext ctx, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width,
                                 GLsizei height, GLboolean fixedsamplelocations)
 {
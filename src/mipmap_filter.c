@@ -0,0 +1,696 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * mipmap_filter.c
+ * MGL
+ *
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "mipmap_filter.h"
+
+typedef enum
+{
+    FILTER_NONE = 0,
+    FILTER_UNORM8,
+    FILTER_UNORM16,
+    FILTER_HALF,
+    FILTER_FLOAT
+} FilterKind;
+
+// up to 3 texels of the level above along one dimension
+typedef struct FilterTaps_t
+{
+    size_t count;
+    size_t index[3];
+    float weight[3];
+} FilterTaps;
+
+static bool getFilterFormat(PixelLayout layout, FilterKind *kind, size_t *channels)
+{
+    switch (layout)
+    {
+    case PIXEL_LAYOUT_R8:
+        *kind = FILTER_UNORM8;
+        *channels = 1;
+        return true;
+    case PIXEL_LAYOUT_RG8:
+        *kind = FILTER_UNORM8;
+        *channels = 2;
+        return true;
+    case PIXEL_LAYOUT_RGB8:
+    case PIXEL_LAYOUT_BGR8:
+        *kind = FILTER_UNORM8;
+        *channels = 3;
+        return true;
+    case PIXEL_LAYOUT_RGBA8:
+    case PIXEL_LAYOUT_BGRA8:
+        *kind = FILTER_UNORM8;
+        *channels = 4;
+        return true;
+
+    case PIXEL_LAYOUT_R16:
+    case PIXEL_LAYOUT_RG16:
+    case PIXEL_LAYOUT_RGB16:
+    case PIXEL_LAYOUT_RGBA16:
+        *kind = FILTER_UNORM16;
+        *channels = 1 + (layout - PIXEL_LAYOUT_R16);
+        return true;
+
+    case PIXEL_LAYOUT_R16F:
+    case PIXEL_LAYOUT_RG16F:
+    case PIXEL_LAYOUT_RGB16F:
+    case PIXEL_LAYOUT_RGBA16F:
+        *kind = FILTER_HALF;
+        *channels = 1 + (layout - PIXEL_LAYOUT_R16F);
+        return true;
+
+    case PIXEL_LAYOUT_R32F:
+    case PIXEL_LAYOUT_RG32F:
+    case PIXEL_LAYOUT_RGB32F:
+    case PIXEL_LAYOUT_RGBA32F:
+        *kind = FILTER_FLOAT;
+        *channels = 1 + (layout - PIXEL_LAYOUT_R32F);
+        return true;
+
+    default:
+        // alpha first and packed layouts aren't texture formats
+        *kind = FILTER_NONE;
+        *channels = 0;
+        return false;
+    }
+}
+
+size_t getMipmapSize(size_t size)
+{
+    return (size > 1) ? size / 2 : 1;
+}
+
+bool canFilterMipmap(PixelLayout layout)
+{
+    FilterKind kind;
+    size_t channels;
+
+    return getFilterFormat(layout, &kind, &channels);
+}
+
+static void getFilterTaps(size_t src_size, size_t i, FilterTaps *taps)
+{
+    size_t n;
+
+    if (src_size == 1)
+    {
+        taps->count = 1;
+        taps->index[0] = 0;
+        taps->weight[0] = 1.0f;
+        return;
+    }
+
+    if ((src_size & 1) == 0)
+    {
+        taps->count = 2;
+        taps->index[0] = 2 * i;
+        taps->index[1] = 2 * i + 1;
+        taps->weight[0] = 0.5f;
+        taps->weight[1] = 0.5f;
+        return;
+    }
+
+    // an odd size shrinks to n = size / 2 texels, each covers 2 + 1/n texels of
+    // the level above and the weights slide across as i goes
+    n = src_size / 2;
+
+    taps->count = 3;
+    taps->index[0] = 2 * i;
+    taps->index[1] = 2 * i + 1;
+    taps->index[2] = 2 * i + 2;
+    taps->weight[0] = (float)(n - i) / (float)(2 * n + 1);
+    taps->weight[1] = (float)n / (float)(2 * n + 1);
+    taps->weight[2] = (float)(i + 1) / (float)(2 * n + 1);
+}
+
+#pragma mark srgb
+
+#define SRGB_ENCODE_STEPS 4096
+
+static float srgb_to_linear[256];
+
+// the linear value each srgb code starts rounding up to the next one at
+static float srgb_thresholds[255];
+
+// the code for linear i / (SRGB_ENCODE_STEPS - 1), a start the thresholds correct
+static unsigned char srgb_encode_start[SRGB_ENCODE_STEPS];
+
+static pthread_once_t srgb_once = PTHREAD_ONCE_INIT;
+
+static double decodeSRGB(double c)
+{
+    return (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+// the number of thresholds at or below v, rounds in srgb space
+static unsigned char searchSRGB(float v)
+{
+    unsigned lo, hi;
+
+    lo = 0;
+    hi = 255;
+
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+
+        if (v >= srgb_thresholds[mid])
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return (unsigned char)lo;
+}
+
+static void initSRGBTables(void)
+{
+    for (int i = 0; i < 256; i++)
+        srgb_to_linear[i] = (float)decodeSRGB(i / 255.0);
+
+    for (int i = 0; i < 255; i++)
+        srgb_thresholds[i] = (float)decodeSRGB((i + 0.5) / 255.0);
+
+    for (int i = 0; i < SRGB_ENCODE_STEPS; i++)
+        srgb_encode_start[i] = searchSRGB((float)i / (SRGB_ENCODE_STEPS - 1));
+}
+
+static unsigned char linearToSRGB(float v)
+{
+    unsigned code;
+
+    // nan too
+    if (!(v > 0.0f))
+        return 0;
+
+    if (v >= 1.0f)
+        return 255;
+
+    // codes are never more than a step or two from the start
+    code = srgb_encode_start[(unsigned)(v * (SRGB_ENCODE_STEPS - 1))];
+
+    while (code < 255 && v >= srgb_thresholds[code])
+        code++;
+
+    while (code > 0 && v < srgb_thresholds[code - 1])
+        code--;
+
+    return (unsigned char)code;
+}
+
+#pragma mark generic filter
+
+static inline uint32_t roundUnorm(float v, uint32_t max)
+{
+    v += 0.5f;
+
+    if (!(v > 0.0f))
+        return 0;
+
+    if (v >= (float)max)
+        return max;
+
+    return (uint32_t)v;
+}
+
+// unorm channels are filtered in their integer range, srgb color in linear 0..1
+static inline float loadChannel(FilterKind kind, bool linear, const unsigned char *p, size_t c)
+{
+    switch (kind)
+    {
+    case FILTER_UNORM8:
+        return linear ? srgb_to_linear[p[c]] : (float)p[c];
+
+    case FILTER_UNORM16: {
+        uint16_t v;
+
+        memcpy(&v, p + c * 2, sizeof(v));
+        return (float)v;
+    }
+
+    case FILTER_HALF: {
+        uint16_t v;
+
+        memcpy(&v, p + c * 2, sizeof(v));
+        return halfToFloat(v);
+    }
+
+    case FILTER_FLOAT: {
+        float v;
+
+        memcpy(&v, p + c * 4, sizeof(v));
+        return v;
+    }
+
+    default:
+        return 0.0f;
+    }
+}
+
+static inline void storeChannel(FilterKind kind, bool linear, unsigned char *p, size_t c, float v)
+{
+    switch (kind)
+    {
+    case FILTER_UNORM8:
+        p[c] = linear ? linearToSRGB(v) : (unsigned char)roundUnorm(v, 255);
+        break;
+
+    case FILTER_UNORM16: {
+        uint16_t h;
+
+        h = (uint16_t)roundUnorm(v, 65535);
+        memcpy(p + c * 2, &h, sizeof(h));
+        break;
+    }
+
+    case FILTER_HALF: {
+        uint16_t h;
+
+        h = floatToHalf(v);
+        memcpy(p + c * 2, &h, sizeof(h));
+        break;
+    }
+
+    case FILTER_FLOAT:
+        memcpy(p + c * 4, &v, sizeof(v));
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool filterMipmapLevelGeneric(PixelLayout layout, bool srgb, void *dst, size_t dst_pitch, size_t dst_image_pitch,
+                              const void *src, size_t src_pitch, size_t src_image_pitch, size_t src_width,
+                              size_t src_height, size_t src_depth)
+{
+    FilterKind kind;
+    size_t channels, pixel_size, dst_width, dst_height, dst_depth;
+    const unsigned char *s;
+    unsigned char *d;
+
+    if (getFilterFormat(layout, &kind, &channels) == false)
+        return false;
+
+    if (src_width == 0 || src_height == 0 || src_depth == 0)
+        return false;
+
+    // srgb only means something for 8 bit color
+    srgb = srgb && (kind == FILTER_UNORM8);
+    if (srgb)
+        pthread_once(&srgb_once, initSRGBTables);
+
+    pixel_size = getPixelLayoutSize(layout);
+
+    dst_width = getMipmapSize(src_width);
+    dst_height = getMipmapSize(src_height);
+    dst_depth = getMipmapSize(src_depth);
+
+    s = (const unsigned char *)src;
+    d = (unsigned char *)dst;
+
+    for (size_t z = 0; z < dst_depth; z++)
+    {
+        FilterTaps tz;
+
+        getFilterTaps(src_depth, z, &tz);
+
+        for (size_t y = 0; y < dst_height; y++)
+        {
+            FilterTaps ty;
+            unsigned char *dst_row;
+
+            getFilterTaps(src_height, y, &ty);
+
+            dst_row = d + z * dst_image_pitch + y * dst_pitch;
+
+            for (size_t x = 0; x < dst_width; x++)
+            {
+                FilterTaps tx;
+                float acc[4];
+
+                getFilterTaps(src_width, x, &tx);
+
+                // taps in memory order, the vector kernels add in the same order
+                for (size_t a = 0; a < tz.count; a++)
+                {
+                    for (size_t b = 0; b < ty.count; b++)
+                    {
+                        for (size_t e = 0; e < tx.count; e++)
+                        {
+                            const unsigned char *p;
+                            float w;
+
+                            p = s + tz.index[a] * src_image_pitch + ty.index[b] * src_pitch + tx.index[e] * pixel_size;
+                            w = tz.weight[a] * ty.weight[b] * tx.weight[e];
+
+                            for (size_t c = 0; c < channels; c++)
+                            {
+                                float v;
+
+                                v = w * loadChannel(kind, srgb && (c < 3), p, c);
+                                acc[c] = (a | b | e) ? acc[c] + v : v;
+                            }
+                        }
+                    }
+                }
+
+                for (size_t c = 0; c < channels; c++)
+                    storeChannel(kind, srgb && (c < 3), dst_row + x * pixel_size, c, acc[c]);
+            }
+        }
+    }
+
+    return true;
+}
+
+#pragma mark 2x2 box kernels
+
+// (a + b + c + d + 2) >> 2 per byte, what the generic path rounds a box of 4 to
+static void boxFilterUnorm8(unsigned char *d, const unsigned char *r0, const unsigned char *r1, size_t dst_width,
+                            size_t channels)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__SSE2__)
+    if (channels == 4)
+    {
+        __m128i zero, two;
+
+        zero = _mm_setzero_si128();
+        two = _mm_set1_epi16(2);
+
+        // 8 texels from each row, 4 out
+        while (dst_width - done >= 4)
+        {
+            __m128i a0, a1, b0, b1, p01, p23, p45, p67, s0, s1;
+
+            a0 = _mm_loadu_si128((const __m128i *)(r0 + done * 8));
+            a1 = _mm_loadu_si128((const __m128i *)(r0 + done * 8 + 16));
+            b0 = _mm_loadu_si128((const __m128i *)(r1 + done * 8));
+            b1 = _mm_loadu_si128((const __m128i *)(r1 + done * 8 + 16));
+
+            // the two rows summed, 2 texels a register
+            p01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            p23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            p45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            p67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+            // then the neighbours, even texels against odd
+            s0 = _mm_add_epi16(_mm_unpacklo_epi64(p01, p23), _mm_unpackhi_epi64(p01, p23));
+            s1 = _mm_add_epi16(_mm_unpacklo_epi64(p45, p67), _mm_unpackhi_epi64(p45, p67));
+
+            s0 = _mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+            s1 = _mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+
+            _mm_storeu_si128((__m128i *)(d + done * 4), _mm_packus_epi16(s0, s1));
+
+            done += 4;
+        }
+    }
+#elif defined(__ARM_NEON)
+    if (channels == 4)
+    {
+        // 4 texels from each row, 2 out
+        while (dst_width - done >= 2)
+        {
+            uint8x16_t a, b;
+            uint16x8_t lo, hi, s;
+
+            a = vld1q_u8(r0 + done * 8);
+            b = vld1q_u8(r1 + done * 8);
+
+            lo = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+            hi = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+
+            s = vcombine_u16(vadd_u16(vget_low_u16(lo), vget_high_u16(lo)),
+                             vadd_u16(vget_low_u16(hi), vget_high_u16(hi)));
+
+            vst1_u8(d + done * 4, vmovn_u16(vrshrq_n_u16(s, 2)));
+
+            done += 2;
+        }
+    }
+#endif
+
+    for (size_t i = done * channels; i < dst_width * channels; i++)
+    {
+        size_t x, c;
+        unsigned sum;
+
+        x = i / channels;
+        c = i % channels;
+
+        sum = r0[2 * x * channels + c] + r0[(2 * x + 1) * channels + c] + r1[2 * x * channels + c] +
+              r1[(2 * x + 1) * channels + c];
+
+        d[i] = (unsigned char)((sum + 2) >> 2);
+    }
+}
+
+// a quarter of each texel added in the generic path's order, a quarter is exact
+// so fused or not the sums round the same
+static void boxFilterFloat(float *d, const float *r0, const float *r1, size_t dst_width, size_t channels)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__SSE2__)
+    if (channels == 4)
+    {
+        __m128 q;
+
+        q = _mm_set1_ps(0.25f);
+
+        for (; done < dst_width; done++)
+        {
+            __m128 acc;
+
+            acc = _mm_mul_ps(_mm_loadu_ps(r0 + done * 8), q);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(r0 + done * 8 + 4), q));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(r1 + done * 8), q));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(r1 + done * 8 + 4), q));
+
+            _mm_storeu_ps(d + done * 4, acc);
+        }
+    }
+#elif defined(__ARM_NEON)
+    if (channels == 4)
+    {
+        for (; done < dst_width; done++)
+        {
+            float32x4_t acc;
+
+            acc = vmulq_n_f32(vld1q_f32(r0 + done * 8), 0.25f);
+            acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(r0 + done * 8 + 4), 0.25f));
+            acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(r1 + done * 8), 0.25f));
+            acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(r1 + done * 8 + 4), 0.25f));
+
+            vst1q_f32(d + done * 4, acc);
+        }
+    }
+#endif
+
+    for (size_t i = done * channels; i < dst_width * channels; i++)
+    {
+        size_t x, c;
+        float acc;
+
+        x = i / channels;
+        c = i % channels;
+
+        acc = 0.25f * r0[2 * x * channels + c];
+        acc += 0.25f * r0[(2 * x + 1) * channels + c];
+        acc += 0.25f * r1[2 * x * channels + c];
+        acc += 0.25f * r1[(2 * x + 1) * channels + c];
+
+        d[i] = acc;
+    }
+}
+
+// rgba16f through float and back, the quarters exact again
+static void boxFilterHalf(unsigned char *d, const unsigned char *r0, const unsigned char *r1, size_t dst_width,
+                          size_t channels)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__F16C__)
+    if (channels == 4)
+    {
+        __m128 q;
+
+        q = _mm_set1_ps(0.25f);
+
+        for (; done < dst_width; done++)
+        {
+            __m128 acc;
+
+            acc = _mm_mul_ps(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(r0 + done * 16))), q);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(r0 + done * 16 + 8))), q));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(r1 + done * 16))), q));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(r1 + done * 16 + 8))), q));
+
+            _mm_storel_epi64((__m128i *)(d + done * 8), _mm_cvtps_ph(acc, _MM_FROUND_TO_NEAREST_INT));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (channels == 4)
+    {
+        for (; done < dst_width; done++)
+        {
+            float32x4_t acc;
+
+            acc = vmulq_n_f32(vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t *)(r0 + done * 16)))), 0.25f);
+            acc = vaddq_f32(
+                acc,
+                vmulq_n_f32(vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t *)(r0 + done * 16 + 8)))),
+                            0.25f));
+            acc = vaddq_f32(
+                acc, vmulq_n_f32(vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t *)(r1 + done * 16)))),
+                                 0.25f));
+            acc = vaddq_f32(
+                acc,
+                vmulq_n_f32(vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t *)(r1 + done * 16 + 8)))),
+                            0.25f));
+
+            vst1_u16((uint16_t *)(d + done * 8), vreinterpret_u16_f16(vcvt_f16_f32(acc)));
+        }
+    }
+#endif
+
+    for (size_t i = done * channels; i < dst_width * channels; i++)
+    {
+        size_t x, c;
+        float acc;
+
+        x = i / channels;
+        c = i % channels;
+
+        acc = 0.25f * loadChannel(FILTER_HALF, false, r0 + 2 * x * channels * 2, c);
+        acc += 0.25f * loadChannel(FILTER_HALF, false, r0 + (2 * x + 1) * channels * 2, c);
+        acc += 0.25f * loadChannel(FILTER_HALF, false, r1 + 2 * x * channels * 2, c);
+        acc += 0.25f * loadChannel(FILTER_HALF, false, r1 + (2 * x + 1) * channels * 2, c);
+
+        storeChannel(FILTER_HALF, false, d + x * channels * 2, c, acc);
+    }
+}
+
+// the rest of the 2x2 boxes, 16 bit unorm and srgb, without the generic tap bookkeeping
+static void boxFilterTexels(FilterKind kind, bool srgb, unsigned char *d, const unsigned char *r0,
+                            const unsigned char *r1, size_t dst_width, size_t channels, size_t pixel_size)
+{
+    for (size_t x = 0; x < dst_width; x++)
+    {
+        const unsigned char *p00, *p01, *p10, *p11;
+
+        p00 = r0 + 2 * x * pixel_size;
+        p01 = p00 + pixel_size;
+        p10 = r1 + 2 * x * pixel_size;
+        p11 = p10 + pixel_size;
+
+        for (size_t c = 0; c < channels; c++)
+        {
+            bool linear;
+            float acc;
+
+            linear = srgb && (c < 3);
+
+            acc = 0.25f * loadChannel(kind, linear, p00, c);
+            acc += 0.25f * loadChannel(kind, linear, p01, c);
+            acc += 0.25f * loadChannel(kind, linear, p10, c);
+            acc += 0.25f * loadChannel(kind, linear, p11, c);
+
+            storeChannel(kind, linear, d + x * pixel_size, c, acc);
+        }
+    }
+}
+
+bool filterMipmapLevel(PixelLayout layout, bool srgb, void *dst, size_t dst_pitch, size_t dst_image_pitch,
+                       const void *src, size_t src_pitch, size_t src_image_pitch, size_t src_width, size_t src_height,
+                       size_t src_depth)
+{
+    FilterKind kind;
+    size_t channels, pixel_size, dst_width, dst_height;
+    const unsigned char *s;
+    unsigned char *d;
+
+    if (getFilterFormat(layout, &kind, &channels) == false)
+        return false;
+
+    // the kernels are the plain 2x2 box of an even sized 2d level, odd sizes
+    // and 3d go the generic way
+    if (src_depth != 1 || src_width < 2 || src_height < 2 || (src_width & 1) || (src_height & 1))
+    {
+        return filterMipmapLevelGeneric(layout, srgb, dst, dst_pitch, dst_image_pitch, src, src_pitch,
+                                        src_image_pitch, src_width, src_height, src_depth);
+    }
+
+    srgb = srgb && (kind == FILTER_UNORM8);
+    if (srgb)
+        pthread_once(&srgb_once, initSRGBTables);
+
+    pixel_size = getPixelLayoutSize(layout);
+
+    dst_width = src_width / 2;
+    dst_height = src_height / 2;
+
+    s = (const unsigned char *)src;
+    d = (unsigned char *)dst;
+
+    for (size_t y = 0; y < dst_height; y++)
+    {
+        const unsigned char *r0, *r1;
+        unsigned char *dst_row;
+
+        r0 = s + 2 * y * src_pitch;
+        r1 = r0 + src_pitch;
+
+        dst_row = d + y * dst_pitch;
+
+        if (kind == FILTER_UNORM8 && srgb == false)
+            boxFilterUnorm8(dst_row, r0, r1, dst_width, channels);
+        else if (kind == FILTER_FLOAT)
+            boxFilterFloat((float *)dst_row, (const float *)r0, (const float *)r1, dst_width, channels);
+        else if (kind == FILTER_HALF)
+            boxFilterHalf(dst_row, r0, r1, dst_width, channels);
+        else
+            boxFilterTexels(kind, srgb, dst_row, r0, r1, dst_width, channels, pixel_size);
+    }
+
+    return true;
+}
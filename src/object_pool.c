@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * object_pool.c
+ * MGL
+ *
+ */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <assert.h>
+
+#include "object_pool.h"
+
+#define ALIGN_UP(_v_, _a_) (((_v_) + ((_a_)-1)) & ~((size_t)(_a_)-1))
+
+static inline ObjectSlab *slabForObject(ObjectPool *pool, void *obj)
+{
+    return (ObjectSlab *)((uintptr_t)obj & ~(uintptr_t)(pool->slab_size - 1));
+}
+
+static inline unsigned indexInSlab(ObjectPool *pool, ObjectSlab *slab, void *obj)
+{
+    return (unsigned)(((char *)obj - ((char *)slab + pool->slab_header_size)) / pool->obj_size);
+}
+
+void initObjectPool(ObjectPool *pool, size_t obj_size)
+{
+    size_t slab_size;
+
+    bzero(pool, sizeof(ObjectPool));
+
+    pool->obj_size = ALIGN_UP(obj_size, OBJECT_POOL_ALIGN);
+    pool->slab_header_size = ALIGN_UP(sizeof(ObjectSlab), OBJECT_POOL_ALIGN);
+
+    // at least 16 objects a slab, slab size a power of 2 for the address mask
+    slab_size = OBJECT_POOL_MIN_SLAB_SIZE;
+    while (slab_size < pool->slab_header_size + pool->obj_size * 16)
+        slab_size *= 2;
+
+    pool->slab_size = slab_size;
+    pool->objs_per_slab = (unsigned)((slab_size - pool->slab_header_size) / pool->obj_size);
+
+    if (pool->objs_per_slab > OBJECT_POOL_MAX_SLAB_OBJS)
+        pool->objs_per_slab = OBJECT_POOL_MAX_SLAB_OBJS;
+
+    pool->stats.object_size = pool->obj_size;
+}
+
+void freeObjectPool(ObjectPool *pool)
+{
+    ObjectSlab *slab;
+
+    slab = pool->slabs;
+    while (slab)
+    {
+        ObjectSlab *next;
+
+        next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    bzero(pool, sizeof(ObjectPool));
+}
+
+static ObjectSlab *newSlab(ObjectPool *pool)
+{
+    ObjectSlab *slab;
+    int err;
+
+    err = posix_memalign((void **)&slab, pool->slab_size, pool->slab_size);
+    assert(err == 0);
+
+    bzero(slab, pool->slab_header_size);
+
+    slab->num_objs = pool->objs_per_slab;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+
+    pool->stats.slabs++;
+    pool->stats.bytes += pool->slab_size;
+
+    return slab;
+}
+
+void *newPoolObject(ObjectPool *pool)
+{
+    ObjectSlab *slab;
+    unsigned index;
+    void *obj;
+
+    assert(pool->obj_size);
+
+    if (pool->free_list)
+    {
+        obj = pool->free_list;
+        pool->free_list = *(void **)obj;
+
+        slab = slabForObject(pool, obj);
+        index = indexInSlab(pool, slab, obj);
+    }
+    else
+    {
+        slab = pool->slabs;
+
+        if (slab == NULL || slab->used == slab->num_objs)
+        {
+            slab = newSlab(pool);
+        }
+
+        index = slab->used++;
+        obj = (char *)slab + pool->slab_header_size + index * pool->obj_size;
+    }
+
+    assert((slab->live_mask[index >> 6] & (1ull << (index & 63))) == 0);
+    slab->live_mask[index >> 6] |= (1ull << (index & 63));
+
+    bzero(obj, pool->obj_size);
+
+    pool->stats.allocs++;
+    pool->stats.live++;
+    if (pool->stats.live > pool->stats.peak)
+        pool->stats.peak = pool->stats.live;
+
+    return obj;
+}
+
+void freePoolObject(ObjectPool *pool, void *obj)
+{
+    ObjectSlab *slab;
+    unsigned index;
+
+    if (obj == NULL)
+        return;
+
+    slab = slabForObject(pool, obj);
+    index = indexInSlab(pool, slab, obj);
+
+    assert(index < slab->used);
+    assert(slab->live_mask[index >> 6] & (1ull << (index & 63)));
+
+    slab->live_mask[index >> 6] &= ~(1ull << (index & 63));
+
+    *(void **)obj = pool->free_list;
+    pool->free_list = obj;
+
+    pool->stats.frees++;
+    pool->stats.live--;
+}
+
+void iterateObjectPool(ObjectPool *pool, void (*func)(void *obj, void *arg), void *arg)
+{
+    for (ObjectSlab *slab = pool->slabs; slab; slab = slab->next)
+    {
+        char *objs;
+
+        objs = (char *)slab + pool->slab_header_size;
+
+        for (unsigned word = 0; word < OBJECT_POOL_MAX_SLAB_OBJS / 64; word++)
+        {
+            uint64_t mask;
+
+            mask = slab->live_mask[word];
+
+            while (mask)
+            {
+                unsigned index;
+
+                index = word * 64 + __builtin_ctzll(mask);
+                mask &= mask - 1;
+
+                func(objs + index * pool->obj_size, arg);
+            }
+        }
+    }
+}
+
+void getObjectPoolStats(ObjectPool *pool, ObjectPoolStats *stats)
+{
+    *stats = pool->stats;
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * page_allocator.c
+ * MGL
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "page_allocator.h"
+
+#define NUM_SIZE_CLASSES 8 // 16 .. 2048
+
+static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+static void *class_free_list[NUM_SIZE_CLASSES];
+static PageAllocatorStats alloc_stats;
+static size_t page_size;
+
+size_t getPageSize(void)
+{
+    // 16k on apple silicon, don't assume 4k
+    if (page_size == 0)
+        page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    return page_size;
+}
+
+size_t page_size_align(size_t size)
+{
+    size_t page;
+
+    page = getPageSize();
+
+    return (size + page - 1) & ~(page - 1);
+}
+
+static inline unsigned sizeClass(size_t size)
+{
+    unsigned index;
+
+    index = 0;
+    while (((size_t)PAGE_ALLOC_MIN_CLASS << index) < size)
+        index++;
+
+    return index;
+}
+
+static void *allocSmall(unsigned index)
+{
+    size_t class_size;
+    void *ptr;
+
+    class_size = (size_t)PAGE_ALLOC_MIN_CLASS << index;
+
+    pthread_mutex_lock(&alloc_lock);
+
+    if (class_free_list[index] == NULL)
+    {
+        char *chunk;
+
+        chunk = (char *)malloc(PAGE_ALLOC_CHUNK_SIZE);
+        if (chunk == NULL)
+        {
+            pthread_mutex_unlock(&alloc_lock);
+            return NULL;
+        }
+
+        // thread the whole chunk onto the free list
+        for (size_t offset = PAGE_ALLOC_CHUNK_SIZE; offset >= class_size; offset -= class_size)
+        {
+            void *slot;
+
+            slot = chunk + offset - class_size;
+            *(void **)slot = class_free_list[index];
+            class_free_list[index] = slot;
+        }
+
+        alloc_stats.small_chunks++;
+    }
+
+    ptr = class_free_list[index];
+    class_free_list[index] = *(void **)ptr;
+
+    alloc_stats.small_bytes += class_size;
+    alloc_stats.allocs++;
+
+    pthread_mutex_unlock(&alloc_lock);
+
+    memset(ptr, 0, class_size);
+
+    return ptr;
+}
+
+static void freeSmall(void *ptr, unsigned index)
+{
+    pthread_mutex_lock(&alloc_lock);
+
+    *(void **)ptr = class_free_list[index];
+    class_free_list[index] = ptr;
+
+    alloc_stats.small_bytes -= (size_t)PAGE_ALLOC_MIN_CLASS << index;
+    alloc_stats.frees++;
+
+    pthread_mutex_unlock(&alloc_lock);
+}
+
+static void *allocMapped(size_t size, unsigned flags)
+{
+    void *ptr;
+
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (ptr == MAP_FAILED)
+        return NULL;
+
+#ifdef MADV_HUGEPAGE
+    if ((flags & PAGE_ALLOC_HUGE_PAGES) && size >= PAGE_ALLOC_HUGE_PAGE_SIZE)
+    {
+        // just a hint, failure leaves normal pages
+        madvise(ptr, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return ptr;
+}
+
+void *allocPages(size_t size, unsigned flags, size_t *alloc_size)
+{
+    void *ptr;
+
+    assert(alloc_size);
+
+    if (size == 0)
+        size = 1;
+
+    if (flags & PAGE_ALLOC_ZERO_COPY)
+    {
+        size = page_size_align(size);
+    }
+    else if (size <= PAGE_ALLOC_MAX_CLASS)
+    {
+        unsigned index;
+
+        index = sizeClass(size);
+
+        ptr = allocSmall(index);
+        if (ptr)
+            *alloc_size = (size_t)PAGE_ALLOC_MIN_CLASS << index;
+
+        return ptr;
+    }
+    else if (size >= PAGE_ALLOC_LARGE_SIZE)
+    {
+        size = page_size_align(size);
+    }
+    else
+    {
+        size = (size + 63) & ~(size_t)63;
+    }
+
+    if (size >= PAGE_ALLOC_LARGE_SIZE)
+    {
+        ptr = allocMapped(size, flags);
+        if (ptr == NULL)
+            return NULL;
+
+        pthread_mutex_lock(&alloc_lock);
+        alloc_stats.mapped_bytes += size;
+        alloc_stats.allocs++;
+        pthread_mutex_unlock(&alloc_lock);
+    }
+    else
+    {
+        if (posix_memalign(&ptr, (flags & PAGE_ALLOC_ZERO_COPY) ? getPageSize() : 64, size))
+            return NULL;
+
+        memset(ptr, 0, size);
+
+        pthread_mutex_lock(&alloc_lock);
+        alloc_stats.heap_bytes += size;
+        alloc_stats.allocs++;
+        pthread_mutex_unlock(&alloc_lock);
+    }
+
+    *alloc_size = size;
+
+    return ptr;
+}
+
+void freePages(void *ptr, size_t alloc_size)
+{
+    if (ptr == NULL)
+        return;
+
+    if (alloc_size <= PAGE_ALLOC_MAX_CLASS)
+    {
+        unsigned index;
+
+        index = sizeClass(alloc_size);
+        assert(((size_t)PAGE_ALLOC_MIN_CLASS << index) == alloc_size);
+
+        freeSmall(ptr, index);
+
+        return;
+    }
+
+    if (alloc_size >= PAGE_ALLOC_LARGE_SIZE)
+    {
+        munmap(ptr, alloc_size);
+
+        pthread_mutex_lock(&alloc_lock);
+        alloc_stats.mapped_bytes -= alloc_size;
+        alloc_stats.frees++;
+        pthread_mutex_unlock(&alloc_lock);
+    }
+    else
+    {
+        free(ptr);
+
+        pthread_mutex_lock(&alloc_lock);
+        alloc_stats.heap_bytes -= alloc_size;
+        alloc_stats.frees++;
+        pthread_mutex_unlock(&alloc_lock);
+    }
+}
+
+void getPageAllocatorStats(PageAllocatorStats *stats)
+{
+    pthread_mutex_lock(&alloc_lock);
+    *stats = alloc_stats;
+    pthread_mutex_unlock(&alloc_lock);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pattern_fill.c
+ * MGL
+ *
+ */
+
+
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "pattern_fill.h"
+
+#define FILL_VECTOR_SIZE 16
+
+#if defined(__SSE2__)
+typedef __m128i FillVector;
+#define loadFillVector(_p_) _mm_loadu_si128((const __m128i *)(_p_))
+#define storeFillVector(_p_, _v_) _mm_storeu_si128((__m128i *)(_p_), _v_)
+#elif defined(__ARM_NEON)
+typedef uint8x16_t FillVector;
+#define loadFillVector(_p_) vld1q_u8((const uint8_t *)(_p_))
+#define storeFillVector(_p_, _v_) vst1q_u8((uint8_t *)(_p_), _v_)
+#else
+typedef struct
+{
+    unsigned char bytes[FILL_VECTOR_SIZE];
+} FillVector;
+#define loadFillVector(_p_) (*(const FillVector *)(_p_))
+#define storeFillVector(_p_, _v_) memcpy((_p_), &(_v_), FILL_VECTOR_SIZE)
+#endif
+
+static bool isByteSplat(const unsigned char *pattern, size_t pattern_size)
+{
+    for (size_t i = 1; i < pattern_size; i++)
+    {
+        if (pattern[i] != pattern[0])
+            return false;
+    }
+
+    return true;
+}
+
+static void fillElements(unsigned char *dst, size_t size, const unsigned char *pattern, size_t pattern_size)
+{
+    while (size >= pattern_size)
+    {
+        memcpy(dst, pattern, pattern_size);
+        dst += pattern_size;
+        size -= pattern_size;
+    }
+
+    memcpy(dst, pattern, size);
+}
+
+// patterns that divide 16, one vector holds a whole number of them
+static void fill16(unsigned char *dst, size_t size, const unsigned char *block)
+{
+    FillVector v;
+
+    v = loadFillVector(block);
+
+    while (size >= FILL_VECTOR_SIZE * 4)
+    {
+        storeFillVector(dst, v);
+        storeFillVector(dst + FILL_VECTOR_SIZE, v);
+        storeFillVector(dst + FILL_VECTOR_SIZE * 2, v);
+        storeFillVector(dst + FILL_VECTOR_SIZE * 3, v);
+
+        dst += FILL_VECTOR_SIZE * 4;
+        size -= FILL_VECTOR_SIZE * 4;
+    }
+
+    while (size >= FILL_VECTOR_SIZE)
+    {
+        storeFillVector(dst, v);
+
+        dst += FILL_VECTOR_SIZE;
+        size -= FILL_VECTOR_SIZE;
+    }
+
+    memcpy(dst, block, size);
+}
+
+// 12 byte patterns (rgb32) repeat every 3 vectors
+static void fill48(unsigned char *dst, size_t size, const unsigned char *block)
+{
+    FillVector v0, v1, v2;
+
+    v0 = loadFillVector(block);
+    v1 = loadFillVector(block + FILL_VECTOR_SIZE);
+    v2 = loadFillVector(block + FILL_VECTOR_SIZE * 2);
+
+    while (size >= FILL_VECTOR_SIZE * 3)
+    {
+        storeFillVector(dst, v0);
+        storeFillVector(dst + FILL_VECTOR_SIZE, v1);
+        storeFillVector(dst + FILL_VECTOR_SIZE * 2, v2);
+
+        dst += FILL_VECTOR_SIZE * 3;
+        size -= FILL_VECTOR_SIZE * 3;
+    }
+
+    memcpy(dst, block, size);
+}
+
+void patternFill(void *dst, size_t size, const void *pattern, size_t pattern_size)
+{
+    unsigned char block[FILL_VECTOR_SIZE * 3];
+    size_t block_size;
+
+    if (size == 0 || pattern_size == 0)
+        return;
+
+    // zero and other single byte values, the common case for clears
+    if (isByteSplat((const unsigned char *)pattern, pattern_size))
+    {
+        memset(dst, *(const unsigned char *)pattern, size);
+        return;
+    }
+
+    switch (pattern_size)
+    {
+    case 2:
+    case 4:
+    case 8:
+    case 16:
+        block_size = FILL_VECTOR_SIZE;
+        break;
+
+    case 12:
+        block_size = FILL_VECTOR_SIZE * 3;
+        break;
+
+    default:
+        fillElements((unsigned char *)dst, size, (const unsigned char *)pattern, pattern_size);
+        return;
+    }
+
+    if (size < block_size)
+    {
+        fillElements((unsigned char *)dst, size, (const unsigned char *)pattern, pattern_size);
+        return;
+    }
+
+    for (size_t i = 0; i < block_size; i += pattern_size)
+        memcpy(block + i, pattern, pattern_size);
+
+    if (block_size == FILL_VECTOR_SIZE)
+        fill16((unsigned char *)dst, size, block);
+    else
+        fill48((unsigned char *)dst, size, block);
+}
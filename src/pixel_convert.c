@@ -0,0 +1,1045 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_convert.c
+ * MGL
+ *
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "pixel_convert.h"
+
+#define CONVERT_CHUNK 64
+
+enum
+{
+    CHANNEL_UNORM8,
+    CHANNEL_PACKED16,
+    CHANNEL_UNORM16,
+    CHANNEL_UNORM32,
+    CHANNEL_HALF,
+    CHANNEL_FLOAT
+};
+
+typedef struct PixelLayoutInfo_t
+{
+    unsigned char size;
+    unsigned char kind;
+    signed char swizzle[4]; // element r, g, b, a are stored at, -1 if there's none
+} PixelLayoutInfo;
+
+static const PixelLayoutInfo layout_info[PIXEL_LAYOUT_COUNT] = {
+    [PIXEL_LAYOUT_R8] = {1, CHANNEL_UNORM8, {0, -1, -1, -1}},
+    [PIXEL_LAYOUT_RG8] = {2, CHANNEL_UNORM8, {0, 1, -1, -1}},
+    [PIXEL_LAYOUT_RGB8] = {3, CHANNEL_UNORM8, {0, 1, 2, -1}},
+    [PIXEL_LAYOUT_BGR8] = {3, CHANNEL_UNORM8, {2, 1, 0, -1}},
+    [PIXEL_LAYOUT_RGBA8] = {4, CHANNEL_UNORM8, {0, 1, 2, 3}},
+    [PIXEL_LAYOUT_BGRA8] = {4, CHANNEL_UNORM8, {2, 1, 0, 3}},
+    [PIXEL_LAYOUT_ABGR8] = {4, CHANNEL_UNORM8, {3, 2, 1, 0}},
+    [PIXEL_LAYOUT_ARGB8] = {4, CHANNEL_UNORM8, {1, 2, 3, 0}},
+
+    [PIXEL_LAYOUT_RGB565] = {2, CHANNEL_PACKED16, {0, 1, 2, -1}},
+    [PIXEL_LAYOUT_BGR565] = {2, CHANNEL_PACKED16, {0, 1, 2, -1}},
+    [PIXEL_LAYOUT_RGBA4444] = {2, CHANNEL_PACKED16, {0, 1, 2, 3}},
+    [PIXEL_LAYOUT_RGBA5551] = {2, CHANNEL_PACKED16, {0, 1, 2, 3}},
+
+    [PIXEL_LAYOUT_R16] = {2, CHANNEL_UNORM16, {0, -1, -1, -1}},
+    [PIXEL_LAYOUT_RG16] = {4, CHANNEL_UNORM16, {0, 1, -1, -1}},
+    [PIXEL_LAYOUT_RGB16] = {6, CHANNEL_UNORM16, {0, 1, 2, -1}},
+    [PIXEL_LAYOUT_RGBA16] = {8, CHANNEL_UNORM16, {0, 1, 2, 3}},
+
+    [PIXEL_LAYOUT_R32] = {4, CHANNEL_UNORM32, {0, -1, -1, -1}},
+
+    [PIXEL_LAYOUT_R16F] = {2, CHANNEL_HALF, {0, -1, -1, -1}},
+    [PIXEL_LAYOUT_RG16F] = {4, CHANNEL_HALF, {0, 1, -1, -1}},
+    [PIXEL_LAYOUT_RGB16F] = {6, CHANNEL_HALF, {0, 1, 2, -1}},
+    [PIXEL_LAYOUT_RGBA16F] = {8, CHANNEL_HALF, {0, 1, 2, 3}},
+
+    [PIXEL_LAYOUT_R32F] = {4, CHANNEL_FLOAT, {0, -1, -1, -1}},
+    [PIXEL_LAYOUT_RG32F] = {8, CHANNEL_FLOAT, {0, 1, -1, -1}},
+    [PIXEL_LAYOUT_RGB32F] = {12, CHANNEL_FLOAT, {0, 1, 2, -1}},
+    [PIXEL_LAYOUT_RGBA32F] = {16, CHANNEL_FLOAT, {0, 1, 2, 3}},
+};
+
+size_t getPixelLayoutSize(PixelLayout layout)
+{
+    if (layout <= PIXEL_LAYOUT_INVALID || layout >= PIXEL_LAYOUT_COUNT)
+        return 0;
+
+    return layout_info[layout].size;
+}
+
+bool canConvertPixels(PixelLayout dst_layout, PixelLayout src_layout)
+{
+    if (getPixelLayoutSize(dst_layout) == 0 || getPixelLayoutSize(src_layout) == 0)
+        return false;
+
+    return true;
+}
+
+#pragma mark half floats
+uint16_t floatToHalf(float f)
+{
+    uint32_t x, sign, mant, half;
+    int32_t exp;
+
+    memcpy(&x, &f, sizeof(x));
+
+    sign = (x >> 16) & 0x8000;
+    exp = (int32_t)((x >> 23) & 0xff);
+    mant = x & 0x7fffff;
+
+    // inf and nan, nans stay quiet like the hardware conversions
+    if (exp == 0xff)
+        return (uint16_t)(sign | 0x7c00 | (mant ? 0x200 | (mant >> 13) : 0));
+
+    exp = exp - 127 + 15;
+
+    if (exp >= 31)
+        return (uint16_t)(sign | 0x7c00);
+
+    if (exp <= 0)
+    {
+        uint32_t shift, rem, halfway;
+
+        // too small even for a denormal
+        if (exp < -10)
+            return (uint16_t)sign;
+
+        mant |= 0x800000;
+        shift = (uint32_t)(14 - exp);
+
+        half = mant >> shift;
+        rem = mant & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+
+        // round to nearest even
+        if (rem > halfway || (rem == halfway && (half & 1)))
+            half++;
+
+        return (uint16_t)(sign | half);
+    }
+
+    half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+
+    // a carry out of the mantissa rounds up into the exponent, and into inf past the largest half
+    if ((mant & 0x1fff) > 0x1000 || ((mant & 0x1fff) == 0x1000 && (half & 1)))
+        half++;
+
+    return (uint16_t)half;
+}
+
+float halfToFloat(uint16_t h)
+{
+    uint32_t sign, exp, mant, x;
+    float f;
+
+    sign = (uint32_t)(h & 0x8000) << 16;
+    exp = (h >> 10) & 0x1f;
+    mant = h & 0x3ff;
+
+    if (exp == 0)
+    {
+        int32_t e;
+
+        if (mant == 0)
+        {
+            x = sign;
+        }
+        else
+        {
+            // denormal, normalize it
+            e = 1;
+            while ((mant & 0x400) == 0)
+            {
+                mant <<= 1;
+                e--;
+            }
+
+            x = sign | ((uint32_t)(e + 112) << 23) | ((mant & 0x3ff) << 13);
+        }
+    }
+    else if (exp == 31)
+    {
+        x = sign | 0x7f800000 | (mant << 13);
+    }
+    else
+    {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+
+    memcpy(&f, &x, sizeof(f));
+
+    return f;
+}
+
+#pragma mark generic path
+static inline float unpackChannel(uint32_t bits, unsigned shift, unsigned width)
+{
+    uint32_t max;
+
+    max = (1u << width) - 1;
+
+    return (float)((bits >> shift) & max) / (float)max;
+}
+
+static void decodePixels(PixelLayout layout, const unsigned char *src, float *rgba, size_t count)
+{
+    const PixelLayoutInfo *info;
+
+    info = &layout_info[layout];
+
+    for (size_t i = 0; i < count; i++, src += info->size, rgba += 4)
+    {
+        rgba[0] = 0.0f;
+        rgba[1] = 0.0f;
+        rgba[2] = 0.0f;
+        rgba[3] = 1.0f;
+
+        if (info->kind == CHANNEL_PACKED16)
+        {
+            uint16_t p;
+
+            memcpy(&p, src, sizeof(p));
+
+            switch (layout)
+            {
+            case PIXEL_LAYOUT_RGB565:
+                rgba[0] = unpackChannel(p, 11, 5);
+                rgba[1] = unpackChannel(p, 5, 6);
+                rgba[2] = unpackChannel(p, 0, 5);
+                break;
+
+            case PIXEL_LAYOUT_BGR565:
+                rgba[0] = unpackChannel(p, 0, 5);
+                rgba[1] = unpackChannel(p, 5, 6);
+                rgba[2] = unpackChannel(p, 11, 5);
+                break;
+
+            case PIXEL_LAYOUT_RGBA4444:
+                rgba[0] = unpackChannel(p, 12, 4);
+                rgba[1] = unpackChannel(p, 8, 4);
+                rgba[2] = unpackChannel(p, 4, 4);
+                rgba[3] = unpackChannel(p, 0, 4);
+                break;
+
+            case PIXEL_LAYOUT_RGBA5551:
+                rgba[0] = unpackChannel(p, 11, 5);
+                rgba[1] = unpackChannel(p, 6, 5);
+                rgba[2] = unpackChannel(p, 1, 5);
+                rgba[3] = unpackChannel(p, 0, 1);
+                break;
+
+            default:
+                break;
+            }
+
+            continue;
+        }
+
+        for (unsigned c = 0; c < 4; c++)
+        {
+            int index;
+
+            index = info->swizzle[c];
+            if (index < 0)
+                continue;
+
+            switch (info->kind)
+            {
+            case CHANNEL_UNORM8:
+                rgba[c] = (float)src[index] / 255.0f;
+                break;
+
+            case CHANNEL_UNORM16: {
+                uint16_t v;
+
+                memcpy(&v, src + index * 2, sizeof(v));
+                rgba[c] = (float)v / 65535.0f;
+                break;
+            }
+
+            case CHANNEL_UNORM32: {
+                uint32_t v;
+
+                memcpy(&v, src + index * 4, sizeof(v));
+                rgba[c] = (float)((double)v / 4294967295.0);
+                break;
+            }
+
+            case CHANNEL_HALF: {
+                uint16_t v;
+
+                memcpy(&v, src + index * 2, sizeof(v));
+                rgba[c] = halfToFloat(v);
+                break;
+            }
+
+            case CHANNEL_FLOAT:
+                memcpy(&rgba[c], src + index * 4, sizeof(float));
+                break;
+            }
+        }
+    }
+}
+
+static inline float clampUnorm(float f)
+{
+    // nan ends up 0
+    return (f > 0.0f) ? ((f < 1.0f) ? f : 1.0f) : 0.0f;
+}
+
+static inline uint32_t packChannel(float f, unsigned shift, unsigned width)
+{
+    uint32_t max;
+
+    max = (1u << width) - 1;
+
+    return (uint32_t)(clampUnorm(f) * (float)max + 0.5f) << shift;
+}
+
+static void encodePixels(PixelLayout layout, unsigned char *dst, const float *rgba, size_t count)
+{
+    const PixelLayoutInfo *info;
+
+    info = &layout_info[layout];
+
+    for (size_t i = 0; i < count; i++, dst += info->size, rgba += 4)
+    {
+        if (info->kind == CHANNEL_PACKED16)
+        {
+            uint32_t p;
+            uint16_t v;
+
+            switch (layout)
+            {
+            case PIXEL_LAYOUT_RGB565:
+                p = packChannel(rgba[0], 11, 5) | packChannel(rgba[1], 5, 6) | packChannel(rgba[2], 0, 5);
+                break;
+
+            case PIXEL_LAYOUT_BGR565:
+                p = packChannel(rgba[0], 0, 5) | packChannel(rgba[1], 5, 6) | packChannel(rgba[2], 11, 5);
+                break;
+
+            case PIXEL_LAYOUT_RGBA4444:
+                p = packChannel(rgba[0], 12, 4) | packChannel(rgba[1], 8, 4) | packChannel(rgba[2], 4, 4) |
+                    packChannel(rgba[3], 0, 4);
+                break;
+
+            case PIXEL_LAYOUT_RGBA5551:
+                p = packChannel(rgba[0], 11, 5) | packChannel(rgba[1], 6, 5) | packChannel(rgba[2], 1, 5) |
+                    packChannel(rgba[3], 0, 1);
+                break;
+
+            default:
+                p = 0;
+                break;
+            }
+
+            v = (uint16_t)p;
+            memcpy(dst, &v, sizeof(v));
+
+            continue;
+        }
+
+        for (unsigned c = 0; c < 4; c++)
+        {
+            int index;
+
+            index = info->swizzle[c];
+            if (index < 0)
+                continue;
+
+            switch (info->kind)
+            {
+            case CHANNEL_UNORM8:
+                dst[index] = (unsigned char)(clampUnorm(rgba[c]) * 255.0f + 0.5f);
+                break;
+
+            case CHANNEL_UNORM16: {
+                uint16_t v;
+
+                v = (uint16_t)(clampUnorm(rgba[c]) * 65535.0f + 0.5f);
+                memcpy(dst + index * 2, &v, sizeof(v));
+                break;
+            }
+
+            case CHANNEL_UNORM32: {
+                uint32_t v;
+
+                // a float can't hold 2^32 - 1
+                v = (uint32_t)((double)clampUnorm(rgba[c]) * 4294967295.0 + 0.5);
+                memcpy(dst + index * 4, &v, sizeof(v));
+                break;
+            }
+
+            case CHANNEL_HALF: {
+                uint16_t v;
+
+                v = floatToHalf(rgba[c]);
+                memcpy(dst + index * 2, &v, sizeof(v));
+                break;
+            }
+
+            case CHANNEL_FLOAT:
+                memcpy(dst + index * 4, &rgba[c], sizeof(float));
+                break;
+            }
+        }
+    }
+}
+
+bool convertPixelsGeneric(PixelLayout dst_layout, void *dst, PixelLayout src_layout, const void *src, size_t count)
+{
+    float rgba[CONVERT_CHUNK * 4];
+    const unsigned char *s;
+    unsigned char *d;
+    size_t src_size, dst_size;
+
+    if (canConvertPixels(dst_layout, src_layout) == false)
+        return false;
+
+    s = (const unsigned char *)src;
+    d = (unsigned char *)dst;
+
+    src_size = getPixelLayoutSize(src_layout);
+    dst_size = getPixelLayoutSize(dst_layout);
+
+    // 32 bit unorm doesn't survive a trip through float
+    if (dst_layout == src_layout)
+    {
+        memcpy(d, s, count * src_size);
+        return true;
+    }
+
+    while (count)
+    {
+        size_t n;
+
+        n = (count < CONVERT_CHUNK) ? count : CONVERT_CHUNK;
+
+        decodePixels(src_layout, s, rgba, n);
+        encodePixels(dst_layout, d, rgba, n);
+
+        s += n * src_size;
+        d += n * dst_size;
+        count -= n;
+    }
+
+    return true;
+}
+
+#pragma mark vector kernels
+// each kernel does what it can a vector at a time and returns how many pixels
+// that was, the generic path picks up the tail
+
+// rgb8 / bgr8 into rgba8
+static size_t expandRGB8(unsigned char *dst, const unsigned char *src, size_t count, bool bgr)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__AVX2__)
+    {
+        const __m256i mask = bgr ? _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1, 2, 1, 0, -1,
+                                                    5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                                 : _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1,
+                                                    3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+
+        // 8 pixels from two 12 byte halves, each load reads 4 bytes past its half
+        while (count - done >= 10)
+        {
+            __m128i lo, hi;
+            __m256i v;
+
+            lo = _mm_loadu_si128((const __m128i *)(src + done * 3));
+            hi = _mm_loadu_si128((const __m128i *)(src + done * 3 + 12));
+
+            v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            v = _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alpha);
+
+            _mm256_storeu_si256((__m256i *)(dst + done * 4), v);
+
+            done += 8;
+        }
+    }
+#elif defined(__SSSE3__)
+    {
+        const __m128i mask = bgr ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                                 : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+
+        // 4 pixels per 16 byte load, it reads 4 bytes past them
+        while (count - done >= 6)
+        {
+            __m128i v;
+
+            v = _mm_loadu_si128((const __m128i *)(src + done * 3));
+            v = _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha);
+
+            _mm_storeu_si128((__m128i *)(dst + done * 4), v);
+
+            done += 4;
+        }
+    }
+#elif defined(__ARM_NEON)
+    while (count - done >= 16)
+    {
+        uint8x16x3_t in;
+        uint8x16x4_t out;
+
+        in = vld3q_u8(src + done * 3);
+
+        out.val[0] = bgr ? in.val[2] : in.val[0];
+        out.val[1] = in.val[1];
+        out.val[2] = bgr ? in.val[0] : in.val[2];
+        out.val[3] = vdupq_n_u8(0xff);
+
+        vst4q_u8(dst + done * 4, out);
+
+        done += 16;
+    }
+#endif
+
+    for (; done < count; done++)
+    {
+        const unsigned char *s = src + done * 3;
+        unsigned char *d = dst + done * 4;
+
+        d[0] = bgr ? s[2] : s[0];
+        d[1] = s[1];
+        d[2] = bgr ? s[0] : s[2];
+        d[3] = 0xff;
+    }
+
+    return done;
+}
+
+// bgra8 <-> rgba8, the same swap both ways
+static size_t swapRB8(unsigned char *dst, const unsigned char *src, size_t count)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__AVX2__)
+    {
+        const __m256i ag_mask = _mm256_set1_epi32((int)0xff00ff00);
+        const __m256i rb_mask = _mm256_set1_epi32(0x00ff00ff);
+
+        while (count - done >= 8)
+        {
+            __m256i v, rb;
+
+            v = _mm256_loadu_si256((const __m256i *)(src + done * 4));
+
+            rb = _mm256_and_si256(v, rb_mask);
+            rb = _mm256_or_si256(_mm256_srli_epi32(rb, 16), _mm256_slli_epi32(rb, 16));
+            v = _mm256_or_si256(_mm256_and_si256(v, ag_mask), rb);
+
+            _mm256_storeu_si256((__m256i *)(dst + done * 4), v);
+
+            done += 8;
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        const __m128i ag_mask = _mm_set1_epi32((int)0xff00ff00);
+        const __m128i rb_mask = _mm_set1_epi32(0x00ff00ff);
+
+        while (count - done >= 4)
+        {
+            __m128i v, rb;
+
+            v = _mm_loadu_si128((const __m128i *)(src + done * 4));
+
+            rb = _mm_and_si128(v, rb_mask);
+            rb = _mm_or_si128(_mm_srli_epi32(rb, 16), _mm_slli_epi32(rb, 16));
+            v = _mm_or_si128(_mm_and_si128(v, ag_mask), rb);
+
+            _mm_storeu_si128((__m128i *)(dst + done * 4), v);
+
+            done += 4;
+        }
+    }
+#elif defined(__ARM_NEON)
+    while (count - done >= 16)
+    {
+        uint8x16x4_t v;
+        uint8x16_t t;
+
+        v = vld4q_u8(src + done * 4);
+
+        t = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = t;
+
+        vst4q_u8(dst + done * 4, v);
+
+        done += 16;
+    }
+#endif
+
+    for (; done < count; done++)
+    {
+        const unsigned char *s = src + done * 4;
+        unsigned char *d = dst + done * 4;
+
+        d[0] = s[2];
+        d[1] = s[1];
+        d[2] = s[0];
+        d[3] = s[3];
+    }
+
+    return done;
+}
+
+// 565 into rgba8, (v * 527 + 23) >> 6 and (v * 259 + 33) >> 6 round 5 and 6 bits
+// to 8 the same as the generic path's float math
+static size_t expandRGB565(unsigned char *dst, const unsigned char *src, size_t count)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__AVX2__)
+    {
+        const __m256i mask5 = _mm256_set1_epi16(31);
+        const __m256i mask6 = _mm256_set1_epi16(63);
+        const __m256i alpha = _mm256_set1_epi16((short)0xff00);
+
+        while (count - done >= 16)
+        {
+            __m256i p, r, g, b, rg, ba, lo, hi;
+
+            p = _mm256_loadu_si256((const __m256i *)(src + done * 2));
+
+            r = _mm256_srli_epi16(p, 11);
+            g = _mm256_and_si256(_mm256_srli_epi16(p, 5), mask6);
+            b = _mm256_and_si256(p, mask5);
+
+            r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(527)), _mm256_set1_epi16(23)), 6);
+            g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(g, _mm256_set1_epi16(259)), _mm256_set1_epi16(33)), 6);
+            b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(527)), _mm256_set1_epi16(23)), 6);
+
+            rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+            ba = _mm256_or_si256(b, alpha);
+
+            // unpack works within 128 bit lanes, put the pixels back in order
+            lo = _mm256_unpacklo_epi16(rg, ba);
+            hi = _mm256_unpackhi_epi16(rg, ba);
+
+            _mm256_storeu_si256((__m256i *)(dst + done * 4), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i *)(dst + done * 4 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+
+            done += 16;
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        const __m128i mask5 = _mm_set1_epi16(31);
+        const __m128i mask6 = _mm_set1_epi16(63);
+        const __m128i alpha = _mm_set1_epi16((short)0xff00);
+
+        while (count - done >= 8)
+        {
+            __m128i p, r, g, b, rg, ba;
+
+            p = _mm_loadu_si128((const __m128i *)(src + done * 2));
+
+            r = _mm_srli_epi16(p, 11);
+            g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+            b = _mm_and_si128(p, mask5);
+
+            r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+            g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(259)), _mm_set1_epi16(33)), 6);
+            b = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+
+            rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+            ba = _mm_or_si128(b, alpha);
+
+            _mm_storeu_si128((__m128i *)(dst + done * 4), _mm_unpacklo_epi16(rg, ba));
+            _mm_storeu_si128((__m128i *)(dst + done * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+
+            done += 8;
+        }
+    }
+#elif defined(__ARM_NEON)
+    while (count - done >= 8)
+    {
+        uint16x8_t p, r, g, b;
+        uint8x8x4_t out;
+
+        p = vld1q_u16((const uint16_t *)(src + done * 2));
+
+        r = vshrq_n_u16(p, 11);
+        g = vandq_u16(vshrq_n_u16(p, 5), vdupq_n_u16(63));
+        b = vandq_u16(p, vdupq_n_u16(31));
+
+        out.val[0] = vmovn_u16(vshrq_n_u16(vmlaq_u16(vdupq_n_u16(23), r, vdupq_n_u16(527)), 6));
+        out.val[1] = vmovn_u16(vshrq_n_u16(vmlaq_u16(vdupq_n_u16(33), g, vdupq_n_u16(259)), 6));
+        out.val[2] = vmovn_u16(vshrq_n_u16(vmlaq_u16(vdupq_n_u16(23), b, vdupq_n_u16(527)), 6));
+        out.val[3] = vdup_n_u8(0xff);
+
+        vst4_u8(dst + done * 4, out);
+
+        done += 8;
+    }
+#endif
+
+    for (; done < count; done++)
+    {
+        uint16_t p;
+        unsigned char *d = dst + done * 4;
+
+        memcpy(&p, src + done * 2, sizeof(p));
+
+        d[0] = (unsigned char)((((p >> 11) & 31) * 527 + 23) >> 6);
+        d[1] = (unsigned char)((((p >> 5) & 63) * 259 + 33) >> 6);
+        d[2] = (unsigned char)(((p & 31) * 527 + 23) >> 6);
+        d[3] = 0xff;
+    }
+
+    return done;
+}
+
+// rgba32f / rgb32f into rgba16f
+static size_t floatToHalfRGBA(unsigned char *dst, const unsigned char *src, size_t count, bool rgb)
+{
+    size_t done, src_size;
+
+    done = 0;
+    src_size = rgb ? 12 : 16;
+
+#if defined(__F16C__)
+    if (rgb == false)
+    {
+#if defined(__AVX2__)
+        while (count - done >= 2)
+        {
+            __m256 v;
+
+            v = _mm256_loadu_ps((const float *)(src + done * 16));
+            _mm_storeu_si128((__m128i *)(dst + done * 8), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+
+            done += 2;
+        }
+#endif
+        while (count - done >= 1)
+        {
+            __m128 v;
+
+            v = _mm_loadu_ps((const float *)(src + done * 16));
+            _mm_storel_epi64((__m128i *)(dst + done * 8), _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+
+            done++;
+        }
+    }
+    else
+    {
+        // the 4th float of a load is the next pixel's red, the last pixel is left to the scalar loop
+        while (count - done >= 2)
+        {
+            __m128 v;
+
+            v = _mm_loadu_ps((const float *)(src + done * 12));
+            v = _mm_insert_ps(v, _mm_set_ss(1.0f), 0x30);
+            _mm_storel_epi64((__m128i *)(dst + done * 8), _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+
+            done++;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (rgb == false)
+    {
+        while (count - done >= 1)
+        {
+            float32x4_t v;
+
+            v = vld1q_f32((const float *)(src + done * 16));
+            vst1_u16((uint16_t *)(dst + done * 8), vreinterpret_u16_f16(vcvt_f16_f32(v)));
+
+            done++;
+        }
+    }
+    else
+    {
+        while (count - done >= 4)
+        {
+            float32x4x3_t in;
+            float32x4x4_t rgba;
+            uint16x4x4_t out;
+
+            in = vld3q_f32((const float *)(src + done * 12));
+
+            rgba.val[0] = in.val[0];
+            rgba.val[1] = in.val[1];
+            rgba.val[2] = in.val[2];
+            rgba.val[3] = vdupq_n_f32(1.0f);
+
+            for (int c = 0; c < 4; c++)
+                out.val[c] = vreinterpret_u16_f16(vcvt_f16_f32(rgba.val[c]));
+
+            vst4_u16((uint16_t *)(dst + done * 8), out);
+
+            done += 4;
+        }
+    }
+#endif
+
+    for (; done < count; done++)
+    {
+        const float *s = (const float *)(src + done * src_size);
+        uint16_t h[4];
+
+        h[0] = floatToHalf(s[0]);
+        h[1] = floatToHalf(s[1]);
+        h[2] = floatToHalf(s[2]);
+        h[3] = rgb ? 0x3c00 : floatToHalf(s[3]);
+
+        memcpy(dst + done * 8, h, sizeof(h));
+    }
+
+    return done;
+}
+
+// rgba8 / bgra8 into rgb8 / bgr8, reads of the drawable into GL_RGB
+static size_t dropAlpha8(unsigned char *dst, const unsigned char *src, size_t count, bool swap)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__SSSE3__)
+    {
+        const __m128i mask = swap ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                                  : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        // 4 pixels make 12 bytes, the 16 byte store writes 4 past them
+        while (count - done >= 6)
+        {
+            __m128i v;
+
+            v = _mm_loadu_si128((const __m128i *)(src + done * 4));
+            _mm_storeu_si128((__m128i *)(dst + done * 3), _mm_shuffle_epi8(v, mask));
+
+            done += 4;
+        }
+    }
+#elif defined(__ARM_NEON)
+    while (count - done >= 16)
+    {
+        uint8x16x4_t in;
+        uint8x16x3_t out;
+
+        in = vld4q_u8(src + done * 4);
+
+        out.val[0] = swap ? in.val[2] : in.val[0];
+        out.val[1] = in.val[1];
+        out.val[2] = swap ? in.val[0] : in.val[2];
+
+        vst3q_u8(dst + done * 3, out);
+
+        done += 16;
+    }
+#endif
+
+    for (; done < count; done++)
+    {
+        const unsigned char *s = src + done * 4;
+        unsigned char *d = dst + done * 3;
+
+        d[0] = swap ? s[2] : s[0];
+        d[1] = s[1];
+        d[2] = swap ? s[0] : s[2];
+    }
+
+    return done;
+}
+
+// rgba16f into rgba32f, every half is exact as a float
+static size_t halfToFloatRGBA(unsigned char *dst, const unsigned char *src, size_t count)
+{
+    size_t done;
+
+    done = 0;
+
+#if defined(__F16C__)
+#if defined(__AVX2__)
+    while (count - done >= 2)
+    {
+        __m128i h;
+
+        h = _mm_loadu_si128((const __m128i *)(src + done * 8));
+        _mm256_storeu_ps((float *)(dst + done * 16), _mm256_cvtph_ps(h));
+
+        done += 2;
+    }
+#endif
+    while (count - done >= 1)
+    {
+        __m128i h;
+
+        h = _mm_loadl_epi64((const __m128i *)(src + done * 8));
+        _mm_storeu_ps((float *)(dst + done * 16), _mm_cvtph_ps(h));
+
+        done++;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    while (count - done >= 1)
+    {
+        uint16x4_t h;
+
+        h = vld1_u16((const uint16_t *)(src + done * 8));
+        vst1q_f32((float *)(dst + done * 16), vcvt_f32_f16(vreinterpret_f16_u16(h)));
+
+        done++;
+    }
+#endif
+
+    for (; done < count; done++)
+    {
+        uint16_t h[4];
+        float f[4];
+
+        memcpy(h, src + done * 8, sizeof(h));
+
+        for (int c = 0; c < 4; c++)
+            f[c] = halfToFloat(h[c]);
+
+        memcpy(dst + done * 16, f, sizeof(f));
+    }
+
+    return done;
+}
+
+// rgb32f into rgba32f, short enough for the compiler to vectorize
+static size_t expandRGB32F(unsigned char *dst, const unsigned char *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        float p[4];
+
+        memcpy(p, src + i * 12, 12);
+        p[3] = 1.0f;
+
+        memcpy(dst + i * 16, p, 16);
+    }
+
+    return count;
+}
+
+bool convertPixels(PixelLayout dst_layout, void *dst, PixelLayout src_layout, const void *src, size_t count)
+{
+    unsigned char *d;
+    const unsigned char *s;
+
+    if (canConvertPixels(dst_layout, src_layout) == false)
+        return false;
+
+    d = (unsigned char *)dst;
+    s = (const unsigned char *)src;
+
+    if (dst_layout == src_layout)
+    {
+        memcpy(d, s, count * getPixelLayoutSize(src_layout));
+        return true;
+    }
+
+    switch (dst_layout)
+    {
+    case PIXEL_LAYOUT_RGBA8:
+        switch (src_layout)
+        {
+        case PIXEL_LAYOUT_RGB8:
+            expandRGB8(d, s, count, false);
+            return true;
+
+        case PIXEL_LAYOUT_BGR8:
+            expandRGB8(d, s, count, true);
+            return true;
+
+        case PIXEL_LAYOUT_BGRA8:
+            swapRB8(d, s, count);
+            return true;
+
+        case PIXEL_LAYOUT_RGB565:
+            expandRGB565(d, s, count);
+            return true;
+
+        default:
+            break;
+        }
+        break;
+
+    case PIXEL_LAYOUT_BGRA8:
+        if (src_layout == PIXEL_LAYOUT_RGBA8)
+        {
+            swapRB8(d, s, count);
+            return true;
+        }
+        break;
+
+    case PIXEL_LAYOUT_RGB8:
+    case PIXEL_LAYOUT_BGR8:
+        if (src_layout == PIXEL_LAYOUT_RGBA8 || src_layout == PIXEL_LAYOUT_BGRA8)
+        {
+            // swap when the red ends up on the other side
+            dropAlpha8(d, s, count, (dst_layout == PIXEL_LAYOUT_RGB8) != (src_layout == PIXEL_LAYOUT_RGBA8));
+            return true;
+        }
+        break;
+
+    case PIXEL_LAYOUT_RGBA16F:
+        if (src_layout == PIXEL_LAYOUT_RGBA32F || src_layout == PIXEL_LAYOUT_RGB32F)
+        {
+            floatToHalfRGBA(d, s, count, src_layout == PIXEL_LAYOUT_RGB32F);
+            return true;
+        }
+        break;
+
+    case PIXEL_LAYOUT_RGBA32F:
+        if (src_layout == PIXEL_LAYOUT_RGB32F)
+        {
+            expandRGB32F(d, s, count);
+            return true;
+        }
+
+        if (src_layout == PIXEL_LAYOUT_RGBA16F)
+        {
+            halfToFloatRGBA(d, s, count);
+            return true;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return convertPixelsGeneric(dst_layout, dst, src_layout, src, count);
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_store.c
+ * MGL
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "pixel_store.h"
+
+void getPixelStoreLayout(const PixelStoreParams *params, size_t pixel_size, size_t element_size, bool is_3d,
+                         size_t width, size_t height, size_t depth, PixelStoreLayout *layout)
+{
+    size_t row_length, row_bytes, alignment, image_height;
+
+    row_length = params->row_length ? params->row_length : width;
+    alignment = params->alignment ? params->alignment : 1;
+
+    row_bytes = row_length * pixel_size;
+
+    // rows start on alignment unless the elements are already at least that aligned
+    if (element_size >= alignment)
+        layout->row_pitch = row_bytes;
+    else
+        layout->row_pitch = (row_bytes + alignment - 1) / alignment * alignment;
+
+    image_height = (is_3d && params->image_height) ? params->image_height : height;
+
+    layout->image_pitch = layout->row_pitch * image_height;
+    layout->row_size = width * pixel_size;
+
+    layout->offset = params->skip_pixels * pixel_size + params->skip_rows * layout->row_pitch;
+    if (is_3d)
+        layout->offset += params->skip_images * layout->image_pitch;
+
+    if (width && height && depth)
+        layout->size = layout->offset + (depth - 1) * layout->image_pitch + (height - 1) * layout->row_pitch +
+                       layout->row_size;
+    else
+        layout->size = 0;
+
+    if (params->swap_bytes && (element_size == 2 || element_size == 4 || element_size == 8))
+        layout->swap_size = element_size;
+    else
+        layout->swap_size = 0;
+}
+
+static inline void swapElement(unsigned char *dst, const unsigned char *src, size_t swap_size)
+{
+    switch (swap_size)
+    {
+    case 2: {
+        uint16_t v;
+
+        memcpy(&v, src, 2);
+        v = __builtin_bswap16(v);
+        memcpy(dst, &v, 2);
+        break;
+    }
+
+    case 4: {
+        uint32_t v;
+
+        memcpy(&v, src, 4);
+        v = __builtin_bswap32(v);
+        memcpy(dst, &v, 4);
+        break;
+    }
+
+    case 8: {
+        uint64_t v;
+
+        memcpy(&v, src, 8);
+        v = __builtin_bswap64(v);
+        memcpy(dst, &v, 8);
+        break;
+    }
+    }
+}
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+// byte i of a vector comes from the mirrored byte of its element
+static void getSwapMask(unsigned char *mask, size_t count, size_t swap_size)
+{
+    for (size_t i = 0; i < count; i++)
+        mask[i] = (unsigned char)(i - i % swap_size + (swap_size - 1 - i % swap_size));
+}
+#endif
+
+void swapPixelBytes(void *dst, const void *src, size_t size, size_t swap_size)
+{
+    unsigned char *d;
+    const unsigned char *s;
+    size_t done;
+
+    d = (unsigned char *)dst;
+    s = (const unsigned char *)src;
+
+    if (swap_size != 2 && swap_size != 4 && swap_size != 8)
+    {
+        if (d != s)
+            memmove(d, s, size);
+
+        return;
+    }
+
+    done = 0;
+
+#if defined(__AVX2__)
+    {
+        unsigned char bytes[32];
+        __m256i mask;
+
+        getSwapMask(bytes, 32, swap_size);
+        mask = _mm256_loadu_si256((const __m256i *)bytes);
+
+        while (size - done >= 32)
+        {
+            __m256i v;
+
+            v = _mm256_loadu_si256((const __m256i *)(s + done));
+            _mm256_storeu_si256((__m256i *)(d + done), _mm256_shuffle_epi8(v, mask));
+
+            done += 32;
+        }
+    }
+#elif defined(__SSSE3__)
+    {
+        unsigned char bytes[16];
+        __m128i mask;
+
+        getSwapMask(bytes, 16, swap_size);
+        mask = _mm_loadu_si128((const __m128i *)bytes);
+
+        while (size - done >= 16)
+        {
+            __m128i v;
+
+            v = _mm_loadu_si128((const __m128i *)(s + done));
+            _mm_storeu_si128((__m128i *)(d + done), _mm_shuffle_epi8(v, mask));
+
+            done += 16;
+        }
+    }
+#elif defined(__SSE2__)
+    while (size - done >= 16)
+    {
+        __m128i v;
+
+        v = _mm_loadu_si128((const __m128i *)(s + done));
+
+        // swap the bytes of each 16 bit word, then the words of wider elements
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+        if (swap_size == 4)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        else if (swap_size == 8)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+
+        _mm_storeu_si128((__m128i *)(d + done), v);
+
+        done += 16;
+    }
+#elif defined(__ARM_NEON)
+    while (size - done >= 16)
+    {
+        uint8x16_t v;
+
+        v = vld1q_u8(s + done);
+
+        if (swap_size == 2)
+            v = vrev16q_u8(v);
+        else if (swap_size == 4)
+            v = vrev32q_u8(v);
+        else
+            v = vrev64q_u8(v);
+
+        vst1q_u8(d + done, v);
+
+        done += 16;
+    }
+#endif
+
+    for (; size - done >= swap_size; done += swap_size)
+        swapElement(d + done, s + done, swap_size);
+
+    // a partial element isn't swapped
+    if (done < size && d != s)
+        memmove(d + done, s + done, size - done);
+}
+
+static inline void copyBytes(unsigned char *dst, const unsigned char *src, size_t size, size_t swap_size)
+{
+    if (swap_size)
+        swapPixelBytes(dst, src, size, swap_size);
+    else
+        memcpy(dst, src, size);
+}
+
+void copyPixelRows(void *dst, size_t dst_pitch, size_t dst_image_pitch, const void *src, size_t src_pitch,
+                   size_t src_image_pitch, size_t row_size, size_t height, size_t depth, size_t swap_size)
+{
+    unsigned char *d;
+    const unsigned char *s;
+    bool rows_packed;
+
+    if (row_size == 0 || height == 0 || depth == 0)
+        return;
+
+    if (swap_size != 2 && swap_size != 4 && swap_size != 8)
+        swap_size = 0;
+
+    d = (unsigned char *)dst;
+    s = (const unsigned char *)src;
+
+    rows_packed = (dst_pitch == row_size) && (src_pitch == row_size);
+
+    // the whole thing is one block
+    if (rows_packed && (depth == 1 || (dst_image_pitch == row_size * height && src_image_pitch == row_size * height)))
+    {
+        copyBytes(d, s, row_size * height * depth, swap_size);
+        return;
+    }
+
+    for (size_t z = 0; z < depth; z++)
+    {
+        unsigned char *dst_row;
+        const unsigned char *src_row;
+
+        dst_row = d + z * dst_image_pitch;
+        src_row = s + z * src_image_pitch;
+
+        if (rows_packed)
+        {
+            copyBytes(dst_row, src_row, row_size * height, swap_size);
+            continue;
+        }
+
+        for (size_t y = 0; y < height; y++)
+        {
+            copyBytes(dst_row, src_row, row_size, swap_size);
+
+            dst_row += dst_pitch;
+            src_row += src_pitch;
+        }
+    }
+}
+
+bool packPixelRows(void *dst, const PixelStoreLayout *layout, PixelLayout dst_pixels, const void *src,
+                   size_t src_pitch, size_t src_image_pitch, PixelLayout src_pixels, size_t width, size_t height,
+                   size_t depth)
+{
+    unsigned char *d;
+    const unsigned char *s;
+
+    d = (unsigned char *)dst + layout->offset;
+    s = (const unsigned char *)src;
+
+    if (dst_pixels == src_pixels)
+    {
+        copyPixelRows(d, layout->row_pitch, layout->image_pitch, s, src_pitch, src_image_pitch, layout->row_size,
+                      height, depth, layout->swap_size);
+        return true;
+    }
+
+    if (canConvertPixels(dst_pixels, src_pixels) == false)
+        return false;
+
+    for (size_t z = 0; z < depth; z++)
+    {
+        unsigned char *dst_row;
+        const unsigned char *src_row;
+
+        dst_row = d + z * layout->image_pitch;
+        src_row = s + z * src_image_pitch;
+
+        for (size_t y = 0; y < height; y++)
+        {
+            convertPixels(dst_pixels, dst_row, src_pixels, src_row, width);
+
+            // the row is still in cache
+            if (layout->swap_size)
+                swapPixelBytes(dst_row, dst_row, layout->row_size, layout->swap_size);
+
+            dst_row += layout->row_pitch;
+            src_row += src_pitch;
+        }
+    }
+
+    return true;
+}
@@ -67,6 +67,7 @@ GLuint sizeForType(GLenum type)
 
     case GL_UNSIGNED_SHORT:
     case GL_SHORT:
+    case GL_HALF_FLOAT:
         return sizeof(uint16_t);
 
     case GL_UNSIGNED_INT:
@@ -92,6 +93,10 @@ GLuint sizeForType(GLenum type)
     case GL_UNSIGNED_INT_8_8_8_8_REV:
     case GL_UNSIGNED_INT_10_10_10_2:
     case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV: // swapped a word at a time
         return sizeof(uint32_t);
 
     default:
@@ -111,6 +116,7 @@ GLuint sizeForFormatType(GLenum format, GLenum type)
 
     case GL_UNSIGNED_SHORT:
     case GL_SHORT:
+    case GL_HALF_FLOAT:
         return sizeof(uint16_t) * numComponentsForFormat(format);
 
     case GL_UNSIGNED_INT:
@@ -136,8 +142,14 @@ GLuint sizeForFormatType(GLenum format, GLenum type)
     case GL_UNSIGNED_INT_8_8_8_8_REV:
     case GL_UNSIGNED_INT_10_10_10_2:
     case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
         return sizeof(uint32_t);
 
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return sizeof(uint32_t) * 2;
+
     default:
         assert(0);
     }
@@ -1867,13 +1879,54 @@ GLenum internalFormatForGLFormatType(GLenum format, GLenum type)
     }
 }
 
+// the khr astc enums are contiguous, the metal ones skip a few values
+static MTLPixelFormat mtlFormatForASTC(GLenum internal_format)
+{
+    if (__builtin_available(macOS 11.0, *))
+    {
+        static const MTLPixelFormat ldr[14] = {
+            MTLPixelFormatASTC_4x4_LDR,   MTLPixelFormatASTC_5x4_LDR,   MTLPixelFormatASTC_5x5_LDR,
+            MTLPixelFormatASTC_6x5_LDR,   MTLPixelFormatASTC_6x6_LDR,   MTLPixelFormatASTC_8x5_LDR,
+            MTLPixelFormatASTC_8x6_LDR,   MTLPixelFormatASTC_8x8_LDR,   MTLPixelFormatASTC_10x5_LDR,
+            MTLPixelFormatASTC_10x6_LDR,  MTLPixelFormatASTC_10x8_LDR,  MTLPixelFormatASTC_10x10_LDR,
+            MTLPixelFormatASTC_12x10_LDR, MTLPixelFormatASTC_12x12_LDR};
+        static const MTLPixelFormat srgb[14] = {
+            MTLPixelFormatASTC_4x4_sRGB,   MTLPixelFormatASTC_5x4_sRGB,   MTLPixelFormatASTC_5x5_sRGB,
+            MTLPixelFormatASTC_6x5_sRGB,   MTLPixelFormatASTC_6x6_sRGB,   MTLPixelFormatASTC_8x5_sRGB,
+            MTLPixelFormatASTC_8x6_sRGB,   MTLPixelFormatASTC_8x8_sRGB,   MTLPixelFormatASTC_10x5_sRGB,
+            MTLPixelFormatASTC_10x6_sRGB,  MTLPixelFormatASTC_10x8_sRGB,  MTLPixelFormatASTC_10x10_sRGB,
+            MTLPixelFormatASTC_12x10_sRGB, MTLPixelFormatASTC_12x12_sRGB};
+
+        if (internal_format >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR &&
+            internal_format <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR)
+            return ldr[internal_format - GL_COMPRESSED_RGBA_ASTC_4x4_KHR];
+
+        if (internal_format >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR &&
+            internal_format <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR)
+            return srgb[internal_format - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR];
+    }
+
+    return MTLPixelFormatInvalid;
+}
+
 MTLPixelFormat mtlFormatForGLInternalFormat(GLenum internal_format)
 {
     switch (internal_format)
     {
+    // unsized formats, rgb is stored with an alpha and converted on upload
+    case GL_RED:
+        return MTLPixelFormatR8Unorm;
+
+    case GL_RG:
+        return MTLPixelFormatRG8Unorm;
+
+    case GL_RGB:
+    case GL_RGBA:
+    case GL_RGB8:
+        return MTLPixelFormatRGBA8Unorm;
+
     case GL_RGB4:
     case GL_RGB5:
-    case GL_RGB8:
     case GL_RGB10:
     case GL_RGB12:
     case GL_RGB16:
@@ -2046,32 +2099,27 @@ MTLPixelFormat mtlFormatForGLInternalFormat(GLenum internal_format)
     case GL_STENCIL_INDEX16:
         return MTLPixelFormatInvalid;
 
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        return MTLPixelFormatBC1_RGBA;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        return MTLPixelFormatBC2_RGBA;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return MTLPixelFormatBC3_RGBA;
+
     case GL_COMPRESSED_RED_RGTC1:
-        return MTLPixelFormatInvalid;
+        return MTLPixelFormatBC4_RUnorm;
 
     case GL_COMPRESSED_SIGNED_RED_RGTC1:
-        return MTLPixelFormatInvalid;
+        return MTLPixelFormatBC4_RSnorm;
 
     case GL_COMPRESSED_RG_RGTC2:
-        if (__builtin_available(macOS 11.0, *))
-        {
-            return MTLPixelFormatEAC_R11Unorm;
-        }
-        else
-        {
-            return MTLPixelFormatInvalid;
-        }
+        return MTLPixelFormatBC5_RGUnorm;
 
     case GL_COMPRESSED_SIGNED_RG_RGTC2:
-        if (__builtin_available(macOS 11.0, *))
-        {
-            return MTLPixelFormatEAC_R11Snorm;
-        }
-        else
-        {
-            // Fallback on earlier versions
-            return MTLPixelFormatInvalid;
-        }
+        return MTLPixelFormatBC5_RGSnorm;
 
     case GL_R8:
         return MTLPixelFormatR8Unorm;
@@ -2286,7 +2334,7 @@ MTLPixelFormat mtlFormatForGLInternalFormat(GLenum internal_format)
         }
 
     default:
-        return MTLPixelFormatInvalid;
+        return mtlFormatForASTC(internal_format);
     }
 
     return MTLPixelFormatInvalid;
@@ -2460,7 +2508,8 @@ MTLPixelFormat mtlPixelFormatForGLTex(Texture *tex)
 
     assert(tex);
 
-    internal_format = tex->internalformat;
+    // compressed formats the device can't sample are decoded on upload
+    internal_format = tex->decoded_format ? tex->decoded_format : tex->internalformat;
     assert(internal_format);
 
     mtl_format = mtlFormatForGLInternalFormat(internal_format);
@@ -2468,3 +2517,370 @@ MTLPixelFormat mtlPixelFormatForGLTex(Texture *tex)
 
     return mtl_format;
 }
+
+#pragma mark pixel conversion
+PixelLayout pixelLayoutForFormatType(GLenum format, GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        switch (format)
+        {
+        case GL_RED:
+            return PIXEL_LAYOUT_R8;
+        case GL_RG:
+            return PIXEL_LAYOUT_RG8;
+        case GL_RGB:
+            return PIXEL_LAYOUT_RGB8;
+        case GL_BGR:
+            return PIXEL_LAYOUT_BGR8;
+        case GL_RGBA:
+            return PIXEL_LAYOUT_RGBA8;
+        case GL_BGRA:
+            return PIXEL_LAYOUT_BGRA8;
+        }
+        break;
+
+    case GL_UNSIGNED_INT_8_8_8_8:
+        switch (format)
+        {
+        case GL_RGBA:
+            return PIXEL_LAYOUT_ABGR8;
+        case GL_BGRA:
+            return PIXEL_LAYOUT_ARGB8;
+        }
+        break;
+
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+        switch (format)
+        {
+        case GL_RGBA:
+            return PIXEL_LAYOUT_RGBA8;
+        case GL_BGRA:
+            return PIXEL_LAYOUT_BGRA8;
+        }
+        break;
+
+    case GL_UNSIGNED_SHORT_5_6_5:
+        switch (format)
+        {
+        case GL_RGB:
+            return PIXEL_LAYOUT_RGB565;
+        case GL_BGR:
+            return PIXEL_LAYOUT_BGR565;
+        }
+        break;
+
+    case GL_UNSIGNED_SHORT_5_6_5_REV:
+        switch (format)
+        {
+        case GL_RGB:
+            return PIXEL_LAYOUT_BGR565;
+        case GL_BGR:
+            return PIXEL_LAYOUT_RGB565;
+        }
+        break;
+
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+        if (format == GL_RGBA)
+            return PIXEL_LAYOUT_RGBA4444;
+        break;
+
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        if (format == GL_RGBA)
+            return PIXEL_LAYOUT_RGBA5551;
+        break;
+
+    case GL_UNSIGNED_SHORT:
+        switch (format)
+        {
+        case GL_RED:
+        case GL_DEPTH_COMPONENT:
+            return PIXEL_LAYOUT_R16;
+        case GL_RG:
+            return PIXEL_LAYOUT_RG16;
+        case GL_RGB:
+            return PIXEL_LAYOUT_RGB16;
+        case GL_RGBA:
+            return PIXEL_LAYOUT_RGBA16;
+        }
+        break;
+
+    case GL_HALF_FLOAT:
+        switch (format)
+        {
+        case GL_RED:
+            return PIXEL_LAYOUT_R16F;
+        case GL_RG:
+            return PIXEL_LAYOUT_RG16F;
+        case GL_RGB:
+            return PIXEL_LAYOUT_RGB16F;
+        case GL_RGBA:
+            return PIXEL_LAYOUT_RGBA16F;
+        }
+        break;
+
+    case GL_UNSIGNED_INT:
+        if (format == GL_DEPTH_COMPONENT)
+            return PIXEL_LAYOUT_R32;
+        break;
+
+    case GL_FLOAT:
+        switch (format)
+        {
+        case GL_RED:
+        case GL_DEPTH_COMPONENT:
+            return PIXEL_LAYOUT_R32F;
+        case GL_RG:
+            return PIXEL_LAYOUT_RG32F;
+        case GL_RGB:
+            return PIXEL_LAYOUT_RGB32F;
+        case GL_RGBA:
+            return PIXEL_LAYOUT_RGBA32F;
+        }
+        break;
+    }
+
+    return PIXEL_LAYOUT_INVALID;
+}
+
+PixelLayout pixelLayoutForMTLPixelFormat(MTLPixelFormat pixel_format)
+{
+    switch (pixel_format)
+    {
+    case MTLPixelFormatR8Unorm:
+        return PIXEL_LAYOUT_R8;
+
+    case MTLPixelFormatRG8Unorm:
+        return PIXEL_LAYOUT_RG8;
+
+    case MTLPixelFormatRGBA8Unorm:
+    case MTLPixelFormatRGBA8Unorm_sRGB:
+        return PIXEL_LAYOUT_RGBA8;
+
+    case MTLPixelFormatBGRA8Unorm:
+    case MTLPixelFormatBGRA8Unorm_sRGB:
+        return PIXEL_LAYOUT_BGRA8;
+
+    case MTLPixelFormatR16Unorm:
+        return PIXEL_LAYOUT_R16;
+
+    case MTLPixelFormatRG16Unorm:
+        return PIXEL_LAYOUT_RG16;
+
+    case MTLPixelFormatRGBA16Unorm:
+        return PIXEL_LAYOUT_RGBA16;
+
+    case MTLPixelFormatR16Float:
+        return PIXEL_LAYOUT_R16F;
+
+    case MTLPixelFormatRG16Float:
+        return PIXEL_LAYOUT_RG16F;
+
+    case MTLPixelFormatRGBA16Float:
+        return PIXEL_LAYOUT_RGBA16F;
+
+    case MTLPixelFormatR32Float:
+        return PIXEL_LAYOUT_R32F;
+
+    case MTLPixelFormatRG32Float:
+        return PIXEL_LAYOUT_RG32F;
+
+    case MTLPixelFormatRGBA32Float:
+        return PIXEL_LAYOUT_RGBA32F;
+
+    // depth reads back as a single channel
+    case MTLPixelFormatDepth16Unorm:
+        return PIXEL_LAYOUT_R16;
+
+    case MTLPixelFormatDepth32Float:
+        return PIXEL_LAYOUT_R32F;
+
+    default:
+        return PIXEL_LAYOUT_INVALID;
+    }
+}
+
+PixelLayout pixelLayoutForInternalFormat(GLenum internalformat)
+{
+    // what the level data is uploaded to metal as, so it follows the metal format
+    return pixelLayoutForMTLPixelFormat(mtlFormatForGLInternalFormat(internalformat));
+}
+
+bool canPixelConvertToInternalFormat(GLenum internalformat, GLenum format, GLenum type)
+{
+    return canConvertPixels(pixelLayoutForInternalFormat(internalformat), pixelLayoutForFormatType(format, type));
+}
+
+GLenum viewClassForInternalFormat(GLenum internalformat)
+{
+    // astc has a class per block size, the sRGB and linear enums run in the same order
+    if (internalformat >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR && internalformat <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR)
+        return GL_VIEW_CLASS_ASTC_4x4_RGBA + (internalformat - GL_COMPRESSED_RGBA_ASTC_4x4_KHR);
+
+    if (internalformat >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR &&
+        internalformat <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR)
+        return GL_VIEW_CLASS_ASTC_4x4_RGBA + (internalformat - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR);
+
+    switch (internalformat)
+    {
+    case GL_RGBA32F:
+    case GL_RGBA32UI:
+    case GL_RGBA32I:
+        return GL_VIEW_CLASS_128_BITS;
+
+    case GL_RGB32F:
+    case GL_RGB32UI:
+    case GL_RGB32I:
+        return GL_VIEW_CLASS_96_BITS;
+
+    case GL_RGBA16F:
+    case GL_RG32F:
+    case GL_RGBA16UI:
+    case GL_RG32UI:
+    case GL_RGBA16I:
+    case GL_RG32I:
+    case GL_RGBA16:
+    case GL_RGBA16_SNORM:
+        return GL_VIEW_CLASS_64_BITS;
+
+    case GL_RGB16:
+    case GL_RGB16_SNORM:
+    case GL_RGB16F:
+    case GL_RGB16UI:
+    case GL_RGB16I:
+        return GL_VIEW_CLASS_48_BITS;
+
+    case GL_RG16F:
+    case GL_R11F_G11F_B10F:
+    case GL_R32F:
+    case GL_RGB10_A2UI:
+    case GL_RGBA8UI:
+    case GL_RG16UI:
+    case GL_R32UI:
+    case GL_RGBA8I:
+    case GL_RG16I:
+    case GL_R32I:
+    case GL_RGB10_A2:
+    case GL_RGBA8:
+    case GL_RG16:
+    case GL_RGBA8_SNORM:
+    case GL_RG16_SNORM:
+    case GL_SRGB8_ALPHA8:
+    case GL_RGB9_E5:
+        return GL_VIEW_CLASS_32_BITS;
+
+    case GL_RGB8:
+    case GL_RGB8_SNORM:
+    case GL_SRGB8:
+    case GL_RGB8UI:
+    case GL_RGB8I:
+        return GL_VIEW_CLASS_24_BITS;
+
+    case GL_R16F:
+    case GL_RG8UI:
+    case GL_R16UI:
+    case GL_RG8I:
+    case GL_R16I:
+    case GL_RG8:
+    case GL_R16:
+    case GL_RG8_SNORM:
+    case GL_R16_SNORM:
+        return GL_VIEW_CLASS_16_BITS;
+
+    case GL_R8UI:
+    case GL_R8I:
+    case GL_R8:
+    case GL_R8_SNORM:
+        return GL_VIEW_CLASS_8_BITS;
+
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+        return GL_VIEW_CLASS_RGTC1_RED;
+
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+        return GL_VIEW_CLASS_RGTC2_RG;
+
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return GL_VIEW_CLASS_BPTC_UNORM;
+
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+        return GL_VIEW_CLASS_BPTC_FLOAT;
+
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return GL_VIEW_CLASS_S3TC_DXT1_RGB;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        return GL_VIEW_CLASS_S3TC_DXT1_RGBA;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        return GL_VIEW_CLASS_S3TC_DXT3_RGBA;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return GL_VIEW_CLASS_S3TC_DXT5_RGBA;
+
+    case GL_COMPRESSED_R11_EAC:
+    case GL_COMPRESSED_SIGNED_R11_EAC:
+        return GL_VIEW_CLASS_EAC_R11;
+
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
+        return GL_VIEW_CLASS_EAC_RG11;
+
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+        return GL_VIEW_CLASS_ETC2_RGB;
+
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        return GL_VIEW_CLASS_ETC2_RGBA;
+
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        return GL_VIEW_CLASS_ETC2_EAC_RGBA;
+
+    default:
+        return 0;
+    }
+}
+
+bool isViewCompatibleFormat(GLenum internalformat, GLenum view_internalformat)
+{
+    GLenum view_class;
+
+    // depth, stencil and the unsized formats can only be viewed as themselves
+    if (internalformat == view_internalformat)
+        return true;
+
+    view_class = viewClassForInternalFormat(internalformat);
+
+    return (view_class && view_class == viewClassForInternalFormat(view_internalformat));
+}
+
+bool pixelConvertToInternalFormat(GLMContext ctx, GLenum internalformat, GLenum format, GLenum type, const void *src,
+                                  void *dst, size_t len)
+{
+    // len is in pixels
+    return convertPixels(pixelLayoutForInternalFormat(internalformat), dst, pixelLayoutForFormatType(format, type), src,
+                         len);
+}
+
+void getPackLayout(GLMContext ctx, GLenum format, GLenum type, bool is_3d, size_t width, size_t height, size_t depth,
+                   PixelStoreLayout *layout)
+{
+    PixelStoreParams params;
+
+    params.alignment = ctx->state.pack.alignment;
+    params.row_length = ctx->state.pack.row_length;
+    params.image_height = ctx->state.pack.image_height;
+    params.skip_pixels = ctx->state.pack.skip_pixels;
+    params.skip_rows = ctx->state.pack.skip_rows;
+    params.skip_images = ctx->state.pack.skip_images;
+    params.swap_bytes = ctx->state.pack.swap_bytes;
+
+    getPixelStoreLayout(&params, sizeForFormatType(format, type), sizeForType(type), is_3d, width, height, depth,
+                        layout);
+}
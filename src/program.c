@@ -34,11 +34,9 @@ Program *newProgram(GLMContext ctx, GLuint program)
 {
     Program *ptr;
 
-    ptr = (Program *)malloc(sizeof(Program));
+    ptr = (Program *)newPoolObject(&STATE(program_pool));
     assert(ptr);
 
-    bzero(ptr, sizeof(Program));
-
     ptr->name = program;
 
     return ptr;
@@ -134,32 +132,18 @@ void mglDeleteProgram(GLMContext ctx, GLuint program)
         }
     }
 
-    // Clean up attached shaders that are marked for deletion
+    // the attached shaders that were deleted go with it
     for (int i = 0; i < _MAX_SHADER_TYPES; i++)
     {
         Shader *shader = ptr->shader_slots[i];
-        if (shader && shader->delete_pending)
+
+        if (shader)
         {
-            // Clean up the shader resources
-            if (shader->compiled_glsl_shader)
-            {
-                glslang_shader_delete(shader->compiled_glsl_shader);
-            }
-            if (shader->mtl_data.library)
-            {
-                ctx->mtl_funcs.mtlDeleteMTLObj(ctx, shader->mtl_data.function);
-                ctx->mtl_funcs.mtlDeleteMTLObj(ctx, shader->mtl_data.library);
-            }
-            if (shader->log)
-            {
-                free(shader->log);
-            }
-            free((void *)shader->mtl_shader_type_name);
-            free((void *)shader->src);
-            free(shader);
+            shader->attach_count--;
+            releaseShader(ctx, shader);
         }
     }
-    
+
     // Free attribute binding names
     for (GLuint i = 0; i < ptr->num_attrib_bindings; i++)
     {
@@ -169,7 +153,7 @@ void mglDeleteProgram(GLMContext ctx, GLuint program)
         }
     }
 
-    free(ptr);
+    freePoolObject(&STATE(program_pool), ptr);
 }
 
 GLboolean mglIsProgram(GLMContext ctx, GLuint program)
@@ -206,7 +190,21 @@ void mglAttachShader(GLMContext ctx, GLuint program, GLuint shader)
 
     index = sptr->glm_type;
 
+    if (pptr->shader_slots[index] == sptr)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // one shader of a type, the one it replaces is let go
+    if (pptr->shader_slots[index])
+    {
+        pptr->shader_slots[index]->attach_count--;
+        releaseShader(ctx, pptr->shader_slots[index]);
+    }
+
     pptr->shader_slots[index] = sptr;
+    sptr->attach_count++;
     fprintf(stderr, "DEBUG: mglAttachShader setting DIRTY_PROGRAM on program %u\n", pptr->name);
     pptr->dirty_bits |= DIRTY_PROGRAM;
 }
@@ -217,8 +215,8 @@ void mglDetachShader(GLMContext ctx, GLuint program, GLuint shader)
     Shader *sptr;
     GLuint index;
 
-    // Note: findShader won't work if the shader was already deleted
-    // We need to search the program's shader slots instead
+    // a deleted shader is still found by name while attached, the slots are what it's
+    // attached to
     pptr = findProgram(ctx, program);
 
     if (!pptr)
@@ -262,26 +260,9 @@ void mglDetachShader(GLMContext ctx, GLuint program, GLuint shader)
         fprintf(stderr, "DEBUG: mglDetachShader skipping DIRTY_PROGRAM on linked program %u\n", pptr->name);
     }
 
-    // If the shader is marked for deletion, clean it up now
-    if (sptr->delete_pending)
-    {
-        if (sptr->compiled_glsl_shader)
-        {
-            glslang_shader_delete(sptr->compiled_glsl_shader);
-        }
-        if (sptr->mtl_data.library)
-        {
-            ctx->mtl_funcs.mtlDeleteMTLObj(ctx, sptr->mtl_data.function);
-            ctx->mtl_funcs.mtlDeleteMTLObj(ctx, sptr->mtl_data.library);
-        }
-        if (sptr->log)
-        {
-            free(sptr->log);
-        }
-        free((void *)sptr->mtl_shader_type_name);
-        free((void *)sptr->src);
-        free(sptr);
-    }
+    // a deleted shader goes with its last program
+    sptr->attach_count--;
+    releaseShader(ctx, sptr);
 }
 
 void error_callback(void *userdata, const char *error)
@@ -18,15 +18,13 @@
  *
  */
 
-#include <mach/mach_vm.h>
-#include <mach/mach_init.h>
-#include <mach/vm_map.h>
 #include <limits.h>
 
 #include "mgl.h"
 
 #include "pixel_utils.h"
 #include "glm_context.h"
+#include "buffers.h"
 
 void mglClear(GLMContext ctx, GLbitfield mask)
 {
@@ -221,7 +219,7 @@ void mglPixelStorei(GLMContext ctx, GLenum pname, GLint param)
         break;
 
     case GL_PACK_SKIP_PIXELS:
-        ctx->state.pack.skip_rows = param;
+        ctx->state.pack.skip_pixels = param;
         break;
 
     case GL_PACK_SKIP_IMAGES:
@@ -265,7 +263,7 @@ void mglPixelStorei(GLMContext ctx, GLenum pname, GLint param)
         break;
 
     case GL_UNPACK_SKIP_PIXELS:
-        ctx->state.unpack.skip_rows = param;
+        ctx->state.unpack.skip_pixels = param;
         break;
 
     case GL_UNPACK_SKIP_IMAGES:
@@ -301,24 +299,36 @@ void mglReadPixels(GLMContext ctx, GLint x, GLint y, GLsizei width, GLsizei heig
     GLuint pixel_size;
 
     pixel_size = sizeForFormatType(format, type);
-    ERROR_CHECK_RETURN(pixel_size != 0, GL_INVALID_ENUM);
-
-    ERROR_CHECK_RETURN(width > 0, GL_INVALID_ENUM);
-    ERROR_CHECK_RETURN(height > 0, GL_INVALID_ENUM);
+    if (pixel_size == 0 || width <= 0 || height <= 0)
+    {
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
 
     switch (format)
     {
     case GL_STENCIL_INDEX:
-        ERROR_CHECK_RETURN(ctx->stencil_format.mtl_pixel_format > 0, GL_INVALID_OPERATION);
+        if (ctx->stencil_format.mtl_pixel_format == 0)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
         break;
 
     case GL_DEPTH_COMPONENT:
-        ERROR_CHECK_RETURN(ctx->depth_format.mtl_pixel_format > 0, GL_INVALID_OPERATION);
+        if (ctx->depth_format.mtl_pixel_format == 0)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
         break;
 
     case GL_DEPTH_STENCIL:
-        ERROR_CHECK_RETURN((ctx->depth_format.mtl_pixel_format > 0) || (ctx->stencil_format.mtl_pixel_format > 0),
-                           GL_INVALID_OPERATION);
+        if (ctx->depth_format.mtl_pixel_format == 0 && ctx->stencil_format.mtl_pixel_format == 0)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
         switch (type)
         {
         case GL_UNSIGNED_INT_24_8:
@@ -327,7 +337,7 @@ void mglReadPixels(GLMContext ctx, GLint x, GLint y, GLsizei width, GLsizei heig
 
         default:
             ERROR_RETURN(GL_INVALID_ENUM);
-            break;
+            return;
         }
         break;
 
@@ -341,7 +351,11 @@ void mglReadPixels(GLMContext ctx, GLint x, GLint y, GLsizei width, GLsizei heig
     case GL_UNSIGNED_BYTE_2_3_3_REV:
     case GL_UNSIGNED_SHORT_5_6_5:
     case GL_UNSIGNED_SHORT_5_6_5_REV:
-        ERROR_CHECK_RETURN(format == GL_RGB || format == GL_BGR, GL_INVALID_OPERATION);
+        if (format != GL_RGB && format != GL_BGR)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
         break;
 
     case GL_UNSIGNED_SHORT_4_4_4_4:
@@ -352,70 +366,72 @@ void mglReadPixels(GLMContext ctx, GLint x, GLint y, GLsizei width, GLsizei heig
     case GL_UNSIGNED_INT_8_8_8_8_REV:
     case GL_UNSIGNED_INT_10_10_10_2:
     case GL_UNSIGNED_INT_2_10_10_10_REV:
-        ERROR_CHECK_RETURN(format == GL_RGBA || format == GL_BGRA, GL_INVALID_OPERATION);
+        if (format != GL_RGBA && format != GL_BGRA)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
         break;
     }
 
+    PixelStoreLayout layout;
+    PixelLayout pixel_layout;
+
+    getPackLayout(ctx, format, type, false, width, height, 1, &layout);
+
+    // the read buffer's texels are converted to this on the way out
+    pixel_layout = pixelLayoutForFormatType(format, type);
+    if (pixel_layout == PIXEL_LAYOUT_INVALID)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
     if (STATE(buffers[_PIXEL_PACK_BUFFER]))
     {
         Buffer *ptr;
+        size_t offset;
 
         ptr = STATE(buffers[_PIXEL_PACK_BUFFER]);
 
-        ERROR_CHECK_RETURN(ptr->mapped == false, GL_INVALID_OPERATION);
-
-        size_t size_req;
-
-        size_req = pixel_size * (width - x) * (height - y);
-
-        ERROR_CHECK_RETURN(ptr->size >= size_req, GL_INVALID_OPERATION);
+        // pixels is an offset into the pack buffer
+        offset = (size_t)pixels;
 
         // GL_INVALID_OPERATION is generated if a non-zero buffer object name is bound to the GL_PIXEL_PACK_BUFFER
         // target and data is not evenly divisible into the number of bytes needed to store in memory a datum indicated
         // by type.
-
-        uint64_t alignment_test;
-        uint32_t alignment;
-
-        alignment_test = (uint64_t)pixels;
-        alignment_test = ~alignment_test;
-
-        alignment = 0;
-        // count number of lower zero bits for alignment
-        while ((alignment_test & 0x1) == 0)
+        if (ptr->mapped || offset + layout.size > ptr->size || (offset % sizeForType(type)) != 0)
         {
-            alignment++;
-            alignment_test >>= 1;
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
         }
 
-        ERROR_CHECK_RETURN(alignment >= pixel_size, GL_INVALID_OPERATION);
-    }
+        // a copy queued behind the draws, mapping the buffer waits for it
+        if (layout.swap_size == 0 && format != GL_DEPTH_COMPONENT &&
+            ctx->mtl_funcs.mtlReadPixelsToBuffer(ctx, ptr, offset + layout.offset, (GLuint)layout.row_pitch, x, y,
+                                                 width, height, format, type))
+            return;
 
-    GLuint pitch;
-    if (STATE(pack.row_length))
-    {
-        pitch = STATE(pack.row_length) * pixel_size;
-    }
-    else
-    {
-        pitch = (width - x) * pixel_size;
-    }
+        // the blit can't convert, read it now and pack it into the cpu side
+        if (ptr->data.mtl_data || ptr->data.slab)
+        {
+            ctx->mtl_funcs.mtlRenameBuffer(ctx, ptr, true);
+        }
 
-    kern_return_t err;
-    vm_address_t buffer_data;
-    size_t buffer_size;
+        if (!ctx->mtl_funcs.mtlReadPixels(ctx, (char *)ptr->data.buffer_data + offset, &layout, pixel_layout, x, y,
+                                          width, height, format == GL_DEPTH_COMPONENT))
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
 
-    buffer_size = pitch * (height - y);
+        setBufferDataDirty(ptr, offset + layout.offset, layout.size - layout.offset);
+        ctx->state.dirty_bits |= DIRTY_BUFFER;
 
-    err = vm_allocate((vm_map_t)mach_task_self(), (vm_address_t *)&buffer_data, buffer_size, VM_FLAGS_ANYWHERE);
-    if (err)
-    {
-        ERROR_RETURN(GL_OUT_OF_MEMORY);
+        return;
     }
 
-    ctx->mtl_funcs.mtlReadDrawable(ctx, (void *)buffer_data, pitch, (GLuint)buffer_size, x, y, width, height);
-
-    memcpy(pixels, (void *)buffer_data, buffer_size);
-
-    vm_deallocate(mach_host_self(), buffer_data, buffer_size);
+    ERROR_CHECK_RETURN(ctx->mtl_funcs.mtlReadPixels(ctx, pixels, &layout, pixel_layout, x, y, width, height,
+                                                    format == GL_DEPTH_COMPONENT),
+                       GL_INVALID_OPERATION);
 }
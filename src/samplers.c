@@ -35,11 +35,9 @@ Sampler *newSampler(GLMContext ctx, GLuint sampler)
 {
     Sampler *ptr;
 
-    ptr = (Sampler *)malloc(sizeof(Sampler));
+    ptr = (Sampler *)newPoolObject(&STATE(sampler_pool));
     assert(ptr);
 
-    bzero(ptr, sizeof(Sampler));
-
     ptr->name = sampler;
 
     float black_color[] = {0, 0, 0, 0};
@@ -180,7 +178,7 @@ void mglDeleteSamplers(GLMContext ctx, GLsizei count, const GLuint *samplers)
                 ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->mtl_data);
             }
 
-            free(ptr);
+            freePoolObject(&STATE(sampler_pool), ptr);
         }
     }
 }
@@ -109,11 +109,9 @@ Shader *newShader(GLMContext ctx, GLenum type, GLuint shader)
     Shader *ptr;
     char shader_type_name[128];
 
-    ptr = (Shader *)malloc(sizeof(Shader));
+    ptr = (Shader *)newPoolObject(&STATE(shader_pool));
     assert(ptr);
 
-    bzero(ptr, sizeof(Shader));
-
     ptr->name = shader;
     ptr->type = type;
     ptr->glm_type = glShaderTypeToGLMType(type);
@@ -186,6 +184,37 @@ GLuint mglCreateShader(GLMContext ctx, GLenum type)
     return shader;
 }
 
+// a shader deleted while attached keeps its name, and stays findable, until the last
+// program lets go of it. only then does the name go back to be reused
+void releaseShader(GLMContext ctx, Shader *ptr)
+{
+    if (ptr->delete_pending == 0 || ptr->attach_count)
+        return;
+
+    deleteHashElement(&STATE(shader_table), ptr->name);
+
+    if (ptr->compiled_glsl_shader)
+    {
+        glslang_shader_delete(ptr->compiled_glsl_shader);
+    }
+
+    if (ptr->mtl_data.library)
+    {
+        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->mtl_data.function);
+        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->mtl_data.library);
+    }
+
+    if (ptr->log)
+    {
+        free(ptr->log);
+    }
+
+    free((void *)ptr->mtl_shader_type_name);
+    free((void *)ptr->src);
+
+    freePoolObject(&STATE(shader_pool), ptr);
+}
+
 void mglDeleteShader(GLMContext ctx, GLuint shader)
 {
     Shader *ptr;
@@ -198,27 +227,7 @@ void mglDeleteShader(GLMContext ctx, GLuint shader)
     // This matches OpenGL spec behavior
     ptr->delete_pending = 1;
 
-    // Only actually delete if not attached to any program
-    // For now, we'll defer deletion - the program will handle cleanup
-    // TODO: Implement proper reference counting
-
-    // Remove from hash table so it can't be found by name anymore
-    deleteHashElement(&STATE(shader_table), shader);
-
-    // Don't delete these yet - will be cleaned up when detached from all programs
-    // if (ptr->compiled_glsl_shader)
-    // {
-    //     glslang_shader_delete(ptr->compiled_glsl_shader);
-    // }
-    //
-    // if (ptr->mtl_data.library)
-    // {
-    //     ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->mtl_data.function);
-    //     ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->mtl_data.library);
-    // }
-    //
-    // free((void *)ptr->mtl_shader_type_name);
-    // free((void *)ptr->src);
+    releaseShader(ctx, ptr);
 }
 
 GLboolean mglIsShader(GLMContext ctx, GLuint shader)
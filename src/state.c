@@ -202,6 +202,8 @@ void mglHint(GLMContext ctx, GLenum target, GLenum mode)
         HINT(texture_compression_hint);
     case GL_FRAGMENT_SHADER_DERIVATIVE_HINT:
         HINT(fragment_shader_derivative_hint);
+    case GL_GENERATE_MIPMAP_HINT:
+        HINT(generate_mipmap_hint);
         break;
 
     default:
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * sub_allocator.c
+ * MGL
+ *
+ */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <assert.h>
+
+#include "sub_allocator.h"
+
+static inline unsigned sizeClass(size_t size)
+{
+    unsigned index;
+
+    index = 0;
+    while (((size_t)SUB_ALLOC_MIN_SIZE << index) < size)
+        index++;
+
+    return index;
+}
+
+static inline size_t slotSize(unsigned size_class)
+{
+    return (size_t)SUB_ALLOC_MIN_SIZE << size_class;
+}
+
+void initSubAllocator(SubAllocator *alloc, void *(*new_backing)(void *arg, size_t size, void **contents),
+                      void (*free_backing)(void *arg, void *backing), void *arg)
+{
+    bzero(alloc, sizeof(SubAllocator));
+
+    alloc->new_backing = new_backing;
+    alloc->free_backing = free_backing;
+    alloc->arg = arg;
+}
+
+static void freeSlab(SubAllocator *alloc, SubAllocSlab *slab)
+{
+    alloc->free_backing(alloc->arg, slab->backing);
+
+    alloc->stats.slabs--;
+    alloc->stats.bytes -= SUB_ALLOC_SLAB_SIZE;
+
+    free(slab->free_mask);
+    free(slab);
+}
+
+void freeSubAllocator(SubAllocator *alloc)
+{
+    for (unsigned i = 0; i < SUB_ALLOC_NUM_CLASSES; i++)
+    {
+        SubAllocSlab *slab;
+
+        slab = alloc->slabs[i];
+        while (slab)
+        {
+            SubAllocSlab *next;
+
+            next = slab->next;
+            freeSlab(alloc, slab);
+            slab = next;
+        }
+    }
+
+    free(alloc->pending);
+
+    bzero(alloc, sizeof(SubAllocator));
+}
+
+static SubAllocSlab *newSlab(SubAllocator *alloc, unsigned size_class)
+{
+    SubAllocSlab *slab;
+    void *contents;
+    unsigned words;
+
+    slab = (SubAllocSlab *)calloc(1, sizeof(SubAllocSlab));
+    if (slab == NULL)
+        return NULL;
+
+    slab->backing = alloc->new_backing(alloc->arg, SUB_ALLOC_SLAB_SIZE, &contents);
+    if (slab->backing == NULL)
+    {
+        free(slab);
+        return NULL;
+    }
+
+    slab->contents = (char *)contents;
+    slab->size_class = size_class;
+    slab->num_slots = (unsigned)(SUB_ALLOC_SLAB_SIZE / slotSize(size_class));
+
+    words = (slab->num_slots + 63) / 64;
+
+    slab->free_mask = (uint64_t *)malloc(words * sizeof(uint64_t));
+    assert(slab->free_mask);
+
+    for (unsigned i = 0; i < words; i++)
+    {
+        unsigned bits;
+
+        bits = slab->num_slots - i * 64;
+        slab->free_mask[i] = (bits >= 64) ? ~0ull : ((1ull << bits) - 1);
+    }
+
+    slab->next = alloc->slabs[size_class];
+    alloc->slabs[size_class] = slab;
+
+    alloc->stats.slabs++;
+    alloc->stats.bytes += SUB_ALLOC_SLAB_SIZE;
+
+    return slab;
+}
+
+SubAllocSlab *newSubAllocation(SubAllocator *alloc, size_t size, size_t *offset)
+{
+    SubAllocSlab *slab;
+    unsigned size_class;
+
+    if (size > SUB_ALLOC_MAX_SIZE)
+        return NULL;
+
+    size_class = sizeClass(size);
+
+    for (slab = alloc->slabs[size_class]; slab; slab = slab->next)
+    {
+        if (slab->used < slab->num_slots)
+            break;
+    }
+
+    if (slab == NULL)
+    {
+        slab = newSlab(alloc, size_class);
+        if (slab == NULL)
+            return NULL;
+    }
+
+    for (unsigned word = 0;; word++)
+    {
+        assert(word * 64 < slab->num_slots);
+
+        if (slab->free_mask[word])
+        {
+            unsigned index;
+
+            index = __builtin_ctzll(slab->free_mask[word]);
+            slab->free_mask[word] &= ~(1ull << index);
+
+            *offset = (word * 64 + index) * slotSize(size_class);
+            break;
+        }
+    }
+
+    slab->used++;
+
+    alloc->stats.live++;
+    alloc->stats.live_bytes += slotSize(size_class);
+    alloc->stats.allocs++;
+
+    return slab;
+}
+
+static void releaseSlot(SubAllocator *alloc, SubAllocSlab *slab, size_t offset)
+{
+    unsigned index;
+
+    index = (unsigned)(offset / slotSize(slab->size_class));
+
+    assert(index < slab->num_slots);
+    assert((slab->free_mask[index >> 6] & (1ull << (index & 63))) == 0);
+
+    slab->free_mask[index >> 6] |= 1ull << (index & 63);
+    slab->used--;
+
+    // keep one slab per class around, give the rest back when they empty out
+    if (slab->used == 0 && (alloc->slabs[slab->size_class] != slab || slab->next))
+    {
+        SubAllocSlab **link;
+
+        for (link = &alloc->slabs[slab->size_class]; *link != slab; link = &(*link)->next)
+            ;
+
+        *link = slab->next;
+
+        freeSlab(alloc, slab);
+    }
+}
+
+void freeSubAllocation(SubAllocator *alloc, SubAllocSlab *slab, size_t offset, uint64_t serial, uint64_t completed)
+{
+    assert(slab);
+    assert(alloc->stats.live);
+
+    alloc->stats.live--;
+    alloc->stats.live_bytes -= slotSize(slab->size_class);
+    alloc->stats.frees++;
+
+    if (serial <= completed)
+    {
+        releaseSlot(alloc, slab, offset);
+
+        return;
+    }
+
+    if (alloc->pending_count == alloc->pending_size)
+    {
+        alloc->pending_size = alloc->pending_size ? alloc->pending_size * 2 : 64;
+        alloc->pending =
+            (SubAllocPending *)realloc(alloc->pending, alloc->pending_size * sizeof(SubAllocPending));
+        assert(alloc->pending);
+    }
+
+    alloc->pending[alloc->pending_count].slab = slab;
+    alloc->pending[alloc->pending_count].offset = offset;
+    alloc->pending[alloc->pending_count].serial = serial;
+    alloc->pending_count++;
+
+    alloc->stats.pending++;
+}
+
+void reclaimSubAllocations(SubAllocator *alloc, uint64_t completed)
+{
+    size_t kept;
+
+    kept = 0;
+
+    for (size_t i = 0; i < alloc->pending_count; i++)
+    {
+        SubAllocPending *pending;
+
+        pending = &alloc->pending[i];
+
+        if (pending->serial <= completed)
+        {
+            releaseSlot(alloc, pending->slab, pending->offset);
+
+            alloc->stats.pending--;
+        }
+        else
+        {
+            alloc->pending[kept++] = *pending;
+        }
+    }
+
+    alloc->pending_count = kept;
+}
+
+size_t getSubAllocationSize(SubAllocSlab *slab)
+{
+    return slotSize(slab->size_class);
+}
+
+void getSubAllocatorStats(SubAllocator *alloc, SubAllocatorStats *stats)
+{
+    *stats = alloc->stats;
+}
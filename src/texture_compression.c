@@ -0,0 +1,934 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * texture_compression.c
+ * MGL
+ *
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "texture_compression.h"
+
+// below this many blocks the threads cost more than they save
+#define DECODE_THREAD_BLOCKS 4096
+#define DECODE_MAX_THREADS 8
+
+#pragma mark formats
+
+static void setCompressedFormat(CompressedFormat *format, CompressedBlocks blocks, GLuint block_width,
+                                GLuint block_height, GLuint block_size, bool srgb, GLenum decoded_format,
+                                GLuint decoded_size)
+{
+    format->blocks = blocks;
+    format->block_width = block_width;
+    format->block_height = block_height;
+    format->block_size = block_size;
+    format->srgb = srgb;
+    format->decoded_format = decoded_format;
+    format->decoded_size = decoded_size;
+}
+
+static bool getASTCFormat(GLenum internalformat, CompressedFormat *format)
+{
+    static const GLuint astc_sizes[14][2] = {{4, 4},  {5, 4},  {5, 5},  {6, 5},   {6, 6},   {8, 5},   {8, 6},
+                                             {8, 8},  {10, 5}, {10, 6}, {10, 8},  {10, 10}, {12, 10}, {12, 12}};
+    GLuint index;
+    bool srgb;
+
+    if (internalformat >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR && internalformat <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR)
+    {
+        index = internalformat - GL_COMPRESSED_RGBA_ASTC_4x4_KHR;
+        srgb = false;
+    }
+    else if (internalformat >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR &&
+             internalformat <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR)
+    {
+        index = internalformat - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR;
+        srgb = true;
+    }
+    else
+    {
+        return false;
+    }
+
+    setCompressedFormat(format, COMPRESSED_BLOCKS_ASTC, astc_sizes[index][0], astc_sizes[index][1], 16, srgb, 0, 0);
+
+    return true;
+}
+
+bool getCompressedFormat(GLenum internalformat, CompressedFormat *format)
+{
+    switch (internalformat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC1_RGB, 4, 4, 8, false, GL_RGBA8, 4);
+        return true;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC1, 4, 4, 8, false, GL_RGBA8, 4);
+        return true;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC2, 4, 4, 16, false, GL_RGBA8, 4);
+        return true;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC3, 4, 4, 16, false, GL_RGBA8, 4);
+        return true;
+
+    case GL_COMPRESSED_RED_RGTC1:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC4, 4, 4, 8, false, GL_R8, 1);
+        return true;
+
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC4_SNORM, 4, 4, 8, false, GL_R8_SNORM, 1);
+        return true;
+
+    case GL_COMPRESSED_RG_RGTC2:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC5, 4, 4, 16, false, GL_RG8, 2);
+        return true;
+
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC5_SNORM, 4, 4, 16, false, GL_RG8_SNORM, 2);
+        return true;
+
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC6H, 4, 4, 16, false, 0, 0);
+        return true;
+
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC7, 4, 4, 16, false, 0, 0);
+        return true;
+
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_BC7, 4, 4, 16, true, 0, 0);
+        return true;
+
+    case GL_COMPRESSED_RGB8_ETC2:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_ETC2_RGB8, 4, 4, 8, false, GL_RGBA8, 4);
+        return true;
+
+    case GL_COMPRESSED_SRGB8_ETC2:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_ETC2_RGB8, 4, 4, 8, true, GL_SRGB8_ALPHA8, 4);
+        return true;
+
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_ETC2_RGB8A1, 4, 4, 8, false, GL_RGBA8, 4);
+        return true;
+
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_ETC2_RGB8A1, 4, 4, 8, true, GL_SRGB8_ALPHA8, 4);
+        return true;
+
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_ETC2_RGBA8, 4, 4, 16, false, GL_RGBA8, 4);
+        return true;
+
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_ETC2_RGBA8, 4, 4, 16, true, GL_SRGB8_ALPHA8, 4);
+        return true;
+
+    case GL_COMPRESSED_R11_EAC:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_EAC_R11, 4, 4, 8, false, GL_R16, 2);
+        return true;
+
+    case GL_COMPRESSED_SIGNED_R11_EAC:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_EAC_R11_SNORM, 4, 4, 8, false, GL_R16_SNORM, 2);
+        return true;
+
+    case GL_COMPRESSED_RG11_EAC:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_EAC_RG11, 4, 4, 16, false, GL_RG16, 4);
+        return true;
+
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
+        setCompressedFormat(format, COMPRESSED_BLOCKS_EAC_RG11_SNORM, 4, 4, 16, false, GL_RG16_SNORM, 4);
+        return true;
+
+    default:
+        return getASTCFormat(internalformat, format);
+    }
+}
+
+size_t getCompressedRowSize(const CompressedFormat *format, size_t width)
+{
+    return ((width + format->block_width - 1) / format->block_width) * format->block_size;
+}
+
+size_t getCompressedImageSize(const CompressedFormat *format, size_t width, size_t height, size_t depth)
+{
+    size_t block_rows;
+
+    block_rows = (height + format->block_height - 1) / format->block_height;
+
+    return getCompressedRowSize(format, width) * block_rows * depth;
+}
+
+#pragma mark s3tc / rgtc
+
+static inline int clampInt(int v, int lo, int hi)
+{
+    return (v < lo) ? lo : ((v > hi) ? hi : v);
+}
+
+// nearest, halves away from zero so signed palettes stay symmetric
+static inline int roundDiv(int v, int d)
+{
+    return (v >= 0) ? (v + d / 2) / d : -((-v + d / 2) / d);
+}
+
+static void expand565(uint16_t c, int rgb[3])
+{
+    int r, g, b;
+
+    r = (c >> 11) & 0x1f;
+    g = (c >> 5) & 0x3f;
+    b = c & 0x1f;
+
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+typedef enum
+{
+    COLOR_BLOCK_BC1,       // c0 <= c1 is 3 colors and clear black
+    COLOR_BLOCK_BC1_RGB,   // c0 <= c1 is 3 colors and opaque black
+    COLOR_BLOCK_FOUR_COLOR // bc2 / bc3 color is always 4 colors
+} ColorBlockMode;
+
+// 16 rgba8 texels, alpha is written too
+static void decodeColorBlock(const uint8_t *b, uint8_t *texels, ColorBlockMode mode)
+{
+    uint8_t palette[4][4];
+    int c0[3], c1[3];
+    uint16_t e0, e1;
+    uint32_t indices;
+
+    e0 = (uint16_t)(b[0] | (b[1] << 8));
+    e1 = (uint16_t)(b[2] | (b[3] << 8));
+    indices = (uint32_t)b[4] | ((uint32_t)b[5] << 8) | ((uint32_t)b[6] << 16) | ((uint32_t)b[7] << 24);
+
+    expand565(e0, c0);
+    expand565(e1, c1);
+
+    for (int c = 0; c < 3; c++)
+    {
+        palette[0][c] = (uint8_t)c0[c];
+        palette[1][c] = (uint8_t)c1[c];
+
+        if (e0 > e1 || mode == COLOR_BLOCK_FOUR_COLOR)
+        {
+            palette[2][c] = (uint8_t)((2 * c0[c] + c1[c] + 1) / 3);
+            palette[3][c] = (uint8_t)((c0[c] + 2 * c1[c] + 1) / 3);
+        }
+        else
+        {
+            palette[2][c] = (uint8_t)((c0[c] + c1[c] + 1) / 2);
+            palette[3][c] = 0;
+        }
+    }
+
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = (e0 <= e1 && mode == COLOR_BLOCK_BC1) ? 0 : 255;
+
+    for (int i = 0; i < 16; i++)
+        memcpy(texels + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+}
+
+static uint64_t readBitsLE48(const uint8_t *b)
+{
+    uint64_t bits;
+
+    bits = 0;
+
+    for (int i = 0; i < 6; i++)
+        bits |= (uint64_t)b[i] << (8 * i);
+
+    return bits;
+}
+
+// bc4 / bc3 alpha, one channel of 16 texels stride bytes apart
+static void decodeRedBlock(const uint8_t *b, uint8_t *out, size_t stride)
+{
+    int palette[8], r0, r1;
+    uint64_t indices;
+
+    r0 = b[0];
+    r1 = b[1];
+
+    palette[0] = r0;
+    palette[1] = r1;
+
+    if (r0 > r1)
+    {
+        for (int k = 1; k < 7; k++)
+            palette[k + 1] = roundDiv((7 - k) * r0 + k * r1, 7);
+    }
+    else
+    {
+        for (int k = 1; k < 5; k++)
+            palette[k + 1] = roundDiv((5 - k) * r0 + k * r1, 5);
+
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    indices = readBitsLE48(b + 2);
+
+    for (int i = 0; i < 16; i++)
+        out[i * stride] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+// signed bc4, -128 is the same as -127
+static void decodeSignedRedBlock(const uint8_t *b, uint8_t *out, size_t stride)
+{
+    int palette[8], r0, r1;
+    uint64_t indices;
+
+    r0 = clampInt((int8_t)b[0], -127, 127);
+    r1 = clampInt((int8_t)b[1], -127, 127);
+
+    palette[0] = r0;
+    palette[1] = r1;
+
+    if (r0 > r1)
+    {
+        for (int k = 1; k < 7; k++)
+            palette[k + 1] = roundDiv((7 - k) * r0 + k * r1, 7);
+    }
+    else
+    {
+        for (int k = 1; k < 5; k++)
+            palette[k + 1] = roundDiv((5 - k) * r0 + k * r1, 5);
+
+        palette[6] = -127;
+        palette[7] = 127;
+    }
+
+    indices = readBitsLE48(b + 2);
+
+    for (int i = 0; i < 16; i++)
+        out[i * stride] = (uint8_t)(int8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+static void decodeBC2Alpha(const uint8_t *b, uint8_t *texels)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        int a;
+
+        a = (b[i / 2] >> (4 * (i & 1))) & 0xf;
+
+        texels[i * 4 + 3] = (uint8_t)(a * 17);
+    }
+}
+
+#pragma mark etc2 / eac
+
+static const int etc_modifiers[8][2] = {{2, 8},   {5, 17},  {9, 29},  {13, 42},
+                                        {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+static const int etc_distances[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+static const int eac_modifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12}, {-2, -5, -8, -13, 1, 4, 7, 12},
+    {-2, -4, -6, -13, 1, 3, 5, 12}, {-3, -6, -8, -12, 2, 5, 7, 11},  {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},  {-2, -6, -8, -10, 1, 5, 7, 9},
+    {-2, -5, -8, -10, 1, 4, 7, 9},  {-2, -4, -8, -10, 1, 3, 7, 9},   {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},   {-4, -6, -8, -9, 3, 5, 7, 8},
+    {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+// etc blocks are big endian and number their texels down the columns
+static uint64_t readBitsBE64(const uint8_t *b)
+{
+    uint64_t bits;
+
+    bits = 0;
+
+    for (int i = 0; i < 8; i++)
+        bits = (bits << 8) | b[i];
+
+    return bits;
+}
+
+static inline int getBits(uint64_t v, int hi, int lo)
+{
+    return (int)((v >> lo) & ((1ull << (hi - lo + 1)) - 1));
+}
+
+static inline int getTexelIndex(uint64_t v, int x, int y)
+{
+    int k;
+
+    k = x * 4 + y;
+
+    return (int)((((v >> (k + 16)) & 1) << 1) | ((v >> k) & 1));
+}
+
+static inline int extend4(int v)
+{
+    return v * 17;
+}
+
+static inline int extend5(int v)
+{
+    return (v << 3) | (v >> 2);
+}
+
+static inline int extend6(int v)
+{
+    return (v << 2) | (v >> 4);
+}
+
+static inline int extend7(int v)
+{
+    return (v << 1) | (v >> 6);
+}
+
+static void setPaletteColor(uint8_t *color, int r, int g, int b, int a)
+{
+    color[0] = (uint8_t)clampInt(r, 0, 255);
+    color[1] = (uint8_t)clampInt(g, 0, 255);
+    color[2] = (uint8_t)clampInt(b, 0, 255);
+    color[3] = (uint8_t)a;
+}
+
+// every texel is one of 4 colors of its half of the block, the halves are side
+// by side or with flip one above the other
+static void pickTexels(uint64_t v, const uint8_t palette[2][4][4], bool flip, uint8_t *texels)
+{
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            int sub;
+
+            sub = flip ? (y >= 2) : (x >= 2);
+
+            memcpy(texels + (y * 4 + x) * 4, palette[sub][getTexelIndex(v, x, y)], 4);
+        }
+    }
+}
+
+// t and h modes pick one of 4 paint colors per texel, with punchthrough index 2 is clear
+static void decodePaintColors(uint64_t v, int paint[4][3], bool punchthrough, uint8_t *texels)
+{
+    uint8_t palette[2][4][4];
+
+    for (int i = 0; i < 4; i++)
+        setPaletteColor(palette[0][i], paint[i][0], paint[i][1], paint[i][2], 255);
+
+    if (punchthrough)
+        memset(palette[0][2], 0, 4);
+
+    memcpy(palette[1], palette[0], sizeof(palette[0]));
+
+    pickTexels(v, palette, false, texels);
+}
+
+static void decodeETC2TMode(uint64_t v, bool punchthrough, uint8_t *texels)
+{
+    int c1[3], c2[3], paint[4][3], d;
+
+    c1[0] = extend4((getBits(v, 60, 59) << 2) | getBits(v, 57, 56));
+    c1[1] = extend4(getBits(v, 55, 52));
+    c1[2] = extend4(getBits(v, 51, 48));
+    c2[0] = extend4(getBits(v, 47, 44));
+    c2[1] = extend4(getBits(v, 43, 40));
+    c2[2] = extend4(getBits(v, 39, 36));
+
+    d = etc_distances[(getBits(v, 35, 34) << 1) | getBits(v, 32, 32)];
+
+    for (int c = 0; c < 3; c++)
+    {
+        paint[0][c] = c1[c];
+        paint[1][c] = clampInt(c2[c] + d, 0, 255);
+        paint[2][c] = c2[c];
+        paint[3][c] = clampInt(c2[c] - d, 0, 255);
+    }
+
+    decodePaintColors(v, paint, punchthrough, texels);
+}
+
+static void decodeETC2HMode(uint64_t v, bool punchthrough, uint8_t *texels)
+{
+    int r1, g1, b1, r2, g2, b2;
+    int c1[3], c2[3], paint[4][3], d, index;
+
+    r1 = getBits(v, 62, 59);
+    g1 = (getBits(v, 58, 56) << 1) | getBits(v, 52, 52);
+    b1 = (getBits(v, 51, 51) << 3) | getBits(v, 49, 47);
+    r2 = getBits(v, 46, 43);
+    g2 = getBits(v, 42, 39);
+    b2 = getBits(v, 38, 35);
+
+    // the order of the two base colors is the low bit of the distance
+    index = (getBits(v, 34, 34) << 2) | (getBits(v, 32, 32) << 1);
+    if (((r1 << 8) | (g1 << 4) | b1) >= ((r2 << 8) | (g2 << 4) | b2))
+        index |= 1;
+
+    d = etc_distances[index];
+
+    c1[0] = extend4(r1);
+    c1[1] = extend4(g1);
+    c1[2] = extend4(b1);
+    c2[0] = extend4(r2);
+    c2[1] = extend4(g2);
+    c2[2] = extend4(b2);
+
+    for (int c = 0; c < 3; c++)
+    {
+        paint[0][c] = clampInt(c1[c] + d, 0, 255);
+        paint[1][c] = clampInt(c1[c] - d, 0, 255);
+        paint[2][c] = clampInt(c2[c] + d, 0, 255);
+        paint[3][c] = clampInt(c2[c] - d, 0, 255);
+    }
+
+    decodePaintColors(v, paint, punchthrough, texels);
+}
+
+static void decodeETC2Planar(uint64_t v, uint8_t *texels)
+{
+    int o[3], h[3], vv[3];
+
+    o[0] = extend6(getBits(v, 62, 57));
+    o[1] = extend7((getBits(v, 56, 56) << 6) | getBits(v, 54, 49));
+    o[2] = extend6((getBits(v, 48, 48) << 5) | (getBits(v, 44, 43) << 3) | getBits(v, 41, 39));
+    h[0] = extend6((getBits(v, 38, 34) << 1) | getBits(v, 32, 32));
+    h[1] = extend7(getBits(v, 31, 25));
+    h[2] = extend6(getBits(v, 24, 19));
+    vv[0] = extend6(getBits(v, 18, 13));
+    vv[1] = extend7(getBits(v, 12, 6));
+    vv[2] = extend6(getBits(v, 5, 0));
+
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            int rgb[3];
+
+            for (int c = 0; c < 3; c++)
+                rgb[c] = (x * (h[c] - o[c]) + y * (vv[c] - o[c]) + 4 * o[c] + 2) >> 2;
+
+            setPaletteColor(texels + (y * 4 + x) * 4, rgb[0], rgb[1], rgb[2], 255);
+        }
+    }
+}
+
+// etc1 individual / differential blocks and the etc2 modes hiding in differential
+// overflows. for punchthrough bit 33 is the opaque bit and the mode is always
+// differential.
+static void decodeETC2Block(const uint8_t *b, bool punchthrough, uint8_t *texels)
+{
+    uint8_t palette[2][4][4];
+    int base[2][3], table[2];
+    bool diff, flip, opaque;
+    uint64_t v;
+
+    v = readBitsBE64(b);
+
+    diff = punchthrough || getBits(v, 33, 33);
+    opaque = punchthrough == false || getBits(v, 33, 33);
+    flip = getBits(v, 32, 32);
+
+    if (diff)
+    {
+        int c1[3], c2[3];
+
+        for (int c = 0; c < 3; c++)
+        {
+            int delta;
+
+            c1[c] = getBits(v, 63 - c * 8, 59 - c * 8);
+
+            // 3 bit two's complement
+            delta = getBits(v, 58 - c * 8, 56 - c * 8);
+            delta = (delta >= 4) ? delta - 8 : delta;
+
+            c2[c] = c1[c] + delta;
+        }
+
+        if (c2[0] < 0 || c2[0] > 31)
+        {
+            decodeETC2TMode(v, opaque == false, texels);
+            return;
+        }
+
+        if (c2[1] < 0 || c2[1] > 31)
+        {
+            decodeETC2HMode(v, opaque == false, texels);
+            return;
+        }
+
+        if (c2[2] < 0 || c2[2] > 31)
+        {
+            decodeETC2Planar(v, texels);
+            return;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            base[0][c] = extend5(c1[c]);
+            base[1][c] = extend5(c2[c]);
+        }
+    }
+    else
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            base[0][c] = extend4(getBits(v, 63 - c * 8, 60 - c * 8));
+            base[1][c] = extend4(getBits(v, 59 - c * 8, 56 - c * 8));
+        }
+    }
+
+    table[0] = getBits(v, 39, 37);
+    table[1] = getBits(v, 36, 34);
+
+    for (int sub = 0; sub < 2; sub++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            int m;
+
+            m = (i & 2) ? -etc_modifiers[table[sub]][i & 1] : etc_modifiers[table[sub]][i & 1];
+
+            // without the opaque bit index 0 has no modifier and index 2 is clear
+            if (opaque == false && i == 0)
+                m = 0;
+
+            setPaletteColor(palette[sub][i], base[sub][0] + m, base[sub][1] + m, base[sub][2] + m, 255);
+        }
+
+        if (opaque == false)
+            memset(palette[sub][2], 0, 4);
+    }
+
+    pickTexels(v, palette, flip, texels);
+}
+
+// eac alpha of an etc2 rgba8 block, 8 bit
+static void decodeEACAlpha(const uint8_t *b, uint8_t *texels)
+{
+    int base, multiplier, table;
+    uint64_t v;
+
+    v = readBitsBE64(b);
+
+    base = getBits(v, 63, 56);
+    multiplier = getBits(v, 55, 52);
+    table = getBits(v, 51, 48);
+
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            int i;
+
+            i = (int)((v >> (45 - 3 * (x * 4 + y))) & 7);
+
+            texels[(y * 4 + x) * 4 + 3] = (uint8_t)clampInt(base + eac_modifiers[table][i] * multiplier, 0, 255);
+        }
+    }
+}
+
+// r11 / rg11, 11 bits widened to 16 bit unorm or snorm, stride in 16 bit channels
+static void decodeEACR11(const uint8_t *b, bool is_signed, uint16_t *out, size_t stride)
+{
+    int base, multiplier, table;
+    uint64_t v;
+
+    v = readBitsBE64(b);
+
+    base = getBits(v, 63, 56);
+    multiplier = getBits(v, 55, 52);
+    table = getBits(v, 51, 48);
+
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            int i, m, value;
+
+            i = (int)((v >> (45 - 3 * (x * 4 + y))) & 7);
+
+            // a 0 multiplier still takes the modifier once, at 11 bit precision
+            m = eac_modifiers[table][i];
+            m = multiplier ? m * multiplier * 8 : m;
+
+            if (is_signed)
+            {
+                int s;
+
+                s = clampInt((int8_t)base, -127, 127);
+                value = clampInt(s * 8 + m, -1023, 1023);
+
+                if (value >= 0)
+                    value = (value << 5) | (value >> 5);
+                else
+                    value = -(((-value) << 5) | ((-value) >> 5));
+            }
+            else
+            {
+                value = clampInt(base * 8 + 4 + m, 0, 2047);
+                value = (value << 5) | (value >> 6);
+            }
+
+            out[(y * 4 + x) * stride] = (uint16_t)value;
+        }
+    }
+}
+
+#pragma mark decode
+
+// one block into 16 texels of decoded_size bytes, row major
+static void decodeBlock(CompressedBlocks blocks, const uint8_t *b, uint8_t *texels)
+{
+    switch (blocks)
+    {
+    case COMPRESSED_BLOCKS_BC1:
+        decodeColorBlock(b, texels, COLOR_BLOCK_BC1);
+        break;
+
+    case COMPRESSED_BLOCKS_BC1_RGB:
+        decodeColorBlock(b, texels, COLOR_BLOCK_BC1_RGB);
+        break;
+
+    case COMPRESSED_BLOCKS_BC2:
+        decodeColorBlock(b + 8, texels, COLOR_BLOCK_FOUR_COLOR);
+        decodeBC2Alpha(b, texels);
+        break;
+
+    case COMPRESSED_BLOCKS_BC3:
+        decodeColorBlock(b + 8, texels, COLOR_BLOCK_FOUR_COLOR);
+        decodeRedBlock(b, texels + 3, 4);
+        break;
+
+    case COMPRESSED_BLOCKS_BC4:
+        decodeRedBlock(b, texels, 1);
+        break;
+
+    case COMPRESSED_BLOCKS_BC4_SNORM:
+        decodeSignedRedBlock(b, texels, 1);
+        break;
+
+    case COMPRESSED_BLOCKS_BC5:
+        decodeRedBlock(b, texels, 2);
+        decodeRedBlock(b + 8, texels + 1, 2);
+        break;
+
+    case COMPRESSED_BLOCKS_BC5_SNORM:
+        decodeSignedRedBlock(b, texels, 2);
+        decodeSignedRedBlock(b + 8, texels + 1, 2);
+        break;
+
+    case COMPRESSED_BLOCKS_ETC2_RGB8:
+        decodeETC2Block(b, false, texels);
+        break;
+
+    case COMPRESSED_BLOCKS_ETC2_RGB8A1:
+        decodeETC2Block(b, true, texels);
+        break;
+
+    case COMPRESSED_BLOCKS_ETC2_RGBA8:
+        decodeETC2Block(b + 8, false, texels);
+        decodeEACAlpha(b, texels);
+        break;
+
+    case COMPRESSED_BLOCKS_EAC_R11:
+    case COMPRESSED_BLOCKS_EAC_R11_SNORM:
+    case COMPRESSED_BLOCKS_EAC_RG11:
+    case COMPRESSED_BLOCKS_EAC_RG11_SNORM: {
+        uint16_t channels[32];
+        bool is_signed;
+        size_t stride;
+
+        is_signed = (blocks == COMPRESSED_BLOCKS_EAC_R11_SNORM || blocks == COMPRESSED_BLOCKS_EAC_RG11_SNORM);
+        stride = (blocks == COMPRESSED_BLOCKS_EAC_RG11 || blocks == COMPRESSED_BLOCKS_EAC_RG11_SNORM) ? 2 : 1;
+
+        decodeEACR11(b, is_signed, channels, stride);
+        if (stride == 2)
+            decodeEACR11(b + 8, is_signed, channels + 1, stride);
+
+        memcpy(texels, channels, 16 * stride * sizeof(uint16_t));
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+// a row of blocks, rows is how many of the block's texel rows are in the image
+static void decodeBlockRow(const CompressedFormat *format, uint8_t *dst, size_t dst_pitch, const uint8_t *src,
+                           size_t width, size_t rows)
+{
+    uint8_t texels[16 * 4];
+    size_t texel_size;
+
+    texel_size = format->decoded_size;
+
+    for (size_t x = 0; x < width; x += 4)
+    {
+        size_t row_size;
+
+        decodeBlock(format->blocks, src, texels);
+
+        row_size = ((width - x < 4) ? width - x : 4) * texel_size;
+
+        for (size_t y = 0; y < rows; y++)
+            memcpy(dst + y * dst_pitch + x * texel_size, texels + y * 4 * texel_size, row_size);
+
+        src += format->block_size;
+    }
+}
+
+bool decodeCompressedBlocks(const CompressedFormat *format, void *dst, size_t dst_pitch, const void *src,
+                            size_t src_pitch, size_t width, size_t height)
+{
+    const uint8_t *s;
+    uint8_t *d;
+
+    // every decoder is 4x4
+    if (format->decoded_format == 0)
+        return false;
+
+    s = (const uint8_t *)src;
+    d = (uint8_t *)dst;
+
+    for (size_t y = 0; y < height; y += 4)
+    {
+        decodeBlockRow(format, d + y * dst_pitch, dst_pitch, s, width, (height - y < 4) ? height - y : 4);
+
+        s += src_pitch;
+    }
+
+    return true;
+}
+
+typedef struct DecodeJob_t
+{
+    const CompressedFormat *format;
+    uint8_t *dst;
+    size_t dst_pitch;
+    size_t dst_image_pitch;
+    const uint8_t *src;
+    size_t src_pitch;
+    size_t src_image_pitch;
+    size_t width;
+    size_t height;
+
+    // block rows numbered across the images
+    size_t first_row;
+    size_t end_row;
+} DecodeJob;
+
+static void *decodeJobRows(void *arg)
+{
+    DecodeJob *job;
+    size_t block_rows;
+
+    job = (DecodeJob *)arg;
+
+    block_rows = (job->height + 3) / 4;
+
+    for (size_t row = job->first_row; row < job->end_row; row++)
+    {
+        size_t z, y;
+
+        z = row / block_rows;
+        y = (row % block_rows) * 4;
+
+        decodeBlockRow(job->format, job->dst + z * job->dst_image_pitch + y * job->dst_pitch, job->dst_pitch,
+                       job->src + z * job->src_image_pitch + (y / 4) * job->src_pitch, job->width,
+                       (job->height - y < 4) ? job->height - y : 4);
+    }
+
+    return NULL;
+}
+
+static size_t getDecodeThreadCount(size_t blocks)
+{
+    long cpus;
+    size_t threads;
+
+    if (blocks < DECODE_THREAD_BLOCKS * 2)
+        return 1;
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+
+    threads = blocks / DECODE_THREAD_BLOCKS;
+    threads = (threads < (size_t)cpus) ? threads : (size_t)cpus;
+
+    return (threads < DECODE_MAX_THREADS) ? threads : DECODE_MAX_THREADS;
+}
+
+bool decodeCompressedImage(const CompressedFormat *format, void *dst, size_t dst_pitch, size_t dst_image_pitch,
+                           const void *src, size_t src_pitch, size_t src_image_pitch, size_t width, size_t height,
+                           size_t depth)
+{
+    DecodeJob jobs[DECODE_MAX_THREADS];
+    pthread_t threads[DECODE_MAX_THREADS];
+    size_t block_rows, thread_count, started;
+
+    if (format->decoded_format == 0)
+        return false;
+
+    block_rows = ((height + 3) / 4) * depth;
+
+    thread_count = getDecodeThreadCount(block_rows * ((width + 3) / 4));
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        jobs[i].format = format;
+        jobs[i].dst = (uint8_t *)dst;
+        jobs[i].dst_pitch = dst_pitch;
+        jobs[i].dst_image_pitch = dst_image_pitch;
+        jobs[i].src = (const uint8_t *)src;
+        jobs[i].src_pitch = src_pitch;
+        jobs[i].src_image_pitch = src_image_pitch;
+        jobs[i].width = width;
+        jobs[i].height = height;
+        jobs[i].first_row = block_rows * i / thread_count;
+        jobs[i].end_row = block_rows * (i + 1) / thread_count;
+    }
+
+    // the calling thread takes the first share, a thread that won't start leaves its share to it too
+    started = 0;
+
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        if (pthread_create(&threads[i], NULL, decodeJobRows, &jobs[i]) != 0)
+            break;
+
+        started = i;
+    }
+
+    decodeJobRows(&jobs[0]);
+
+    for (size_t i = started + 1; i < thread_count; i++)
+        decodeJobRows(&jobs[i]);
+
+    for (size_t i = 1; i <= started; i++)
+        pthread_join(threads[i], NULL);
+
+    return true;
+}
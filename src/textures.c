@@ -18,17 +18,22 @@
  *
  */
 
-#include <mach/mach_vm.h>
-#include <mach/mach_init.h>
-#include <mach/vm_map.h>
-
+#include <stdint.h>
 #include <Accelerate/Accelerate.h>
 
 #include "pixel_utils.h"
+#include "pixel_store.h"
 #include "utils.h"
 #include "glm_context.h"
+#include "buffers.h"
+#include "mipmap_filter.h"
+#include "texture_compression.h"
+#include "pattern_fill.h"
 
 extern void *getBufferData(GLMContext ctx, Buffer *ptr);
+extern Renderbuffer *findRenderbuffer(GLMContext ctx, GLuint renderbuffer);
+
+void invalidateTexture(GLMContext ctx, Texture *tex);
 
 GLuint textureIndexFromTarget(GLMContext ctx, GLenum target)
 {
@@ -88,14 +93,13 @@ Texture *newTexObj(GLMContext ctx, GLenum target)
         assert(0);
     }
 
-    ptr = (Texture *)malloc(sizeof(Texture));
+    ptr = (Texture *)newPoolObject(&STATE(texture_pool));
     assert(ptr);
 
-    bzero(ptr, sizeof(Texture));
-
     ptr->name = TEX_OBJ_RES_NAME;
     ptr->target = target;
     ptr->index = index;
+    ptr->ref_count = 1;
 
     float black_color[] = {0, 0, 0, 0};
 
@@ -207,7 +211,15 @@ Texture *getTex(GLMContext ctx, GLuint name, GLenum target)
 bool checkInternalFormatForMetal(GLMContext ctx, GLuint internalformat)
 {
     // see if we can actually use this internal format
+    CompressedFormat compressed;
     GLenum mtl_format;
+
+    // blocks the device can't sample are fine if we can decode them
+    if (getCompressedFormat(internalformat, &compressed))
+    {
+        return (ctx->mtl_funcs.mtlSupportsCompressedFormat(ctx, internalformat) || compressed.decoded_format);
+    }
+
     mtl_format = mtlFormatForGLInternalFormat(internalformat);
 
     if (mtl_format == MTLPixelFormatInvalid)
@@ -218,6 +230,21 @@ bool checkInternalFormatForMetal(GLMContext ctx, GLuint internalformat)
     return true;
 }
 
+// compressed blocks the device can't sample and we can't decode aren't a supported format, anything else metal
+// can't use is an invalid operation
+static GLenum getInternalFormatErrorForMetal(GLMContext ctx, GLuint internalformat)
+{
+    CompressedFormat compressed;
+
+    if (checkInternalFormatForMetal(ctx, internalformat))
+        return GL_NO_ERROR;
+
+    if (getCompressedFormat(internalformat, &compressed))
+        return GL_INVALID_ENUM;
+
+    return GL_INVALID_OPERATION;
+}
+
 #pragma mark basic tex calls bind / delete / gen...
 void mglGenTextures(GLMContext ctx, GLsizei n, GLuint *textures)
 {
@@ -225,11 +252,15 @@ void mglGenTextures(GLMContext ctx, GLsizei n, GLuint *textures)
 
     while (n--)
     {
-        *textures++ = getNewName(&STATE(texture_table));
+        GLuint name;
 
         // TEX_OBJ_RES_NAME has special name.. skip it
-        if (STATE(texture_table.current_name) == TEX_OBJ_RES_NAME)
-            getNewName(&STATE(texture_table));
+        do
+        {
+            name = getNewName(&STATE(texture_table));
+        } while (name == TEX_OBJ_RES_NAME);
+
+        *textures++ = name;
     }
 }
 
@@ -318,8 +349,12 @@ void mglBindImageTexture(GLMContext ctx, GLuint unit, GLuint texture, GLint leve
 
     ImageUnit unit_params;
 
+    // the texture is made again with the new usage, a view only over the same storage
     if (ptr->access != access)
     {
+        if (ptr->view_parent == NULL)
+            keepTextureGPUWrites(ctx, ptr);
+
         ptr->dirty_bits |= DIRTY_TEXTURE_ACCESS;
         ptr->access = access;
     }
@@ -337,6 +372,63 @@ void mglBindImageTexture(GLMContext ctx, GLuint unit, GLuint texture, GLint leve
     ctx->state.dirty_bits |= DIRTY_IMAGE_UNIT_STATE;
 }
 
+static void detachTextureFromFramebuffer(void *data, void *arg)
+{
+    Framebuffer *fbo;
+    Texture *tex;
+
+    fbo = (Framebuffer *)data;
+    tex = (Texture *)arg;
+
+    for (int i = 0; i < MAX_COLOR_ATTACHMENTS; i++)
+    {
+        if (fbo->color_attachments[i].textarget != GL_RENDERBUFFER && fbo->color_attachments[i].buf.tex == tex)
+        {
+            bzero(&fbo->color_attachments[i], sizeof(FBOAttachment));
+            fbo->color_attachment_bitfield &= ~(0x1 << i);
+            fbo->dirty_bits |= DIRTY_FBO_TEX;
+        }
+    }
+
+    if (fbo->depth.textarget != GL_RENDERBUFFER && fbo->depth.buf.tex == tex)
+    {
+        bzero(&fbo->depth, sizeof(FBOAttachment));
+        fbo->dirty_bits |= DIRTY_FBO_TEX;
+    }
+
+    if (fbo->stencil.textarget != GL_RENDERBUFFER && fbo->stencil.buf.tex == tex)
+    {
+        bzero(&fbo->stencil, sizeof(FBOAttachment));
+        fbo->dirty_bits |= DIRTY_FBO_TEX;
+    }
+}
+
+// a deleted texture with views keeps its storage until the last view is deleted
+static void releaseTexture(GLMContext ctx, Texture *tex)
+{
+    Texture *parent;
+
+    assert(tex->ref_count);
+
+    if (--tex->ref_count)
+        return;
+
+    parent = tex->view_parent;
+
+    if (tex->params.mtl_data)
+    {
+        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, tex->params.mtl_data);
+    }
+
+    // releases mtl_data and the level storage
+    invalidateTexture(ctx, tex);
+
+    freePoolObject(&STATE(texture_pool), tex);
+
+    if (parent)
+        releaseTexture(ctx, parent);
+}
+
 void mglDeleteTextures(GLMContext ctx, GLsizei n, const GLuint *textures)
 {
     while (n--)
@@ -359,6 +451,16 @@ void mglDeleteTextures(GLMContext ctx, GLsizei n, const GLuint *textures)
 
                     ctx->state.dirty_bits |= DIRTY_TEX_BINDING;
                 }
+
+                for (int j = 0; j < _MAX_TEXTURE_TYPES; j++)
+                {
+                    if (ctx->state.texture_units[i].textures[j] == tex)
+                    {
+                        ctx->state.texture_units[i].textures[j] = NULL;
+
+                        ctx->state.dirty_bits |= DIRTY_TEX_BINDING;
+                    }
+                }
             }
 
             for (int i = 0; i < TEXTURE_UNITS; i++)
@@ -371,10 +473,13 @@ void mglDeleteTextures(GLMContext ctx, GLsizei n, const GLuint *textures)
                 }
             }
 
-            if (tex->mtl_data)
-            {
-                ctx->mtl_funcs.mtlDeleteMTLObj(ctx, tex->mtl_data);
-            }
+            // attachments hold the texture pointer, drop them before it goes away
+            iterateHashTable(&STATE(framebuffer_table), detachTextureFromFramebuffer, tex);
+            ctx->state.dirty_bits |= DIRTY_FBO;
+
+            deleteHashElement(&STATE(texture_table), name);
+
+            releaseTexture(ctx, tex);
         }
     }
 }
@@ -384,17 +489,206 @@ GLboolean mglIsTexture(GLMContext ctx, GLuint texture)
     return isTexture(ctx, texture);
 }
 
+// what invalidation keeps track of in a level, its layers or 3d slices. a cube map's images
+// are its faces and 1d array layers are rows, the way gl counts them
+GLuint getTexLevelImages(Texture *tex, GLint level)
+{
+    if (tex->target == GL_TEXTURE_CUBE_MAP)
+        return _CUBE_MAP_MAX_FACE;
+
+    if (tex->target == GL_TEXTURE_1D_ARRAY)
+        return MAX(tex->faces[0].levels[level].height, 1);
+
+    return MAX(tex->faces[0].levels[level].depth, 1);
+}
+
+// bits of images first .. first + count, the mask only holds the first 64
+static uint64_t getTexImageBits(GLuint first, GLuint count)
+{
+    if (first >= 64 || count == 0)
+        return 0;
+
+    count = MIN(count, 64 - first);
+
+    return ((count == 64) ? ~0ull : ((1ull << count) - 1)) << first;
+}
+
+// sets or clears the images' bits, whether any of them were set before
+static bool setTexImagesInvalidated(Texture *tex, GLint level, GLuint first, GLuint count, bool invalidated)
+{
+    TextureLevel *tex_level;
+    uint64_t bits;
+    bool was_invalidated;
+
+    if (level < 0 || level >= tex->mipmap_levels || tex->faces[0].levels == NULL)
+        return false;
+
+    was_invalidated = false;
+
+    // a cube map face is a level of its own
+    if (tex->target == GL_TEXTURE_CUBE_MAP)
+    {
+        for (GLuint face = first; face < _CUBE_MAP_MAX_FACE && face - first < count; face++)
+        {
+            tex_level = &tex->faces[face].levels[level];
+
+            was_invalidated |= (tex_level->invalidated_images != 0);
+            tex_level->invalidated_images = (invalidated ? 1 : 0);
+        }
+
+        return was_invalidated;
+    }
+
+    tex_level = &tex->faces[0].levels[level];
+    bits = getTexImageBits(first, count);
+
+    was_invalidated = ((tex_level->invalidated_images & bits) != 0);
+
+    if (invalidated)
+        tex_level->invalidated_images |= bits;
+    else
+        tex_level->invalidated_images &= ~bits;
+
+    return was_invalidated;
+}
+
+// the images aren't uploaded while set and a render pass doesn't load them
+void invalidateTexImages(Texture *tex, GLint level, GLuint first, GLuint count)
+{
+    setTexImagesInvalidated(tex, level, first, count, true);
+}
+
+// anything written to the images defines them again, whether they were invalidated
+bool writeTexImages(Texture *tex, GLint level, GLuint first, GLuint count)
+{
+    return setTexImagesInvalidated(tex, level, first, count, false);
+}
+
+// every image of the face's level is undefined, none of it has to go up
+bool isTexLevelInvalidated(Texture *tex, GLuint face, GLint level)
+{
+    TextureLevel *tex_level;
+    GLuint images;
+
+    tex_level = &tex->faces[face].levels[level];
+
+    if (tex_level->invalidated_images == 0)
+        return false;
+
+    images = (tex->target == GL_TEXTURE_CUBE_MAP) ? 1 : getTexLevelImages(tex, level);
+
+    return (tex_level->invalidated_images == getTexImageBits(0, images));
+}
+
+// a region of a level was written, the images under it are defined again. a cube map's faces
+// are its depth and 1d array layers its rows
+static void writeTexRegion(Texture *tex, GLint level, GLint yoffset, GLsizei height, GLint zoffset, GLsizei depth)
+{
+    if (tex->target == GL_TEXTURE_1D_ARRAY)
+        writeTexImages(tex, level, yoffset, height);
+    else
+        writeTexImages(tex, level, zoffset, depth);
+}
+
+static bool checkInvalidateTexLevel(GLMContext ctx, Texture *tex, GLint level)
+{
+    // GL_INVALID_VALUE is generated if level is less than zero or greater than the base 2 logarithm
+    // of the maximum texture width, height, or depth.
+    ERROR_CHECK_RETURN_VALUE(level >= 0 && level < 32, GL_INVALID_VALUE, false);
+
+    switch (tex->target)
+    {
+    case GL_TEXTURE_RECTANGLE:
+    case GL_TEXTURE_BUFFER:
+    case GL_TEXTURE_2D_MULTISAMPLE:
+    case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+        // GL_INVALID_VALUE is generated if the target of texture is GL_TEXTURE_RECTANGLE, GL_TEXTURE_BUFFER,
+        // GL_TEXTURE_2D_MULTISAMPLE, or GL_TEXTURE_2D_MULTISAMPLE_ARRAY and level is not zero.
+        ERROR_CHECK_RETURN_VALUE(level == 0, GL_INVALID_VALUE, false);
+        break;
+    }
+
+    return true;
+}
+
 void mglInvalidateTexImage(GLMContext ctx, GLuint texture, GLint level)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    tex = findTexture(ctx, texture);
+
+    // GL_INVALID_VALUE is generated if texture is zero or is not the name of an existing texture.
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    if (checkInvalidateTexLevel(ctx, tex, level) == false)
+        return;
+
+    // nothing allocated for it, nothing to skip
+    if (level >= tex->mipmap_levels || tex->faces[0].levels == NULL)
+        return;
+
+    invalidateTexImages(tex, level, 0, getTexLevelImages(tex, level));
 }
 
 void mglInvalidateTexSubImage(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
                               GLsizei width, GLsizei height, GLsizei depth)
 {
-    // Unimplemented function
-    assert(0);
+    TextureLevel *tex_level;
+    Texture *tex;
+    GLint level_depth;
+
+    tex = findTexture(ctx, texture);
+
+    // GL_INVALID_VALUE is generated if texture is zero or is not the name of an existing texture.
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    if (checkInvalidateTexLevel(ctx, tex, level) == false)
+        return;
+
+    // GL_INVALID_VALUE is generated if width, height, or depth is negative.
+    if (width < 0 || height < 0 || depth < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    if (level >= tex->mipmap_levels || tex->faces[0].levels == NULL)
+        return;
+
+    tex_level = &tex->faces[0].levels[level];
+
+    // a cube map's faces are its depth
+    level_depth = (tex->target == GL_TEXTURE_1D_ARRAY) ? 1 : getTexLevelImages(tex, level);
+
+    // GL_INVALID_VALUE is generated if the region extends outside the level
+    if (xoffset < 0 || xoffset + width > tex_level->width || yoffset < 0 ||
+        yoffset + height > MAX(tex_level->height, 1) || zoffset < 0 || zoffset + depth > level_depth)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    // the hint is per layer, 3d slice or face, a partial one still has to be loaded
+    if (xoffset != 0 || width != tex_level->width)
+        return;
+
+    // 1d array layers are rows
+    if (tex->target == GL_TEXTURE_1D_ARRAY)
+    {
+        invalidateTexImages(tex, level, yoffset, height);
+        return;
+    }
+
+    if (yoffset == 0 && height == MAX(tex_level->height, 1))
+        invalidateTexImages(tex, level, zoffset, depth);
 }
 
 void mglBindImageTextures(GLMContext ctx, GLuint first, GLsizei count, const GLuint *textures)
@@ -480,697 +774,2563 @@ void mglBindTextureUnit(GLMContext ctx, GLuint unit, GLuint texture)
     STATE(texture_units[unit].textures[target]) = ptr;
 }
 
-void generateMipmaps(GLMContext ctx, GLuint texture, GLenum target)
-{
-    Texture *ptr;
-
-    ptr = getTex(ctx, texture, target);
-
-    ERROR_CHECK_RETURN(ptr, GL_INVALID_OPERATION);
-
-    // level 0 needs to be filled out for mipmap geneation
-    ERROR_CHECK_RETURN(ptr->faces[0].levels[0].complete, GL_INVALID_OPERATION);
+static bool pinTextureShadow(GLMContext ctx, Texture *tex);
+static bool isTextureShadowCurrent(Texture *tex, GLuint face, GLint level);
 
-    ptr->mipmapped = true;
-    ptr->genmipmaps = true;
+// glGenerateMipmap filters from GL_TEXTURE_BASE_LEVEL down to GL_TEXTURE_MAX_LEVEL, within the
+// levels the texture has
+static void getMipmapLevelRange(Texture *tex, GLuint num_levels, GLuint *base_level, GLuint *max_level)
+{
+    GLuint last_level;
 
-    ptr->dirty_bits |= DIRTY_TEXTURE_LEVEL;
+    last_level = num_levels ? num_levels - 1 : 0;
 
-    ctx->mtl_funcs.mtlGenerateMipmaps(ctx, ptr);
+    *base_level = MIN(tex->params.base_level, last_level);
+    *max_level = MIN(tex->params.max_level, last_level);
 }
 
-void mglGenerateMipmap(GLMContext ctx, GLenum target)
+// the levels are filtered out of the base level's shadow and upload with the texture on its next
+// bind, layers of arrays are filtered on their own, cube map arrays are left to the gpu
+static bool buildMipmapLevels(GLMContext ctx, Texture *tex)
 {
-    switch (target)
+    PixelLayout layout;
+    MTLPixelFormat mtl_format;
+    GLuint num_faces, num_layers, num_levels, base_level, max_level;
+    size_t pixel_size;
+    bool srgb;
+
+    switch (tex->target)
     {
     case GL_TEXTURE_1D:
     case GL_TEXTURE_2D:
     case GL_TEXTURE_3D:
     case GL_TEXTURE_1D_ARRAY:
     case GL_TEXTURE_2D_ARRAY:
+        num_faces = 1;
+        break;
+
     case GL_TEXTURE_CUBE_MAP:
-    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        num_faces = 6;
         break;
 
     default:
-        ERROR_RETURN(GL_INVALID_ENUM);
+        return false;
     }
 
-    generateMipmaps(ctx, 0, target);
-}
+    layout = pixelLayoutForInternalFormat(tex->internalformat);
+    if (canFilterMipmap(layout) == false)
+        return false;
 
-void mglGenerateTextureMipmap(GLMContext ctx, GLuint texture)
-{
-    generateMipmaps(ctx, texture, 0);
-}
+    mtl_format = mtlFormatForGLInternalFormat(tex->internalformat);
+    srgb = (mtl_format == MTLPixelFormatRGBA8Unorm_sRGB || mtl_format == MTLPixelFormatBGRA8Unorm_sRGB);
 
-static size_t page_size_align(size_t size)
-{
-    if (size & (4096 - 1))
-    {
-        size_t pad_size = 0;
+    pixel_size = getPixelLayoutSize(layout);
 
-        pad_size = 4096 - (size & (4096 - 1));
+    // immutable storage has the levels glTexStorage gave it and no more
+    num_levels = tex->immutable_storage ? MIN(tex->num_levels, tex->mipmap_levels) : tex->mipmap_levels;
 
-        size += pad_size;
-    }
+    getMipmapLevelRange(tex, num_levels, &base_level, &max_level);
 
-    return size;
-}
+    if (pinTextureShadow(ctx, tex) == false)
+        return false;
 
-void invalidateTexture(GLMContext ctx, Texture *tex)
-{
-    if (tex->mtl_data)
+    for (GLuint face = 0; face < num_faces; face++)
     {
-        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, tex->mtl_data);
+        if (isTextureShadowCurrent(tex, face, base_level) == false)
+            return false;
     }
 
-    for (int face = 0; face < _CUBE_MAP_MAX_FACE; face++)
+    for (GLuint face = 0; face < num_faces; face++)
     {
-        for (int i = 0; i < tex->num_levels; i++)
+        TextureLevel *levels;
+
+        levels = tex->faces[face].levels;
+
+        // 1d arrays keep their layers in the height, 2d arrays in the depth
+        if (tex->target == GL_TEXTURE_1D_ARRAY)
+            num_layers = levels[base_level].height;
+        else if (tex->target == GL_TEXTURE_2D_ARRAY)
+            num_layers = levels[base_level].depth;
+        else
+            num_layers = 1;
+
+        for (GLuint level = base_level + 1; level < num_levels; level++)
         {
-            if (tex->faces[face].levels[i].complete)
+            TextureLevel *src, *dst;
+            size_t width, height, depth, src_image_pitch, dst_image_pitch;
+
+            src = &levels[level - 1];
+            dst = &levels[level];
+
+            // past GL_TEXTURE_MAX_LEVEL only levels never specified are filled, the mtl texture
+            // needs the whole chain
+            if (level > max_level && dst->complete)
+                continue;
+
+            width = getMipmapSize(src->width);
+            height = getMipmapSize(src->height);
+            depth = getMipmapSize(src->depth);
+
+            if (tex->target == GL_TEXTURE_1D_ARRAY)
+                height = src->height;
+            else if (tex->target == GL_TEXTURE_2D_ARRAY)
+                depth = src->depth;
+
+            src_image_pitch = src->pitch * src->height;
+            dst_image_pitch = pixel_size * width * height;
+
+            if (allocTextureLevelData(ctx, tex, face, level, dst_image_pitch * depth) == 0)
+                return false;
+
+            dst->width = (GLuint)width;
+            dst->height = (GLuint)height;
+            dst->depth = (GLuint)depth;
+            dst->pitch = pixel_size * width;
+
+            if (num_layers == 1)
+            {
+                filterMipmapLevel(layout, srgb, (void *)dst->data, dst->pitch, dst_image_pitch, (void *)src->data,
+                                  src->pitch, src_image_pitch, src->width, src->height, src->depth);
+            }
+            else if (tex->target == GL_TEXTURE_1D_ARRAY)
+            {
+                for (GLuint layer = 0; layer < num_layers; layer++)
+                {
+                    filterMipmapLevel(layout, srgb, (void *)(dst->data + layer * dst->pitch), dst->pitch,
+                                      dst->pitch, (void *)(src->data + layer * src->pitch), src->pitch, src->pitch,
+                                      src->width, 1, 1);
+                }
+            }
+            else
             {
-                if (tex->faces[face].levels[i].data)
+                for (GLuint layer = 0; layer < num_layers; layer++)
                 {
-                    vm_deallocate(mach_host_self(), tex->faces[face].levels[i].data,
-                                  tex->faces[face].levels[i].data_size);
+                    filterMipmapLevel(layout, srgb, (void *)(dst->data + layer * dst_image_pitch), dst->pitch,
+                                      dst_image_pitch, (void *)(src->data + layer * src_image_pitch), src->pitch,
+                                      src_image_pitch, src->width, src->height, 1);
                 }
             }
+
+            dst->complete = true;
         }
     }
 
-    for (int i = 0; i < 6; i++)
+    if (tex->immutable_storage == false)
+        tex->num_levels = num_levels;
+
+    tex->dirty_bits |= DIRTY_TEXTURE_DATA;
+
+    return true;
+}
+
+// GL_NICEST asks for the cpu filters, they're gamma correct and every texel of an odd
+// sized level counts. with no preference textures that aren't on the gpu yet are built
+// here rather than uploaded just to be filtered
+static bool useCPUMipmaps(GLMContext ctx, Texture *tex)
+{
+    switch (STATE(hints.generate_mipmap_hint))
     {
-        if (tex->faces[i].levels)
-            free(tex->faces[i].levels);
-    }
+    case GL_NICEST:
+        return true;
 
-    bzero(tex, sizeof(Texture));
+    case GL_FASTEST:
+        return false;
+
+    default:
+        return (tex->mtl_data == NULL);
+    }
 }
 
-void initBaseTexLevel(GLMContext ctx, Texture *tex, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth)
+void generateMipmaps(GLMContext ctx, GLuint texture, GLenum target)
 {
-    tex->mipmapped = 0;
-    tex->mipmap_levels = ilog2(MAX(width, height)) + 1;
+    Texture *ptr;
+    GLuint base_level, max_level;
 
-    for (int face = 0; face < _CUBE_MAP_MAX_FACE; face++)
+    ptr = getTex(ctx, texture, target);
+
+    if (ptr == NULL)
     {
-        tex->faces[face].levels = (TextureLevel *)calloc(tex->mipmap_levels, sizeof(TextureLevel));
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    tex->internalformat = internalformat;
-    tex->width = width;
-    tex->height = height;
-    tex->depth = depth;
-    tex->complete = false;
+    getMipmapLevelRange(ptr, ptr->mipmap_levels, &base_level, &max_level);
 
-    for (int face = 0; face < _CUBE_MAP_MAX_FACE; face++)
+    // the base level needs to be filled out for mipmap geneation, blocks can't be filtered
+    if (ptr->faces[0].levels == NULL || ptr->faces[0].levels[base_level].complete == false || ptr->compressed)
     {
-        for (int i = 0; i < tex->mipmap_levels; i++)
-        {
-            tex->faces[face].levels[i].complete = false;
-        }
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
-}
 
-bool checkTexLevelParams(GLMContext ctx, Texture *tex, GLint level, GLuint internalformat, GLsizei width,
-                         GLsizei height, GLsizei depth, GLenum format, GLenum type)
-{
-    GLuint base_width, base_height;
+    // a texture made without mip levels is made again with them
+    if (ptr->mipmapped == false)
+    {
+        keepTextureGPUWrites(ctx, ptr);
 
-    if (level >= tex->mipmap_levels)
+        ptr->dirty_bits |= DIRTY_TEXTURE_LEVEL;
+    }
+
+    ptr->mipmapped = true;
+    ptr->genmipmaps = true;
+
+    // the levels past the base are filtered from it, on the cpu or the gpu
+    for (GLuint level = base_level + 1; level <= max_level; level++)
     {
-        return false;
+        writeTexImages(ptr, level, 0, UINT32_MAX);
     }
 
-    if (tex->target == GL_TEXTURE_2D)
+    // a view's levels are only on the gpu, its parent reads them back for a shadow
+    if (ptr->view_parent)
     {
-        if (level != 0)
-        {
-            base_width = tex->width;
-            base_height = tex->height;
+        ptr->view_parent->genmipmaps = true;
 
-            while (level--)
-            {
-                base_width >>= 1;
-                base_height >>= 1;
-            }
+        ctx->mtl_funcs.mtlGenerateMipmaps(ctx, ptr);
+        return;
+    }
 
-            if (width != base_width || height != base_height)
-            {
-                return false;
-            }
-        }
+    // anything the cpu can't filter falls back to the blit encoder
+    if (useCPUMipmaps(ctx, ptr) && buildMipmapLevels(ctx, ptr))
+    {
+        STATE(dirty_bits) |= DIRTY_TEX;
+        return;
     }
 
-    if (internalformat)
+    ctx->mtl_funcs.mtlGenerateMipmaps(ctx, ptr);
+}
+
+void mglGenerateMipmap(GLMContext ctx, GLenum target)
+{
+    switch (target)
     {
-        // internal formats don't jive
-        if (internalformat != tex->internalformat)
+    case GL_TEXTURE_1D:
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_1D_ARRAY:
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
+
+    generateMipmaps(ctx, 0, target);
+}
+
+void mglGenerateTextureMipmap(GLMContext ctx, GLuint texture)
+{
+    generateMipmaps(ctx, texture, 0);
+}
+
+#pragma mark texture shadows
+// once a texture is on the gpu its level data is only a shadow, with a budget set the least
+// recently used shadows of textures the gpu never writes are dropped and read back when the
+// level data is needed again
+
+#define TEXTURE_SHADOW_ALIGN 16
+
+// cube maps and cube map arrays keep a level per face, everything else just one
+static GLuint getTexFaceCount(Texture *tex)
+{
+    switch (tex->target)
+    {
+    case GL_TEXTURE_CUBE_MAP:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        return _CUBE_MAP_MAX_FACE;
+
+    default:
+        return 1;
+    }
+}
+
+// a level's size down the chain from the base level, array layers don't shrink
+static void getTexLevelDims(Texture *tex, GLuint level, GLuint *width, GLuint *height, GLuint *depth)
+{
+    *width = MAX(tex->width >> level, 1);
+    *height = (tex->target == GL_TEXTURE_1D_ARRAY) ? tex->height : MAX(tex->height >> level, 1);
+    *depth = (tex->target == GL_TEXTURE_3D) ? MAX(tex->depth >> level, 1) : tex->depth;
+}
+
+// bytes a level takes in the shadow and its row pitch, unsized internal formats
+// take their size from the format / type
+static size_t getTexLevelDataSize(GLenum internalformat, GLenum format, GLenum type, size_t width, size_t height,
+                                  size_t depth, size_t *pitch)
+{
+    CompressedFormat compressed;
+    size_t pixel_size;
+
+    if (getCompressedFormat(internalformat, &compressed))
+    {
+        // rows of blocks, edges round up to a whole block
+        *pitch = getCompressedRowSize(&compressed, width);
+
+        return getCompressedImageSize(&compressed, width, height, depth);
+    }
+
+    // converted formats are stored in the layout metal expects
+    pixel_size = getPixelLayoutSize(pixelLayoutForInternalFormat(internalformat));
+    if (pixel_size == 0)
+        pixel_size = sizeForInternalFormat(internalformat, format, type);
+
+    *pitch = pixel_size * width;
+
+    return *pitch * height * depth;
+}
+
+// offsets of every level of the chain, small levels pack together. levels
+// specified at other sizes don't fit their slot and get storage of their own
+static void layoutTextureShadow(Texture *tex, GLenum format, GLenum type)
+{
+    GLuint num_faces;
+    size_t offset;
+
+    num_faces = getTexFaceCount(tex);
+    offset = 0;
+
+    for (GLuint level = 0; level < tex->mipmap_levels; level++)
+    {
+        GLuint width, height, depth;
+        size_t size, pitch;
+
+        getTexLevelDims(tex, level, &width, &height, &depth);
+
+        size = getTexLevelDataSize(tex->internalformat, format, type, width, height, depth, &pitch);
+        size = (size + TEXTURE_SHADOW_ALIGN - 1) & ~(size_t)(TEXTURE_SHADOW_ALIGN - 1);
+
+        for (GLuint face = 0; face < num_faces; face++)
         {
-            return false;
+            tex->faces[face].levels[level].offset = offset;
+            tex->faces[face].levels[level].slot_size = size;
+
+            offset += size;
         }
     }
+
+    tex->shadow_layout_size = offset;
+}
+
+static size_t getShadowLevelsSize(Texture *tex, GLuint levels)
+{
+    if (levels >= tex->mipmap_levels)
+        return tex->shadow_layout_size;
+
+    return tex->faces[0].levels[levels].offset;
+}
+
+// the shadow allocation has to cover the first levels. glTexImage textures start out
+// with what they asked for and get the whole chain once a level past it is used,
+// levels of a grown allocation keep their offsets
+static bool reserveTextureShadow(GLMContext ctx, Texture *tex, GLuint levels)
+{
+    vm_address_t data;
+    size_t size, alloc_size;
+    GLuint num_levels, num_faces;
+
+    if (tex->shadow_data && levels <= tex->shadow_levels)
+        return true;
+
+    if (tex->shadow_data)
+        num_levels = tex->mipmap_levels;
     else
+        num_levels = MAX(levels, tex->shadow_levels);
+
+    size = getShadowLevelsSize(tex, num_levels);
+
+    data = (vm_address_t)allocPages(size, PAGE_ALLOC_HUGE_PAGES, &alloc_size);
+    if (data == 0)
+        return false;
+
+    addMemResident(&ctx->shadow_budget, alloc_size);
+
+    if (tex->shadow_data)
     {
-        GLuint temp_internalformat;
+        memcpy((void *)data, (void *)tex->shadow_data, getShadowLevelsSize(tex, tex->shadow_levels));
 
-        // check if we are expected to convert data
-        temp_internalformat = internalFormatForGLFormatType(format, type);
+        num_faces = getTexFaceCount(tex);
 
-        if (temp_internalformat != tex->internalformat)
+        for (GLuint face = 0; face < num_faces; face++)
         {
-            return false;
+            for (GLuint level = 0; level < tex->shadow_levels; level++)
+            {
+                TextureLevel *tex_level;
+
+                tex_level = &tex->faces[face].levels[level];
+
+                if (tex_level->data && tex_level->data_alloc_size == 0)
+                    tex_level->data = data + tex_level->offset;
+            }
         }
-    }
 
-    if (checkInternalFormatForMetal(ctx, internalformat))
-    {
-        return false;
+        freePages((void *)tex->shadow_data, tex->shadow_alloc_size);
+        removeMemResident(&ctx->shadow_budget, tex->shadow_alloc_size);
     }
 
+    tex->shadow_data = data;
+    tex->shadow_alloc_size = alloc_size;
+    tex->shadow_levels = num_levels;
+
     return true;
 }
 
-bool verifyInternalFormatAndFormatType(GLMContext ctx, GLint internalformat, GLenum format, GLenum type)
+vm_address_t allocTextureLevelData(GLMContext ctx, Texture *tex, GLuint face, GLint level, size_t size)
 {
-    switch (internalformat)
+    TextureLevel *tex_level;
+    vm_address_t data;
+    size_t alloc_size;
+
+    tex_level = &tex->faces[face].levels[level];
+
+    // respecifying a level that had storage of its own, drop it
+    if (tex_level->data && tex_level->data_alloc_size)
     {
-    // unsized formats
-    case GL_DEPTH_COMPONENT:
-    case GL_DEPTH_STENCIL:
-    case GL_RED:
-    case GL_RG:
-    case GL_RGB:
-    case GL_RGBA:
-        break;
+        freePages((void *)tex_level->data, tex_level->data_alloc_size);
+        removeMemResident(&ctx->shadow_budget, tex_level->data_alloc_size);
+    }
 
-    // sized formats
-    case GL_R8:
-    case GL_R8_SNORM:
-    case GL_R16:
-    case GL_R16_SNORM:
-    case GL_RG8:
-    case GL_RG8_SNORM:
-    case GL_RG16:
-    case GL_RG16_SNORM:
-    case GL_R3_G3_B2:
-    case GL_RGB4:
-    case GL_RGB5:
-    case GL_RGB8:
-    case GL_RGB8_SNORM:
-    case GL_RGB10:
-    case GL_RGB12:
-    case GL_RGB16_SNORM:
-    case GL_RGBA2:
-    case GL_RGBA4:
-    case GL_RGB5_A1:
-    case GL_RGBA8:
-    case GL_RGBA8_SNORM:
-    case GL_RGB10_A2:
-    case GL_RGB10_A2UI:
-    case GL_RGBA12:
-    case GL_RGBA16:
-    case GL_SRGB8:
-    case GL_SRGB8_ALPHA8:
-    case GL_R16F:
-    case GL_RG16F:
-    case GL_RGB16F:
-    case GL_RGBA16F:
-    case GL_R32F:
-    case GL_RG32F:
-    case GL_RGB32F:
-    case GL_RGBA32F:
-    case GL_R11F_G11F_B10F:
-    case GL_RGB9_E5:
-    case GL_R8I:
-    case GL_R8UI:
-    case GL_R16I:
-    case GL_R16UI:
-    case GL_R32I:
-    case GL_R32UI:
-    case GL_RG8I:
-    case GL_RG8UI:
-    case GL_RG16I:
-    case GL_RG16UI:
-    case GL_RG32I:
-    case GL_RG32UI:
-    case GL_RGB8I:
-    case GL_RGB8UI:
-    case GL_RGB16I:
-    case GL_RGB16UI:
-    case GL_RGB32I:
-    case GL_RGB32UI:
-    case GL_RGBA8I:
-    case GL_RGBA8UI:
-    case GL_RGBA16I:
-    case GL_RGBA16UI:
-    case GL_RGBA32I:
-    case GL_RGBA32UI:
-        break;
+    tex_level->data = 0;
+    tex_level->data_alloc_size = 0;
 
-    // compressed types
-    case GL_COMPRESSED_RED:
-    case GL_COMPRESSED_RG:
-    case GL_COMPRESSED_RGB:
-    case GL_COMPRESSED_RGBA:
-    case GL_COMPRESSED_SRGB:
-    case GL_COMPRESSED_SRGB_ALPHA:
-    case GL_COMPRESSED_RED_RGTC1:
-    case GL_COMPRESSED_SIGNED_RED_RGTC1:
-    case GL_COMPRESSED_RG_RGTC2:
-    case GL_COMPRESSED_SIGNED_RG_RGTC2:
-    case GL_COMPRESSED_RGBA_BPTC_UNORM:
-    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
-    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
-    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
-        break;
+    if (size && size <= tex_level->slot_size)
+    {
+        if (reserveTextureShadow(ctx, tex, level + 1) == false)
+            return 0;
 
-    case GL_DEPTH_COMPONENT16:
-    case GL_DEPTH_COMPONENT24:
-    case GL_DEPTH_COMPONENT32:
-        ERROR_CHECK_RETURN_VALUE(format == GL_DEPTH_COMPONENT, GL_INVALID_OPERATION, false);
-        break;
+        tex_level->data_size = size;
+        tex_level->data = tex->shadow_data + tex_level->offset;
 
-    default:
-        ERROR_RETURN_VALUE(GL_INVALID_ENUM, false);
+        return tex_level->data;
     }
 
-    switch (format)
+    data = (vm_address_t)allocPages(size, PAGE_ALLOC_HUGE_PAGES, &alloc_size);
+    if (data == 0)
+        return 0;
+
+    addMemResident(&ctx->shadow_budget, alloc_size);
+
+    tex_level->data_size = size;
+    tex_level->data_alloc_size = alloc_size;
+    tex_level->data = data;
+
+    return data;
+}
+
+static void freeTextureShadow(GLMContext ctx, Texture *tex)
+{
+    GLuint num_faces;
+
+    if (tex->faces[0].levels == NULL)
+        return;
+
+    num_faces = getTexFaceCount(tex);
+
+    for (GLuint face = 0; face < num_faces; face++)
     {
-    case GL_RED:
-    case GL_RG:
-    case GL_RGB:
-    case GL_BGR:
-    case GL_RGBA:
-    case GL_BGRA:
-    case GL_RED_INTEGER:
-    case GL_RG_INTEGER:
-    case GL_RGB_INTEGER:
-    case GL_BGR_INTEGER:
-    case GL_RGBA_INTEGER:
-    case GL_BGRA_INTEGER:
-    case GL_STENCIL_INDEX:
-    case GL_DEPTH_COMPONENT:
-    case GL_DEPTH_STENCIL:
-        break;
+        for (GLuint i = 0; i < tex->mipmap_levels; i++)
+        {
+            TextureLevel *tex_level;
 
-    default:
-        ERROR_RETURN_VALUE(GL_INVALID_ENUM, false);
+            tex_level = &tex->faces[face].levels[i];
+
+            if (tex_level->data && tex_level->data_alloc_size)
+            {
+                freePages((void *)tex_level->data, tex_level->data_alloc_size);
+                removeMemResident(&ctx->shadow_budget, tex_level->data_alloc_size);
+            }
+
+            tex_level->data = 0;
+            tex_level->data_alloc_size = 0;
+        }
     }
 
-    switch (type)
+    // shadow_levels stays, a restored shadow covers the same levels
+    if (tex->shadow_data)
     {
-    case GL_UNSIGNED_BYTE:
-    case GL_BYTE:
-    case GL_UNSIGNED_SHORT:
-    case GL_SHORT:
-    case GL_UNSIGNED_INT:
-    case GL_INT:
-    case GL_FLOAT:
-        break;
+        freePages((void *)tex->shadow_data, tex->shadow_alloc_size);
+        removeMemResident(&ctx->shadow_budget, tex->shadow_alloc_size);
 
-    case GL_UNSIGNED_BYTE_3_3_2:
-    case GL_UNSIGNED_BYTE_2_3_3_REV:
+        tex->shadow_data = 0;
+    }
+}
+
+static size_t getTextureShadowSize(Texture *tex)
+{
+    GLuint num_faces;
+    size_t size;
+
+    if (tex->faces[0].levels == NULL)
+        return 0;
+
+    size = tex->shadow_data ? tex->shadow_alloc_size : 0;
+
+    num_faces = getTexFaceCount(tex);
+
+    for (GLuint face = 0; face < num_faces; face++)
+    {
+        for (GLuint i = 0; i < tex->mipmap_levels; i++)
+        {
+            if (tex->faces[face].levels[i].data)
+                size += tex->faces[face].levels[i].data_alloc_size;
+        }
+    }
+
+    return size;
+}
+
+// the gpu may have written it since the shadow was made
+static bool isTextureGPUWritten(Texture *tex)
+{
+    return (tex->mtl_data && (tex->mtl_requires_private_storage || tex->is_render_target ||
+                              tex->access != GL_READ_ONLY || tex->genmipmaps || tex->gpu_written));
+}
+
+// the cpu is about to read what the gpu has, whatever is queued on it has to land first
+static void finishTextureGPUWrites(GLMContext ctx, Texture *tex)
+{
+    if (isTextureGPUWritten(tex) || (tex->view_parent && isTextureGPUWritten(tex->view_parent)))
+    {
+        ctx->mtl_funcs.mtlFlush(ctx, true);
+    }
+}
+
+static bool isTextureShadowEvictable(Texture *tex)
+{
+    // the gpu copy has to be current and never written by the gpu, depth textures
+    // are private and have no shadow to begin with. decoded blocks can't be read back
+    return (tex->mtl_data && tex->dirty_bits == 0 && tex->mtl_requires_private_storage == false &&
+            tex->decoded_format == 0 && isTextureGPUWritten(tex) == false);
+}
+
+void touchTextureShadow(GLMContext ctx, Texture *tex)
+{
+    size_t size;
+
+    if (isOnMemLRU(&tex->shadow_lru))
+    {
+        touchMemLRU(&ctx->shadow_budget, &tex->shadow_lru, tex->shadow_lru.size);
+        return;
+    }
+
+    if (tex->shadow_evicted || isTextureShadowEvictable(tex) == false)
+        return;
+
+    size = getTextureShadowSize(tex);
+    if (size)
+        touchMemLRU(&ctx->shadow_budget, &tex->shadow_lru, size);
+}
+
+void evictTextureShadows(GLMContext ctx)
+{
+    MemLRUNode *node;
+
+    while ((node = findMemEvictCandidate(&ctx->shadow_budget)))
+    {
+        Texture *tex;
+        size_t size;
+
+        tex = (Texture *)((char *)node - offsetof(Texture, shadow_lru));
+        size = node->size;
+
+        removeMemLRU(&ctx->shadow_budget, node);
+
+        // became a render target or was modified since it was last used
+        if (isTextureShadowEvictable(tex) == false)
+            continue;
+
+        freeTextureShadow(ctx, tex);
+
+        tex->shadow_evicted = GL_TRUE;
+
+        recordMemEviction(&ctx->shadow_budget, size);
+    }
+}
+
+bool restoreTextureShadow(GLMContext ctx, Texture *tex)
+{
+    if (tex->shadow_evicted == GL_FALSE)
+        return true;
+
+    // the renderer allocates the levels again and reads them from the mtl texture
+    if (ctx->mtl_funcs.mtlReadTextureShadow(ctx, tex) == false)
+        return false;
+
+    tex->shadow_evicted = GL_FALSE;
+
+    recordMemRestore(&ctx->shadow_budget, getTextureShadowSize(tex));
+
+    return true;
+}
+
+// the gpu wrote it after the shadow was made. cpu writes waiting to go up were made over a
+// shadow that was read back first
+static bool isTextureShadowStale(Texture *tex)
+{
+    return (isTextureGPUWritten(tex) && tex->mtl_requires_private_storage == false && tex->decoded_format == 0 &&
+            (tex->dirty_bits & DIRTY_TEXTURE_DATA) == 0);
+}
+
+// brings the shadow up to what the mtl texture has, before the cpu writes into it or the texture
+// is made again from it. only what the gpu has finished is read, gl calls finish what's queued
+// on it first
+bool readBackTextureShadow(GLMContext ctx, Texture *tex)
+{
+    if (tex->mtl_data == NULL)
+        return true;
+
+    if (tex->shadow_evicted)
+        return restoreTextureShadow(ctx, tex);
+
+    if (isTextureShadowStale(tex) == false)
+        return true;
+
+    if (ctx->mtl_funcs.mtlReadTextureShadow(ctx, tex) == false)
+        return false;
+
+    tex->shadow_deferred = GL_FALSE;
+    tex->gpu_written = GL_FALSE;
+
+    return true;
+}
+
+// the mtl texture is about to be made again, anything only the gpu has goes into the shadow
+// while the gl call can still finish the queued work
+void keepTextureGPUWrites(GLMContext ctx, Texture *tex)
+{
+    if (tex->view_parent)
+        tex = tex->view_parent;
+
+    if (tex->mtl_data == NULL)
+        return;
+
+    if (tex->shadow_evicted || isTextureShadowStale(tex))
+    {
+        finishTextureGPUWrites(ctx, tex);
+
+        readBackTextureShadow(ctx, tex);
+    }
+}
+
+// a new texture has no shadow, levels made without pixels only get their size. render
+// targets and storage textures the app fills on the gpu never need one, the others get
+// theirs the first time the cpu writes or reads them back through it
+static bool backTextureShadow(GLMContext ctx, Texture *tex)
+{
+    GLuint num_faces;
+
+    // the gpu may have written it, the levels start out as what it has
+    if (isTextureGPUWritten(tex) && tex->mtl_requires_private_storage == false)
+    {
+        if (ctx->mtl_funcs.mtlReadTextureShadow(ctx, tex) == false)
+            return false;
+
+        tex->shadow_deferred = GL_FALSE;
+        tex->gpu_written = GL_FALSE;
+
+        return true;
+    }
+
+    // one allocation for every level there is so far
+    if (tex->num_levels && reserveTextureShadow(ctx, tex, tex->num_levels) == false)
+        return false;
+
+    num_faces = getTexFaceCount(tex);
+
+    for (GLuint face = 0; face < num_faces; face++)
+    {
+        for (GLuint level = 0; level < tex->num_levels; level++)
+        {
+            TextureLevel *tex_level;
+
+            tex_level = &tex->faces[face].levels[level];
+
+            if (tex_level->data_size == 0)
+                continue;
+
+            if (allocTextureLevelData(ctx, tex, face, level, tex_level->data_size) == 0)
+                return false;
+        }
+    }
+
+    tex->shadow_deferred = GL_FALSE;
+
+    return true;
+}
+
+// level data is about to be written, it has to be there and stay there
+static bool pinTextureShadow(GLMContext ctx, Texture *tex)
+{
+    removeMemLRU(&ctx->shadow_budget, &tex->shadow_lru);
+
+    // the levels come back from the gpu copy, as does anything it wrote since they were made.
+    // writing into a stale shadow would upload it over what the gpu put there
+    if (tex->shadow_deferred || tex->shadow_evicted || isTextureShadowStale(tex))
+        finishTextureGPUWrites(ctx, tex);
+
+    if (tex->shadow_deferred)
+        return backTextureShadow(ctx, tex);
+
+    return readBackTextureShadow(ctx, tex);
+}
+
+void getTextureMemory(Texture *tex, MemoryStats *stats)
+{
+    stats->objects++;
+    stats->cpu_bytes += getTextureShadowSize(tex);
+
+    if (tex->mtl_data)
+    {
+        if (tex->mtl_requires_private_storage)
+            stats->private_bytes += tex->mtl_alloc_size;
+        else
+            stats->managed_bytes += tex->mtl_alloc_size;
+    }
+
+    if (tex->shadow_evicted)
+        stats->evicted_objects++;
+}
+
+void invalidateTexture(GLMContext ctx, Texture *tex)
+{
+    TextureParameter params;
+    GLuint name, target, index, ref_count;
+
+    if (tex->mtl_data)
+    {
+        ctx->mtl_funcs.mtlDeleteMTLObj(ctx, tex->mtl_data);
+    }
+
+    removeMemLRU(&ctx->shadow_budget, &tex->shadow_lru);
+
+    freeTextureShadow(ctx, tex);
+
+    // one array has the levels of every face
+    free(tex->faces[0].levels);
+
+    // respecified textures keep their name, target and parameters
+    name = tex->name;
+    target = tex->target;
+    index = tex->index;
+    params = tex->params;
+    ref_count = tex->ref_count;
+
+    bzero(tex, sizeof(Texture));
+
+    tex->name = name;
+    tex->target = target;
+    tex->index = index;
+    tex->params = params;
+    tex->ref_count = ref_count;
+}
+
+void initBaseTexLevel(GLMContext ctx, Texture *tex, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth)
+{
+    CompressedFormat compressed;
+    TextureLevel *levels;
+    GLuint num_faces;
+
+    tex->mipmapped = 0;
+    tex->mipmap_levels = ilog2(MAX(width, height)) + 1;
+
+    // only the faces the target has
+    num_faces = getTexFaceCount(tex);
+
+    levels = (TextureLevel *)calloc(num_faces * tex->mipmap_levels, sizeof(TextureLevel));
+    assert(levels);
+
+    for (GLuint face = 0; face < num_faces; face++)
+    {
+        tex->faces[face].levels = levels + face * tex->mipmap_levels;
+    }
+
+    tex->internalformat = internalformat;
+    tex->width = width;
+    tex->height = height;
+    tex->depth = depth;
+    tex->complete = false;
+    tex->shadow_deferred = GL_TRUE;
+
+    // levels keep the blocks, they're decoded on upload when the device can't sample them
+    tex->compressed = getCompressedFormat(internalformat, &compressed);
+    tex->decoded_format = 0;
+
+    if (tex->compressed && ctx->mtl_funcs.mtlSupportsCompressedFormat(ctx, internalformat) == false)
+        tex->decoded_format = compressed.decoded_format;
+}
+
+bool checkTexLevelParams(GLMContext ctx, Texture *tex, GLint level, GLuint internalformat, GLsizei width,
+                         GLsizei height, GLsizei depth, GLenum format, GLenum type)
+{
+    GLuint base_width, base_height;
+
+    if (level >= tex->mipmap_levels)
+    {
+        return false;
+    }
+
+    if (tex->target == GL_TEXTURE_2D)
+    {
+        if (level != 0)
+        {
+            base_width = tex->width;
+            base_height = tex->height;
+
+            while (level--)
+            {
+                base_width >>= 1;
+                base_height >>= 1;
+            }
+
+            if (width != base_width || height != base_height)
+            {
+                return false;
+            }
+        }
+    }
+
+    if (internalformat)
+    {
+        // internal formats don't jive
+        if (internalformat != tex->internalformat)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        GLuint temp_internalformat;
+
+        // check if we are expected to convert data
+        temp_internalformat = internalFormatForGLFormatType(format, type);
+
+        if (temp_internalformat != tex->internalformat &&
+            canPixelConvertToInternalFormat(tex->internalformat, format, type) == false)
+        {
+            return false;
+        }
+    }
+
+    if (checkInternalFormatForMetal(ctx, tex->internalformat) == false)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool verifyInternalFormatAndFormatType(GLMContext ctx, GLint internalformat, GLenum format, GLenum type)
+{
+    CompressedFormat compressed;
+
+    switch (internalformat)
+    {
+    // unsized formats
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_STENCIL:
+    case GL_RED:
+    case GL_RG:
+    case GL_RGB:
+    case GL_RGBA:
+        break;
+
+    // sized formats
+    case GL_R8:
+    case GL_R8_SNORM:
+    case GL_R16:
+    case GL_R16_SNORM:
+    case GL_RG8:
+    case GL_RG8_SNORM:
+    case GL_RG16:
+    case GL_RG16_SNORM:
+    case GL_R3_G3_B2:
+    case GL_RGB4:
+    case GL_RGB5:
+    case GL_RGB8:
+    case GL_RGB8_SNORM:
+    case GL_RGB10:
+    case GL_RGB12:
+    case GL_RGB16_SNORM:
+    case GL_RGBA2:
+    case GL_RGBA4:
+    case GL_RGB5_A1:
+    case GL_RGBA8:
+    case GL_RGBA8_SNORM:
+    case GL_RGB10_A2:
+    case GL_RGB10_A2UI:
+    case GL_RGBA12:
+    case GL_RGBA16:
+    case GL_SRGB8:
+    case GL_SRGB8_ALPHA8:
+    case GL_R16F:
+    case GL_RG16F:
+    case GL_RGB16F:
+    case GL_RGBA16F:
+    case GL_R32F:
+    case GL_RG32F:
+    case GL_RGB32F:
+    case GL_RGBA32F:
+    case GL_R11F_G11F_B10F:
+    case GL_RGB9_E5:
+    case GL_R8I:
+    case GL_R8UI:
+    case GL_R16I:
+    case GL_R16UI:
+    case GL_R32I:
+    case GL_R32UI:
+    case GL_RG8I:
+    case GL_RG8UI:
+    case GL_RG16I:
+    case GL_RG16UI:
+    case GL_RG32I:
+    case GL_RG32UI:
+    case GL_RGB8I:
+    case GL_RGB8UI:
+    case GL_RGB16I:
+    case GL_RGB16UI:
+    case GL_RGB32I:
+    case GL_RGB32UI:
+    case GL_RGBA8I:
+    case GL_RGBA8UI:
+    case GL_RGBA16I:
+    case GL_RGBA16UI:
+    case GL_RGBA32I:
+    case GL_RGBA32UI:
+        break;
+
+    // compressed types
+    case GL_COMPRESSED_RED:
+    case GL_COMPRESSED_RG:
+    case GL_COMPRESSED_RGB:
+    case GL_COMPRESSED_RGBA:
+    case GL_COMPRESSED_SRGB:
+    case GL_COMPRESSED_SRGB_ALPHA:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+        break;
+
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32:
+        ERROR_CHECK_RETURN_VALUE(format == GL_DEPTH_COMPONENT, GL_INVALID_OPERATION, false);
+        break;
+
+    default:
+        // s3tc, etc2 / eac and astc
+        ERROR_CHECK_RETURN_VALUE(getCompressedFormat(internalformat, &compressed), GL_INVALID_ENUM, false);
+        break;
+    }
+
+    switch (format)
+    {
+    case GL_RED:
+    case GL_RG:
+    case GL_RGB:
+    case GL_BGR:
+    case GL_RGBA:
+    case GL_BGRA:
+    case GL_RED_INTEGER:
+    case GL_RG_INTEGER:
+    case GL_RGB_INTEGER:
+    case GL_BGR_INTEGER:
+    case GL_RGBA_INTEGER:
+    case GL_BGRA_INTEGER:
+    case GL_STENCIL_INDEX:
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_STENCIL:
+        break;
+
+    default:
+        ERROR_RETURN_VALUE(GL_INVALID_ENUM, false);
+    }
+
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT:
+        break;
+
+    case GL_UNSIGNED_BYTE_3_3_2:
+    case GL_UNSIGNED_BYTE_2_3_3_REV:
     case GL_UNSIGNED_SHORT_5_6_5:
     case GL_UNSIGNED_SHORT_5_6_5_REV:
         ERROR_CHECK_RETURN_VALUE(format == GL_RGB, GL_INVALID_OPERATION, false);
         break;
 
-    case GL_UNSIGNED_SHORT_4_4_4_4:
-    case GL_UNSIGNED_SHORT_4_4_4_4_REV:
-    case GL_UNSIGNED_SHORT_5_5_5_1:
-    case GL_UNSIGNED_SHORT_1_5_5_5_REV:
-    case GL_UNSIGNED_INT_8_8_8_8:
-    case GL_UNSIGNED_INT_8_8_8_8_REV:
-    case GL_UNSIGNED_INT_10_10_10_2:
-    case GL_UNSIGNED_INT_2_10_10_10_REV:
-        ERROR_CHECK_RETURN_VALUE((format == GL_RGBA || format == GL_BGRA), GL_INVALID_OPERATION, false);
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+    case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+    case GL_UNSIGNED_INT_8_8_8_8:
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+    case GL_UNSIGNED_INT_10_10_10_2:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+        ERROR_CHECK_RETURN_VALUE((format == GL_RGBA || format == GL_BGRA), GL_INVALID_OPERATION, false);
+        break;
+    }
+
+    return true;
+}
+
+static void getUnpackLayout(GLMContext ctx, Texture *tex, GLenum format, GLenum type, size_t width, size_t height,
+                            size_t depth, PixelStoreLayout *layout)
+{
+    PixelStoreParams params;
+    bool is_3d;
+
+    params.alignment = ctx->state.unpack.alignment;
+    params.row_length = ctx->state.unpack.row_length;
+    params.image_height = ctx->state.unpack.image_height;
+    params.skip_pixels = ctx->state.unpack.skip_pixels;
+    params.skip_rows = ctx->state.unpack.skip_rows;
+    params.skip_images = ctx->state.unpack.skip_images;
+    params.swap_bytes = ctx->state.unpack.swap_bytes;
+
+    // lsb_first is for GL_BITMAP, there's none of that in core
+
+    switch (tex->target)
+    {
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        is_3d = true;
+        break;
+
+    default:
+        is_3d = false;
+        break;
+    }
+
+    getPixelStoreLayout(&params, sizeForFormatType(format, type), sizeForType(type), is_3d, width, height, depth,
+                        layout);
+}
+
+void unpackTexture(GLMContext ctx, Texture *tex, GLuint face, GLuint level, GLenum format, GLenum type,
+                   const PixelStoreLayout *src_layout, void *src_data, void *dst_data, size_t xoffset, size_t yoffset,
+                   size_t zoffset, size_t width, size_t height, size_t depth)
+{
+    GLubyte *src, *dst;
+    size_t dst_pitch, dst_image_size, pixel_size;
+    PixelLayout src_pixel_layout, dst_pixel_layout;
+
+    assert(tex);
+    dst_pitch = tex->faces[face].levels[level].pitch;
+    assert(dst_pitch);
+
+    dst_image_size = dst_pitch * tex->faces[face].levels[level].height;
+    pixel_size = dst_pitch / tex->faces[face].levels[level].width;
+
+    src = (GLubyte *)src_data + src_layout->offset;
+    dst = (GLubyte *)dst_data + xoffset * pixel_size + yoffset * dst_pitch + zoffset * dst_image_size;
+
+    src_pixel_layout = pixelLayoutForFormatType(format, type);
+    dst_pixel_layout = pixelLayoutForInternalFormat(tex->internalformat);
+
+    // format / type is already the level layout, a straight strided copy
+    if (src_pixel_layout == dst_pixel_layout || canConvertPixels(dst_pixel_layout, src_pixel_layout) == false)
+    {
+        copyPixelRows(dst, dst_pitch, dst_image_size, src, src_layout->row_pitch, src_layout->image_pitch,
+                      width * pixel_size, height, depth, src_layout->swap_size);
+        return;
+    }
+
+    GLubyte *swapped;
+
+    // swapped rows go through a temp before they're converted
+    swapped = NULL;
+    if (src_layout->swap_size)
+    {
+        swapped = (GLubyte *)malloc(src_layout->row_size);
+        assert(swapped);
+    }
+
+    for (size_t z = 0; z < depth; z++)
+    {
+        GLubyte *src_row, *dst_row;
+
+        src_row = src + z * src_layout->image_pitch;
+        dst_row = dst + z * dst_image_size;
+
+        for (size_t y = 0; y < height; y++)
+        {
+            if (swapped)
+            {
+                swapPixelBytes(swapped, src_row, src_layout->row_size, src_layout->swap_size);
+                pixelConvertToInternalFormat(ctx, tex->internalformat, format, type, swapped, dst_row, width);
+            }
+            else
+            {
+                pixelConvertToInternalFormat(ctx, tex->internalformat, format, type, src_row, dst_row, width);
+            }
+
+            src_row += src_layout->row_pitch;
+            dst_row += dst_pitch;
+        }
+    }
+
+    free(swapped);
+}
+
+#pragma mark texture views
+// a view has no level data, it's levels and layers of its parent's storage. its mtl texture
+// is a view of the parent's
+
+static GLuint getTexLayerCount(Texture *tex)
+{
+    if (tex->view_parent)
+        return tex->view_num_layers;
+
+    switch (tex->target)
+    {
+    case GL_TEXTURE_1D_ARRAY:
+        return tex->height;
+
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        return tex->depth;
+
+    case GL_TEXTURE_CUBE_MAP:
+        return 6;
+
+    default:
+        return 1;
+    }
+}
+
+// the texture with the level data and where a face, level and layer of a view are in it.
+// layers of arrays are rows of 1d arrays and images of the others, cube faces are faces
+static Texture *getViewStorage(Texture *tex, GLuint *face, GLint *level, GLint *yoffset, GLint *zoffset)
+{
+    Texture *storage;
+    GLuint layer;
+
+    storage = tex->view_parent;
+    if (storage == NULL)
+        return tex;
+
+    // cube views count their faces as layers
+    layer = tex->view_min_layer + *face;
+
+    *face = 0;
+    *level += tex->view_min_level;
+
+    switch (storage->target)
+    {
+    case GL_TEXTURE_CUBE_MAP:
+        *face = layer + *zoffset;
+        *zoffset = 0;
+        break;
+
+    case GL_TEXTURE_1D_ARRAY:
+        *yoffset += layer;
+        break;
+
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        *zoffset += layer;
+        break;
+
+    default:
+        break;
+    }
+
+    return storage;
+}
+
+#pragma mark texImage 1D/2D/3D
+bool createTextureLevel(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLboolean is_array,
+                        GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type,
+                        void *pixels, GLboolean proxy)
+{
+    GLenum err;
+    bool defer;
+
+    // all the levels are created on a tex storage call.. if we get here we should just assert
+    if (tex->immutable_storage)
+    {
+        if (width != tex->width || height != tex->height || internalformat != tex->internalformat)
+        {
+            ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+        }
+    }
+
+    if (level == 0)
+    {
+        if (internalformat == 0)
+        {
+            internalformat = internalFormatForGLFormatType(format, type);
+
+            if (internalformat == 0)
+            {
+                ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+            }
+        }
+        else if (pixels)
+        {
+            GLuint temp_format;
+
+            // check if format type can be copied directly to the internal format
+            temp_format = internalFormatForGLFormatType(format, type);
+
+            // otherwise it has to be converted on the way in
+            if (temp_format != internalformat && canPixelConvertToInternalFormat(internalformat, format, type) == false)
+            {
+                ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+            }
+        }
+
+        // see if we can actually use this internal format
+        err = getInternalFormatErrorForMetal(ctx, internalformat);
+        if (err)
+        {
+            ERROR_RETURN_VALUE(err, false);
+        }
+
+        if (tex->mipmap_levels == 0)
+        {
+            // uninitialized tex
+            initBaseTexLevel(ctx, tex, internalformat, width, height, depth);
+            layoutTextureShadow(tex, format, type);
+        }
+        else if (width != tex->width || height != tex->height || internalformat != tex->internalformat)
+        {
+            // invalidate texture because the base level width / height / internal format are being changed...
+            invalidateTexture(ctx, tex);
+
+            initBaseTexLevel(ctx, tex, internalformat, width, height, depth);
+            layoutTextureShadow(tex, format, type);
+        }
+    }
+    else if (checkTexLevelParams(ctx, tex, level, internalformat, width, height, depth, format, type) == false)
+    {
+        ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+    }
+
+    // nothing to unpack, the level can wait for its shadow with the others
+    defer = (tex->shadow_deferred && pixels == NULL && (format == 0 || STATE(buffers[_PIXEL_UNPACK_BUFFER]) == NULL));
+
+    // the other levels are uploaded again with this one
+    if (defer == false)
+    {
+        ERROR_CHECK_RETURN_VALUE(pinTextureShadow(ctx, tex), GL_OUT_OF_MEMORY, false);
+    }
+    else
+    {
+        keepTextureGPUWrites(ctx, tex);
+    }
+
+    // the level is specified again, a cube map's face on its own
+    if (tex->target == GL_TEXTURE_CUBE_MAP)
+        writeTexImages(tex, level, face, 1);
+    else
+        writeTexImages(tex, level, 0, UINT32_MAX);
+
+    // storage and compressed levels come without a format, they don't unpack anything
+    if (format && STATE(buffers[_PIXEL_UNPACK_BUFFER]))
+    {
+        Buffer *ptr;
+
+        ptr = STATE(buffers[_PIXEL_UNPACK_BUFFER]);
+
+        ERROR_CHECK_RETURN_VALUE(ptr->mapped == false, GL_INVALID_OPERATION, false);
+
+        GLubyte *buffer_data;
+        buffer_data = getBufferData(ctx, ptr);
+
+        // if a pixel buffer is the src, pixels is the offset
+        size_t offset;
+        offset = (size_t)pixels;
+
+        PixelStoreLayout src_layout;
+        getUnpackLayout(ctx, tex, format, type, width, height, depth, &src_layout);
+
+        // everything the unpack reads has to be in the buffer
+        if (offset + src_layout.size > ptr->size)
+        {
+            ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+        }
+
+        pixels = &buffer_data[offset];
+    }
+
+    tex->num_levels = MAX(tex->num_levels, level + 1);
+
+    tex->faces[face].levels[level].width = width;
+    tex->faces[face].levels[level].height = height;
+    tex->faces[face].levels[level].depth = depth;
+
+    vm_address_t texture_data;
+    size_t internal_size;
+
+    assert(width);
+    assert(height);
+    assert(depth);
+
+    internal_size = getTexLevelDataSize(internalformat, format, type, width, height, depth,
+                                        &tex->faces[face].levels[level].pitch);
+    ERROR_CHECK_RETURN_VALUE(internal_size, GL_INVALID_ENUM, false);
+
+    switch (mtlFormatForGLInternalFormat(internalformat))
+    {
+    case MTLPixelFormatDepth16Unorm:
+    case MTLPixelFormatDepth32Float:
+    case MTLPixelFormatDepth24Unorm_Stencil8:
+    case MTLPixelFormatDepth32Float_Stencil8:
+        tex->mtl_requires_private_storage = true;
+        break;
+
+    default:
+        tex->mtl_requires_private_storage = false;
+        break;
+    }
+
+    if (tex->mtl_requires_private_storage == false && defer)
+    {
+        tex->faces[face].levels[level].data_size = internal_size;
+    }
+    else if (tex->mtl_requires_private_storage == false)
+    {
+        texture_data = allocTextureLevelData(ctx, tex, face, level, internal_size);
+        ERROR_CHECK_RETURN_VALUE(texture_data, GL_OUT_OF_MEMORY, false);
+
+        if (pixels)
+        {
+            PixelStoreLayout src_layout;
+
+            getUnpackLayout(ctx, tex, format, type, width, height, depth, &src_layout);
+
+            unpackTexture(ctx, tex, face, level, format, type, &src_layout, (void *)pixels, (void *)texture_data, 0, 0,
+                          0, width, height, depth);
+
+            tex->dirty_bits |= DIRTY_TEXTURE_DATA;
+        };
+    }
+
+    tex->faces[face].levels[level].complete = true;
+
+    tex->dirty_bits |= DIRTY_TEXTURE_LEVEL;
+    STATE(dirty_bits) |= DIRTY_TEX;
+
+    return true;
+}
+
+void mglTexImage1D(GLMContext ctx, GLenum target, GLint level, GLint internalformat, GLsizei width, GLint border,
+                   GLenum format, GLenum type, const void *pixels)
+{
+    Texture *tex;
+    bool proxy;
+
+    proxy = false;
+
+    switch (target)
+    {
+    case GL_TEXTURE_1D:
+        break;
+
+    case GL_PROXY_TEXTURE_1D:
+        proxy = true;
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+    }
+
+    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+
+    // verifyFormatType sets the error
+    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, internalformat, format, type), 0);
+
+    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(border == 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, 0, target);
+
+    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+
+    tex->access = GL_READ_ONLY;
+
+    createTextureLevel(ctx, tex, 0, level, false, internalformat, width, 1, 1, format, type, (void *)pixels, proxy);
+}
+
+void mglTexImage2D(GLMContext ctx, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                   GLint border, GLenum format, GLenum type, const void *pixels)
+{
+    Texture *tex;
+    GLuint face;
+    GLboolean is_array;
+    GLboolean proxy;
+
+    face = 0;
+    is_array = false;
+    proxy = false;
+
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        break;
+
+    case GL_PROXY_TEXTURE_2D:
+    case GL_PROXY_TEXTURE_CUBE_MAP:
+        proxy = true;
+        break;
+
+    case GL_PROXY_TEXTURE_1D_ARRAY:
+        is_array = true;
+        proxy = true;
+        break;
+
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
+        face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+        break;
+
+    case GL_PROXY_TEXTURE_RECTANGLE:
+        proxy = true;
+        ERROR_CHECK_RETURN(level == 0, GL_INVALID_OPERATION);
+        break;
+
+    case GL_TEXTURE_RECTANGLE:
+        ERROR_CHECK_RETURN(level == 0, GL_INVALID_OPERATION);
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+    }
+
+    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+
+    // verifyFormatType sets the error
+    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, internalformat, format, type), 0);
+
+    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(border == 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, 0, target);
+
+    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+
+    tex->access = GL_READ_ONLY;
+
+    createTextureLevel(ctx, tex, face, level, is_array, internalformat, width, height, 1, format, type, (void *)pixels,
+                       proxy);
+}
+
+void mglTexImage2DMultisample(GLMContext ctx, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width,
+                              GLsizei height, GLboolean fixedsamplelocations)
+{
+    // Unimplemented function
+    assert(0);
+}
+
+void mglTexImage3D(GLMContext ctx, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                   GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels)
+{
+    Texture *tex;
+    GLboolean is_array;
+    GLboolean proxy;
+
+    is_array = false;
+    proxy = false;
+
+    switch (target)
+    {
+    case GL_TEXTURE_3D:
+        break;
+
+    case GL_PROXY_TEXTURE_3D:
+        proxy = true;
+        break;
+
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_PROXY_TEXTURE_2D_ARRAY:
+        is_array = true;
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+    }
+
+    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+
+    // verifyFormatType sets the error
+    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, internalformat, format, type), 0);
+
+    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(depth >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(border == 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, 0, target);
+
+    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+
+    tex->access = GL_READ_ONLY;
+
+    createTextureLevel(ctx, tex, 0, level, is_array, internalformat, width, height, depth, format, type, (void *)pixels,
+                       proxy);
+}
+
+void mglTexImage3DMultisample(GLMContext ctx, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width,
+                              GLsizei height, GLsizei depth, GLboolean fixedsamplelocations)
+{
+    // Unimplemented function
+    assert(0);
+}
+
+#pragma mark texSubImage
+bool texSubImage(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                 GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, void *pixels)
+{
+    ERROR_CHECK_RETURN_VALUE(level <= tex->num_levels, GL_INVALID_OPERATION, false);
+
+    ERROR_CHECK_RETURN_VALUE(tex->faces[face].levels[level].complete, GL_INVALID_OPERATION, false);
+
+    // blocks only come in through glCompressedTexSubImage
+    ERROR_CHECK_RETURN_VALUE(tex->compressed == false, GL_INVALID_OPERATION, false);
+
+    PixelStoreLayout src_layout;
+    size_t buffer_offset;
+
+    getUnpackLayout(ctx, tex, format, type, width, height, depth, &src_layout);
+
+    buffer_offset = 0;
+
+    // unpack from pixel buffer
+    if (STATE(buffers[_PIXEL_UNPACK_BUFFER]))
+    {
+        Buffer *ptr;
+
+        ptr = STATE(buffers[_PIXEL_UNPACK_BUFFER]);
+
+        ERROR_CHECK_RETURN_VALUE(ptr->mapped == false, GL_INVALID_OPERATION, false);
+
+        GLubyte *buffer_data;
+        buffer_data = getBufferData(ctx, ptr);
+
+        // if a pixel buffer is the src, pixels is the offset
+        buffer_offset = (size_t)pixels;
+
+        // everything the unpack reads has to be in the buffer
+        if (buffer_offset + src_layout.size > ptr->size)
+        {
+            ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+        }
+
+        pixels = &buffer_data[buffer_offset];
+    }
+
+    // no src data.. return
+    ERROR_CHECK_RETURN_VALUE(pixels, GL_INVALID_OPERATION, false);
+
+    void *texture_data;
+    Texture *storage;
+    GLuint storage_face;
+    GLint storage_level, storage_yoffset, storage_zoffset;
+
+    storage_face = face;
+    storage_level = level;
+    storage_yoffset = yoffset;
+    storage_zoffset = zoffset;
+
+    storage = getViewStorage(tex, &storage_face, &storage_level, &storage_yoffset, &storage_zoffset);
+
+    // the faces of a cube map are apart, a 2d array view of one writes a face at a time
+    ERROR_CHECK_RETURN_VALUE(storage->target != GL_TEXTURE_CUBE_MAP || depth == 1, GL_INVALID_OPERATION, false);
+
+    ERROR_CHECK_RETURN_VALUE(pinTextureShadow(ctx, storage), GL_OUT_OF_MEMORY, false);
+
+    if (storage->target == GL_TEXTURE_CUBE_MAP)
+        writeTexImages(storage, storage_level, storage_face, 1);
+    else
+        writeTexRegion(storage, storage_level, storage_yoffset, height, storage_zoffset, depth);
+
+    texture_data = (void *)storage->faces[storage_face].levels[storage_level].data;
+
+    // a view's texels go in as its own format, its levels are laid out like the parent's
+    unpackTexture(ctx, tex, face, level, format, type, &src_layout, pixels, texture_data, xoffset, storage_yoffset,
+                  storage_zoffset, width, height, depth);
+
+    // use a blit command to update data
+    do
+    {
+        Buffer *buf;
+
+        buf = STATE(buffers[_PIXEL_UNPACK_BUFFER]);
+
+        if (buf == NULL)
+            continue;
+
+        if (tex->mtl_data == NULL || tex->view_parent)
+            continue;
+
+        // the blit copies bytes, converted or swapped data goes up from the shadow
+        if (pixelLayoutForFormatType(format, type) != pixelLayoutForInternalFormat(tex->internalformat))
+            continue;
+
+        if (src_layout.swap_size)
+            continue;
+
+        ctx->mtl_funcs.mtlTexSubImage(ctx, tex, buf, buffer_offset + src_layout.offset, src_layout.row_pitch,
+                                      src_layout.image_pitch, src_layout.size - src_layout.offset, face, level,
+                                      width, height, depth, xoffset, yoffset, zoffset);
+
+        return true;
+    } while (false);
+
+    // use process gl to upload texture data
+    storage->dirty_bits |= DIRTY_TEXTURE_DATA;
+
+    return true;
+}
+
+#pragma mark texSubImage1D
+void texSubImage1D(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLint xoffset, GLsizei width, GLenum format,
+                   GLenum type, const void *pixels)
+{
+    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+
+    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+
+    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(width + xoffset < tex->width, GL_INVALID_VALUE);
+
+    texSubImage(ctx, tex, face, level, xoffset, 0, 0, width, 1, 1, format, type, (void *)pixels);
+}
+
+void mglTexSubImage1D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLsizei width, GLenum format,
+                      GLenum type, const void *pixels)
+{
+    Texture *tex;
+
+    switch (target)
+    {
+    case GL_TEXTURE_1D:
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+    }
+
+    tex = getTex(ctx, 0, target);
+
+    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+
+    texSubImage1D(ctx, tex, 0, level, xoffset, width, format, type, pixels);
+}
+
+void mglTextureSubImage1D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLsizei width, GLenum format,
+                          GLenum type, const void *pixels)
+{
+    Texture *tex;
+
+    tex = getTex(ctx, texture, 0);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texSubImage1D(ctx, tex, 0, level, xoffset, width, format, type, pixels);
+}
+
+#pragma mark texSubImage2D
+bool texSubImage2D(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+                   GLsizei height, GLenum format, GLenum type, const void *pixels)
+{
+    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+
+    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+
+    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(width + xoffset <= tex->width, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height + yoffset <= tex->height, GL_INVALID_VALUE);
+
+    texSubImage(ctx, tex, face, level, xoffset, yoffset, 0, width, height, 1, format, type, (void *)pixels);
+
+    return true;
+}
+
+void mglTexSubImage2D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+                      GLsizei height, GLenum format, GLenum type, const void *pixels)
+{
+    Texture *tex;
+    GLuint face;
+
+    face = 0;
+
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_1D_ARRAY:
+    case GL_TEXTURE_RECTANGLE:
+        break;
+
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
+        face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+    }
+
+    tex = getTex(ctx, 0, target);
+
+    texSubImage2D(ctx, tex, face, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+void mglTextureSubImage2D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+                          GLsizei height, GLenum format, GLenum type, const void *pixels)
+{
+    Texture *tex;
+
+    tex = getTex(ctx, texture, 0);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texSubImage2D(ctx, tex, 0, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+#pragma mark texSubImage3D
+void texSubImage3D(GLMContext ctx, Texture *tex, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                   GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+{
+
+    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+
+    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+
+    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(depth >= 0, GL_INVALID_VALUE);
+
+    ERROR_CHECK_RETURN(width + xoffset <= tex->width, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height + yoffset <= tex->height, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(depth + zoffset <= tex->depth, GL_INVALID_VALUE);
+
+    texSubImage(ctx, tex, 0, level, xoffset, yoffset, zoffset, width, height, depth, format, type, (void *)pixels);
+}
+
+void mglTexSubImage3D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                      GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+{
+    Texture *tex;
+
+    switch (target)
+    {
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_2D_ARRAY:
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+    }
+
+    tex = getTex(ctx, 0, target);
+
+    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+
+    texSubImage3D(ctx, tex, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+}
+
+void mglTextureSubImage3D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                          GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+{
+    Texture *tex;
+
+    tex = getTex(ctx, texture, 0);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texSubImage3D(ctx, tex, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+}
+
+#pragma mark TexStorage
+
+void texStorage(GLMContext ctx, Texture *tex, GLuint faces, GLsizei levels, GLboolean is_array, GLenum internalformat,
+                GLsizei width, GLsizei height, GLsizei depth, GLboolean proxy)
+{
+    tex->access = GL_READ_ONLY;
+
+    // every level is known up front, once there is a shadow it's one allocation for all of them
+    if (tex->mipmap_levels)
+        invalidateTexture(ctx, tex);
+
+    initBaseTexLevel(ctx, tex, internalformat, width, height, depth);
+    layoutTextureShadow(tex, 0, 0);
+
+    tex->shadow_levels = MIN((GLuint)levels, tex->mipmap_levels);
+
+    for (int face = 0; face < faces; face++)
+    {
+        for (int level = 0; level < levels; level++)
+        {
+            GLuint level_width, level_height, level_depth;
+
+            getTexLevelDims(tex, level, &level_width, &level_height, &level_depth);
+
+            if (createTextureLevel(ctx, tex, face, level, is_array, internalformat, level_width, level_height,
+                                   level_depth, 0, 0, NULL, proxy) == false)
+                return;
+        }
+    }
+
+    // mark it immutable
+    tex->immutable_storage = BUFFER_IMMUTABLE_STORAGE_FLAG;
+
+    // bind it to metal
+    ctx->mtl_funcs.mtlBindTexture(ctx, tex);
+
+    ERROR_CHECK_RETURN(tex->mtl_data, GL_OUT_OF_MEMORY);
+}
+
+void mglTexStorage1D(GLMContext ctx, GLenum target, GLsizei levels, GLenum internalformat, GLsizei width)
+{
+    Texture *tex;
+    GLenum err;
+    GLboolean proxy;
+
+    proxy = false;
+
+    switch (target)
+    {
+    case GL_TEXTURE_1D:
+        break;
+
+    case GL_PROXY_TEXTURE_1D:
+        proxy = true;
         break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
     }
 
-    return true;
+    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+
+    err = getInternalFormatErrorForMetal(ctx, internalformat);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
+
+    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, 0, target);
+
+    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+
+    texStorage(ctx, tex, 1, levels, false, internalformat, width, 1, 1, proxy);
+}
+
+void mglTextureStorage1D(GLMContext ctx, GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width)
+{
+    Texture *tex;
+    GLenum err;
+
+    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+
+    err = getInternalFormatErrorForMetal(ctx, internalformat);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
+
+    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, texture, 0);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texStorage(ctx, tex, 1, levels, false, internalformat, width, 1, 1, false);
+}
+
+void mglTexStorage2D(GLMContext ctx, GLenum target, GLsizei levels, GLenum internalformat, GLsizei width,
+                     GLsizei height)
+{
+    Texture *tex;
+    GLenum err;
+    GLboolean is_array;
+    GLboolean proxy;
+    GLuint num_faces;
+
+    is_array = false;
+    proxy = false;
+    num_faces = 1;
+
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_RECTANGLE:
+        break;
+
+    case GL_PROXY_TEXTURE_2D:
+    case GL_PROXY_TEXTURE_RECTANGLE:
+        proxy = true;
+        break;
+
+    case GL_TEXTURE_CUBE_MAP:
+        num_faces = 6;
+        proxy = true;
+        break;
+
+    case GL_PROXY_TEXTURE_CUBE_MAP:
+        num_faces = 6;
+        proxy = true;
+        break;
+
+    case GL_TEXTURE_1D_ARRAY:
+        is_array = true;
+        break;
+
+    case GL_PROXY_TEXTURE_1D_ARRAY:
+        is_array = true;
+        proxy = true;
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+    }
+
+    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+
+    err = getInternalFormatErrorForMetal(ctx, internalformat);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
+
+    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, 0, target);
+
+    texStorage(ctx, tex, num_faces, levels, is_array, internalformat, width, height, 1, proxy);
+}
+
+void mglTextureStorage2D(GLMContext ctx, GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width,
+                         GLsizei height)
+{
+    Texture *tex;
+    GLenum err;
+
+    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+
+    err = getInternalFormatErrorForMetal(ctx, internalformat);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
+
+    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, texture, 0);
+
+    texStorage(ctx, tex, 1, levels, false, internalformat, width, height, 1, false);
 }
 
-void unpackTexture(GLMContext ctx, Texture *tex, GLuint face, GLuint level, void *src_data, void *dst_data,
-                   size_t src_pitch, size_t pixel_size, size_t xoffset, size_t yoffset, size_t zoffset, size_t width,
-                   size_t height, size_t depth)
-{
-    GLubyte *src, *dst;
-    size_t dst_pitch;
+void mglTextureStorage2DMultisample(GLMContext ctx, GLuint texture, GLsizei samples, GLenum internalformat,
+                                    GLsizei width, GLsizei height, GLboolean fixedsamplelocations)
+{
+    // Unimplemented function
+    assert(0);
+}
+
+void mglTexStorage3D(GLMContext ctx, GLenum target, GLsizei levels, GLenum internalformat, GLsizei width,
+                     GLsizei height, GLsizei depth)
+{
+    Texture *tex;
+    GLenum err;
+    GLboolean is_array;
+    GLboolean proxy;
+
+    is_array = false;
+    proxy = false;
+
+    switch (target)
+    {
+    case GL_TEXTURE_3D:
+        break;
+
+    case GL_PROXY_TEXTURE_3D:
+        proxy = true;
+        break;
+
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        is_array = true;
+        break;
+
+    case GL_PROXY_TEXTURE_2D_ARRAY:
+    case GL_PROXY_TEXTURE_CUBE_MAP_ARRAY:
+        is_array = true;
+        proxy = true;
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
+
+    ERROR_CHECK_RETURN(checkMaxLevels(levels, width, height, depth), GL_INVALID_OPERATION);
+    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+
+    err = getInternalFormatErrorForMetal(ctx, internalformat);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
+
+    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(depth > 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, 0, target);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texStorage(ctx, tex, 1, levels, is_array, internalformat, width, height, depth, proxy);
+}
+
+void mglTextureStorage3D(GLMContext ctx, GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width,
+                         GLsizei height, GLsizei depth)
+{
+    Texture *tex;
+    GLenum err;
+
+    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+
+    err = getInternalFormatErrorForMetal(ctx, internalformat);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
+
+    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
+    ERROR_CHECK_RETURN(depth > 0, GL_INVALID_VALUE);
+
+    tex = getTex(ctx, texture, 0);
+
+    createTextureLevel(ctx, tex, 0, 0, false, internalformat, width, height, depth, 0, 0, NULL, false);
+}
+
+void mglTextureStorage3DMultisample(GLMContext ctx, GLuint texture, GLsizei samples, GLenum internalformat,
+                                    GLsizei width, GLsizei height, GLsizei depth, GLboolean fixedsamplelocations)
+{
+    // Unimplemented function
+    assert(0);
+}
+
+#pragma mark clear tex image
+
+// gl's depth of a level, cube faces are its images
+static GLuint getTexLevelDepth(Texture *tex, GLint level)
+{
+    if (tex->target == GL_TEXTURE_CUBE_MAP)
+        return 6;
+
+    return MAX(tex->faces[0].levels[level].depth, 1);
+}
+
+// repeats a texel over a region of the level's shadow, whole rows and images go as one run
+static void fillTexLevel(TextureLevel *tex_level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width,
+                         GLsizei height, GLsizei depth, const void *value, size_t value_size)
+{
+    GLubyte *dst;
+    size_t pitch, image_size, row_size;
+
+    pitch = tex_level->pitch;
+    image_size = pitch * tex_level->height;
+    row_size = width * value_size;
+
+    dst = (GLubyte *)tex_level->data + zoffset * image_size + yoffset * pitch + xoffset * value_size;
+
+    if (row_size == pitch && height == tex_level->height)
+    {
+        patternFill(dst, image_size * depth, value, value_size);
+        return;
+    }
+
+    for (GLsizei z = 0; z < depth; z++)
+    {
+        if (row_size == pitch)
+        {
+            patternFill(dst + z * image_size, row_size * height, value, value_size);
+            continue;
+        }
+
+        for (GLsizei y = 0; y < height; y++)
+        {
+            patternFill(dst + z * image_size + y * pitch, row_size, value, value_size);
+        }
+    }
+}
+
+// the gpu is about to write it outside of a draw, the shadow under it is read back from here on.
+// a view's writes land in its parent. the mtl texture stays as it is, making it again would
+// lose what the gpu has in it
+static void setTextureGPUWritten(Texture *tex)
+{
+    if (tex->view_parent)
+        tex = tex->view_parent;
+
+    tex->gpu_written = true;
+}
+
+// the clear value is converted to a texel of the level once and repeated over the region. a
+// shadow that is the texture's contents is filled and the live texture gets the same region,
+// a texture the gpu writes or a view of one is only cleared on the gpu and its shadows are read
+// back from then on
+static bool clearTexImage(GLMContext ctx, Texture *tex, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                          GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *data)
+{
+    TextureLevel *tex_level;
+    PixelLayout src_layout, dst_layout;
+    GLubyte value[16];
+    size_t value_size;
+
+    ERROR_CHECK_RETURN_VALUE(tex->target != GL_TEXTURE_BUFFER, GL_INVALID_OPERATION, false);
+    ERROR_CHECK_RETURN_VALUE(tex->compressed == false, GL_INVALID_OPERATION, false);
+
+    ERROR_CHECK_RETURN_VALUE(level >= 0 && level < tex->num_levels, GL_INVALID_OPERATION, false);
+
+    tex_level = &tex->faces[0].levels[level];
+    ERROR_CHECK_RETURN_VALUE(tex_level->complete && tex_level->width, GL_INVALID_OPERATION, false);
+
+    // verifyFormatType sets the error
+    if (verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type) == false)
+        return false;
+
+    ERROR_CHECK_RETURN_VALUE(width >= 0 && height >= 0 && depth >= 0, GL_INVALID_VALUE, false);
+
+    ERROR_CHECK_RETURN_VALUE(xoffset >= 0 && xoffset + width <= tex_level->width, GL_INVALID_OPERATION, false);
+    ERROR_CHECK_RETURN_VALUE(yoffset >= 0 && yoffset + height <= MAX(tex_level->height, 1), GL_INVALID_OPERATION,
+                             false);
+    ERROR_CHECK_RETURN_VALUE(zoffset >= 0 && zoffset + depth <= getTexLevelDepth(tex, level), GL_INVALID_OPERATION,
+                             false);
+
+    if (width == 0 || height == 0 || depth == 0)
+        return true;
+
+    // the level's texel, what unpackTexture steps by
+    value_size = tex_level->pitch / tex_level->width;
+    ERROR_CHECK_RETURN_VALUE(value_size && value_size <= sizeof(value), GL_INVALID_OPERATION, false);
+
+    // a NULL value clears to zero
+    bzero(value, sizeof(value));
+
+    if (data)
+    {
+        src_layout = pixelLayoutForFormatType(format, type);
+        dst_layout = pixelLayoutForInternalFormat(tex->internalformat);
+
+        if (src_layout != dst_layout && canConvertPixels(dst_layout, src_layout))
+        {
+            pixelConvertToInternalFormat(ctx, tex->internalformat, format, type, data, value, 1);
+        }
+        else
+        {
+            // already a texel of the level or nothing converts it, it goes in as is like texSubImage
+            ERROR_CHECK_RETURN_VALUE(sizeForFormatType(format, type) == value_size, GL_INVALID_OPERATION, false);
+
+            memcpy(value, data, value_size);
+        }
+    }
 
-    src = (GLubyte *)src_data;
-    dst = (GLubyte *)dst_data;
+    writeTexRegion(tex, level, yoffset, height, zoffset, depth);
 
-    if (xoffset || yoffset || zoffset)
+    if (tex->view_parent || isTextureGPUWritten(tex))
     {
-        const size_t xbytes = xoffset * pixel_size;                  // num pixels
-        const size_t ybytes = yoffset * pixel_size * width;          // num lines
-        const size_t zbytes = zoffset * pixel_size * width * height; // num planes
+        setTextureGPUWritten(tex);
+
+        ctx->mtl_funcs.mtlClearTexImage(ctx, tex, level, xoffset, yoffset, zoffset, width, height, depth, value,
+                                        value_size);
 
-        dst += xbytes;
-        dst += ybytes;
-        dst += zbytes;
+        return true;
     }
 
-    assert(tex);
-    dst_pitch = tex->faces[face].levels[level].pitch;
-    assert(dst_pitch);
+    ERROR_CHECK_RETURN_VALUE(pinTextureShadow(ctx, tex), GL_OUT_OF_MEMORY, false);
 
-    if (depth > 1)
+    if (tex->target == GL_TEXTURE_CUBE_MAP)
     {
-        // 3d texture
-        for (int y = 0; y < depth; y++)
+        for (GLsizei i = 0; i < depth; i++)
         {
-            memcpy(dst, src, dst_pitch);
-            src += src_pitch;
-            dst += dst_pitch;
+            fillTexLevel(&tex->faces[zoffset + i].levels[level], xoffset, yoffset, 0, width, height, 1, value,
+                         value_size);
         }
     }
-    else if (height > 1)
+    else
     {
-        // 2d texture
-        for (int y = 0; y < height; y++)
-        {
-            memcpy(dst, src, width * pixel_size);
-            src += src_pitch;
-            dst += dst_pitch;
-        }
+        fillTexLevel(tex_level, xoffset, yoffset, zoffset, width, height, depth, value, value_size);
+    }
+
+    // a texture already up takes just the region, otherwise the levels go up on the next bind
+    if (tex->mtl_data && (tex->dirty_bits & DIRTY_TEXTURE_DATA) == 0)
+    {
+        ctx->mtl_funcs.mtlClearTexImage(ctx, tex, level, xoffset, yoffset, zoffset, width, height, depth, value,
+                                        value_size);
     }
     else
     {
-        // 1d texture
-        memcpy(dst, src, width * pixel_size);
+        tex->dirty_bits |= DIRTY_TEXTURE_DATA;
     }
+
+    return true;
 }
 
-#pragma mark texImage 1D/2D/3D
-bool createTextureLevel(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLboolean is_array,
-                        GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type,
-                        void *pixels, GLboolean proxy)
+void mglClearTexImage(GLMContext ctx, GLuint texture, GLint level, GLenum format, GLenum type, const void *data)
 {
-    // all the levels are created on a tex storage call.. if we get here we should just assert
-    if (tex->immutable_storage)
+    Texture *tex;
+    TextureLevel *tex_level;
+
+    tex = findTexture(ctx, texture);
+    if (tex == NULL)
     {
-        if (width != tex->width || height != tex->height || internalformat != tex->internalformat)
-        {
-            ERROR_RETURN(GL_INVALID_OPERATION);
-        }
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    if (level == 0)
+    if (level < 0 || level >= tex->num_levels)
     {
-        if (internalformat == 0)
-        {
-            internalformat = internalFormatForGLFormatType(format, type);
-
-            if (internalformat == 0)
-            {
-                ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
-            }
-        }
-        else if (pixels)
-        {
-            GLuint temp_format;
-
-            // check if format type can be copied directly to the internal format
-            temp_format = internalFormatForGLFormatType(format, type);
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-            // no pixel format conversion here
-            if (temp_format != internalformat)
-            {
-                ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
-            }
-        }
+    tex_level = &tex->faces[0].levels[level];
 
-        // see if we can actually use this internal format
-        if (checkInternalFormatForMetal(ctx, internalformat) == false)
-        {
-            ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
-        }
+    clearTexImage(ctx, tex, level, 0, 0, 0, tex_level->width, MAX(tex_level->height, 1),
+                  getTexLevelDepth(tex, level), format, type, data);
+}
 
-        if (tex->mipmap_levels == 0)
-        {
-            // uninitialized tex
-            initBaseTexLevel(ctx, tex, internalformat, width, height, depth);
-        }
-        else if (width != tex->width || height != tex->height || internalformat != tex->internalformat)
-        {
-            // invalidate texture because the base level width / height / internal format are being changed...
-            invalidateTexture(ctx, tex);
+void mglClearTexSubImage(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                         GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *data)
+{
+    Texture *tex;
 
-            initBaseTexLevel(ctx, tex, internalformat, width, height, depth);
-        }
-    }
-    else if (checkTexLevelParams(ctx, tex, level, internalformat, width, height, depth, format, type) == false)
+    tex = findTexture(ctx, texture);
+    if (tex == NULL)
     {
-        ERROR_RETURN_VALUE(GL_INVALID_OPERATION, false);
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
+    clearTexImage(ctx, tex, level, xoffset, yoffset, zoffset, width, height, depth, format, type, data);
+}
+
+#pragma mark compressed tex image
+
+// copies whole blocks into the level's shadow, the edit starts on a block and
+// covers whole blocks unless it runs to the edge of the level
+static bool compressedTexSubImage(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLint xoffset,
+                                  GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth,
+                                  GLenum format, GLsizei imageSize, const void *data)
+{
+    CompressedFormat compressed;
+    TextureLevel *tex_level;
+    size_t src_pitch, src_image_size, dst_image_size;
+    GLubyte *dst;
+
+    ERROR_CHECK_RETURN_VALUE(level >= 0 && level < tex->num_levels, GL_INVALID_VALUE, false);
+
+    tex_level = &tex->faces[face].levels[level];
+    ERROR_CHECK_RETURN_VALUE(tex_level->complete, GL_INVALID_OPERATION, false);
+
+    ERROR_CHECK_RETURN_VALUE(tex->compressed && format == tex->internalformat, GL_INVALID_OPERATION, false);
+    getCompressedFormat(format, &compressed);
+
+    ERROR_CHECK_RETURN_VALUE(xoffset >= 0 && yoffset >= 0 && zoffset >= 0, GL_INVALID_VALUE, false);
+    ERROR_CHECK_RETURN_VALUE(width >= 0 && height >= 0 && depth >= 0, GL_INVALID_VALUE, false);
+    ERROR_CHECK_RETURN_VALUE(xoffset + width <= tex_level->width, GL_INVALID_VALUE, false);
+    ERROR_CHECK_RETURN_VALUE(yoffset + height <= tex_level->height, GL_INVALID_VALUE, false);
+    ERROR_CHECK_RETURN_VALUE(zoffset + depth <= tex_level->depth, GL_INVALID_VALUE, false);
+
+    ERROR_CHECK_RETURN_VALUE(xoffset % compressed.block_width == 0, GL_INVALID_OPERATION, false);
+    ERROR_CHECK_RETURN_VALUE(yoffset % compressed.block_height == 0, GL_INVALID_OPERATION, false);
+    ERROR_CHECK_RETURN_VALUE(width % compressed.block_width == 0 || xoffset + width == tex_level->width,
+                             GL_INVALID_OPERATION, false);
+    ERROR_CHECK_RETURN_VALUE(height % compressed.block_height == 0 || yoffset + height == tex_level->height,
+                             GL_INVALID_OPERATION, false);
+
+    src_pitch = getCompressedRowSize(&compressed, width);
+    src_image_size = getCompressedImageSize(&compressed, width, height, 1);
+    ERROR_CHECK_RETURN_VALUE((size_t)imageSize == src_image_size * depth, GL_INVALID_VALUE, false);
+
     if (STATE(buffers[_PIXEL_UNPACK_BUFFER]))
     {
         Buffer *ptr;
+        size_t offset;
 
         ptr = STATE(buffers[_PIXEL_UNPACK_BUFFER]);
+        ERROR_CHECK_RETURN_VALUE(ptr->mapped == false, GL_INVALID_OPERATION, false);
 
-        ERROR_CHECK_RETURN(ptr->mapped == false, GL_INVALID_OPERATION);
+        // if a pixel buffer is the src, data is the offset
+        offset = (size_t)data;
+        ERROR_CHECK_RETURN_VALUE(offset + imageSize <= ptr->size, GL_INVALID_OPERATION, false);
 
-        GLubyte *buffer_data;
-        buffer_data = getBufferData(ctx, ptr);
+        data = (GLubyte *)getBufferData(ctx, ptr) + offset;
+    }
 
-        // if a pixel buffer is the src, pixels is the offset
-        // need to check offset against size
-        size_t offset;
-        offset = (size_t)pixels;
+    // no src data.. contents are undefined
+    if (data == NULL || imageSize == 0)
+        return true;
 
-        // Bounds check: offset should be reasonable for a buffer offset
-        if (offset >= ptr->data.buffer_size)
-        {
-            ERROR_RETURN_VALUE(GL_INVALID_VALUE, false);
-        }
+    // views write the blocks of their parent
+    tex = getViewStorage(tex, &face, &level, &yoffset, &zoffset);
+    tex_level = &tex->faces[face].levels[level];
 
-        pixels = &buffer_data[offset];
-    }
+    ERROR_CHECK_RETURN_VALUE(tex->target != GL_TEXTURE_CUBE_MAP || depth == 1, GL_INVALID_OPERATION, false);
 
-    tex->num_levels = MAX(tex->num_levels, level + 1);
+    ERROR_CHECK_RETURN_VALUE(pinTextureShadow(ctx, tex), GL_OUT_OF_MEMORY, false);
 
-    tex->faces[face].levels[level].width = width;
-    tex->faces[face].levels[level].height = height;
-    tex->faces[face].levels[level].depth = depth;
+    if (tex->target == GL_TEXTURE_CUBE_MAP)
+        writeTexImages(tex, level, face, 1);
+    else
+        writeTexRegion(tex, level, yoffset, height, zoffset, depth);
 
-    kern_return_t err;
-    vm_address_t texture_data;
-    size_t pixel_size;
-    size_t internal_size;
-    size_t texture_size;
-    size_t src_pitch;
+    dst_image_size = tex_level->data_size / tex_level->depth;
 
-    pixel_size = sizeForInternalFormat(internalformat, format, type);
-    ERROR_CHECK_RETURN_VALUE(pixel_size, GL_INVALID_ENUM, false);
+    dst = (GLubyte *)tex_level->data;
+    dst += zoffset * dst_image_size;
+    dst += (yoffset / compressed.block_height) * tex_level->pitch;
+    dst += (xoffset / compressed.block_width) * compressed.block_size;
 
-    assert(width);
-    assert(height);
-    assert(depth);
+    copyPixelRows(dst, tex_level->pitch, dst_image_size, data, src_pitch, src_image_size, src_pitch,
+                  src_image_size / src_pitch, depth, 0);
 
-    tex->faces[face].levels[level].pitch = pixel_size * width;
+    // goes up whole, decoded first if the device can't sample it
+    tex->dirty_bits |= DIRTY_TEXTURE_DATA;
+    STATE(dirty_bits) |= DIRTY_TEX;
 
-    if (depth > 1)
-    {
-        // 3d texture
-        internal_size = pixel_size * width * height * depth;
-    }
-    else if (height > 1)
+    return true;
+}
+
+static void compressedTexImage(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLboolean is_array,
+                               GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border,
+                               GLsizei imageSize, const void *data, GLboolean proxy)
+{
+    CompressedFormat compressed;
+
+    if (level < 0 || width < 0 || height < 0 || depth < 0 || border != 0)
     {
-        // 2d texture
-        internal_size = pixel_size * width * height;
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
     }
-    else
+
+    // the generic GL_COMPRESSED_* formats take uncompressed data through glTexImage
+    if (getCompressedFormat(internalformat, &compressed) == false)
     {
-        // 1d texture
-        internal_size = pixel_size * width;
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
     }
 
-    texture_size = page_size_align(internal_size);
-    assert(texture_size);
-
-    switch (mtlFormatForGLInternalFormat(internalformat))
+    if ((size_t)imageSize != getCompressedImageSize(&compressed, width, height, depth))
     {
-    case MTLPixelFormatDepth16Unorm:
-    case MTLPixelFormatDepth32Float:
-    case MTLPixelFormatDepth24Unorm_Stencil8:
-    case MTLPixelFormatDepth32Float_Stencil8:
-        tex->mtl_requires_private_storage = true;
-        break;
-
-    default:
-        tex->mtl_requires_private_storage = false;
-        break;
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
     }
 
-    if (tex->mtl_requires_private_storage == false)
+    if (tex == NULL)
     {
-        // Allocate directly from VM
-        err = vm_allocate((vm_map_t)mach_task_self(), (vm_address_t *)&texture_data, texture_size, VM_FLAGS_ANYWHERE);
-        assert(err == 0);
-        assert(texture_data);
-
-        tex->faces[face].levels[level].data_size = texture_size;
-        tex->faces[face].levels[level].data = (vm_address_t)texture_data;
-
-        if (pixels)
-        {
-            GLsizei src_size;
-
-            src_size = width * sizeForFormatType(format, type);
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-            if (ctx->state.unpack.row_length)
-            {
-                size_t alignment;
+    tex->access = GL_READ_ONLY;
 
-                ERROR_CHECK_RETURN((ctx->state.unpack.row_length >> level) >= width, GL_INVALID_VALUE);
+    if (createTextureLevel(ctx, tex, face, level, is_array, internalformat, width, height, depth, 0, 0, NULL,
+                           proxy) == false)
+        return;
 
-                alignment = ctx->state.unpack.alignment;
-                if (alignment)
-                {
-                    if (src_size >= alignment)
-                    {
-                        src_pitch = src_size * (ctx->state.unpack.row_length >> level);
-                        assert(src_pitch);
-                    }
-                    else if (depth > 1)
-                    {
-                        // 3d texture
-                        src_pitch = alignment / src_size;
+    if (proxy)
+        return;
 
-                        src_pitch = src_pitch * src_size * ctx->state.unpack.row_length * height;
+    compressedTexSubImage(ctx, tex, face, level, 0, 0, 0, width, height, depth, internalformat, imageSize, data);
+}
 
-                        src_pitch = src_pitch / alignment;
-                        assert(src_pitch);
-                    }
-                    else
-                    {
-                        src_pitch = alignment / src_size;
+void mglCompressedTexImage3D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLsizei width,
+                             GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void *data)
+{
+    CompressedFormat compressed;
+    GLboolean is_array;
+    GLboolean proxy;
 
-                        src_pitch = src_pitch * src_size * ctx->state.unpack.row_length;
+    is_array = false;
+    proxy = false;
 
-                        src_pitch = src_pitch / alignment;
-                        assert(src_pitch);
-                    }
-                }
-                else
-                {
-                    src_pitch = src_size * (ctx->state.unpack.row_length >> level);
-                    assert(src_pitch);
-                }
-            }
-            else
-            {
-                src_pitch = tex->faces[face].levels[level].pitch;
-                assert(src_pitch);
-            }
+    switch (target)
+    {
+    case GL_TEXTURE_3D:
+    case GL_PROXY_TEXTURE_3D:
+        proxy = (target == GL_PROXY_TEXTURE_3D);
 
-            // unpack from pixel buffer
-            if (STATE(buffers[_PIXEL_UNPACK_BUFFER]))
+        // only bptc has 3d blocks in core
+        if (getCompressedFormat(internalformat, &compressed))
+        {
+            if (compressed.blocks != COMPRESSED_BLOCKS_BC6H && compressed.blocks != COMPRESSED_BLOCKS_BC7)
             {
-                Buffer *ptr;
-
-                ptr = STATE(buffers[_PIXEL_UNPACK_BUFFER]);
-
-                ERROR_CHECK_RETURN(ptr->mapped == false, GL_INVALID_OPERATION);
-
-                GLubyte *buffer_data;
-                buffer_data = getBufferData(ctx, ptr);
-
-                // if a pixel buffer is the src, pixels is the offset
-                // need to check offset against size
-                size_t offset;
-                offset = (size_t)pixels;
-
-                pixels = &buffer_data[offset];
+                ERROR_RETURN(GL_INVALID_OPERATION);
+                return;
             }
+        }
+        break;
 
-            unpackTexture(ctx, tex, face, level, (void *)pixels, (void *)texture_data, src_pitch, pixel_size, 0, 0, 0,
-                          width, height, depth);
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_PROXY_TEXTURE_2D_ARRAY:
+        proxy = (target == GL_PROXY_TEXTURE_2D_ARRAY);
+        is_array = true;
+        break;
 
-            tex->dirty_bits |= DIRTY_TEXTURE_DATA;
-        };
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
     }
 
-    tex->faces[face].levels[level].complete = true;
-
-    tex->dirty_bits |= DIRTY_TEXTURE_LEVEL;
-    STATE(dirty_bits) |= DIRTY_TEX;
-
-    return true;
+    compressedTexImage(ctx, getTex(ctx, 0, target), 0, level, is_array, internalformat, width, height, depth, border,
+                       imageSize, data, proxy);
 }
 
-void mglTexImage1D(GLMContext ctx, GLenum target, GLint level, GLint internalformat, GLsizei width, GLint border,
-                   GLenum format, GLenum type, const void *pixels)
+void mglCompressedTexImage2D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLsizei width,
+                             GLsizei height, GLint border, GLsizei imageSize, const void *data)
 {
-    Texture *tex;
-    bool proxy;
+    GLuint face;
+    GLboolean proxy;
 
+    face = 0;
     proxy = false;
 
     switch (target)
     {
-    case GL_TEXTURE_1D:
+    case GL_TEXTURE_2D:
         break;
 
-    case GL_PROXY_TEXTURE_1D:
+    case GL_PROXY_TEXTURE_2D:
+    case GL_PROXY_TEXTURE_CUBE_MAP:
         proxy = true;
         break;
 
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
+        face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+        break;
+
     default:
         ERROR_RETURN(GL_INVALID_ENUM);
+        return;
     }
 
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+    compressedTexImage(ctx, getTex(ctx, 0, target), face, level, false, internalformat, width, height, 1, border,
+                       imageSize, data, proxy);
+}
 
-    // verifyFormatType sets the error
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, internalformat, format, type), 0);
+void mglCompressedTexImage1D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLsizei width,
+                             GLint border, GLsizei imageSize, const void *data)
+{
+    // none of the block formats have 1d blocks
+    ERROR_RETURN(GL_INVALID_ENUM);
+}
 
-    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+void mglCompressedTexSubImage3D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                                GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize,
+                                const void *data)
+{
+    Texture *tex;
 
-    ERROR_CHECK_RETURN(border == 0, GL_INVALID_VALUE);
+    switch (target)
+    {
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_2D_ARRAY:
+        break;
 
-    tex = getTex(ctx, 0, target);
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
 
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+    tex = getTex(ctx, 0, target);
 
-    tex->access = GL_READ_ONLY;
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-    createTextureLevel(ctx, tex, 0, level, false, internalformat, width, 1, 1, format, type, (void *)pixels, proxy);
+    compressedTexSubImage(ctx, tex, 0, level, xoffset, yoffset, zoffset, width, height, depth, format, imageSize,
+                          data);
 }
 
-void mglTexImage2D(GLMContext ctx, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
-                   GLint border, GLenum format, GLenum type, const void *pixels)
+void mglCompressedTexSubImage2D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+                                GLsizei height, GLenum format, GLsizei imageSize, const void *data)
 {
     Texture *tex;
     GLuint face;
-    GLboolean is_array;
-    GLboolean proxy;
 
     face = 0;
-    is_array = false;
-    proxy = false;
 
     switch (target)
     {
     case GL_TEXTURE_2D:
         break;
 
-    case GL_PROXY_TEXTURE_2D:
-    case GL_PROXY_TEXTURE_CUBE_MAP:
-        proxy = true;
-        break;
-
-    case GL_PROXY_TEXTURE_1D_ARRAY:
-        is_array = true;
-        proxy = true;
-        break;
-
     case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
     case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
     case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
@@ -1180,924 +3340,1317 @@ void mglTexImage2D(GLMContext ctx, GLenum target, GLint level, GLint internalfor
         face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
         break;
 
-    case GL_PROXY_TEXTURE_RECTANGLE:
-        proxy = true;
-        ERROR_CHECK_RETURN(level == 0, GL_INVALID_OPERATION);
-        break;
-
-    case GL_TEXTURE_RECTANGLE:
-        ERROR_CHECK_RETURN(level == 0, GL_INVALID_OPERATION);
-        break;
-
     default:
         ERROR_RETURN(GL_INVALID_ENUM);
+        return;
     }
 
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
-
-    // verifyFormatType sets the error
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, internalformat, format, type), 0);
-
-    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
-
-    ERROR_CHECK_RETURN(border == 0, GL_INVALID_VALUE);
-
     tex = getTex(ctx, 0, target);
 
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-    tex->access = GL_READ_ONLY;
+    compressedTexSubImage(ctx, tex, face, level, xoffset, yoffset, 0, width, height, 1, format, imageSize, data);
+}
 
-    createTextureLevel(ctx, tex, face, level, is_array, internalformat, width, height, 1, format, type, (void *)pixels,
-                       proxy);
+void mglCompressedTexSubImage1D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLsizei width, GLenum format,
+                                GLsizei imageSize, const void *data)
+{
+    // none of the block formats have 1d blocks
+    ERROR_RETURN(GL_INVALID_ENUM);
 }
 
-void mglTexImage2DMultisample(GLMContext ctx, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width,
-                              GLsizei height, GLboolean fixedsamplelocations)
+#pragma mark copy tex
+void mglCopyTexImage1D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLint x, GLint y,
+                       GLsizei width, GLint border)
 {
     // Unimplemented function
     assert(0);
 }
 
-void mglTexImage3D(GLMContext ctx, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
-                   GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels)
+void mglCopyTexImage2D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLint x, GLint y,
+                       GLsizei width, GLsizei height, GLint border)
 {
-    Texture *tex;
-    GLboolean is_array;
-    GLboolean proxy;
-
-    is_array = false;
-    proxy = false;
-
-    switch (target)
-    {
-    case GL_TEXTURE_3D:
-        break;
-
-    case GL_PROXY_TEXTURE_3D:
-        proxy = true;
-        break;
-
-    case GL_TEXTURE_2D_ARRAY:
-    case GL_PROXY_TEXTURE_2D_ARRAY:
-        is_array = true;
-        break;
-
-    default:
-        ERROR_RETURN(GL_INVALID_ENUM);
-    }
-
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
-
-    // verifyFormatType sets the error
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, internalformat, format, type), 0);
-
-    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(depth >= 0, GL_INVALID_VALUE);
-
-    ERROR_CHECK_RETURN(border == 0, GL_INVALID_VALUE);
+    // Unimplemented function
+    assert(0);
+}
 
-    tex = getTex(ctx, 0, target);
+void mglCopyTexSubImage1D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint x, GLint y, GLsizei width)
+{
+    // Unimplemented function
+    assert(0);
+}
 
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+void mglCopyTexSubImage2D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y,
+                          GLsizei width, GLsizei height)
+{
+    // Unimplemented function
+    assert(0);
+}
 
-    tex->access = GL_READ_ONLY;
+void mglCopyTexSubImage3D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                          GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    // Unimplemented function
+    assert(0);
+}
 
-    createTextureLevel(ctx, tex, 0, level, is_array, internalformat, width, height, depth, format, type, (void *)pixels,
-                       proxy);
+void mglCopyTextureSubImage1D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint x, GLint y,
+                              GLsizei width)
+{
+    // Unimplemented function
+    assert(0);
 }
 
-void mglTexImage3DMultisample(GLMContext ctx, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width,
-                              GLsizei height, GLsizei depth, GLboolean fixedsamplelocations)
+void mglCopyTextureSubImage2D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint x,
+                              GLint y, GLsizei width, GLsizei height)
 {
     // Unimplemented function
     assert(0);
 }
 
-#pragma mark texSubImage
-bool texSubImage(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                 GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, void *pixels)
+void mglCopyTextureSubImage3D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                              GLint x, GLint y, GLsizei width, GLsizei height)
 {
-    ERROR_CHECK_RETURN_VALUE(level <= tex->num_levels, GL_INVALID_OPERATION, false);
+    // Unimplemented function
+    assert(0);
+}
 
-    ERROR_CHECK_RETURN_VALUE(tex->faces[face].levels[level].complete, GL_INVALID_OPERATION, false);
+#pragma mark copy image sub data
 
-    // unpack from pixel buffer
-    if (STATE(buffers[_PIXEL_UNPACK_BUFFER]))
-    {
-        Buffer *ptr;
+// the texture and level one end of a copy names, renderbuffers copy through their texture
+static GLenum getCopyImage(GLMContext ctx, GLuint name, GLenum target, GLint level, CopyImageRegion *image)
+{
+    Texture *tex;
+    TextureLevel *tex_level;
+    CompressedFormat compressed;
 
-        ptr = STATE(buffers[_PIXEL_UNPACK_BUFFER]);
+    switch (target)
+    {
+    case GL_RENDERBUFFER: {
+        Renderbuffer *rbo;
 
-        ERROR_CHECK_RETURN(ptr->mapped == false, GL_INVALID_OPERATION);
+        rbo = findRenderbuffer(ctx, name);
+        if (rbo == NULL)
+            return GL_INVALID_VALUE;
 
-        GLubyte *buffer_data;
-        buffer_data = getBufferData(ctx, ptr);
+        // no storage yet
+        tex = rbo->tex;
+        if (tex == NULL)
+            return GL_INVALID_OPERATION;
+        break;
+    }
 
-        // if a pixel buffer is the src, pixels is the offset
-        // need to check offset against size
-        size_t offset;
-        offset = (size_t)pixels;
+    case GL_TEXTURE_1D:
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_RECTANGLE:
+    case GL_TEXTURE_1D_ARRAY:
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+    case GL_TEXTURE_2D_MULTISAMPLE:
+    case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+        tex = findTexture(ctx, name);
+        if (tex == NULL)
+            return GL_INVALID_VALUE;
 
-        // Bounds check: offset should be reasonable for a buffer offset
-        if (offset >= ptr->data.buffer_size)
-        {
-            ERROR_RETURN_VALUE(GL_INVALID_VALUE, false);
-        }
+        if (tex->target != target)
+            return GL_INVALID_ENUM;
+        break;
 
-        pixels = &buffer_data[offset];
+    // buffer textures included
+    default:
+        return GL_INVALID_ENUM;
     }
 
-    // no src data.. return
-    ERROR_CHECK_RETURN(pixels, GL_INVALID_OPERATION);
+    if (level < 0 || level >= tex->num_levels)
+        return GL_INVALID_VALUE;
 
-    size_t pixel_size;
-    size_t src_size;
-    size_t src_pitch;
+    tex_level = &tex->faces[0].levels[level];
+    if (tex_level->complete == false || tex_level->width == 0)
+        return GL_INVALID_OPERATION;
 
-    pixel_size = sizeForFormatType(format, type);
-    src_size = width * pixel_size;
+    image->tex = tex;
+    image->level = level;
 
-    if (ctx->state.unpack.row_length)
+    if (tex->compressed && getCompressedFormat(tex->internalformat, &compressed))
     {
-        size_t alignment;
-
-        ERROR_CHECK_RETURN((ctx->state.unpack.row_length >> level) >= width, GL_INVALID_VALUE);
-
-        alignment = ctx->state.unpack.alignment;
-        if (alignment)
-        {
-            if (src_size >= alignment)
-            {
-                src_pitch = src_size * (ctx->state.unpack.row_length >> level);
-                assert(src_pitch);
-            }
-            else if (depth > 1)
-            {
-                // 3d texture
-                src_pitch = alignment / src_size;
-
-                src_pitch = src_pitch * src_size * ctx->state.unpack.row_length * height;
-
-                src_pitch = src_pitch / alignment;
-                assert(src_pitch);
-            }
-            else
-            {
-                src_pitch = alignment / src_size;
-
-                src_pitch = src_pitch * src_size * ctx->state.unpack.row_length;
-
-                src_pitch = src_pitch / alignment;
-                assert(src_pitch);
-            }
-        }
-        else
-        {
-            src_pitch = src_size * (ctx->state.unpack.row_length >> level);
-            assert(src_pitch);
-        }
+        image->block_width = compressed.block_width;
+        image->block_height = compressed.block_height;
+        image->unit_size = compressed.block_size;
     }
     else
     {
-        src_pitch = src_size;
-        assert(src_pitch);
+        image->block_width = 1;
+        image->block_height = 1;
+        image->unit_size = tex_level->pitch / tex_level->width;
     }
 
-    void *texture_data;
-
-    texture_data = (void *)tex->faces[face].levels[level].data;
-
-    unpackTexture(ctx, tex, face, level, pixels, texture_data, src_pitch, pixel_size, xoffset, yoffset, zoffset, width,
-                  height, depth);
-
-    // use a blit command to update data
-    do
-    {
-        Buffer *buf;
-
-        buf = STATE(buffers[_PIXEL_UNPACK_BUFFER]);
-
-        if (buf == NULL)
-            continue;
-
-        if (tex->mtl_data == NULL)
-            continue;
+    return GL_NO_ERROR;
+}
 
-        size_t src_offset;
-        size_t src_image_size;
-        size_t src_size;
+// the region has to be in the level, block images take whole blocks unless it runs to the edge
+static GLenum setCopyImageRegion(CopyImageRegion *image, GLint x, GLint y, GLint z, GLsizei width, GLsizei height,
+                                 GLsizei depth)
+{
+    TextureLevel *tex_level;
+    GLint level_height;
 
-        src_offset = (size_t)0;
+    tex_level = &image->tex->faces[0].levels[image->level];
+    level_height = MAX(tex_level->height, 1);
 
-        src_image_size = src_pitch * height;
+    if (x < 0 || y < 0 || z < 0 || width < 0 || height < 0 || depth < 0)
+        return GL_INVALID_VALUE;
 
-        src_size = src_image_size * depth;
+    if (x + width > tex_level->width || y + height > level_height ||
+        z + depth > getTexLevelDepth(image->tex, image->level))
+        return GL_INVALID_VALUE;
 
-        ctx->mtl_funcs.mtlTexSubImage(ctx, tex, buf, src_offset, src_pitch, src_image_size, src_size, zoffset, level,
-                                      width, height, depth, xoffset, yoffset, zoffset);
+    if (x % image->block_width || y % image->block_height)
+        return GL_INVALID_VALUE;
 
-        return true;
-    } while (false);
+    if ((width % image->block_width && x + width != tex_level->width) ||
+        (height % image->block_height && y + height != level_height))
+        return GL_INVALID_VALUE;
 
-    // use process gl to upload texture data
-    tex->dirty_bits |= DIRTY_TEXTURE_DATA;
+    image->x = x;
+    image->y = y;
+    image->z = z;
+    image->width = width;
+    image->height = height;
+    image->depth = depth;
 
-    return true;
+    return GL_NO_ERROR;
 }
 
-#pragma mark texSubImage1D
-void texSubImage1D(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLint xoffset, GLsizei width, GLenum format,
-                   GLenum type, const void *pixels)
+// a row of texels or blocks of the region in the shadow, rows count down each image in turn.
+// 1d array layers are rows and cube faces are images, the way gl counts them
+static GLubyte *getCopyImageRow(const CopyImageRegion *image, size_t rows, size_t row)
 {
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
-
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+    TextureLevel *tex_level;
+    GLuint face, z;
+    size_t image_size;
 
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+    face = 0;
+    z = image->z + row / rows;
 
-    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
+    if (image->tex->target == GL_TEXTURE_CUBE_MAP)
+    {
+        face = z;
+        z = 0;
+    }
 
-    ERROR_CHECK_RETURN(width + xoffset < tex->width, GL_INVALID_VALUE);
+    tex_level = &image->tex->faces[face].levels[image->level];
+    image_size = tex_level->data_size / MAX(tex_level->depth, 1);
 
-    texSubImage(ctx, tex, face, level, xoffset, 0, 0, width, 1, 1, format, type, (void *)pixels);
+    return ((GLubyte *)tex_level->data + z * image_size +
+            (image->y / image->block_height + row % rows) * tex_level->pitch +
+            (image->x / image->block_width) * image->unit_size);
 }
 
-void mglTexSubImage1D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLsizei width, GLenum format,
-                      GLenum type, const void *pixels)
+// both ends hold the same bytes in the same number of rows, a strided copy an image at a time
+static void copyImageShadow(const CopyImageRegion *src, const CopyImageRegion *dst)
 {
-    Texture *tex;
-
-    switch (target)
-    {
-    case GL_TEXTURE_1D:
-        break;
-
-    default:
-        ERROR_RETURN(GL_INVALID_ENUM);
-    }
+    size_t row_size, rows;
+    size_t src_pitch, dst_pitch;
 
-    tex = getTex(ctx, 0, target);
+    row_size = (src->width + src->block_width - 1) / src->block_width * src->unit_size;
+    rows = (src->height + src->block_height - 1) / src->block_height;
 
-    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+    src_pitch = src->tex->faces[0].levels[src->level].pitch;
+    dst_pitch = dst->tex->faces[0].levels[dst->level].pitch;
 
-    texSubImage1D(ctx, tex, 0, level, xoffset, width, format, type, pixels);
+    for (size_t row = 0; row < rows * src->depth; row += rows)
+    {
+        copyPixelRows(getCopyImageRow(dst, rows, row), dst_pitch, 0, getCopyImageRow(src, rows, row), src_pitch, 0,
+                      row_size, rows, 1, 0);
+    }
 }
 
-void mglTextureSubImage1D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLsizei width, GLenum format,
-                          GLenum type, const void *pixels)
+// textures whose shadows are their contents copy shadow to shadow, and a destination already up
+// takes the region in one blit. anything the gpu writes is copied there, copies in a row share
+// a blit encoder
+void mglCopyImageSubData(GLMContext ctx, GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX, GLint srcY,
+                         GLint srcZ, GLuint dstName, GLenum dstTarget, GLint dstLevel, GLint dstX, GLint dstY,
+                         GLint dstZ, GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth)
 {
-    Texture *tex;
+    CopyImageRegion src, dst;
+    GLsizei dst_width, dst_height;
+    GLenum err;
+    bool compatible, decoded;
 
-    tex = getTex(ctx, texture, 0);
+    err = getCopyImage(ctx, srcName, srcTarget, srcLevel, &src);
+    if (err == GL_NO_ERROR)
+        err = getCopyImage(ctx, dstName, dstTarget, dstLevel, &dst);
 
-    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
 
-    texSubImage1D(ctx, tex, 0, level, xoffset, width, format, type, pixels);
-}
+    // formats of a view class, or a block the size of the other end's texel
+    if (src.tex->compressed == dst.tex->compressed)
+        compatible = isViewCompatibleFormat(src.tex->internalformat, dst.tex->internalformat);
+    else
+        compatible = (src.unit_size == dst.unit_size);
 
-#pragma mark texSubImage2D
-bool texSubImage2D(GLMContext ctx, Texture *tex, GLuint face, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
-                   GLsizei height, GLenum format, GLenum type, const void *pixels)
-{
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
+    if (compatible == false)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+    // the same texels or blocks measured in the destination's texels
+    dst_width = srcWidth;
+    dst_height = srcHeight;
+
+    if (src.block_width != dst.block_width || src.block_height != dst.block_height)
+    {
+        dst_width = (srcWidth + src.block_width - 1) / src.block_width * dst.block_width;
+        dst_height = (srcHeight + src.block_height - 1) / src.block_height * dst.block_height;
+    }
 
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+    err = setCopyImageRegion(&src, srcX, srcY, srcZ, srcWidth, srcHeight, srcDepth);
+    if (err == GL_NO_ERROR)
+        err = setCopyImageRegion(&dst, dstX, dstY, dstZ, dst_width, dst_height, srcDepth);
 
-    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
+    if (err)
+    {
+        ERROR_RETURN(err);
+        return;
+    }
 
-    ERROR_CHECK_RETURN(width + xoffset <= tex->width, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height + yoffset <= tex->height, GL_INVALID_VALUE);
+    if (srcWidth == 0 || srcHeight == 0 || srcDepth == 0)
+        return;
 
-    texSubImage(ctx, tex, face, level, xoffset, yoffset, 0, width, height, 1, format, type, (void *)pixels);
+    // blocks decoded for the device are only blocks in the shadow
+    decoded = (src.tex->decoded_format || dst.tex->decoded_format);
 
-    return true;
-}
+    if (src.tex->view_parent == NULL && isTextureGPUWritten(src.tex) == false && dst.tex->view_parent == NULL &&
+        isTextureGPUWritten(dst.tex) == false)
+    {
+        if (pinTextureShadow(ctx, src.tex) == false || pinTextureShadow(ctx, dst.tex) == false)
+        {
+            ERROR_RETURN(GL_OUT_OF_MEMORY);
+            return;
+        }
 
-void mglTexSubImage2D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
-                      GLsizei height, GLenum format, GLenum type, const void *pixels)
-{
-    Texture *tex;
-    GLuint face;
+        writeTexRegion(dst.tex, dst.level, dst.y, dst.height, dst.z, dst.depth);
 
-    face = 0;
+        copyImageShadow(&src, &dst);
 
-    switch (target)
-    {
-    case GL_TEXTURE_2D:
-    case GL_TEXTURE_1D_ARRAY:
-    case GL_TEXTURE_RECTANGLE:
-        break;
+        if (dst.tex->mtl_data && (dst.tex->dirty_bits & DIRTY_TEXTURE_DATA) == 0 && decoded == false)
+            ctx->mtl_funcs.mtlCopyImageSubData(ctx, &src, &dst);
+        else
+            dst.tex->dirty_bits |= DIRTY_TEXTURE_DATA;
 
-    case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
-    case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
-    case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
-    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
-    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
-    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
-        face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
-        break;
+        return;
+    }
 
-    default:
-        ERROR_RETURN(GL_INVALID_ENUM);
+    if (decoded)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    tex = getTex(ctx, 0, target);
+    writeTexRegion(dst.tex, dst.level, dst.y, dst.height, dst.z, dst.depth);
 
-    texSubImage2D(ctx, tex, face, level, xoffset, yoffset, width, height, format, type, pixels);
+    setTextureGPUWritten(dst.tex);
+
+    ctx->mtl_funcs.mtlCopyImageSubData(ctx, &src, &dst);
 }
 
-void mglTextureSubImage2D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
-                          GLsizei height, GLenum format, GLenum type, const void *pixels)
-{
-    Texture *tex;
+#pragma mark get tex image
 
-    tex = getTex(ctx, texture, 0);
+// the level's shadow has what the gpu copy has, or something newer waiting to upload. mip
+// levels the gpu made are only in the gpu copy, like anything else it writes
+static bool isTextureShadowCurrent(Texture *tex, GLuint face, GLint level)
+{
+    if (tex->faces[face].levels[level].data == 0 || tex->shadow_evicted)
+        return false;
 
-    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+    if (tex->mtl_data == NULL || (tex->dirty_bits & DIRTY_TEXTURE_DATA))
+        return true;
 
-    texSubImage2D(ctx, tex, 0, level, xoffset, yoffset, width, height, format, type, pixels);
+    return (isTextureGPUWritten(tex) == false);
 }
 
-#pragma mark texSubImage3D
-void texSubImage3D(GLMContext ctx, Texture *tex, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                   GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+// the blocks of a face and level, a view's are the layers it has of its parent's level
+static void *getCompressedLevelData(Texture *tex, GLuint face, GLint level, size_t *size)
 {
+    TextureLevel *tex_level;
+    Texture *storage;
+    GLuint storage_face;
+    GLint storage_level, storage_yoffset, storage_zoffset;
+    size_t image_size;
 
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
-
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+    storage_face = face;
+    storage_level = level;
+    storage_yoffset = 0;
+    storage_zoffset = 0;
 
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+    storage = getViewStorage(tex, &storage_face, &storage_level, &storage_yoffset, &storage_zoffset);
+    tex_level = &storage->faces[storage_face].levels[storage_level];
 
-    ERROR_CHECK_RETURN(width >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(depth >= 0, GL_INVALID_VALUE);
+    if (tex_level->data == 0)
+        return NULL;
 
-    ERROR_CHECK_RETURN(width + xoffset <= tex->width, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height + yoffset <= tex->height, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(depth + zoffset <= tex->depth, GL_INVALID_VALUE);
+    image_size = tex_level->data_size / tex_level->depth;
+    *size = image_size * tex->faces[face].levels[level].depth;
 
-    texSubImage(ctx, tex, 0, level, xoffset, yoffset, zoffset, width, height, depth, format, type, (void *)pixels);
+    return (void *)(tex_level->data + storage_zoffset * image_size);
 }
 
-void mglTexSubImage3D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                      GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+// a level comes back as num_faces faces of depth images each, the layers of an array or the
+// slices of a 3d texture. everything is checked before the pack buffer is touched
+static void getTexImage(GLMContext ctx, Texture *tex, GLuint face, GLuint num_faces, GLint level, GLenum format,
+                        GLenum type, size_t buf_size, void *pixels)
 {
-    Texture *tex;
+    PixelStoreLayout layout;
+    PixelLayout dst_pixel_layout, src_pixel_layout;
+    CompressedFormat compressed;
+    GLuint width, height, depth;
+    size_t src_pitch, src_image_pitch, face_pitch, offset;
+    Buffer *pack_buffer;
+    GLubyte *dst;
+    void *temp;
 
-    switch (target)
+    if (level >= tex->num_levels)
     {
-    case GL_TEXTURE_3D:
-    case GL_TEXTURE_2D_ARRAY:
-        break;
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-    default:
-        ERROR_RETURN(GL_INVALID_ENUM);
+    width = tex->faces[face].levels[level].width;
+    height = tex->faces[face].levels[level].height;
+    depth = MAX(tex->faces[face].levels[level].depth, 1);
+
+    if (width == 0 || height == 0)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    tex = getTex(ctx, 0, target);
+    dst_pixel_layout = pixelLayoutForFormatType(format, type);
+    src_pixel_layout = pixelLayoutForInternalFormat(tex->internalformat);
+    src_pitch = tex->faces[face].levels[level].pitch;
 
-    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+    // blocks are decoded and packed from there, bptc and astc have no decoder
+    if (tex->compressed)
+    {
+        getCompressedFormat(tex->internalformat, &compressed);
 
-    texSubImage3D(ctx, tex, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
-}
+        if (compressed.decoded_format == 0)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
 
-void mglTextureSubImage3D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                          GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
-{
-    Texture *tex;
+        src_pixel_layout = pixelLayoutForInternalFormat(compressed.decoded_format);
+        src_pitch = compressed.decoded_size * width;
+    }
 
-    tex = getTex(ctx, texture, 0);
+    // formats the converter doesn't know come back as they're stored
+    if (src_pixel_layout == PIXEL_LAYOUT_INVALID || dst_pixel_layout == PIXEL_LAYOUT_INVALID)
+    {
+        if (sizeForFormatType(format, type) * width != src_pitch)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
 
-    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+        src_pixel_layout = dst_pixel_layout;
+    }
 
-    texSubImage3D(ctx, tex, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
-}
+    src_image_pitch = src_pitch * height;
 
-#pragma mark TexStorage
+    getPackLayout(ctx, format, type, (num_faces * depth > 1), width, height, num_faces * depth, &layout);
+    face_pitch = layout.image_pitch * depth;
 
-void texStorage(GLMContext ctx, Texture *tex, GLuint faces, GLsizei levels, GLboolean is_array, GLenum internalformat,
-                GLsizei width, GLsizei height, GLsizei depth, GLboolean proxy)
-{
-    tex->access = GL_READ_ONLY;
+    pack_buffer = STATE(buffers[_PIXEL_PACK_BUFFER]);
+    offset = 0;
 
-    for (int face = 0; face < faces; face++)
+    if (pack_buffer)
+    {
+        // pixels is an offset into the pack buffer
+        offset = (size_t)pixels;
+
+        if (pack_buffer->mapped || offset + layout.size > pack_buffer->size || (offset % sizeForType(type)) != 0)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
+    }
+    else
     {
-        GLuint level_width, level_height;
+        if (pixels == NULL)
+        {
+            ERROR_RETURN(GL_INVALID_VALUE);
+            return;
+        }
+
+        if (layout.size > buf_size)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
+    }
 
-        level_width = width;
-        level_height = height;
+    if (tex->compressed)
+    {
+        size_t size;
 
-        for (int level = 0; level < levels; level++)
+        if (pinTextureShadow(ctx, tex->view_parent ? tex->view_parent : tex) == false)
         {
-            createTextureLevel(ctx, tex, face, level, is_array, internalformat, level_width, level_height, depth, 0, 0,
-                               NULL, proxy);
+            ERROR_RETURN(GL_OUT_OF_MEMORY);
+            return;
+        }
 
-            level_width >>= 1;
-            level_height >>= 1;
+        for (GLuint i = face; i < face + num_faces; i++)
+        {
+            if (getCompressedLevelData(tex, i, level, &size) == NULL)
+            {
+                ERROR_RETURN(GL_INVALID_OPERATION);
+                return;
+            }
         }
     }
+    else
+    {
+        // views have no shadow, they read what the gpu has once the parent's levels are up
+        if (tex->view_parent)
+        {
+            ctx->mtl_funcs.mtlBindTexture(ctx, tex);
 
-    // mark it immutable
-    tex->immutable_storage = BUFFER_IMMUTABLE_STORAGE_FLAG;
+            if (tex->mtl_data == NULL)
+            {
+                ERROR_RETURN(GL_OUT_OF_MEMORY);
+                return;
+            }
+        }
 
-    // bind it to metal
-    ctx->mtl_funcs.mtlBindTexture(ctx, tex);
+        // not on the gpu yet, a level without a shadow reads back as what it gets one with
+        if (tex->mtl_data == NULL && pinTextureShadow(ctx, tex) == false)
+        {
+            ERROR_RETURN(GL_OUT_OF_MEMORY);
+            return;
+        }
+    }
 
-    ERROR_CHECK_RETURN(tex->mtl_data, GL_OUT_OF_MEMORY);
-}
+    // decoded blocks and gpu rows that aren't in the client's layout go through here
+    temp = NULL;
 
-void mglTexStorage1D(GLMContext ctx, GLenum target, GLsizei levels, GLenum internalformat, GLsizei width)
-{
-    Texture *tex;
-    GLboolean proxy;
+    if (tex->compressed || src_pixel_layout != dst_pixel_layout || layout.swap_size)
+    {
+        temp = malloc(src_image_pitch * depth);
 
-    proxy = false;
+        if (temp == NULL)
+        {
+            ERROR_RETURN(GL_OUT_OF_MEMORY);
+            return;
+        }
+    }
 
-    switch (target)
+    if (pack_buffer)
     {
-    case GL_TEXTURE_1D:
-        break;
+        if (pack_buffer->data.mtl_data || pack_buffer->data.slab)
+        {
+            ctx->mtl_funcs.mtlRenameBuffer(ctx, pack_buffer, true);
+        }
 
-    case GL_PROXY_TEXTURE_1D:
-        proxy = true;
-        break;
+        dst = (GLubyte *)pack_buffer->data.buffer_data + offset;
 
-    default:
-        ERROR_RETURN(GL_INVALID_ENUM);
+        setBufferDataDirty(pack_buffer, offset + layout.offset, layout.size - layout.offset);
+        ctx->state.dirty_bits |= DIRTY_BUFFER;
+    }
+    else
+    {
+        dst = (GLubyte *)pixels;
     }
 
-    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
-
-    ERROR_CHECK_RETURN(checkInternalFormatForMetal(ctx, internalformat), GL_INVALID_OPERATION);
+    if (tex->compressed == false)
+    {
+        finishTextureGPUWrites(ctx, tex);
+    }
 
-    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+    for (GLuint i = 0; i < num_faces; i++)
+    {
+        TextureLevel *tex_level;
+        GLubyte *face_dst;
 
-    tex = getTex(ctx, 0, target);
+        tex_level = &tex->faces[face + i].levels[level];
+        face_dst = dst + i * face_pitch;
 
-    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+        if (tex->compressed)
+        {
+            void *blocks;
+            size_t size;
 
-    texStorage(ctx, tex, 1, levels, false, internalformat, width, 1, 1, proxy);
-}
+            blocks = getCompressedLevelData(tex, face + i, level, &size);
 
-void mglTextureStorage1D(GLMContext ctx, GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width)
-{
-    Texture *tex;
+            decodeCompressedImage(&compressed, temp, src_pitch, src_image_pitch, blocks, tex_level->pitch,
+                                  size / depth, width, height, depth);
 
-    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+            packPixelRows(face_dst, &layout, dst_pixel_layout, temp, src_pitch, src_image_pitch, src_pixel_layout,
+                          width, height, depth);
+            continue;
+        }
 
-    ERROR_CHECK_RETURN(checkInternalFormatForMetal(ctx, internalformat), GL_INVALID_OPERATION);
+        if (isTextureShadowCurrent(tex, face + i, level))
+        {
+            packPixelRows(face_dst, &layout, dst_pixel_layout, (void *)tex_level->data, tex_level->pitch,
+                          tex_level->data_size / depth, src_pixel_layout, width, height, depth);
+            continue;
+        }
 
-    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
+        // same layout and nothing to skip or swap, metal writes the rows where they go
+        if (temp == NULL)
+        {
+            ctx->mtl_funcs.mtlGetTexImage(ctx, tex, face_dst + layout.offset, (GLuint)layout.row_pitch,
+                                          (GLuint)layout.image_pitch, 0, 0, face + i, width, height, depth, level);
+            continue;
+        }
 
-    tex = getTex(ctx, texture, 0);
+        ctx->mtl_funcs.mtlGetTexImage(ctx, tex, temp, (GLuint)src_pitch, (GLuint)src_image_pitch, 0, 0, face + i,
+                                      width, height, depth, level);
 
-    ERROR_CHECK_RETURN(tex != NULL, GL_INVALID_OPERATION);
+        packPixelRows(face_dst, &layout, dst_pixel_layout, temp, src_pitch, src_image_pitch, src_pixel_layout, width,
+                      height, depth);
+    }
 
-    texStorage(ctx, tex, 1, levels, false, internalformat, width, 1, 1, false);
+    free(temp);
 }
 
-void mglTexStorage2D(GLMContext ctx, GLenum target, GLsizei levels, GLenum internalformat, GLsizei width,
-                     GLsizei height)
+static void getnTexImage(GLMContext ctx, GLenum target, GLint level, GLenum format, GLenum type, size_t buf_size,
+                         void *pixels)
 {
     Texture *tex;
-    GLboolean is_array;
-    GLboolean proxy;
-    GLuint num_faces;
+    GLuint face;
 
-    is_array = false;
-    proxy = false;
-    num_faces = 1;
+    face = 0;
 
     switch (target)
     {
+    case GL_TEXTURE_1D:
     case GL_TEXTURE_2D:
-    case GL_TEXTURE_RECTANGLE:
-        break;
-
-    case GL_PROXY_TEXTURE_2D:
-    case GL_PROXY_TEXTURE_RECTANGLE:
-        proxy = true;
-        break;
-
-    case GL_TEXTURE_CUBE_MAP:
-        num_faces = 6;
-        proxy = true;
-        break;
-
-    case GL_PROXY_TEXTURE_CUBE_MAP:
-        num_faces = 6;
-        proxy = true;
-        break;
-
+    case GL_TEXTURE_3D:
     case GL_TEXTURE_1D_ARRAY:
-        is_array = true;
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_RECTANGLE:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
         break;
 
-    case GL_PROXY_TEXTURE_1D_ARRAY:
-        is_array = true;
-        proxy = true;
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
+        face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+        target = GL_TEXTURE_CUBE_MAP;
         break;
 
     default:
         ERROR_RETURN(GL_INVALID_ENUM);
+        return;
     }
 
-    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+    if (level < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-    ERROR_CHECK_RETURN(checkInternalFormatForMetal(ctx, internalformat), GL_INVALID_OPERATION);
+    tex = getTex(ctx, 0, target);
 
-    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
+    // Check format/type match, it raises the error
+    if (verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type) == false)
+        return;
 
-    tex = getTex(ctx, 0, target);
+    getTexImage(ctx, tex, face, 1, level, format, type, buf_size, pixels);
+}
+
+void mglGetTexImage(GLMContext ctx, GLenum target, GLint level, GLenum format, GLenum type, void *pixels)
+{
+    getnTexImage(ctx, target, level, format, type, SIZE_MAX, pixels);
+}
+
+void mglGetnTexImage(GLMContext ctx, GLenum target, GLint level, GLenum format, GLenum type, GLsizei bufSize,
+                     void *pixels)
+{
+    if (bufSize < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-    texStorage(ctx, tex, num_faces, levels, is_array, internalformat, width, height, 1, proxy);
+    getnTexImage(ctx, target, level, format, type, (size_t)bufSize, pixels);
 }
 
-void mglTextureStorage2D(GLMContext ctx, GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width,
-                         GLsizei height)
+void mglGetTextureImage(GLMContext ctx, GLuint texture, GLint level, GLenum format, GLenum type, GLsizei bufSize,
+                        void *pixels)
 {
     Texture *tex;
 
-    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+    if (level < 0 || bufSize < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-    ERROR_CHECK_RETURN(checkInternalFormatForMetal(ctx, internalformat), GL_INVALID_OPERATION);
+    // Find texture by ID
+    tex = findTexture(ctx, texture);
 
-    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-    tex = getTex(ctx, texture, 0);
+    // Check format/type match, it raises the error
+    if (verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type) == false)
+        return;
 
-    texStorage(ctx, tex, 1, levels, false, internalformat, width, height, 1, false);
+    // a cube map comes back as its 6 faces one after the other
+    getTexImage(ctx, tex, 0, (tex->target == GL_TEXTURE_CUBE_MAP) ? 6 : 1, level, format, type, (size_t)bufSize,
+                pixels);
 }
 
-void mglTextureStorage2DMultisample(GLMContext ctx, GLuint texture, GLsizei samples, GLenum internalformat,
-                                    GLsizei width, GLsizei height, GLboolean fixedsamplelocations)
+void mglGetTextureSubImage(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                           GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, GLsizei bufSize,
+                           void *pixels)
 {
     // Unimplemented function
     assert(0);
 }
 
-void mglTexStorage3D(GLMContext ctx, GLenum target, GLsizei levels, GLenum internalformat, GLsizei width,
-                     GLsizei height, GLsizei depth)
+// compressed textures are never written by the gpu, their shadow has the blocks
+static void getCompressedTexImage(GLMContext ctx, Texture *tex, GLuint face, GLuint num_faces, GLint level,
+                                  size_t buf_size, void *pixels)
 {
-    Texture *tex;
-    GLboolean is_array;
-    GLboolean proxy;
-
-    is_array = false;
-    proxy = false;
+    size_t size, face_size;
+    GLubyte *dst;
 
-    switch (target)
+    if (level >= tex->num_levels)
     {
-    case GL_TEXTURE_3D:
-        break;
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-    case GL_PROXY_TEXTURE_3D:
-        proxy = true;
-        break;
+    if (tex->compressed == false)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-    case GL_TEXTURE_2D_ARRAY:
-    case GL_TEXTURE_CUBE_MAP_ARRAY:
-        is_array = true;
-        break;
+    if (pinTextureShadow(ctx, tex->view_parent ? tex->view_parent : tex) == false)
+    {
+        ERROR_RETURN(GL_OUT_OF_MEMORY);
+        return;
+    }
 
-    case GL_PROXY_TEXTURE_2D_ARRAY:
-    case GL_PROXY_TEXTURE_CUBE_MAP_ARRAY:
-        is_array = true;
-        proxy = true;
-        break;
+    size = 0;
+    for (GLuint i = face; i < face + num_faces; i++)
+    {
+        if (getCompressedLevelData(tex, i, level, &face_size) == NULL)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
 
-    default:
-        ERROR_RETURN(GL_INVALID_ENUM);
+        size += face_size;
     }
 
-    ERROR_CHECK_RETURN(checkMaxLevels(levels, width, height, depth), GL_INVALID_OPERATION);
-    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+    if (STATE(buffers[_PIXEL_PACK_BUFFER]))
+    {
+        Buffer *ptr;
+        size_t offset;
 
-    ERROR_CHECK_RETURN(checkInternalFormatForMetal(ctx, internalformat), GL_INVALID_OPERATION);
+        ptr = STATE(buffers[_PIXEL_PACK_BUFFER]);
 
-    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(depth > 0, GL_INVALID_VALUE);
+        // pixels is an offset into the pack buffer
+        offset = (size_t)pixels;
 
-    tex = getTex(ctx, 0, target);
+        if (ptr->mapped || offset + size > ptr->size)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
 
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+        if (ptr->data.mtl_data || ptr->data.slab)
+        {
+            ctx->mtl_funcs.mtlRenameBuffer(ctx, ptr, true);
+        }
 
-    texStorage(ctx, tex, 1, levels, is_array, internalformat, width, height, depth, proxy);
+        dst = (GLubyte *)ptr->data.buffer_data + offset;
+
+        setBufferDataDirty(ptr, offset, size);
+        ctx->state.dirty_bits |= DIRTY_BUFFER;
+    }
+    else
+    {
+        if (pixels == NULL)
+        {
+            ERROR_RETURN(GL_INVALID_VALUE);
+            return;
+        }
+
+        if (size > buf_size)
+        {
+            ERROR_RETURN(GL_INVALID_OPERATION);
+            return;
+        }
+
+        dst = (GLubyte *)pixels;
+    }
+
+    for (GLuint i = face; i < face + num_faces; i++)
+    {
+        void *blocks;
+
+        blocks = getCompressedLevelData(tex, i, level, &face_size);
+
+        memcpy(dst, blocks, face_size);
+        dst += face_size;
+    }
 }
 
-void mglTextureStorage3D(GLMContext ctx, GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width,
-                         GLsizei height, GLsizei depth)
+static void getnCompressedTexImage(GLMContext ctx, GLenum target, GLint level, size_t buf_size, void *pixels)
 {
     Texture *tex;
+    GLuint face;
 
-    ERROR_CHECK_RETURN(levels > 0, GL_INVALID_VALUE);
+    face = 0;
 
-    ERROR_CHECK_RETURN(checkInternalFormatForMetal(ctx, internalformat), GL_INVALID_OPERATION);
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_3D:
+        break;
 
-    ERROR_CHECK_RETURN(width > 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(height > 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(depth > 0, GL_INVALID_VALUE);
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
+    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
+    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
+        face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+        target = GL_TEXTURE_CUBE_MAP;
+        break;
 
-    tex = getTex(ctx, texture, 0);
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
 
-    createTextureLevel(ctx, tex, 0, 0, false, internalformat, width, height, depth, 0, 0, NULL, false);
-}
+    if (level < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-void mglTextureStorage3DMultisample(GLMContext ctx, GLuint texture, GLsizei samples, GLenum internalformat,
-                                    GLsizei width, GLsizei height, GLsizei depth, GLboolean fixedsamplelocations)
-{
-    // Unimplemented function
-    assert(0);
-}
+    tex = getTex(ctx, 0, target);
 
-#pragma mark clear tex image
-void mglClearTexImage(GLMContext ctx, GLuint texture, GLint level, GLenum format, GLenum type, const void *data)
-{
-    // Unimplemented function
-    assert(0);
+    getCompressedTexImage(ctx, tex, face, 1, level, buf_size, pixels);
 }
 
-void mglClearTexSubImage(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                         GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *data)
+void mglGetCompressedTexImage(GLMContext ctx, GLenum target, GLint level, void *img)
 {
-    // Unimplemented function
-    assert(0);
+    getnCompressedTexImage(ctx, target, level, SIZE_MAX, img);
 }
 
-#pragma mark compressed tex image
-void mglCompressedTexImage3D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLsizei width,
-                             GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void *data)
+void mglGetnCompressedTexImage(GLMContext ctx, GLenum target, GLint lod, GLsizei bufSize, void *pixels)
 {
-    // Unimplemented function
-    assert(0);
-}
+    if (bufSize < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-void mglCompressedTexImage2D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLsizei width,
-                             GLsizei height, GLint border, GLsizei imageSize, const void *data)
-{
-    // Unimplemented function
-    assert(0);
+    getnCompressedTexImage(ctx, target, lod, (size_t)bufSize, pixels);
 }
 
-void mglCompressedTexImage1D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLsizei width,
-                             GLint border, GLsizei imageSize, const void *data)
+void mglGetCompressedTextureSubImage(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset,
+                                     GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLsizei bufSize,
+                                     void *pixels)
 {
     // Unimplemented function
     assert(0);
 }
 
-void mglCompressedTexSubImage3D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                                GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize,
-                                const void *data)
+// table 8.21, what a texture can be viewed as
+static bool isViewCompatibleTarget(GLenum orig_target, GLenum target)
 {
-    // Unimplemented function
-    assert(0);
-}
+    switch (orig_target)
+    {
+    case GL_TEXTURE_1D:
+    case GL_TEXTURE_1D_ARRAY:
+        return (target == GL_TEXTURE_1D || target == GL_TEXTURE_1D_ARRAY);
 
-void mglCompressedTexSubImage2D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
-                                GLsizei height, GLenum format, GLsizei imageSize, const void *data)
-{
-    // Unimplemented function
-    assert(0);
-}
+    case GL_TEXTURE_2D:
+        return (target == GL_TEXTURE_2D || target == GL_TEXTURE_2D_ARRAY);
 
-void mglCompressedTexSubImage1D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLsizei width, GLenum format,
-                                GLsizei imageSize, const void *data)
-{
-    // Unimplemented function
-    assert(0);
-}
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_RECTANGLE:
+        return (target == orig_target);
 
-#pragma mark copy tex
-void mglCopyTexImage1D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLint x, GLint y,
-                       GLsizei width, GLint border)
-{
-    // Unimplemented function
-    assert(0);
-}
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        return (target == GL_TEXTURE_2D || target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_CUBE_MAP ||
+                target == GL_TEXTURE_CUBE_MAP_ARRAY);
 
-void mglCopyTexImage2D(GLMContext ctx, GLenum target, GLint level, GLenum internalformat, GLint x, GLint y,
-                       GLsizei width, GLsizei height, GLint border)
-{
-    // Unimplemented function
-    assert(0);
-}
+    case GL_TEXTURE_2D_MULTISAMPLE:
+    case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+        return (target == GL_TEXTURE_2D_MULTISAMPLE || target == GL_TEXTURE_2D_MULTISAMPLE_ARRAY);
 
-void mglCopyTexSubImage1D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint x, GLint y, GLsizei width)
-{
-    // Unimplemented function
-    assert(0);
+    default:
+        return false;
+    }
 }
 
-void mglCopyTexSubImage2D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y,
-                          GLsizei width, GLsizei height)
+void mglTextureView(GLMContext ctx, GLuint texture, GLenum target, GLuint origtexture, GLenum internalformat,
+                    GLuint minlevel, GLuint numlevels, GLuint minlayer, GLuint numlayers)
 {
-    // Unimplemented function
-    assert(0);
-}
+    Texture *orig, *storage, *tex;
+    GLuint orig_levels, orig_layers, num_faces;
+    GLuint width, height, depth;
+
+    switch (target)
+    {
+    case GL_TEXTURE_1D:
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_RECTANGLE:
+    case GL_TEXTURE_2D_MULTISAMPLE:
+        if (numlayers != 1)
+        {
+            ERROR_RETURN(GL_INVALID_VALUE);
+            return;
+        }
+        break;
+
+    case GL_TEXTURE_CUBE_MAP:
+        if (numlayers != 6)
+        {
+            ERROR_RETURN(GL_INVALID_VALUE);
+            return;
+        }
+        break;
+
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        if (numlayers % 6 != 0)
+        {
+            ERROR_RETURN(GL_INVALID_VALUE);
+            return;
+        }
+        break;
+
+    case GL_TEXTURE_1D_ARRAY:
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+        break;
+
+    default:
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
+
+    if (texture == 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    // the view has to be a new name, one that was never bound
+    if (findTexture(ctx, texture))
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-void mglCopyTexSubImage3D(GLMContext ctx, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                          GLint x, GLint y, GLsizei width, GLsizei height)
-{
-    // Unimplemented function
-    assert(0);
-}
+    orig = findTexture(ctx, origtexture);
+    if (orig == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-void mglCopyTextureSubImage1D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint x, GLint y,
-                              GLsizei width)
-{
-    // Unimplemented function
-    assert(0);
-}
+    if (orig->immutable_storage == 0 || isViewCompatibleTarget(orig->target, target) == false ||
+        isViewCompatibleFormat(orig->internalformat, internalformat) == false)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
 
-void mglCopyTextureSubImage2D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint x,
-                              GLint y, GLsizei width, GLsizei height)
-{
-    // Unimplemented function
-    assert(0);
-}
+    orig_levels = orig->num_levels;
+    orig_layers = getTexLayerCount(orig);
 
-void mglCopyTextureSubImage3D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                              GLint x, GLint y, GLsizei width, GLsizei height)
-{
-    // Unimplemented function
-    assert(0);
-}
+    if (minlevel >= orig_levels || minlayer >= orig_layers)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-#pragma mark get tex image
+    numlevels = MIN(numlevels, orig_levels - minlevel);
+    numlayers = MIN(numlayers, orig_layers - minlayer);
+    if (numlevels == 0 || numlayers == 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
 
-void mglGetTexImage(GLMContext ctx, GLenum target, GLint level, GLenum format, GLenum type, void *pixels)
-{
-    Texture *tex;
-    GLuint face;
-    GLboolean is_array;
-    GLboolean proxy;
-    int bytes_per_pixel;
-    GLuint bytes_per_row;
-    GLuint width, height;
+    // a view of a view is a view of the same storage
+    storage = orig;
+    if (orig->view_parent)
+    {
+        storage = orig->view_parent;
+        minlevel += orig->view_min_level;
+        minlayer += orig->view_min_layer;
+    }
 
-    face = 0;
-    is_array = false;
-    proxy = false;
+    // blocks the device can't sample are decoded on the gpu, another block format can't see them
+    if (storage->decoded_format && internalformat != storage->internalformat)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    getTexLevelDims(storage, minlevel, &width, &height, &depth);
 
     switch (target)
     {
-    case GL_TEXTURE_2D:
+    case GL_TEXTURE_1D:
+        height = 1;
+        depth = 1;
         break;
-    default:
-        ERROR_RETURN(GL_INVALID_ENUM);
-    }
 
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(pixels, GL_INVALID_VALUE);
+    case GL_TEXTURE_1D_ARRAY:
+        height = numlayers;
+        depth = 1;
+        break;
 
-    tex = getTex(ctx, 0, target);
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+    case GL_TEXTURE_2D_ARRAY:
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+    case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+        depth = numlayers;
+        break;
 
-    // Check format/type match
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+    case GL_TEXTURE_3D:
+        break;
 
-    if (level >= tex->num_levels)
+    default:
+        depth = 1;
+        break;
+    }
+
+    if ((target == GL_TEXTURE_CUBE_MAP || target == GL_TEXTURE_CUBE_MAP_ARRAY) && width != height)
     {
-        ERROR_RETURN(GL_INVALID_VALUE);
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
     }
 
-    width = tex->faces[face].levels[level].width;
-    height = tex->faces[face].levels[level].height;
+    tex = getTexture(ctx, target, texture);
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_OUT_OF_MEMORY);
+        return;
+    }
 
-    // Calculate bytes per pixel
-    bytes_per_pixel = sizeForFormatType(format, type);
-    bytes_per_row = width * bytes_per_pixel;
+    initBaseTexLevel(ctx, tex, internalformat, width, height, depth);
 
-    // Call Metal function
-    ctx->mtl_funcs.mtlGetTexImage(ctx, tex, pixels, bytes_per_row, 0, 0, 0, width, height, level, face);
-}
+    tex->decoded_format = storage->decoded_format;
+    tex->mtl_requires_private_storage = storage->mtl_requires_private_storage;
+    tex->access = GL_READ_ONLY;
+    tex->mipmapped = (numlevels > 1);
 
-void mglGetTextureImage(GLMContext ctx, GLuint texture, GLint level, GLenum format, GLenum type, GLsizei bufSize,
-                        void *pixels)
-{
-    Texture *tex;
-    GLuint face;
-    int bytes_per_pixel;
-    GLuint bytes_per_row;
-    GLuint width, height;
+    // the view starts out with the parameters of the texture it was made from
+    tex->params = orig->params;
+    tex->params.mtl_data = NULL;
 
-    face = 0;
+    num_faces = getTexFaceCount(tex);
 
-    ERROR_CHECK_RETURN(level >= 0, GL_INVALID_VALUE);
-    ERROR_CHECK_RETURN(pixels, GL_INVALID_VALUE);
+    for (GLuint face = 0; face < num_faces; face++)
+    {
+        for (GLuint level = 0; level < numlevels; level++)
+        {
+            TextureLevel *tex_level;
 
-    // Find texture by ID
-    tex = findTexture(ctx, texture);
-    ERROR_CHECK_RETURN(tex, GL_INVALID_OPERATION);
+            tex_level = &tex->faces[face].levels[level];
 
-    // Check format/type match
-    ERROR_CHECK_RETURN(verifyInternalFormatAndFormatType(ctx, tex->internalformat, format, type), 0);
+            getTexLevelDims(tex, level, &tex_level->width, &tex_level->height, &tex_level->depth);
 
-    if (level >= tex->num_levels)
-    {
-        ERROR_RETURN(GL_INVALID_VALUE);
+            // same texel or block size as the parent
+            tex_level->pitch = storage->faces[0].levels[minlevel + level].pitch;
+            tex_level->complete = true;
+        }
     }
 
-    width = tex->faces[face].levels[level].width;
-    height = tex->faces[face].levels[level].height;
+    tex->num_levels = numlevels;
+    tex->immutable_storage = BUFFER_IMMUTABLE_STORAGE_FLAG;
 
-    // Calculate bytes per pixel
-    bytes_per_pixel = sizeForFormatType(format, type);
-    bytes_per_row = width * bytes_per_pixel;
+    tex->view_parent = storage;
+    tex->view_min_level = minlevel;
+    tex->view_num_levels = numlevels;
+    tex->view_min_layer = minlayer;
+    tex->view_num_layers = numlayers;
 
-    // Check buffer size
-    GLsizei required_size = bytes_per_row * height;
-    ERROR_CHECK_RETURN(bufSize >= required_size, GL_INVALID_OPERATION);
+    // the storage gets usage for views once, with the first one. what it had goes into the
+    // shadow before it is made again, private storage was made with it
+    if (storage->has_views == false)
+    {
+        if (storage->mtl_data && storage->mtl_requires_private_storage == false)
+        {
+            keepTextureGPUWrites(ctx, storage);
 
-    // Call Metal function
-    ctx->mtl_funcs.mtlGetTexImage(ctx, tex, pixels, bytes_per_row, 0, 0, 0, width, height, level, face);
-}
+            storage->dirty_bits |= DIRTY_TEXTURE_ACCESS;
+        }
 
-void mglGetTextureSubImage(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
-                           GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, GLsizei bufSize,
-                           void *pixels)
-{
-    // Unimplemented function
-    assert(0);
+        storage->has_views = true;
+    }
+
+    storage->ref_count++;
 }
 
-void mglGetCompressedTexImage(GLMContext ctx, GLenum target, GLint level, void *img)
+#pragma mark texture buffers
+
+// table 8.18 less the 3 x 32 bit formats, metal has no 96 bit texel to view a buffer with
+static bool isTexBufferFormat(GLenum internalformat)
 {
-    // Unimplemented function
-    assert(0);
+    switch (internalformat)
+    {
+    case GL_R8:
+    case GL_R16:
+    case GL_R16F:
+    case GL_R32F:
+    case GL_R8I:
+    case GL_R16I:
+    case GL_R32I:
+    case GL_R8UI:
+    case GL_R16UI:
+    case GL_R32UI:
+    case GL_RG8:
+    case GL_RG16:
+    case GL_RG16F:
+    case GL_RG32F:
+    case GL_RG8I:
+    case GL_RG16I:
+    case GL_RG32I:
+    case GL_RG8UI:
+    case GL_RG16UI:
+    case GL_RG32UI:
+    case GL_RGBA8:
+    case GL_RGBA16:
+    case GL_RGBA16F:
+    case GL_RGBA32F:
+    case GL_RGBA8I:
+    case GL_RGBA16I:
+    case GL_RGBA32I:
+    case GL_RGBA8UI:
+    case GL_RGBA16UI:
+    case GL_RGBA32UI:
+        return true;
+    }
+
+    return false;
 }
 
-void mglGetnCompressedTexImage(GLMContext ctx, GLenum target, GLint lod, GLsizei bufSize, void *pixels)
+// the mtl texture is made over the buffer's own mtl buffer when bound, writes to the
+// buffer reach it through the buffer's dirty ranges and a renamed buffer is viewed again
+static bool texBuffer(GLMContext ctx, Texture *tex, GLenum internalformat, GLuint buffer, GLintptr offset,
+                      GLsizeiptr size, bool range)
 {
-    // Unimplemented function
-    assert(0);
+    Buffer *buf;
+
+    ERROR_CHECK_RETURN_VALUE(isTexBufferFormat(internalformat), GL_INVALID_ENUM, false);
+
+    buf = NULL;
+    if (buffer)
+    {
+        buf = findBuffer(ctx, buffer);
+        ERROR_CHECK_RETURN_VALUE(buf, GL_INVALID_OPERATION, false);
+
+        if (range)
+        {
+            ERROR_CHECK_RETURN_VALUE(offset >= 0 && size > 0, GL_INVALID_VALUE, false);
+            ERROR_CHECK_RETURN_VALUE(offset + size <= buf->size, GL_INVALID_VALUE, false);
+
+            if (STATE(var.texture_buffer_offset_alignment))
+            {
+                ERROR_CHECK_RETURN_VALUE(offset % STATE(var.texture_buffer_offset_alignment) == 0, GL_INVALID_VALUE,
+                                         false);
+            }
+        }
+    }
+
+    tex->internalformat = internalformat;
+    tex->tex_buffer = buf;
+    tex->tex_buffer_offset = (buf && range) ? offset : 0;
+    tex->tex_buffer_size = (buf && range) ? size : 0;
+
+    tex->dirty_bits |= DIRTY_TEXTURE_LEVEL;
+    STATE(dirty_bits) |= DIRTY_TEX;
+
+    return true;
 }
 
-void mglGetCompressedTextureSubImage(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset,
-                                     GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLsizei bufSize,
-                                     void *pixels)
+void mglTexBuffer(GLMContext ctx, GLenum target, GLenum internalformat, GLuint buffer)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    if (target != GL_TEXTURE_BUFFER)
+    {
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
+
+    tex = currentTexture(ctx, _TEXTURE_BUFFER_TARGET);
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texBuffer(ctx, tex, internalformat, buffer, 0, 0, false);
 }
 
-void mglTextureView(GLMContext ctx, GLuint texture, GLenum target, GLuint origtexture, GLenum internalformat,
-                    GLuint minlevel, GLuint numlevels, GLuint minlayer, GLuint numlayers)
+void mglTexBufferRange(GLMContext ctx, GLenum target, GLenum internalformat, GLuint buffer, GLintptr offset,
+                       GLsizeiptr size)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    if (target != GL_TEXTURE_BUFFER)
+    {
+        ERROR_RETURN(GL_INVALID_ENUM);
+        return;
+    }
+
+    tex = currentTexture(ctx, _TEXTURE_BUFFER_TARGET);
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texBuffer(ctx, tex, internalformat, buffer, offset, size, true);
 }
 
 void mglTextureBuffer(GLMContext ctx, GLuint texture, GLenum internalformat, GLuint buffer)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    tex = findTexture(ctx, texture);
+    if (tex == NULL || tex->target != GL_TEXTURE_BUFFER)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texBuffer(ctx, tex, internalformat, buffer, 0, 0, false);
 }
 
 void mglTextureBufferRange(GLMContext ctx, GLuint texture, GLenum internalformat, GLuint buffer, GLintptr offset,
                            GLsizeiptr size)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    tex = findTexture(ctx, texture);
+    if (tex == NULL || tex->target != GL_TEXTURE_BUFFER)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    texBuffer(ctx, tex, internalformat, buffer, offset, size, true);
 }
 
 void mglCompressedTextureSubImage1D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLsizei width,
                                     GLenum format, GLsizei imageSize, const void *data)
 {
-    // Unimplemented function
-    assert(0);
+    // none of the block formats have 1d blocks
+    ERROR_RETURN(GL_INVALID_OPERATION);
 }
 
 void mglCompressedTextureSubImage2D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset,
                                     GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void *data)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    tex = getTex(ctx, texture, 0);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    compressedTexSubImage(ctx, tex, 0, level, xoffset, yoffset, 0, width, height, 1, format, imageSize, data);
 }
 
 void mglCompressedTextureSubImage3D(GLMContext ctx, GLuint texture, GLint level, GLint xoffset, GLint yoffset,
                                     GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format,
                                     GLsizei imageSize, const void *data)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    tex = getTex(ctx, texture, 0);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // the faces of a cube map are its layers here
+    if (tex->target == GL_TEXTURE_CUBE_MAP)
+    {
+        if (zoffset < 0 || depth < 0 || zoffset + depth > 6)
+        {
+            ERROR_RETURN(GL_INVALID_VALUE);
+            return;
+        }
+
+        for (GLsizei face = zoffset; face < zoffset + depth; face++)
+        {
+            if (compressedTexSubImage(ctx, tex, face, level, xoffset, yoffset, 0, width, height, 1, format,
+                                      depth ? imageSize / depth : 0,
+                                      data ? (GLubyte *)data + (face - zoffset) * (imageSize / depth) : NULL) == false)
+                return;
+        }
+
+        return;
+    }
+
+    compressedTexSubImage(ctx, tex, 0, level, xoffset, yoffset, zoffset, width, height, depth, format, imageSize,
+                          data);
 }
 
 void mglGetCompressedTextureImage(GLMContext ctx, GLuint texture, GLint level, GLsizei bufSize, void *pixels)
 {
-    // Unimplemented function
-    assert(0);
+    Texture *tex;
+
+    if (level < 0 || bufSize < 0)
+    {
+        ERROR_RETURN(GL_INVALID_VALUE);
+        return;
+    }
+
+    tex = findTexture(ctx, texture);
+
+    if (tex == NULL)
+    {
+        ERROR_RETURN(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // a cube map comes back as its 6 faces one after the other
+    getCompressedTexImage(ctx, tex, 0, (tex->target == GL_TEXTURE_CUBE_MAP) ? 6 : 1, level, (size_t)bufSize, pixels);
 }
 
 void mglGetTextureLevelParameterfv(GLMContext ctx, GLuint texture, GLint level, GLenum pname, GLfloat *params)
@@ -329,21 +329,47 @@ void mglUniform(GLMContext ctx, GLint location, void *ptr, GLsizei size)
             new_size = ((new_size + 255) / 256) * 256;
 
             // Allocate new buffer and copy old data
-            void *new_data = calloc(1, new_size);
+            size_t alloc_size;
+            void *new_data = allocPages(new_size, 0, &alloc_size);
+            ERROR_CHECK_RETURN(new_data, GL_OUT_OF_MEMORY);
+
             if (buf->data.buffer_data != 0)
             {
-                memcpy(new_data, (void *)buf->data.buffer_data, buf->data.buffer_size);
-                free((void *)buf->data.buffer_data);
+                memcpy(new_data, (void *)buf->data.buffer_data, buf->size < new_size ? buf->size : new_size);
+
+                if (buf->data.mtl_data)
+                {
+                    // backing was the mtl buffer contents
+                    ctx->mtl_funcs.mtlDeleteMTLObj(ctx, buf->data.mtl_data);
+                    buf->data.mtl_data = NULL;
+
+                    releaseBufferRenames(ctx, buf);
+                }
+                else if (buf->data.slab)
+                {
+                    ctx->mtl_funcs.mtlFreeBufferSubAlloc(ctx, buf);
+                }
+                else
+                {
+                    freePages((void *)buf->data.buffer_data, buf->data.buffer_size);
+                }
             }
             buf->data.buffer_data = (vm_address_t)new_data;
-            buf->data.buffer_size = new_size;
+            buf->data.buffer_size = alloc_size;
             buf->size = new_size;
-            buf->data.dirty_bits |= DIRTY_BUFFER;
+            buf->data.dirty_bits |= DIRTY_BUFFER_ADDR;
+            setBufferDataDirty(buf, 0, new_size);
+        }
+
+        // earlier draws may still read the other members
+        if (buf->data.mtl_data || buf->data.slab)
+        {
+            ctx->mtl_funcs.mtlRenameBuffer(ctx, buf, true);
         }
 
         // Update the specific member at its offset
         memcpy((char *)buf->data.buffer_data + offset, ptr, size);
-        buf->data.dirty_bits |= DIRTY_BUFFER;
+        setBufferDataDirty(buf, offset, size);
     }
     else
     {
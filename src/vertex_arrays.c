@@ -70,11 +70,9 @@ VertexArray *newVAO(GLMContext ctx, GLuint vao)
 {
     VertexArray *ptr;
 
-    ptr = (VertexArray *)malloc(sizeof(VertexArray));
+    ptr = (VertexArray *)newPoolObject(&STATE(vao_pool));
     assert(ptr);
 
-    bzero((void *)ptr, sizeof(VertexArray));
-
     ptr->name = vao;
 
     for (int i = 0; i < MAX_ATTRIBS; i++)
@@ -173,10 +171,16 @@ void mglDeleteVertexArrays(GLMContext ctx, GLsizei n, const GLuint *arrays)
                     mglBindVertexArray(ctx, 0);
                 }
 
+                deleteHashElement(&STATE(vao_table), vao);
+
                 // delete any mtl_data
-            }
+                if (ptr->mtl_data)
+                {
+                    ctx->mtl_funcs.mtlDeleteMTLObj(ctx, ptr->mtl_data);
+                }
 
-            deleteHashElement(&STATE(vao_table), vao);
+                freePoolObject(&STATE(vao_pool), ptr);
+            }
         }
     }
 }
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * dirty_ranges_bench.cpp
+ * MGL
+ *
+ */
+
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <vector>
+
+extern "C"
+{
+#include "dirty_ranges.h"
+}
+
+// one buffer sub data sized write per iteration into a 64 MiB buffer, the set
+// is cleared every 1024 writes like a flush at draw time would
+
+#define BUFFER_SIZE (64u << 20)
+#define WRITES_PER_FLUSH 1024
+
+static void BM_DirtyRangesSequential(benchmark::State &state)
+{
+    DirtyRangeSet set;
+    size_t length = state.range(0);
+    size_t offset = 0;
+    unsigned writes = 0;
+
+    clearDirtyRanges(&set);
+
+    for (auto _ : state)
+    {
+        addDirtyRange(&set, offset, length);
+
+        offset = (offset + length) % BUFFER_SIZE;
+
+        if (++writes == WRITES_PER_FLUSH)
+        {
+            benchmark::DoNotOptimize(getDirtyRangeBytes(&set));
+            clearDirtyRanges(&set);
+            writes = 0;
+        }
+    }
+}
+BENCHMARK(BM_DirtyRangesSequential)->Arg(4)->Arg(256)->Arg(64 << 10);
+
+static void BM_DirtyRangesRandom(benchmark::State &state)
+{
+    DirtyRangeSet set;
+    std::vector<size_t> offsets(WRITES_PER_FLUSH);
+    size_t length = state.range(0);
+    unsigned writes = 0;
+
+    srand(1234);
+    for (auto &offset : offsets)
+        offset = (size_t)rand() % (BUFFER_SIZE - length);
+
+    clearDirtyRanges(&set);
+
+    for (auto _ : state)
+    {
+        addDirtyRange(&set, offsets[writes], length);
+
+        if (++writes == WRITES_PER_FLUSH)
+        {
+            benchmark::DoNotOptimize(getDirtyRangeBytes(&set));
+            clearDirtyRanges(&set);
+            writes = 0;
+        }
+    }
+}
+BENCHMARK(BM_DirtyRangesRandom)->Arg(4)->Arg(256)->Arg(64 << 10);
+
+// how many bytes end up flushed for a frame of scattered writes, against the
+// whole buffer flush this replaces
+static void BM_DirtyRangesFlushedBytes(benchmark::State &state)
+{
+    DirtyRangeSet set;
+    size_t length = state.range(0);
+    size_t flushed = 0;
+
+    srand(1234);
+
+    for (auto _ : state)
+    {
+        clearDirtyRanges(&set);
+
+        for (int i = 0; i < state.range(1); i++)
+            addDirtyRange(&set, (size_t)rand() % (BUFFER_SIZE - length), length);
+
+        flushed = getDirtyRangeBytes(&set);
+        benchmark::DoNotOptimize(flushed);
+    }
+
+    state.counters["flushed_pct"] = 100.0 * flushed / BUFFER_SIZE;
+}
+BENCHMARK(BM_DirtyRangesFlushedBytes)->Args({4, 1})->Args({4, 8})->Args({4, 64})->Args({4096, 64});
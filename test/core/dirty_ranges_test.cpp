@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * dirty_ranges_test.cpp
+ * MGL
+ *
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <vector>
+
+extern "C"
+{
+#include "dirty_ranges.h"
+}
+
+class DirtyRangesTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override { clearDirtyRanges(&set); }
+
+    void expectSortedDisjoint()
+    {
+        for (unsigned i = 0; i < set.count; i++)
+        {
+            EXPECT_LT(set.ranges[i].start, set.ranges[i].end);
+
+            // touching ranges should have been merged
+            if (i > 0)
+            {
+                EXPECT_LT(set.ranges[i - 1].end, set.ranges[i].start);
+            }
+        }
+    }
+
+    DirtyRangeSet set;
+};
+
+TEST_F(DirtyRangesTest, EmptyAndZeroLength)
+{
+    EXPECT_EQ(set.count, 0u);
+    EXPECT_EQ(getDirtyRangeBytes(&set), 0u);
+
+    addDirtyRange(&set, 100, 0);
+    EXPECT_EQ(set.count, 0u);
+}
+
+TEST_F(DirtyRangesTest, SingleRange)
+{
+    addDirtyRange(&set, 4, 4);
+
+    ASSERT_EQ(set.count, 1u);
+    EXPECT_EQ(set.ranges[0].start, 4u);
+    EXPECT_EQ(set.ranges[0].end, 8u);
+    EXPECT_EQ(getDirtyRangeBytes(&set), 4u);
+}
+
+TEST_F(DirtyRangesTest, AdjacentRangesCoalesce)
+{
+    addDirtyRange(&set, 0, 16);
+    addDirtyRange(&set, 16, 16);
+    addDirtyRange(&set, 48, 16);
+    addDirtyRange(&set, 32, 16);
+
+    ASSERT_EQ(set.count, 1u);
+    EXPECT_EQ(set.ranges[0].start, 0u);
+    EXPECT_EQ(set.ranges[0].end, 64u);
+}
+
+TEST_F(DirtyRangesTest, OverlapSpanningSeveralRanges)
+{
+    addDirtyRange(&set, 0, 10);
+    addDirtyRange(&set, 20, 10);
+    addDirtyRange(&set, 40, 10);
+    addDirtyRange(&set, 60, 10);
+    ASSERT_EQ(set.count, 4u);
+
+    // swallows the middle two and touches neither end
+    addDirtyRange(&set, 15, 40);
+
+    ASSERT_EQ(set.count, 3u);
+    EXPECT_EQ(set.ranges[0].end, 10u);
+    EXPECT_EQ(set.ranges[1].start, 15u);
+    EXPECT_EQ(set.ranges[1].end, 55u);
+    EXPECT_EQ(set.ranges[2].start, 60u);
+    expectSortedDisjoint();
+}
+
+TEST_F(DirtyRangesTest, ContainedRangeIsNoop)
+{
+    addDirtyRange(&set, 100, 100);
+    addDirtyRange(&set, 120, 10);
+
+    ASSERT_EQ(set.count, 1u);
+    EXPECT_EQ(getDirtyRangeBytes(&set), 100u);
+}
+
+TEST_F(DirtyRangesTest, OutOfOrderInsertKeepsSorted)
+{
+    addDirtyRange(&set, 300, 10);
+    addDirtyRange(&set, 100, 10);
+    addDirtyRange(&set, 200, 10);
+    addDirtyRange(&set, 0, 10);
+
+    ASSERT_EQ(set.count, 4u);
+    EXPECT_EQ(set.ranges[0].start, 0u);
+    EXPECT_EQ(set.ranges[1].start, 100u);
+    EXPECT_EQ(set.ranges[2].start, 200u);
+    EXPECT_EQ(set.ranges[3].start, 300u);
+}
+
+TEST_F(DirtyRangesTest, FullSetJoinsSmallestGap)
+{
+    // gaps of 90 except one of 10 between the 3rd and 4th ranges
+    size_t starts[MAX_DIRTY_RANGES] = {0, 100, 200, 220, 400, 500, 600, 700};
+
+    for (unsigned i = 0; i < MAX_DIRTY_RANGES; i++)
+        addDirtyRange(&set, starts[i], 10);
+
+    ASSERT_EQ(set.count, (unsigned)MAX_DIRTY_RANGES);
+
+    addDirtyRange(&set, 10000, 10);
+
+    ASSERT_EQ(set.count, (unsigned)MAX_DIRTY_RANGES);
+    EXPECT_EQ(set.ranges[2].start, 200u);
+    EXPECT_EQ(set.ranges[2].end, 230u);
+    EXPECT_EQ(set.ranges[MAX_DIRTY_RANGES - 1].start, 10000u);
+    expectSortedDisjoint();
+}
+
+TEST_F(DirtyRangesTest, FullSetGrowsCloseNeighbour)
+{
+    for (unsigned i = 0; i < MAX_DIRTY_RANGES; i++)
+        addDirtyRange(&set, i * 1000, 10);
+
+    // 5 bytes past the 4th range, closer than any existing gap
+    addDirtyRange(&set, 3015, 10);
+
+    ASSERT_EQ(set.count, (unsigned)MAX_DIRTY_RANGES);
+    EXPECT_EQ(set.ranges[3].start, 3000u);
+    EXPECT_EQ(set.ranges[3].end, 3025u);
+
+    // and just before the 6th
+    addDirtyRange(&set, 4990, 5);
+
+    EXPECT_EQ(set.ranges[5].start, 4990u);
+    EXPECT_EQ(set.ranges[5].end, 5010u);
+    expectSortedDisjoint();
+}
+
+TEST_F(DirtyRangesTest, RandomWritesAlwaysCovered)
+{
+    const size_t size = 64 * 1024;
+    std::vector<bool> written(size, false);
+
+    srand(1234);
+
+    for (int i = 0; i < 2000; i++)
+    {
+        size_t offset = rand() % size;
+        size_t length = 1 + rand() % 64;
+
+        if (offset + length > size)
+            length = size - offset;
+
+        addDirtyRange(&set, offset, length);
+
+        for (size_t j = offset; j < offset + length; j++)
+            written[j] = true;
+
+        ASSERT_LE(set.count, (unsigned)MAX_DIRTY_RANGES);
+    }
+
+    expectSortedDisjoint();
+
+    // every written byte has to be flushed, over flushing is allowed
+    unsigned r = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        if (!written[i])
+            continue;
+
+        while (r < set.count && set.ranges[r].end <= i)
+            r++;
+
+        ASSERT_LT(r, set.count);
+        ASSERT_GE(i, set.ranges[r].start);
+    }
+}
+
+TEST_F(DirtyRangesTest, ClearEmptiesSet)
+{
+    addDirtyRange(&set, 0, 10);
+    addDirtyRange(&set, 100, 10);
+
+    clearDirtyRanges(&set);
+
+    EXPECT_EQ(set.count, 0u);
+    EXPECT_EQ(getDirtyRangeBytes(&set), 0u);
+}
+
+TEST_F(DirtyRangesTest, RemoveTrimsAndDrops)
+{
+    addDirtyRange(&set, 0, 100);
+    addDirtyRange(&set, 200, 100);
+    addDirtyRange(&set, 400, 100);
+
+    // end of the first, all of the second, start of the third
+    removeDirtyRange(&set, 50, 400);
+
+    ASSERT_EQ(set.count, 2u);
+    EXPECT_EQ(set.ranges[0].start, 0u);
+    EXPECT_EQ(set.ranges[0].end, 50u);
+    EXPECT_EQ(set.ranges[1].start, 450u);
+    EXPECT_EQ(set.ranges[1].end, 500u);
+    expectSortedDisjoint();
+
+    // touching isn't overlapping
+    removeDirtyRange(&set, 50, 400);
+    EXPECT_EQ(getDirtyRangeBytes(&set), 100u);
+
+    removeDirtyRange(&set, 0, 1000);
+    EXPECT_EQ(set.count, 0u);
+}
+
+TEST_F(DirtyRangesTest, RemoveSplits)
+{
+    addDirtyRange(&set, 0, 100);
+
+    removeDirtyRange(&set, 40, 20);
+
+    ASSERT_EQ(set.count, 2u);
+    EXPECT_EQ(set.ranges[0].end, 40u);
+    EXPECT_EQ(set.ranges[1].start, 60u);
+    EXPECT_EQ(set.ranges[1].end, 100u);
+}
+
+TEST_F(DirtyRangesTest, RemoveSplitOnFullSetKeepsRange)
+{
+    for (unsigned i = 0; i < MAX_DIRTY_RANGES; i++)
+        addDirtyRange(&set, i * 100, 50);
+
+    ASSERT_EQ(set.count, (unsigned)MAX_DIRTY_RANGES);
+
+    removeDirtyRange(&set, 110, 10);
+
+    // still covers everything that might be dirty
+    EXPECT_EQ(set.count, (unsigned)MAX_DIRTY_RANGES);
+    EXPECT_EQ(set.ranges[1].start, 100u);
+    EXPECT_EQ(set.ranges[1].end, 150u);
+}
+
+TEST_F(DirtyRangesTest, RandomRemoveMatchesBitmap)
+{
+    std::vector<bool> dirty(4096, false);
+
+    srand(99);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        size_t offset = rand() % 4000;
+        size_t length = 1 + rand() % 96;
+
+        if (rand() % 3)
+        {
+            addDirtyRange(&set, offset, length);
+
+            for (size_t j = offset; j < offset + length; j++)
+                dirty[j] = true;
+        }
+        else
+        {
+            removeDirtyRange(&set, offset, length);
+
+            // only bytes outside the set are guaranteed clean
+            for (size_t j = offset; j < offset + length; j++)
+            {
+                bool covered = false;
+
+                for (unsigned r = 0; r < set.count; r++)
+                    covered |= (j >= set.ranges[r].start && j < set.ranges[r].end);
+
+                if (!covered)
+                    dirty[j] = false;
+            }
+        }
+
+        expectSortedDisjoint();
+
+        // every dirty byte is still covered
+        for (size_t j = 0; j < dirty.size(); j++)
+        {
+            if (!dirty[j])
+                continue;
+
+            bool covered = false;
+
+            for (unsigned r = 0; r < set.count; r++)
+                covered |= (j >= set.ranges[r].start && j < set.ranges[r].end);
+
+            ASSERT_TRUE(covered) << "byte " << j << " iteration " << i;
+        }
+    }
+}
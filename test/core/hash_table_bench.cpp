@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * hash_table_bench.cpp
+ * MGL
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+extern "C"
+{
+#include "hash_table.h"
+}
+
+static std::vector<GLuint> denseNames(size_t count)
+{
+    std::vector<GLuint> names;
+
+    for (size_t i = 0; i < count; i++)
+        names.push_back((GLuint)i + 1);
+
+    return names;
+}
+
+static std::vector<GLuint> sparseNames(size_t count)
+{
+    std::mt19937 rng(1234);
+    std::vector<GLuint> names;
+
+    // random 32 bit names, what apps picking their own names look like
+    while (names.size() < count)
+    {
+        GLuint name = rng() | 0x80000000u;
+        names.push_back(name);
+    }
+
+    return names;
+}
+
+static void lookup(benchmark::State &state, const std::vector<GLuint> &names)
+{
+    HashTable table;
+    std::vector<GLuint> order(names);
+
+    initHashTable(&table, 128);
+
+    for (GLuint name : names)
+    {
+        if (searchHashTable(&table, name) == NULL)
+            insertHashElement(&table, name, (void *)(uintptr_t)(name | 1));
+    }
+
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(searchHashTable(&table, order[i]));
+
+        if (++i == order.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+
+    freeHashTable(&table);
+}
+
+static void BM_LookupDense(benchmark::State &state)
+{
+    lookup(state, denseNames(state.range(0)));
+}
+BENCHMARK(BM_LookupDense)->Arg(64)->Arg(4096)->Arg(65536);
+
+static void BM_LookupSparse(benchmark::State &state)
+{
+    lookup(state, sparseNames(state.range(0)));
+}
+BENCHMARK(BM_LookupSparse)->Arg(64)->Arg(4096)->Arg(65536);
+
+static void BM_LookupMiss(benchmark::State &state)
+{
+    HashTable table;
+    std::vector<GLuint> names = sparseNames(4096);
+
+    initHashTable(&table, 128);
+
+    for (GLuint name : names)
+    {
+        if (searchHashTable(&table, name) == NULL)
+            insertHashElement(&table, name, (void *)(uintptr_t)(name | 1));
+    }
+
+    GLuint name = 0x12345;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(searchHashTable(&table, name));
+        name += 0x10001;
+    }
+
+    freeHashTable(&table);
+}
+BENCHMARK(BM_LookupMiss);
+
+static void BM_InsertDelete(benchmark::State &state)
+{
+    HashTable table;
+
+    initHashTable(&table, 128);
+
+    for (auto _ : state)
+    {
+        GLuint name;
+
+        name = getNewName(&table);
+        insertHashElement(&table, name, (void *)(uintptr_t)(name | 1));
+        deleteHashElement(&table, name);
+    }
+
+    freeHashTable(&table);
+}
+BENCHMARK(BM_InsertDelete);
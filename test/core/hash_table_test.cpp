@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * hash_table_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <vector>
+
+extern "C"
+{
+#include "hash_table.h"
+}
+
+class HashTableTest : public ::testing::Test
+{
+  protected:
+    HashTable table;
+
+    void SetUp() override
+    {
+        initHashTable(&table, 128);
+    }
+
+    void TearDown() override
+    {
+        freeHashTable(&table);
+    }
+
+    static void *obj(uintptr_t v)
+    {
+        return (void *)(v << 4);
+    }
+};
+
+TEST_F(HashTableTest, NewNamesAreSequential)
+{
+    EXPECT_EQ(getNewName(&table), 1u);
+    EXPECT_EQ(getNewName(&table), 2u);
+    EXPECT_EQ(getNewName(&table), 3u);
+}
+
+TEST_F(HashTableTest, DenseInsertSearchDelete)
+{
+    for (GLuint i = 1; i < 100; i++)
+        insertHashElement(&table, i, obj(i));
+
+    for (GLuint i = 1; i < 100; i++)
+        EXPECT_EQ(searchHashTable(&table, i), obj(i));
+
+    deleteHashElement(&table, 50);
+    EXPECT_EQ(searchHashTable(&table, 50), nullptr);
+    EXPECT_EQ(searchHashTable(&table, 51), obj(51));
+}
+
+TEST_F(HashTableTest, DenseGrowth)
+{
+    for (GLuint i = 1; i < 10000; i++)
+        insertHashElement(&table, getNewName(&table), obj(i));
+
+    EXPECT_GE(table.size, 10000u);
+    EXPECT_EQ(table.sparse_count, 0u);
+
+    for (GLuint i = 1; i < 10000; i++)
+        EXPECT_EQ(searchHashTable(&table, i), obj(i));
+}
+
+TEST_F(HashTableTest, SearchOutOfRangeReturnsNull)
+{
+    EXPECT_EQ(searchHashTable(&table, 0xcafebeef), nullptr);
+    EXPECT_EQ(searchHashTable(&table, 0xffffffff), nullptr);
+
+    deleteHashElement(&table, 0xffffffff);
+}
+
+TEST_F(HashTableTest, SparseNamesDontGrowDenseArray)
+{
+    std::vector<GLuint> names;
+
+    for (GLuint i = 0; i < 1000; i++)
+        names.push_back(0x10000000u + i * 7919u);
+
+    for (GLuint name : names)
+        insertHashElement(&table, name, obj(name));
+
+    EXPECT_EQ(table.size, 128u);
+    EXPECT_EQ(table.sparse_count, 1000u);
+
+    for (GLuint name : names)
+        EXPECT_EQ(searchHashTable(&table, name), obj(name));
+
+    EXPECT_EQ(searchHashTable(&table, 0x10000001u), nullptr);
+}
+
+TEST_F(HashTableTest, SparseDeleteAndReinsert)
+{
+    for (int pass = 0; pass < 8; pass++)
+    {
+        for (GLuint i = 0; i < 500; i++)
+            insertHashElement(&table, 0x80000000u | (i << 8), obj(i + 1));
+
+        for (GLuint i = 0; i < 500; i++)
+            EXPECT_EQ(searchHashTable(&table, 0x80000000u | (i << 8)), obj(i + 1));
+
+        for (GLuint i = 0; i < 500; i++)
+            deleteHashElement(&table, 0x80000000u | (i << 8));
+
+        EXPECT_EQ(table.sparse_count, 0u);
+    }
+
+    // deleted slots get reclaimed instead of growing forever
+    EXPECT_LE(table.sparse_size, 2048u);
+}
+
+TEST_F(HashTableTest, SparseNamesMoveDenseOnGrowth)
+{
+    insertHashElement(&table, 200, obj(200));
+    insertHashElement(&table, 5000, obj(5000));
+
+    EXPECT_EQ(searchHashTable(&table, 5000), obj(5000));
+
+    // grow the dense array past 5000 one step at a time
+    for (GLuint i = 1; i < 6000; i++)
+    {
+        if (i != 200 && i != 5000)
+            insertHashElement(&table, i, obj(i));
+    }
+
+    EXPECT_GT(table.size, 5000u);
+    EXPECT_EQ(table.sparse_count, 0u);
+    EXPECT_EQ(searchHashTable(&table, 200), obj(200));
+    EXPECT_EQ(searchHashTable(&table, 5000), obj(5000));
+}
+
+TEST_F(HashTableTest, NewNameSkipsUserChosenNames)
+{
+    insertHashElement(&table, 1, obj(1));
+    insertHashElement(&table, 2, obj(2));
+
+    EXPECT_EQ(getNewName(&table), 3u);
+}
+
+TEST_F(HashTableTest, DeletedNamesAreRecycled)
+{
+    std::vector<GLuint> names;
+
+    for (GLuint i = 0; i < HASH_NAME_REUSE_DELAY * 2; i++)
+    {
+        GLuint name = getNewName(&table);
+        insertHashElement(&table, name, obj(name));
+        names.push_back(name);
+    }
+
+    for (GLuint name : names)
+        deleteHashElement(&table, name);
+
+    // oldest deleted names come back first, only once past the reuse delay
+    for (GLuint i = 0; i < HASH_NAME_REUSE_DELAY; i++)
+        EXPECT_EQ(getNewName(&table), names[i]);
+
+    EXPECT_EQ(getNewName(&table), HASH_NAME_REUSE_DELAY * 2 + 1);
+}
+
+TEST_F(HashTableTest, ChurnStaysCompact)
+{
+    std::vector<GLuint> live;
+
+    // editor style create / delete churn
+    for (int i = 0; i < 100000; i++)
+    {
+        GLuint name = getNewName(&table);
+        insertHashElement(&table, name, obj(name));
+        live.push_back(name);
+
+        if (live.size() > 32)
+        {
+            deleteHashElement(&table, live.front());
+            live.erase(live.begin());
+        }
+    }
+
+    EXPECT_LE(table.current_name, 32u + HASH_NAME_REUSE_DELAY + 2);
+    EXPECT_EQ(table.size, 128u);
+}
+
+TEST_F(HashTableTest, RecycleSkipsRebound)
+{
+    std::vector<GLuint> names;
+
+    for (GLuint i = 0; i < HASH_NAME_REUSE_DELAY + 1; i++)
+    {
+        GLuint name = getNewName(&table);
+        insertHashElement(&table, name, obj(name));
+        names.push_back(name);
+    }
+
+    for (GLuint name : names)
+        deleteHashElement(&table, name);
+
+    // app binds a deleted name again by hand
+    insertHashElement(&table, names[0], obj(1));
+
+    GLuint name = getNewName(&table);
+    EXPECT_NE(name, names[0]);
+    EXPECT_EQ(searchHashTable(&table, name), nullptr);
+}
+
+TEST_F(HashTableTest, GenerationCatchesStaleLookup)
+{
+    GLuint name = getNewName(&table);
+    insertHashElement(&table, name, obj(name));
+
+    EXPECT_EQ(getNameGeneration(&table, name), 0u);
+    EXPECT_EQ(table.stale_lookups, 0u);
+
+    deleteHashElement(&table, name);
+
+    EXPECT_EQ(searchHashTable(&table, name), nullptr);
+    EXPECT_EQ(table.stale_lookups, 1u);
+    EXPECT_EQ(getNameGeneration(&table, name), 0u);
+
+    // push it through the reuse delay
+    for (GLuint i = 0; i < HASH_NAME_REUSE_DELAY; i++)
+    {
+        GLuint n = getNewName(&table);
+        insertHashElement(&table, n, obj(n));
+        deleteHashElement(&table, n);
+    }
+
+    EXPECT_EQ(getNewName(&table), name);
+    EXPECT_EQ(getNameGeneration(&table, name), 1u);
+
+    insertHashElement(&table, name, obj(2));
+    EXPECT_EQ(searchHashTable(&table, name), obj(2));
+    EXPECT_EQ(table.stale_lookups, 1u);
+}
+
+TEST_F(HashTableTest, IterateVisitsDenseAndSparse)
+{
+    insertHashElement(&table, 3, obj(3));
+    insertHashElement(&table, 0x90000000u, obj(4));
+
+    int count = 0;
+    iterateHashTable(
+        &table, [](void *, void *arg) { (*(int *)arg)++; }, &count);
+
+    EXPECT_EQ(count, 2);
+}
+
+TEST(HashTable, CreateHashTable)
+{
+    HashTable *table;
+
+    table = createHashTable(100);
+    ASSERT_NE(table, nullptr);
+
+    EXPECT_EQ(table->size, 128u);
+    EXPECT_EQ(table->current_name, 1u);
+
+    freeHashTable(table);
+    free(table);
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * mem_budget_test.cpp
+ * MGL
+ *
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C"
+{
+#include "mem_budget.h"
+}
+
+// what the caller does with a candidate, drop the shadow and account for it
+static void evict(MemBudget *mb, MemLRUNode *node)
+{
+    size_t size = node->size;
+
+    removeMemLRU(mb, node);
+    removeMemResident(mb, size);
+    recordMemEviction(mb, size);
+}
+
+TEST(MemBudgetTest, NoBudgetNeverEvicts)
+{
+    MemBudget mb;
+    MemLRUNode node = {};
+
+    initMemBudget(&mb, 0);
+
+    addMemResident(&mb, 1 << 30);
+    touchMemLRU(&mb, &node, 1 << 30);
+
+    EXPECT_EQ(findMemEvictCandidate(&mb), nullptr);
+}
+
+TEST(MemBudgetTest, UnderBudgetNeverEvicts)
+{
+    MemBudget mb;
+    MemLRUNode node = {};
+
+    initMemBudget(&mb, 4096);
+
+    addMemResident(&mb, 4096);
+    touchMemLRU(&mb, &node, 4096);
+
+    EXPECT_EQ(findMemEvictCandidate(&mb), nullptr);
+}
+
+TEST(MemBudgetTest, EvictsLeastRecentlyUsedFirst)
+{
+    MemBudget mb;
+    MemLRUNode nodes[4] = {};
+
+    initMemBudget(&mb, 2500);
+
+    for (int i = 0; i < 4; i++)
+    {
+        addMemResident(&mb, 1000);
+        touchMemLRU(&mb, &nodes[i], 1000);
+    }
+
+    // 0 gets used again, 1 is now the oldest
+    touchMemLRU(&mb, &nodes[0], 1000);
+
+    MemLRUNode *node = findMemEvictCandidate(&mb);
+    ASSERT_EQ(node, &nodes[1]);
+    evict(&mb, node);
+
+    node = findMemEvictCandidate(&mb);
+    ASSERT_EQ(node, &nodes[2]);
+    evict(&mb, node);
+
+    EXPECT_EQ(findMemEvictCandidate(&mb), nullptr);
+
+    MemBudgetStats stats;
+    getMemBudgetStats(&mb, &stats);
+    EXPECT_EQ(stats.resident, 2000u);
+    EXPECT_EQ(stats.evictable, 2000u);
+    EXPECT_EQ(stats.evictions, 2u);
+    EXPECT_EQ(stats.evicted_bytes, 2000u);
+}
+
+TEST(MemBudgetTest, PinnedShadowsCountButAreNotEvicted)
+{
+    MemBudget mb;
+    MemLRUNode node = {};
+
+    initMemBudget(&mb, 1000);
+
+    // dirty or render target shadows are resident but never on the lru
+    addMemResident(&mb, 5000);
+
+    addMemResident(&mb, 500);
+    touchMemLRU(&mb, &node, 500);
+
+    ASSERT_EQ(findMemEvictCandidate(&mb), &node);
+    evict(&mb, &node);
+
+    EXPECT_FALSE(isOnMemLRU(&node));
+    EXPECT_EQ(findMemEvictCandidate(&mb), nullptr);
+}
+
+TEST(MemBudgetTest, RemoveAndResize)
+{
+    MemBudget mb;
+    MemLRUNode a = {}, b = {};
+
+    initMemBudget(&mb, 100);
+
+    touchMemLRU(&mb, &a, 300);
+    touchMemLRU(&mb, &b, 200);
+
+    // respecified at a different size
+    touchMemLRU(&mb, &a, 50);
+
+    MemBudgetStats stats;
+    getMemBudgetStats(&mb, &stats);
+    EXPECT_EQ(stats.evictable, 250u);
+
+    removeMemLRU(&mb, &b);
+    removeMemLRU(&mb, &b);
+
+    getMemBudgetStats(&mb, &stats);
+    EXPECT_EQ(stats.evictable, 50u);
+
+    removeMemLRU(&mb, &a);
+
+    getMemBudgetStats(&mb, &stats);
+    EXPECT_EQ(stats.evictable, 0u);
+}
+
+TEST(MemBudgetTest, LoweringTheBudgetEvictsMore)
+{
+    MemBudget mb;
+    std::vector<MemLRUNode> nodes(100);
+
+    initMemBudget(&mb, 0);
+
+    for (auto &node : nodes)
+    {
+        addMemResident(&mb, 1024);
+        touchMemLRU(&mb, &node, 1024);
+    }
+
+    setMemBudget(&mb, 10 * 1024);
+
+    size_t evicted = 0;
+    MemLRUNode *node;
+    while ((node = findMemEvictCandidate(&mb)))
+    {
+        EXPECT_EQ(node, &nodes[evicted]);
+        evict(&mb, node);
+        evicted++;
+    }
+
+    EXPECT_EQ(evicted, 90u);
+
+    // read back from the gpu and used again
+    addMemResident(&mb, 1024);
+    recordMemRestore(&mb, 1024);
+    touchMemLRU(&mb, &nodes[0], 1024);
+
+    node = findMemEvictCandidate(&mb);
+    ASSERT_EQ(node, &nodes[90]);
+
+    MemBudgetStats stats;
+    getMemBudgetStats(&mb, &stats);
+    EXPECT_EQ(stats.restores, 1u);
+    EXPECT_EQ(stats.restored_bytes, 1024u);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * mipmap_filter_bench.cpp
+ * MGL
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+extern "C"
+{
+#include "mipmap_filter.h"
+}
+
+// the first level of a 1024x1024 texture, bytes processed counts the level
+// being filtered. the odd sized run is the generic path either way.
+
+static void runFilter(benchmark::State &state, bool generic)
+{
+    PixelLayout layout = (PixelLayout)state.range(0);
+    size_t width = state.range(1), height = state.range(1);
+    bool srgb = state.range(2) != 0;
+    size_t pixel_size = getPixelLayoutSize(layout);
+    size_t dst_width = getMipmapSize(width), dst_height = getMipmapSize(height);
+    std::vector<unsigned char> src(width * height * pixel_size), dst(dst_width * dst_height * pixel_size);
+
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (unsigned char)(i * 13);
+
+    // keep the float layouts finite
+    if (layout >= PIXEL_LAYOUT_R32F)
+    {
+        for (size_t i = 0; i < src.size() / 4; i++)
+            ((float *)src.data())[i] = (float)(i & 255) / 255.0f;
+    }
+
+    for (auto _ : state)
+    {
+        if (generic)
+            filterMipmapLevelGeneric(layout, srgb, dst.data(), dst_width * pixel_size, dst.size(), src.data(),
+                                     width * pixel_size, src.size(), width, height, 1);
+        else
+            filterMipmapLevel(layout, srgb, dst.data(), dst_width * pixel_size, dst.size(), src.data(),
+                              width * pixel_size, src.size(), width, height, 1);
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+
+static void BM_FilterGeneric(benchmark::State &state)
+{
+    runFilter(state, true);
+}
+
+static void BM_Filter(benchmark::State &state)
+{
+    runFilter(state, false);
+}
+
+static void filterArgs(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"layout", "size", "srgb"});
+    b->Args({PIXEL_LAYOUT_RGBA8, 1024, 0});
+    b->Args({PIXEL_LAYOUT_RGBA8, 1024, 1});
+    b->Args({PIXEL_LAYOUT_RGBA8, 1023, 0});
+    b->Args({PIXEL_LAYOUT_RGBA16F, 1024, 0});
+    b->Args({PIXEL_LAYOUT_RGBA32F, 1024, 0});
+}
+
+BENCHMARK(BM_FilterGeneric)->Apply(filterArgs);
+BENCHMARK(BM_Filter)->Apply(filterArgs);
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * mipmap_filter_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "mipmap_filter.h"
+}
+
+static const PixelLayout filtered_layouts[] = {
+    PIXEL_LAYOUT_R8,     PIXEL_LAYOUT_RG8,     PIXEL_LAYOUT_RGB8,    PIXEL_LAYOUT_BGR8,    PIXEL_LAYOUT_RGBA8,
+    PIXEL_LAYOUT_BGRA8,  PIXEL_LAYOUT_R16,     PIXEL_LAYOUT_RG16,    PIXEL_LAYOUT_RGB16,   PIXEL_LAYOUT_RGBA16,
+    PIXEL_LAYOUT_R16F,   PIXEL_LAYOUT_RG16F,   PIXEL_LAYOUT_RGB16F,  PIXEL_LAYOUT_RGBA16F, PIXEL_LAYOUT_R32F,
+    PIXEL_LAYOUT_RG32F,  PIXEL_LAYOUT_RGB32F,  PIXEL_LAYOUT_RGBA32F,
+};
+
+// float layouts get finite values so nothing depends on nan payloads
+static void fillRandom(PixelLayout layout, std::vector<unsigned char> &buf)
+{
+    if (layout >= PIXEL_LAYOUT_R32F && layout <= PIXEL_LAYOUT_RGBA32F)
+    {
+        for (size_t i = 0; i + 4 <= buf.size(); i += 4)
+        {
+            float f = (float)(rand() % 20000 - 5000) / 10000.0f;
+            memcpy(&buf[i], &f, 4);
+        }
+    }
+    else if (layout >= PIXEL_LAYOUT_R16F && layout <= PIXEL_LAYOUT_RGBA16F)
+    {
+        for (size_t i = 0; i + 2 <= buf.size(); i += 2)
+        {
+            uint16_t h = floatToHalf((float)(rand() % 20000 - 5000) / 10000.0f);
+            memcpy(&buf[i], &h, 2);
+        }
+    }
+    else
+    {
+        for (auto &b : buf)
+            b = (unsigned char)rand();
+    }
+}
+
+TEST(MipmapFilter, SizesAndLayouts)
+{
+    EXPECT_EQ(getMipmapSize(1), 1u);
+    EXPECT_EQ(getMipmapSize(2), 1u);
+    EXPECT_EQ(getMipmapSize(3), 1u);
+    EXPECT_EQ(getMipmapSize(5), 2u);
+    EXPECT_EQ(getMipmapSize(1024), 512u);
+
+    for (PixelLayout layout : filtered_layouts)
+        EXPECT_TRUE(canFilterMipmap(layout)) << layout;
+
+    EXPECT_FALSE(canFilterMipmap(PIXEL_LAYOUT_INVALID));
+    EXPECT_FALSE(canFilterMipmap(PIXEL_LAYOUT_RGB565));
+    EXPECT_FALSE(canFilterMipmap(PIXEL_LAYOUT_ABGR8));
+
+    unsigned char texel[4] = {}, out[4];
+    EXPECT_FALSE(filterMipmapLevel(PIXEL_LAYOUT_RGBA4444, false, out, 4, 4, texel, 4, 4, 1, 1, 1));
+}
+
+TEST(MipmapFilter, BoxRoundsToNearest)
+{
+    // 2x2 rgba8, a 2 texel wide level 0 in rows of 8 bytes
+    unsigned char src[16] = {0, 1, 255, 10, 1, 2, 255, 20, 0, 1, 255, 30, 1, 1, 254, 41};
+    unsigned char dst[4];
+
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_RGBA8, false, dst, 4, 4, src, 8, 16, 2, 2, 1));
+    EXPECT_EQ(dst[0], 1);   // 2 / 4 rounds up
+    EXPECT_EQ(dst[1], 1);   // 5 / 4
+    EXPECT_EQ(dst[2], 255); // 1019 / 4
+    EXPECT_EQ(dst[3], 25);  // 101 / 4
+}
+
+// every kernel has to give exactly what the generic path gives, widths cover the
+// vector widths and the scalar tails and rows are padded
+TEST(MipmapFilter, EveryLayoutMatchesGeneric)
+{
+    srand(2468);
+
+    for (PixelLayout layout : filtered_layouts)
+    {
+        size_t pixel_size = getPixelLayoutSize(layout);
+
+        for (bool srgb : {false, true})
+        {
+            for (size_t width : {1, 2, 3, 4, 6, 7, 8, 10, 16, 18, 33, 64})
+            {
+                for (size_t height : {1, 2, 3, 4, 5})
+                {
+                    size_t src_pitch = width * pixel_size + 12;
+                    size_t dst_width = getMipmapSize(width), dst_height = getMipmapSize(height);
+                    size_t dst_pitch = dst_width * pixel_size + 4;
+                    std::vector<unsigned char> src(src_pitch * height);
+                    std::vector<unsigned char> expect(dst_pitch * dst_height, 0xcd), got(expect.size(), 0xcd);
+
+                    fillRandom(layout, src);
+
+                    ASSERT_TRUE(filterMipmapLevelGeneric(layout, srgb, expect.data(), dst_pitch, expect.size(),
+                                                         src.data(), src_pitch, src.size(), width, height, 1));
+                    ASSERT_TRUE(filterMipmapLevel(layout, srgb, got.data(), dst_pitch, got.size(), src.data(),
+                                                  src_pitch, src.size(), width, height, 1));
+
+                    // the padding has to be left alone too
+                    ASSERT_EQ(memcmp(expect.data(), got.data(), got.size()), 0)
+                        << "layout " << layout << " srgb " << srgb << " " << width << "x" << height;
+
+                    for (size_t y = 0; y < dst_height; y++)
+                    {
+                        for (size_t i = dst_width * pixel_size; i < dst_pitch; i++)
+                            ASSERT_EQ(got[y * dst_pitch + i], 0xcd);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(MipmapFilter, OddSizesWeighEveryTexel)
+{
+    // 5 wide goes to 2, the middle texel is split between them
+    float row[5] = {0.0f, 5.0f, 10.0f, 15.0f, 20.0f};
+    float out[2];
+
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_R32F, false, out, sizeof(out), sizeof(out), row, sizeof(row),
+                                  sizeof(row), 5, 1, 1));
+    EXPECT_NEAR(out[0], (2 * 0.0f + 2 * 5.0f + 10.0f) / 5, 1e-5);
+    EXPECT_NEAR(out[1], (10.0f + 2 * 15.0f + 2 * 20.0f) / 5, 1e-5);
+
+    // a flat image stays flat whatever the sizes
+    for (size_t width : {3, 5, 7, 9})
+    {
+        for (size_t height : {1, 3, 4, 7})
+        {
+            std::vector<unsigned char> src(width * height * 4, 77);
+            size_t dst_width = getMipmapSize(width), dst_height = getMipmapSize(height);
+            std::vector<unsigned char> dst(dst_width * dst_height * 4);
+
+            ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_RGBA8, false, dst.data(), dst_width * 4, dst.size(),
+                                          src.data(), width * 4, src.size(), width, height, 1));
+
+            for (unsigned char b : dst)
+                ASSERT_EQ(b, 77) << width << "x" << height;
+        }
+    }
+
+    // the average is kept, 3x3 to 1 is the plain mean
+    uint16_t grid[9] = {0, 100, 200, 300, 400, 500, 600, 700, 800};
+    uint16_t mean;
+
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_R16, false, &mean, 2, 2, grid, 6, 18, 3, 3, 1));
+    EXPECT_EQ(mean, 400);
+}
+
+TEST(MipmapFilter, SRGBFiltersInLinear)
+{
+    // two black and two white texels, half the light is srgb 188 not 128
+    unsigned char src[16] = {0, 0, 0, 0, 255, 255, 255, 255, 0, 0, 0, 0, 255, 255, 255, 255};
+    unsigned char dst[4];
+
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_RGBA8, true, dst, 4, 4, src, 8, 16, 2, 2, 1));
+    EXPECT_EQ(dst[0], 188);
+    EXPECT_EQ(dst[1], 188);
+    EXPECT_EQ(dst[2], 188);
+    EXPECT_EQ(dst[3], 128); // alpha is linear
+
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_RGBA8, false, dst, 4, 4, src, 8, 16, 2, 2, 1));
+    EXPECT_EQ(dst[0], 128);
+
+    // every mix of two codes lands where rounding the linear mean in srgb does, mixes of
+    // two codes in the linear segment can land on a half and float decides those
+    for (int a = 0; a < 256; a++)
+    {
+        for (int b = a; b < 256; b++)
+        {
+            unsigned char mix[16] = {(unsigned char)a, 0, 0, 0, (unsigned char)b, 0, 0, 0,
+                                     (unsigned char)a, 0, 0, 0, (unsigned char)b, 0, 0, 0};
+            unsigned char out[4];
+            double la = (a / 255.0 <= 0.04045) ? a / 255.0 / 12.92 : pow((a / 255.0 + 0.055) / 1.055, 2.4);
+            double lb = (b / 255.0 <= 0.04045) ? b / 255.0 / 12.92 : pow((b / 255.0 + 0.055) / 1.055, 2.4);
+            double l = (la + lb) / 2;
+            double c = (l <= 0.0031308) ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+
+            if (fabs(c * 255.0 - floor(c * 255.0) - 0.5) < 1e-4)
+                continue;
+
+            ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_RGBA8, true, out, 4, 4, mix, 8, 16, 2, 2, 1));
+            ASSERT_EQ(out[0], lrint(c * 255.0)) << a << " " << b;
+        }
+    }
+
+    // every code survives a flat image
+    for (int v = 0; v < 256; v++)
+    {
+        unsigned char flat[16], out[4];
+
+        memset(flat, v, sizeof(flat));
+
+        ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_RGBA8, true, out, 4, 4, flat, 8, 16, 2, 2, 1));
+        ASSERT_EQ(out[0], v);
+    }
+}
+
+TEST(MipmapFilter, Volumes)
+{
+    // 2x2x2 goes to a single texel, the mean of all 8
+    float cube[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float out;
+
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_R32F, false, &out, 4, 4, cube, 8, 16, 2, 2, 2));
+    EXPECT_FLOAT_EQ(out, 4.5f);
+
+    // 4x4x3 goes to 2x2x1, each of the 3 slices weighs a third
+    std::vector<float> vol(4 * 4 * 3);
+    float planes[2 * 2];
+
+    for (size_t z = 0; z < 3; z++)
+    {
+        for (size_t i = 0; i < 16; i++)
+            vol[z * 16 + i] = (float)(z * 30);
+    }
+
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_R32F, false, planes, 8, 16, vol.data(), 16, 64, 4, 4, 3));
+
+    for (float f : planes)
+        EXPECT_NEAR(f, 30.0f, 1e-4);
+
+    // 3d always takes the generic path, rgba8 just to cover the weights there
+    std::vector<unsigned char> src(6 * 6 * 4 * 4), expect(3 * 3 * 2 * 4), got(expect.size());
+
+    fillRandom(PIXEL_LAYOUT_RGBA8, src);
+
+    ASSERT_TRUE(filterMipmapLevelGeneric(PIXEL_LAYOUT_RGBA8, false, expect.data(), 12, 36, src.data(), 24, 144, 6, 6,
+                                         4));
+    ASSERT_TRUE(filterMipmapLevel(PIXEL_LAYOUT_RGBA8, false, got.data(), 12, 36, src.data(), 24, 144, 6, 6, 4));
+    EXPECT_EQ(memcmp(expect.data(), got.data(), got.size()), 0);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * object_pool_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <set>
+#include <vector>
+
+extern "C"
+{
+#include "object_pool.h"
+}
+
+class ObjectPoolTest : public ::testing::Test
+{
+  protected:
+    ObjectPool pool;
+
+    void SetUp() override
+    {
+        // odd size, same ballpark as Texture
+        initObjectPool(&pool, 264);
+    }
+
+    void TearDown() override
+    {
+        freeObjectPool(&pool);
+    }
+};
+
+TEST_F(ObjectPoolTest, ObjectsAreAlignedAndZeroed)
+{
+    EXPECT_EQ(pool.obj_size % OBJECT_POOL_ALIGN, 0u);
+
+    for (int i = 0; i < 100; i++)
+    {
+        unsigned char *obj = (unsigned char *)newPoolObject(&pool);
+
+        ASSERT_NE(obj, nullptr);
+        EXPECT_EQ((uintptr_t)obj % OBJECT_POOL_ALIGN, 0u);
+
+        for (size_t j = 0; j < 264; j++)
+            ASSERT_EQ(obj[j], 0);
+
+        memset(obj, 0xff, 264);
+    }
+}
+
+TEST_F(ObjectPoolTest, FreedObjectsAreRecycled)
+{
+    void *a = newPoolObject(&pool);
+    void *b = newPoolObject(&pool);
+
+    memset(a, 0xab, 264);
+    freePoolObject(&pool, a);
+
+    void *c = newPoolObject(&pool);
+    EXPECT_EQ(c, a);
+    EXPECT_EQ(((unsigned char *)c)[100], 0);
+
+    freePoolObject(&pool, b);
+    freePoolObject(&pool, c);
+}
+
+TEST_F(ObjectPoolTest, Stats)
+{
+    std::vector<void *> objs;
+
+    for (unsigned i = 0; i < pool.objs_per_slab + 1; i++)
+        objs.push_back(newPoolObject(&pool));
+
+    ObjectPoolStats stats;
+    getObjectPoolStats(&pool, &stats);
+
+    EXPECT_EQ(stats.live, pool.objs_per_slab + 1);
+    EXPECT_EQ(stats.slabs, 2u);
+    EXPECT_EQ(stats.bytes, pool.slab_size * 2);
+
+    for (void *obj : objs)
+        freePoolObject(&pool, obj);
+
+    // churn stays inside the existing slabs
+    for (int i = 0; i < 10000; i++)
+        freePoolObject(&pool, newPoolObject(&pool));
+
+    getObjectPoolStats(&pool, &stats);
+
+    EXPECT_EQ(stats.live, 0u);
+    EXPECT_EQ(stats.peak, pool.objs_per_slab + 1);
+    EXPECT_EQ(stats.slabs, 2u);
+    EXPECT_EQ(stats.allocs, stats.frees);
+}
+
+TEST_F(ObjectPoolTest, IterateVisitsLiveObjects)
+{
+    std::vector<void *> objs;
+    std::set<void *> live;
+
+    for (int i = 0; i < 1000; i++)
+        objs.push_back(newPoolObject(&pool));
+
+    for (int i = 0; i < 1000; i++)
+    {
+        if (i % 3)
+            freePoolObject(&pool, objs[i]);
+        else
+            live.insert(objs[i]);
+    }
+
+    std::set<void *> seen;
+    iterateObjectPool(
+        &pool, [](void *obj, void *arg) { ((std::set<void *> *)arg)->insert(obj); }, &seen);
+
+    EXPECT_EQ(seen, live);
+}
+
+TEST(ObjectPool, LargeObjects)
+{
+    ObjectPool pool;
+
+    // Program sized
+    initObjectPool(&pool, 2216);
+
+    EXPECT_GE(pool.objs_per_slab, 16u);
+    EXPECT_EQ(pool.slab_size & (pool.slab_size - 1), 0u);
+
+    void *obj = newPoolObject(&pool);
+    memset(obj, 1, 2216);
+    freePoolObject(&pool, obj);
+
+    freeObjectPool(&pool);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * page_allocator_bench.cpp
+ * MGL
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <sys/mman.h>
+
+extern "C"
+{
+#include "page_allocator.h"
+}
+
+// what every buffer / texture level used to cost, a page sized mapping
+static void BM_MapPerAllocation(benchmark::State &state)
+{
+    size_t size = page_size_align(state.range(0));
+
+    for (auto _ : state)
+    {
+        void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        *(volatile char *)ptr = 1;
+        munmap(ptr, size);
+    }
+}
+BENCHMARK(BM_MapPerAllocation)->Arg(16)->Arg(256)->Arg(4096)->Arg(64 << 10)->Arg(1 << 20);
+
+static void BM_AllocPages(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        size_t alloc_size;
+        void *ptr = allocPages(state.range(0), 0, &alloc_size);
+        *(volatile char *)ptr = 1;
+        freePages(ptr, alloc_size);
+    }
+}
+BENCHMARK(BM_AllocPages)->Arg(16)->Arg(256)->Arg(4096)->Arg(64 << 10)->Arg(1 << 20);
+
+static void BM_AllocPagesZeroCopy(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        size_t alloc_size;
+        void *ptr = allocPages(state.range(0), PAGE_ALLOC_ZERO_COPY, &alloc_size);
+        *(volatile char *)ptr = 1;
+        freePages(ptr, alloc_size);
+    }
+}
+BENCHMARK(BM_AllocPagesZeroCopy)->Arg(16)->Arg(4096)->Arg(1 << 20);
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * page_allocator_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "page_allocator.h"
+}
+
+static bool isZero(const void *ptr, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)ptr;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        if (p[i])
+            return false;
+    }
+
+    return true;
+}
+
+TEST(PageAllocator, SmallSizeClasses)
+{
+    size_t alloc_size;
+
+    void *ptr = allocPages(16, 0, &alloc_size);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ(alloc_size, 16u);
+    freePages(ptr, alloc_size);
+
+    ptr = allocPages(100, 0, &alloc_size);
+    EXPECT_EQ(alloc_size, 128u);
+    freePages(ptr, alloc_size);
+
+    ptr = allocPages(2048, 0, &alloc_size);
+    EXPECT_EQ(alloc_size, 2048u);
+    freePages(ptr, alloc_size);
+
+    // a 1x1 mip level doesn't cost a page
+    ptr = allocPages(4, 0, &alloc_size);
+    EXPECT_LT(alloc_size, getPageSize());
+    freePages(ptr, alloc_size);
+}
+
+TEST(PageAllocator, MemoryIsZeroed)
+{
+    const size_t sizes[] = {16, 200, 3000, 100000, 1 << 20};
+
+    for (size_t size : sizes)
+    {
+        size_t alloc_size;
+
+        // dirty it, free it, get it back
+        void *ptr = allocPages(size, 0, &alloc_size);
+        memset(ptr, 0xcd, alloc_size);
+        freePages(ptr, alloc_size);
+
+        ptr = allocPages(size, 0, &alloc_size);
+        EXPECT_GE(alloc_size, size);
+        EXPECT_TRUE(isZero(ptr, alloc_size)) << size;
+        freePages(ptr, alloc_size);
+    }
+}
+
+TEST(PageAllocator, ZeroCopyIsPageAligned)
+{
+    const size_t sizes[] = {1, 4096, 5000, 1 << 20};
+
+    for (size_t size : sizes)
+    {
+        size_t alloc_size;
+
+        void *ptr = allocPages(size, PAGE_ALLOC_ZERO_COPY, &alloc_size);
+        ASSERT_NE(ptr, nullptr);
+
+        EXPECT_EQ((uintptr_t)ptr % getPageSize(), 0u);
+        EXPECT_EQ(alloc_size % getPageSize(), 0u);
+        EXPECT_GE(alloc_size, size);
+
+        freePages(ptr, alloc_size);
+    }
+}
+
+TEST(PageAllocator, LargeAllocationsAreMapped)
+{
+    PageAllocatorStats before, during;
+    size_t alloc_size;
+
+    getPageAllocatorStats(&before);
+
+    void *ptr = allocPages(4 << 20, PAGE_ALLOC_HUGE_PAGES, &alloc_size);
+    ASSERT_NE(ptr, nullptr);
+    memset(ptr, 1, alloc_size);
+
+    getPageAllocatorStats(&during);
+    EXPECT_EQ(during.mapped_bytes - before.mapped_bytes, alloc_size);
+
+    freePages(ptr, alloc_size);
+
+    getPageAllocatorStats(&during);
+    EXPECT_EQ(during.mapped_bytes, before.mapped_bytes);
+}
+
+TEST(PageAllocator, SmallChurnReusesChunks)
+{
+    PageAllocatorStats before, after;
+    std::vector<std::pair<void *, size_t>> live;
+
+    getPageAllocatorStats(&before);
+
+    for (int pass = 0; pass < 100; pass++)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            size_t alloc_size;
+            void *ptr = allocPages(64, 0, &alloc_size);
+            live.push_back({ptr, alloc_size});
+        }
+
+        for (auto &p : live)
+            freePages(p.first, p.second);
+
+        live.clear();
+    }
+
+    getPageAllocatorStats(&after);
+
+    EXPECT_LE(after.small_chunks - before.small_chunks, 1u);
+    EXPECT_EQ(after.small_bytes, before.small_bytes);
+}
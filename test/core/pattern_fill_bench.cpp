@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pattern_fill_bench.cpp
+ * MGL
+ *
+ */
+
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "pattern_fill.h"
+}
+
+// clear throughput by pattern size, the per element copy is what the buffer
+// clear used to do
+
+static void BM_FillPerElement(benchmark::State &state)
+{
+    size_t pattern_size = state.range(0);
+    size_t size = (size_t)state.range(1) / pattern_size * pattern_size;
+    std::vector<unsigned char> buf(size);
+    unsigned char pattern[16];
+
+    for (size_t i = 0; i < sizeof(pattern); i++)
+        pattern[i] = (unsigned char)(i + 1);
+
+    for (auto _ : state)
+    {
+        unsigned char *dst = buf.data();
+
+        for (size_t i = 0; i < size / pattern_size; i++)
+        {
+            memcpy(dst, pattern, pattern_size);
+            dst += pattern_size;
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+static void BM_PatternFill(benchmark::State &state)
+{
+    size_t pattern_size = state.range(0);
+    size_t size = (size_t)state.range(1) / pattern_size * pattern_size;
+    std::vector<unsigned char> buf(size);
+    unsigned char pattern[16];
+
+    for (size_t i = 0; i < sizeof(pattern); i++)
+        pattern[i] = (unsigned char)(i + 1);
+
+    for (auto _ : state)
+    {
+        patternFill(buf.data(), size, pattern, pattern_size);
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+static void fillArgs(benchmark::internal::Benchmark *b)
+{
+    for (int size : {64 << 10, 16 << 20})
+    {
+        for (int pattern_size : {1, 2, 4, 8, 12, 16})
+            b->Args({pattern_size, size});
+    }
+}
+
+BENCHMARK(BM_FillPerElement)->Apply(fillArgs);
+BENCHMARK(BM_PatternFill)->Apply(fillArgs);
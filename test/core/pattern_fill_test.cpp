@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pattern_fill_test.cpp
+ * MGL
+ *
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "pattern_fill.h"
+}
+
+static void expectFilled(const std::vector<unsigned char> &buf, size_t offset, size_t size,
+                         const unsigned char *pattern, size_t pattern_size)
+{
+    for (size_t i = 0; i < size; i++)
+        ASSERT_EQ(buf[offset + i], pattern[i % pattern_size]) << "byte " << i << " pattern size " << pattern_size;
+}
+
+class PatternFillTest : public ::testing::TestWithParam<size_t>
+{
+};
+
+TEST_P(PatternFillTest, FillsEverySizeAndAlignment)
+{
+    size_t pattern_size = GetParam();
+    unsigned char pattern[32];
+
+    for (size_t i = 0; i < sizeof(pattern); i++)
+        pattern[i] = (unsigned char)(0x11 * (i + 1));
+
+    // misaligned starts and sizes around the vector and unroll boundaries
+    for (size_t offset = 0; offset < 4; offset++)
+    {
+        for (size_t count = 0; count < 80; count++)
+        {
+            size_t size = count * pattern_size;
+            std::vector<unsigned char> buf(size + 8, 0xcd);
+
+            patternFill(buf.data() + offset, size, pattern, pattern_size);
+
+            expectFilled(buf, offset, size, pattern, pattern_size);
+
+            // nothing written past the end
+            for (size_t i = offset + size; i < buf.size(); i++)
+                ASSERT_EQ(buf[i], 0xcd);
+
+            for (size_t i = 0; i < offset; i++)
+                ASSERT_EQ(buf[i], 0xcd);
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(PatternSizes, PatternFillTest, ::testing::Values(1, 2, 3, 4, 6, 8, 12, 16, 24));
+
+TEST(PatternFill, ByteSplatPattern)
+{
+    uint32_t zero = 0;
+    uint32_t ones = 0xffffffff;
+    std::vector<unsigned char> buf(1000, 0xcd);
+
+    patternFill(buf.data(), 1000, &zero, 4);
+    for (auto b : buf)
+        ASSERT_EQ(b, 0);
+
+    patternFill(buf.data(), 1000, &ones, 4);
+    for (auto b : buf)
+        ASSERT_EQ(b, 0xff);
+}
+
+TEST(PatternFill, LargeRgb32Fill)
+{
+    float rgb[3] = {1.0f, 0.5f, 0.25f};
+    size_t count = 100003;
+    std::vector<float> buf(count * 3);
+
+    patternFill(buf.data(), count * sizeof(rgb), rgb, sizeof(rgb));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ASSERT_EQ(buf[i * 3], 1.0f);
+        ASSERT_EQ(buf[i * 3 + 1], 0.5f);
+        ASSERT_EQ(buf[i * 3 + 2], 0.25f);
+    }
+}
+
+TEST(PatternFill, ZeroSizeIsNoop)
+{
+    unsigned char buf[4] = {1, 2, 3, 4};
+    uint16_t pattern = 0x1234;
+
+    patternFill(buf, 0, &pattern, 2);
+
+    EXPECT_EQ(buf[0], 1);
+    EXPECT_EQ(buf[3], 4);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_convert_bench.cpp
+ * MGL
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+extern "C"
+{
+#include "pixel_convert.h"
+}
+
+// upload and readback conversion throughput per format pair, a 1024 pixel row at
+// a time like a texture upload or a glReadPixels pack does it. bytes processed counts the source side.
+
+#define ROW_PIXELS 1024
+#define ROWS 1024
+
+static void runConvert(benchmark::State &state, bool generic)
+{
+    PixelLayout dst_layout = (PixelLayout)state.range(0);
+    PixelLayout src_layout = (PixelLayout)state.range(1);
+    size_t src_size = getPixelLayoutSize(src_layout);
+    size_t dst_size = getPixelLayoutSize(dst_layout);
+    std::vector<unsigned char> src(src_size * ROW_PIXELS * ROWS);
+    std::vector<unsigned char> dst(dst_size * ROW_PIXELS * ROWS);
+
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (unsigned char)(i * 7);
+
+    for (auto _ : state)
+    {
+        for (size_t row = 0; row < ROWS; row++)
+        {
+            const unsigned char *s = src.data() + row * ROW_PIXELS * src_size;
+            unsigned char *d = dst.data() + row * ROW_PIXELS * dst_size;
+
+            if (generic)
+                convertPixelsGeneric(dst_layout, d, src_layout, s, ROW_PIXELS);
+            else
+                convertPixels(dst_layout, d, src_layout, s, ROW_PIXELS);
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+
+static void BM_ConvertGeneric(benchmark::State &state)
+{
+    runConvert(state, true);
+}
+
+static void BM_Convert(benchmark::State &state)
+{
+    runConvert(state, false);
+}
+
+static void convertArgs(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"dst", "src"});
+    b->Args({PIXEL_LAYOUT_RGBA8, PIXEL_LAYOUT_RGB8});
+    b->Args({PIXEL_LAYOUT_RGBA8, PIXEL_LAYOUT_BGR8});
+    b->Args({PIXEL_LAYOUT_RGBA8, PIXEL_LAYOUT_BGRA8});
+    b->Args({PIXEL_LAYOUT_RGBA8, PIXEL_LAYOUT_RGB565});
+    b->Args({PIXEL_LAYOUT_RGBA16F, PIXEL_LAYOUT_RGBA32F});
+    b->Args({PIXEL_LAYOUT_RGBA16F, PIXEL_LAYOUT_RGB32F});
+    b->Args({PIXEL_LAYOUT_RGBA32F, PIXEL_LAYOUT_RGB32F});
+    b->Args({PIXEL_LAYOUT_RGBA8, PIXEL_LAYOUT_RGBA4444});
+
+    // readback
+    b->Args({PIXEL_LAYOUT_RGB8, PIXEL_LAYOUT_BGRA8});
+    b->Args({PIXEL_LAYOUT_RGBA32F, PIXEL_LAYOUT_RGBA16F});
+    b->Args({PIXEL_LAYOUT_R32, PIXEL_LAYOUT_R32F});
+}
+
+BENCHMARK(BM_ConvertGeneric)->Apply(convertArgs);
+BENCHMARK(BM_Convert)->Apply(convertArgs);
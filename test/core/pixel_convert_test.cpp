@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_convert_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "pixel_convert.h"
+}
+
+// random pixels, float sources get finite values around 0..1 so nothing depends on nan payloads
+static std::vector<unsigned char> randomPixels(PixelLayout layout, size_t count)
+{
+    size_t size = getPixelLayoutSize(layout) * count;
+    std::vector<unsigned char> buf(size);
+
+    switch (layout)
+    {
+    case PIXEL_LAYOUT_R32F:
+    case PIXEL_LAYOUT_RG32F:
+    case PIXEL_LAYOUT_RGB32F:
+    case PIXEL_LAYOUT_RGBA32F:
+        for (size_t i = 0; i < size / 4; i++)
+        {
+            float f = (float)(rand() % 20000 - 5000) / 10000.0f;
+            memcpy(&buf[i * 4], &f, 4);
+        }
+        break;
+
+    case PIXEL_LAYOUT_R16F:
+    case PIXEL_LAYOUT_RG16F:
+    case PIXEL_LAYOUT_RGB16F:
+    case PIXEL_LAYOUT_RGBA16F:
+        for (size_t i = 0; i < size / 2; i++)
+        {
+            uint16_t h = floatToHalf((float)(rand() % 20000 - 5000) / 10000.0f);
+            memcpy(&buf[i * 2], &h, 2);
+        }
+        break;
+
+    default:
+        for (size_t i = 0; i < size; i++)
+            buf[i] = (unsigned char)rand();
+        break;
+    }
+
+    return buf;
+}
+
+TEST(PixelConvert, LayoutSizes)
+{
+    EXPECT_EQ(getPixelLayoutSize(PIXEL_LAYOUT_INVALID), 0u);
+    EXPECT_EQ(getPixelLayoutSize(PIXEL_LAYOUT_COUNT), 0u);
+    EXPECT_EQ(getPixelLayoutSize(PIXEL_LAYOUT_RGB8), 3u);
+    EXPECT_EQ(getPixelLayoutSize(PIXEL_LAYOUT_RGB565), 2u);
+    EXPECT_EQ(getPixelLayoutSize(PIXEL_LAYOUT_RGB16F), 6u);
+    EXPECT_EQ(getPixelLayoutSize(PIXEL_LAYOUT_RGBA32F), 16u);
+
+    for (int layout = PIXEL_LAYOUT_R8; layout < PIXEL_LAYOUT_COUNT; layout++)
+        EXPECT_NE(getPixelLayoutSize((PixelLayout)layout), 0u) << layout;
+}
+
+TEST(PixelConvert, OnlyInvalidLayoutsAreRefused)
+{
+    unsigned char src[4] = {}, dst[4];
+
+    EXPECT_TRUE(canConvertPixels(PIXEL_LAYOUT_RGBA8, PIXEL_LAYOUT_RGB565));
+    EXPECT_TRUE(canConvertPixels(PIXEL_LAYOUT_RGB565, PIXEL_LAYOUT_RGBA8));
+    EXPECT_FALSE(canConvertPixels(PIXEL_LAYOUT_RGBA8, PIXEL_LAYOUT_INVALID));
+    EXPECT_FALSE(canConvertPixels(PIXEL_LAYOUT_COUNT, PIXEL_LAYOUT_RGBA8));
+
+    EXPECT_FALSE(convertPixels(PIXEL_LAYOUT_INVALID, dst, PIXEL_LAYOUT_RGBA8, src, 1));
+    EXPECT_FALSE(convertPixelsGeneric(PIXEL_LAYOUT_RGBA8, dst, PIXEL_LAYOUT_INVALID, src, 1));
+}
+
+// every vector kernel has to give exactly what the generic path gives, lengths
+// cover the vector widths and the scalar tails
+TEST(PixelConvert, EveryPairMatchesGeneric)
+{
+    srand(4321);
+
+    for (int s = PIXEL_LAYOUT_R8; s < PIXEL_LAYOUT_COUNT; s++)
+    {
+        for (int d = PIXEL_LAYOUT_R8; d < PIXEL_LAYOUT_COUNT; d++)
+        {
+            PixelLayout src_layout = (PixelLayout)s, dst_layout = (PixelLayout)d;
+
+            if (canConvertPixels(dst_layout, src_layout) == false)
+                continue;
+
+            size_t dst_size = getPixelLayoutSize(dst_layout);
+
+            for (size_t count : {0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 80, 1000})
+            {
+                std::vector<unsigned char> src = randomPixels(src_layout, count);
+                std::vector<unsigned char> expect(count * dst_size + 16, 0xcd);
+                std::vector<unsigned char> got(count * dst_size + 16, 0xcd);
+
+                ASSERT_TRUE(convertPixelsGeneric(dst_layout, expect.data(), src_layout, src.data(), count));
+                ASSERT_TRUE(convertPixels(dst_layout, got.data(), src_layout, src.data(), count));
+
+                // also checks nothing was written past the end
+                ASSERT_EQ(memcmp(expect.data(), got.data(), got.size()), 0)
+                    << "src " << s << " dst " << d << " count " << count;
+
+                for (size_t i = count * dst_size; i < got.size(); i++)
+                    ASSERT_EQ(got[i], 0xcd);
+            }
+        }
+    }
+}
+
+TEST(PixelConvert, RGB8AndBGR8GetOpaqueAlpha)
+{
+    unsigned char rgb[6] = {1, 2, 3, 4, 5, 6};
+    unsigned char rgba[8];
+    unsigned char expect_rgb[8] = {1, 2, 3, 255, 4, 5, 6, 255};
+    unsigned char expect_bgr[8] = {3, 2, 1, 255, 6, 5, 4, 255};
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, rgba, PIXEL_LAYOUT_RGB8, rgb, 2));
+    EXPECT_EQ(memcmp(rgba, expect_rgb, sizeof(rgba)), 0);
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, rgba, PIXEL_LAYOUT_BGR8, rgb, 2));
+    EXPECT_EQ(memcmp(rgba, expect_bgr, sizeof(rgba)), 0);
+}
+
+TEST(PixelConvert, MissingChannelsAndDroppedChannels)
+{
+    unsigned char r[2] = {10, 20};
+    unsigned char rgba[8];
+    unsigned char expect[8] = {10, 0, 0, 255, 20, 0, 0, 255};
+    unsigned char bgra[4] = {1, 2, 3, 4};
+    unsigned char rg[2];
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, rgba, PIXEL_LAYOUT_R8, r, 2));
+    EXPECT_EQ(memcmp(rgba, expect, sizeof(rgba)), 0);
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RG8, rg, PIXEL_LAYOUT_BGRA8, bgra, 1));
+    EXPECT_EQ(rg[0], 3);
+    EXPECT_EQ(rg[1], 2);
+}
+
+TEST(PixelConvert, Packed16Expansion)
+{
+    uint16_t src[4] = {0xffff, 0xf800, 0x07e0, 0x001f};
+    unsigned char rgba[16];
+    unsigned char expect[16] = {255, 255, 255, 255, 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255};
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, rgba, PIXEL_LAYOUT_RGB565, src, 4));
+    EXPECT_EQ(memcmp(rgba, expect, sizeof(rgba)), 0);
+
+    // every 565 value rounds like the float math would
+    for (uint32_t v = 0; v < 65536; v++)
+    {
+        uint16_t p = (uint16_t)v;
+        unsigned char out[4];
+
+        ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, out, PIXEL_LAYOUT_RGB565, &p, 1));
+
+        ASSERT_EQ(out[0], (unsigned char)lrintf((float)(p >> 11) * 255.0f / 31.0f));
+        ASSERT_EQ(out[1], (unsigned char)lrintf((float)((p >> 5) & 63) * 255.0f / 63.0f));
+        ASSERT_EQ(out[2], (unsigned char)lrintf((float)(p & 31) * 255.0f / 31.0f));
+    }
+
+    uint16_t rgba4 = 0x1234;
+    unsigned char out[4];
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, out, PIXEL_LAYOUT_RGBA4444, &rgba4, 1));
+    EXPECT_EQ(out[0], 0x11);
+    EXPECT_EQ(out[1], 0x22);
+    EXPECT_EQ(out[2], 0x33);
+    EXPECT_EQ(out[3], 0x44);
+}
+
+TEST(PixelConvert, HalfFloatValues)
+{
+    EXPECT_EQ(floatToHalf(0.0f), 0x0000);
+    EXPECT_EQ(floatToHalf(-0.0f), 0x8000);
+    EXPECT_EQ(floatToHalf(1.0f), 0x3c00);
+    EXPECT_EQ(floatToHalf(-2.0f), 0xc000);
+    EXPECT_EQ(floatToHalf(0.1f), 0x2e66);
+    EXPECT_EQ(floatToHalf(65504.0f), 0x7bff);
+    EXPECT_EQ(floatToHalf(65519.0f), 0x7bff);
+    EXPECT_EQ(floatToHalf(65520.0f), 0x7c00);
+    EXPECT_EQ(floatToHalf(INFINITY), 0x7c00);
+    EXPECT_EQ(floatToHalf(-INFINITY), 0xfc00);
+    EXPECT_EQ(floatToHalf(ldexpf(1.0f, -24)), 0x0001);
+    EXPECT_EQ(floatToHalf(ldexpf(1.0f, -25)), 0x0000);
+    EXPECT_EQ(floatToHalf(ldexpf(1.5f, -25)), 0x0001);
+    EXPECT_EQ(floatToHalf(ldexpf(1.0f, -14)), 0x0400);
+    EXPECT_EQ(floatToHalf(1e-10f), 0x0000);
+    EXPECT_EQ(floatToHalf(NAN) & 0x7e00, 0x7e00);
+
+    // ties go to even
+    EXPECT_EQ(floatToHalf(1.0f + ldexpf(1.0f, -11)), 0x3c00);
+    EXPECT_EQ(floatToHalf(1.0f + 3 * ldexpf(1.0f, -11)), 0x3c02);
+
+    EXPECT_TRUE(isnan(halfToFloat(0x7e00)));
+    EXPECT_EQ(halfToFloat(0xfc00), -INFINITY);
+    EXPECT_EQ(halfToFloat(0x0001), ldexpf(1.0f, -24));
+    EXPECT_EQ(halfToFloat(0x03ff), ldexpf(1023.0f, -24));
+
+    // every half that isn't a nan survives the round trip
+    for (uint32_t v = 0; v < 65536; v++)
+    {
+        uint16_t h = (uint16_t)v;
+
+        if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff))
+            continue;
+
+        ASSERT_EQ(floatToHalf(halfToFloat(h)), h) << std::hex << h;
+    }
+}
+
+TEST(PixelConvert, FloatToHalfRGBA)
+{
+    float src[6] = {0.5f, -1.0f, 2.0f, 0.25f, 1024.0f, 0.0f};
+    uint16_t dst[8];
+    uint16_t expect[8] = {0x3800, 0xbc00, 0x4000, 0x3c00, 0x3400, 0x6400, 0x0000, 0x3c00};
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA16F, dst, PIXEL_LAYOUT_RGB32F, src, 2));
+    EXPECT_EQ(memcmp(dst, expect, sizeof(dst)), 0);
+}
+
+TEST(PixelConvert, UnormRoundsAndClamps)
+{
+    float src[4] = {-1.0f, 0.5f, 2.0f, NAN};
+    unsigned char dst[4];
+    uint16_t dst16[4];
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, dst, PIXEL_LAYOUT_RGBA32F, src, 1));
+    EXPECT_EQ(dst[0], 0);
+    EXPECT_EQ(dst[1], 128);
+    EXPECT_EQ(dst[2], 255);
+    EXPECT_EQ(dst[3], 0);
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA16, dst16, PIXEL_LAYOUT_RGBA32F, src, 1));
+    EXPECT_EQ(dst16[0], 0);
+    EXPECT_EQ(dst16[1], 32768);
+    EXPECT_EQ(dst16[2], 65535);
+}
+
+TEST(PixelConvert, PackedRoundTrip)
+{
+    // every packed value expands to rgba8 and packs back to itself
+    for (PixelLayout layout : {PIXEL_LAYOUT_RGB565, PIXEL_LAYOUT_BGR565, PIXEL_LAYOUT_RGBA4444, PIXEL_LAYOUT_RGBA5551})
+    {
+        for (uint32_t v = 0; v < 65536; v++)
+        {
+            uint16_t p = (uint16_t)v, back;
+            unsigned char rgba[4];
+
+            ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA8, rgba, layout, &p, 1));
+            ASSERT_TRUE(convertPixels(layout, &back, PIXEL_LAYOUT_RGBA8, rgba, 1));
+            ASSERT_EQ(back, p) << "layout " << layout;
+        }
+    }
+
+    unsigned char red[4] = {255, 0, 0, 255};
+    uint16_t p;
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_BGR565, &p, PIXEL_LAYOUT_RGBA8, red, 1));
+    EXPECT_EQ(p, 0x001f);
+}
+
+TEST(PixelConvert, DropAlphaForRGBReads)
+{
+    unsigned char bgra[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    unsigned char rgb[6];
+    unsigned char expect_rgb[6] = {3, 2, 1, 7, 6, 5};
+    unsigned char expect_bgr[6] = {1, 2, 3, 5, 6, 7};
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGB8, rgb, PIXEL_LAYOUT_BGRA8, bgra, 2));
+    EXPECT_EQ(memcmp(rgb, expect_rgb, sizeof(rgb)), 0);
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_BGR8, rgb, PIXEL_LAYOUT_BGRA8, bgra, 2));
+    EXPECT_EQ(memcmp(rgb, expect_bgr, sizeof(rgb)), 0);
+}
+
+TEST(PixelConvert, DepthAsUnsignedInt)
+{
+    float depth[4] = {0.0f, 1.0f, 0.5f, 2.0f};
+    uint32_t got[4];
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_R32, got, PIXEL_LAYOUT_R32F, depth, 4));
+    EXPECT_EQ(got[0], 0u);
+    EXPECT_EQ(got[1], 0xffffffffu);
+    EXPECT_EQ(got[2], 0x80000000u);
+    EXPECT_EQ(got[3], 0xffffffffu);
+
+    uint16_t got16[2];
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_R16, got16, PIXEL_LAYOUT_R32F, depth, 2));
+    EXPECT_EQ(got16[0], 0u);
+    EXPECT_EQ(got16[1], 0xffffu);
+}
+
+TEST(PixelConvert, HalfToFloatRGBA)
+{
+    uint16_t src[8] = {0x3c00, 0xc000, 0x3800, 0x0001, 0x7c00, 0x0000, 0x8000, 0x7bff};
+    float dst[8];
+    float expect[8] = {1.0f, -2.0f, 0.5f, ldexpf(1.0f, -24), INFINITY, 0.0f, -0.0f, 65504.0f};
+
+    ASSERT_TRUE(convertPixels(PIXEL_LAYOUT_RGBA32F, dst, PIXEL_LAYOUT_RGBA16F, src, 2));
+    EXPECT_EQ(memcmp(dst, expect, sizeof(dst)), 0);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_store_bench.cpp
+ * MGL
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "pixel_store.h"
+}
+
+// 1024x1024 rgba8 unpacks, tight rows are the one memcpy case and a padded
+// source pitch is the row by row case
+
+#define WIDTH 1024
+#define HEIGHT 1024
+
+static void BM_CopyRowByRow(benchmark::State &state)
+{
+    size_t src_pitch = WIDTH * 4 + state.range(0);
+    std::vector<unsigned char> src(src_pitch * HEIGHT), dst(WIDTH * 4 * HEIGHT);
+
+    for (auto _ : state)
+    {
+        for (size_t y = 0; y < HEIGHT; y++)
+            memcpy(&dst[y * WIDTH * 4], &src[y * src_pitch], WIDTH * 4);
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * dst.size());
+}
+
+static void BM_CopyPixelRows(benchmark::State &state)
+{
+    size_t src_pitch = WIDTH * 4 + state.range(0);
+    std::vector<unsigned char> src(src_pitch * HEIGHT), dst(WIDTH * 4 * HEIGHT);
+
+    for (auto _ : state)
+    {
+        copyPixelRows(dst.data(), WIDTH * 4, dst.size(), src.data(), src_pitch, src.size(), WIDTH * 4, HEIGHT, 1, 0);
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * dst.size());
+}
+
+BENCHMARK(BM_CopyRowByRow)->Arg(0)->Arg(64);
+BENCHMARK(BM_CopyPixelRows)->Arg(0)->Arg(64);
+
+// swap_bytes uploads, a scalar bswap per element against the vector swap
+static void BM_SwapScalar(benchmark::State &state)
+{
+    size_t swap_size = state.range(0);
+    std::vector<unsigned char> src(WIDTH * HEIGHT * 4), dst(src.size());
+
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < src.size(); i += swap_size)
+        {
+            for (size_t b = 0; b < swap_size; b++)
+                dst[i + b] = src[i + swap_size - 1 - b];
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+
+static void BM_SwapPixelBytes(benchmark::State &state)
+{
+    size_t swap_size = state.range(0);
+    std::vector<unsigned char> src(WIDTH * HEIGHT * 4), dst(src.size());
+
+    for (auto _ : state)
+    {
+        swapPixelBytes(dst.data(), src.data(), src.size(), swap_size);
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+
+BENCHMARK(BM_SwapScalar)->Arg(2)->Arg(4)->Arg(8);
+BENCHMARK(BM_SwapPixelBytes)->Arg(2)->Arg(4)->Arg(8);
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * pixel_store_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "pixel_store.h"
+}
+
+static PixelStoreParams defaultParams(void)
+{
+    PixelStoreParams params;
+
+    memset(&params, 0, sizeof(params));
+    params.alignment = 4;
+
+    return params;
+}
+
+TEST(PixelStore, DefaultLayoutIsTightUpToAlignment)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+
+    // rgba8, rows already a multiple of 4
+    getPixelStoreLayout(&params, 4, 1, false, 10, 3, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 40u);
+    EXPECT_EQ(layout.image_pitch, 120u);
+    EXPECT_EQ(layout.row_size, 40u);
+    EXPECT_EQ(layout.offset, 0u);
+    EXPECT_EQ(layout.size, 120u);
+    EXPECT_EQ(layout.swap_size, 0u);
+
+    // rgb8 rows of 15 bytes pad to 16, the last row isn't padded
+    getPixelStoreLayout(&params, 3, 1, false, 5, 3, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 16u);
+    EXPECT_EQ(layout.row_size, 15u);
+    EXPECT_EQ(layout.size, 16u * 2 + 15);
+
+    params.alignment = 1;
+    getPixelStoreLayout(&params, 3, 1, false, 5, 3, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 15u);
+
+    params.alignment = 8;
+    getPixelStoreLayout(&params, 3, 1, false, 5, 3, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 16u);
+
+    getPixelStoreLayout(&params, 3, 1, false, 6, 3, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 24u);
+}
+
+TEST(PixelStore, ElementsWiderThanAlignmentArentPadded)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+
+    // rgb16, 3 pixels is 18 bytes and the 2 byte elements don't care about alignment 2
+    params.alignment = 2;
+    getPixelStoreLayout(&params, 6, 2, false, 3, 2, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 18u);
+
+    params.alignment = 4;
+    getPixelStoreLayout(&params, 6, 2, false, 3, 2, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 20u);
+
+    // rgb32f is always tight at 4
+    getPixelStoreLayout(&params, 12, 4, false, 3, 2, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 36u);
+}
+
+TEST(PixelStore, RowLengthAndSkips)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+
+    params.row_length = 100;
+    params.skip_pixels = 3;
+    params.skip_rows = 2;
+    params.skip_images = 5; // ignored for 2d
+
+    getPixelStoreLayout(&params, 4, 1, false, 10, 4, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 400u);
+    EXPECT_EQ(layout.row_size, 40u);
+    EXPECT_EQ(layout.offset, 3u * 4 + 2 * 400);
+    EXPECT_EQ(layout.size, layout.offset + 3 * 400 + 40);
+}
+
+TEST(PixelStore, ImageHeightAndSkipImagesFor3D)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+
+    params.image_height = 8;
+    params.skip_images = 2;
+    params.skip_rows = 1;
+
+    getPixelStoreLayout(&params, 4, 1, true, 4, 4, 3, &layout);
+    EXPECT_EQ(layout.row_pitch, 16u);
+    EXPECT_EQ(layout.image_pitch, 16u * 8);
+    EXPECT_EQ(layout.offset, 2u * 128 + 16);
+    EXPECT_EQ(layout.size, layout.offset + 2 * 128 + 3 * 16 + 16);
+
+    // image height is a 3d only setting too
+    getPixelStoreLayout(&params, 4, 1, false, 4, 4, 1, &layout);
+    EXPECT_EQ(layout.image_pitch, 16u * 4);
+    EXPECT_EQ(layout.offset, 16u);
+}
+
+TEST(PixelStore, SwapSizeFollowsElements)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+
+    params.swap_bytes = true;
+
+    getPixelStoreLayout(&params, 4, 1, false, 1, 1, 1, &layout);
+    EXPECT_EQ(layout.swap_size, 0u);
+
+    getPixelStoreLayout(&params, 2, 2, false, 1, 1, 1, &layout);
+    EXPECT_EQ(layout.swap_size, 2u);
+
+    getPixelStoreLayout(&params, 16, 4, false, 1, 1, 1, &layout);
+    EXPECT_EQ(layout.swap_size, 4u);
+
+    getPixelStoreLayout(&params, 8, 8, false, 1, 1, 1, &layout);
+    EXPECT_EQ(layout.swap_size, 8u);
+}
+
+TEST(PixelStore, EmptyImageReadsNothing)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+
+    params.skip_rows = 10;
+
+    getPixelStoreLayout(&params, 4, 1, false, 0, 4, 1, &layout);
+    EXPECT_EQ(layout.size, 0u);
+}
+
+// every swap size, every length and misalignment against a byte at a time swap
+TEST(PixelStore, SwapBytesMatchesScalar)
+{
+    srand(99);
+
+    for (size_t swap_size : {2, 4, 8})
+    {
+        for (size_t offset = 0; offset < 3; offset++)
+        {
+            for (size_t size = 0; size < 100; size += (size < 40) ? 1 : 7)
+            {
+                std::vector<unsigned char> src(size + offset), expect(size), got(size + offset + 8, 0xcd);
+
+                for (auto &b : src)
+                    b = (unsigned char)rand();
+
+                for (size_t i = 0; i < size; i++)
+                {
+                    size_t element = i - i % swap_size;
+
+                    if (element + swap_size <= size)
+                        expect[i] = src[offset + element + swap_size - 1 - i % swap_size];
+                    else
+                        expect[i] = src[offset + i];
+                }
+
+                swapPixelBytes(got.data() + offset, src.data() + offset, size, swap_size);
+
+                ASSERT_EQ(memcmp(got.data() + offset, expect.data(), size), 0)
+                    << "swap " << swap_size << " size " << size << " offset " << offset;
+
+                for (size_t i = offset + size; i < got.size(); i++)
+                    ASSERT_EQ(got[i], 0xcd);
+
+                // in place
+                swapPixelBytes(src.data() + offset, src.data() + offset, size, swap_size);
+                ASSERT_EQ(memcmp(src.data() + offset, expect.data(), size), 0);
+            }
+        }
+    }
+}
+
+TEST(PixelStore, CopyRowsStrided)
+{
+    const size_t row_size = 12, height = 5, depth = 3;
+    const size_t src_pitch = 16, src_image = src_pitch * 7;
+    const size_t dst_pitch = 20, dst_image = dst_pitch * 6;
+    std::vector<unsigned char> src(src_image * depth), dst(dst_image * depth, 0xcd);
+
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (unsigned char)(i * 13 + 1);
+
+    copyPixelRows(dst.data(), dst_pitch, dst_image, src.data(), src_pitch, src_image, row_size, height, depth, 0);
+
+    for (size_t z = 0; z < depth; z++)
+    {
+        for (size_t y = 0; y < 6; y++)
+        {
+            for (size_t x = 0; x < dst_pitch; x++)
+            {
+                unsigned char got = dst[z * dst_image + y * dst_pitch + x];
+
+                if (y < height && x < row_size)
+                    ASSERT_EQ(got, src[z * src_image + y * src_pitch + x]);
+                else
+                    ASSERT_EQ(got, 0xcd);
+            }
+        }
+    }
+}
+
+TEST(PixelStore, CopyRowsPackedAndSwapped)
+{
+    const size_t row_size = 16, height = 4, depth = 2;
+    std::vector<uint32_t> src(row_size / 4 * height * depth), dst(src.size());
+
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = 0x01020304u + (uint32_t)i;
+
+    copyPixelRows(dst.data(), row_size, row_size * height, src.data(), row_size, row_size * height, row_size, height,
+                  depth, 4);
+
+    for (size_t i = 0; i < src.size(); i++)
+        ASSERT_EQ(dst[i], __builtin_bswap32(src[i]));
+
+    // packed rows with a gap between images
+    std::vector<uint32_t> dst2(row_size / 4 * (height + 1) * depth, 0);
+
+    copyPixelRows(dst2.data(), row_size, row_size * (height + 1), src.data(), row_size, row_size * height, row_size,
+                  height, depth, 0);
+
+    for (size_t z = 0; z < depth; z++)
+        ASSERT_EQ(memcmp(&dst2[z * 4 * (height + 1)], &src[z * 4 * height], row_size * height), 0);
+
+    for (size_t i = 0; i < 4; i++)
+        ASSERT_EQ(dst2[4 * height + i], 0u);
+}
+
+TEST(PixelStore, PackAlignedRowsWithConversion)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+
+    // a bgra8 drawable read as rgb/ubyte, 5 pixel rows pad from 15 to 16 bytes
+    const size_t width = 5, height = 3;
+    std::vector<unsigned char> src(width * 4 * height);
+
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (unsigned char)i;
+
+    params.skip_pixels = 1;
+    params.skip_rows = 1;
+    params.row_length = 6;
+
+    getPixelStoreLayout(&params, 3, 1, false, width, height, 1, &layout);
+    EXPECT_EQ(layout.row_pitch, 20u);
+
+    std::vector<unsigned char> dst(layout.size + 8, 0xcd);
+
+    ASSERT_TRUE(packPixelRows(dst.data(), &layout, PIXEL_LAYOUT_RGB8, src.data(), width * 4, src.size(),
+                              PIXEL_LAYOUT_BGRA8, width, height, 1));
+
+    for (size_t i = 0; i < dst.size(); i++)
+    {
+        size_t rel = i - layout.offset;
+        size_t y = rel / layout.row_pitch, x = rel % layout.row_pitch;
+
+        if (i >= layout.offset && y < height && x < width * 3)
+        {
+            const unsigned char *texel = &src[y * width * 4 + x / 3 * 4];
+
+            ASSERT_EQ(dst[i], texel[2 - x % 3]) << i;
+        }
+        else
+        {
+            ASSERT_EQ(dst[i], 0xcd) << i;
+        }
+    }
+}
+
+TEST(PixelStore, PackSwapsAfterConverting)
+{
+    PixelStoreParams params = defaultParams();
+    PixelStoreLayout layout;
+    float depth[3] = {0.0f, 1.0f, 0.5f};
+    uint32_t got[3];
+
+    params.swap_bytes = true;
+
+    getPixelStoreLayout(&params, 4, 4, false, 3, 1, 1, &layout);
+    ASSERT_TRUE(packPixelRows(got, &layout, PIXEL_LAYOUT_R32, depth, sizeof(depth), sizeof(depth), PIXEL_LAYOUT_R32F,
+                              3, 1, 1));
+
+    EXPECT_EQ(got[0], 0u);
+    EXPECT_EQ(got[1], 0xffffffffu);
+    EXPECT_EQ(got[2], 0x00000080u);
+
+    // no conversion is a straight strided copy
+    uint32_t raw[3];
+
+    ASSERT_TRUE(packPixelRows(raw, &layout, PIXEL_LAYOUT_R32F, depth, sizeof(depth), sizeof(depth), PIXEL_LAYOUT_R32F,
+                              3, 1, 1));
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        uint32_t bits;
+
+        memcpy(&bits, &depth[i], 4);
+        EXPECT_EQ(raw[i], __builtin_bswap32(bits));
+    }
+
+    EXPECT_FALSE(packPixelRows(raw, &layout, PIXEL_LAYOUT_INVALID, depth, sizeof(depth), sizeof(depth),
+                               PIXEL_LAYOUT_R32F, 3, 1, 1));
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * sub_allocator_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <utility>
+#include <vector>
+
+extern "C"
+{
+#include "sub_allocator.h"
+}
+
+// stands in for the mtl buffer the renderer creates
+static void *newTestBacking(void *arg, size_t size, void **contents)
+{
+    int *count = (int *)arg;
+    void *ptr;
+
+    if (*count < 0)
+        return NULL;
+
+    ptr = malloc(size);
+    *contents = ptr;
+    (*count)++;
+
+    return ptr;
+}
+
+static void freeTestBacking(void *arg, void *backing)
+{
+    int *count = (int *)arg;
+
+    free(backing);
+    (*count)--;
+}
+
+class SubAllocatorTest : public ::testing::Test
+{
+  protected:
+    SubAllocator alloc;
+    int backings = 0;
+
+    void SetUp() override { initSubAllocator(&alloc, newTestBacking, freeTestBacking, &backings); }
+
+    void TearDown() override
+    {
+        freeSubAllocator(&alloc);
+        EXPECT_EQ(backings, 0);
+    }
+};
+
+TEST_F(SubAllocatorTest, SlotsAreAlignedAndSized)
+{
+    size_t sizes[] = {1, 255, 256, 257, 1000, 4096, 5000, 65536};
+
+    for (size_t size : sizes)
+    {
+        SubAllocSlab *slab;
+        size_t offset;
+
+        slab = newSubAllocation(&alloc, size, &offset);
+        ASSERT_NE(slab, nullptr);
+
+        EXPECT_EQ(offset % SUB_ALLOC_MIN_SIZE, 0u);
+        EXPECT_GE(getSubAllocationSize(slab), size);
+        EXPECT_LT(getSubAllocationSize(slab), size * 2 + SUB_ALLOC_MIN_SIZE);
+        EXPECT_LE(offset + getSubAllocationSize(slab), (size_t)SUB_ALLOC_SLAB_SIZE);
+    }
+}
+
+TEST_F(SubAllocatorTest, TooLargeIsRefused)
+{
+    size_t offset;
+
+    EXPECT_EQ(newSubAllocation(&alloc, SUB_ALLOC_MAX_SIZE + 1, &offset), nullptr);
+    EXPECT_EQ(backings, 0);
+}
+
+TEST_F(SubAllocatorTest, ManySmallBuffersShareOneSlab)
+{
+    std::set<std::pair<SubAllocSlab *, size_t>> seen;
+    SubAllocSlab *first = nullptr;
+
+    // a raylib style scene, hundreds of tiny vbos
+    for (int i = 0; i < 1000; i++)
+    {
+        SubAllocSlab *slab;
+        size_t offset;
+
+        slab = newSubAllocation(&alloc, 192, &offset);
+        ASSERT_NE(slab, nullptr);
+
+        if (first == nullptr)
+            first = slab;
+
+        EXPECT_EQ(slab, first);
+        EXPECT_TRUE(seen.insert(std::make_pair(slab, offset)).second);
+
+        // the caller writes through contents, make sure slots don't overlap
+        memset(slab->contents + offset, i & 0xff, 192);
+    }
+
+    EXPECT_EQ(backings, 1);
+
+    for (auto &slot : seen)
+    {
+        unsigned char expect = (unsigned char)*(slot.first->contents + slot.second);
+
+        for (int j = 0; j < 192; j++)
+            ASSERT_EQ((unsigned char)slot.first->contents[slot.second + j], expect);
+    }
+}
+
+TEST_F(SubAllocatorTest, FullSlabGetsANewOne)
+{
+    unsigned per_slab = SUB_ALLOC_SLAB_SIZE / SUB_ALLOC_MAX_SIZE;
+    size_t offset;
+
+    for (unsigned i = 0; i < per_slab; i++)
+        ASSERT_NE(newSubAllocation(&alloc, SUB_ALLOC_MAX_SIZE, &offset), nullptr);
+
+    EXPECT_EQ(backings, 1);
+
+    ASSERT_NE(newSubAllocation(&alloc, SUB_ALLOC_MAX_SIZE, &offset), nullptr);
+
+    EXPECT_EQ(backings, 2);
+}
+
+TEST_F(SubAllocatorTest, FreeIsDeferredUntilSerialCompletes)
+{
+    SubAllocSlab *slab, *again;
+    size_t offset, offset2;
+
+    slab = newSubAllocation(&alloc, 1024, &offset);
+    ASSERT_NE(slab, nullptr);
+
+    // queued at serial 5, only 3 has completed
+    freeSubAllocation(&alloc, slab, offset, 5, 3);
+
+    again = newSubAllocation(&alloc, 1024, &offset2);
+    ASSERT_EQ(again, slab);
+    EXPECT_NE(offset2, offset);
+
+    reclaimSubAllocations(&alloc, 4);
+
+    SubAllocatorStats stats;
+    getSubAllocatorStats(&alloc, &stats);
+    EXPECT_EQ(stats.pending, 1u);
+
+    reclaimSubAllocations(&alloc, 5);
+
+    getSubAllocatorStats(&alloc, &stats);
+    EXPECT_EQ(stats.pending, 0u);
+
+    // the lowest free slot comes back first
+    again = newSubAllocation(&alloc, 1024, &offset2);
+    ASSERT_EQ(again, slab);
+    EXPECT_EQ(offset2, offset);
+}
+
+TEST_F(SubAllocatorTest, EmptySlabsAreReleasedButOneIsKept)
+{
+    unsigned per_slab = SUB_ALLOC_SLAB_SIZE / SUB_ALLOC_MAX_SIZE;
+    std::vector<std::pair<SubAllocSlab *, size_t>> slots;
+
+    for (unsigned i = 0; i < per_slab * 3; i++)
+    {
+        SubAllocSlab *slab;
+        size_t offset;
+
+        slab = newSubAllocation(&alloc, SUB_ALLOC_MAX_SIZE, &offset);
+        ASSERT_NE(slab, nullptr);
+
+        slots.push_back(std::make_pair(slab, offset));
+    }
+
+    EXPECT_EQ(backings, 3);
+
+    for (auto &slot : slots)
+        freeSubAllocation(&alloc, slot.first, slot.second, 1, 1);
+
+    EXPECT_EQ(backings, 1);
+
+    SubAllocatorStats stats;
+    getSubAllocatorStats(&alloc, &stats);
+    EXPECT_EQ(stats.slabs, 1u);
+    EXPECT_EQ(stats.live, 0u);
+    EXPECT_EQ(stats.live_bytes, 0u);
+    EXPECT_EQ(stats.allocs, per_slab * 3);
+    EXPECT_EQ(stats.frees, per_slab * 3);
+}
+
+TEST_F(SubAllocatorTest, BackingFailureIsReported)
+{
+    size_t offset;
+
+    backings = -1;
+
+    EXPECT_EQ(newSubAllocation(&alloc, 100, &offset), nullptr);
+
+    backings = 0;
+}
+
+TEST_F(SubAllocatorTest, RandomChurn)
+{
+    std::vector<std::pair<std::pair<SubAllocSlab *, size_t>, size_t>> live;
+    uint64_t serial = 1;
+
+    srand(1234);
+
+    for (int i = 0; i < 20000; i++)
+    {
+        if (live.empty() || (rand() % 3))
+        {
+            SubAllocSlab *slab;
+            size_t offset, size;
+
+            size = 1 + rand() % SUB_ALLOC_MAX_SIZE;
+
+            slab = newSubAllocation(&alloc, size, &offset);
+            ASSERT_NE(slab, nullptr);
+
+            live.push_back(std::make_pair(std::make_pair(slab, offset), size));
+        }
+        else
+        {
+            size_t index = rand() % live.size();
+
+            freeSubAllocation(&alloc, live[index].first.first, live[index].first.second, serial, serial - 1);
+
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        if ((i % 100) == 0)
+            reclaimSubAllocations(&alloc, serial++);
+    }
+
+    // nothing handed out twice
+    std::set<std::pair<SubAllocSlab *, size_t>> seen;
+    for (auto &slot : live)
+        EXPECT_TRUE(seen.insert(slot.first).second);
+
+    for (auto &slot : live)
+        freeSubAllocation(&alloc, slot.first.first, slot.first.second, serial, serial);
+
+    reclaimSubAllocations(&alloc, serial);
+
+    SubAllocatorStats stats;
+    getSubAllocatorStats(&alloc, &stats);
+    EXPECT_EQ(stats.live, 0u);
+    EXPECT_EQ(stats.pending, 0u);
+    EXPECT_LE(stats.slabs, (size_t)SUB_ALLOC_NUM_CLASSES);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * texture_compression_bench.cpp
+ * MGL
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+extern "C"
+{
+#include "texture_compression.h"
+}
+
+// decoding a 2048x2048 level of random blocks, one thread against the
+// threaded level decode. bytes processed counts the decoded texels.
+
+#define SIZE 2048
+
+static void runDecode(benchmark::State &state, bool threaded)
+{
+    CompressedFormat format;
+
+    getCompressedFormat((GLenum)state.range(0), &format);
+
+    size_t src_pitch = getCompressedRowSize(&format, SIZE);
+    size_t dst_pitch = SIZE * format.decoded_size;
+    std::vector<uint8_t> src(getCompressedImageSize(&format, SIZE, SIZE, 1)), dst(dst_pitch * SIZE);
+
+    srand(97531);
+    for (auto &b : src)
+        b = (uint8_t)rand();
+
+    for (auto _ : state)
+    {
+        if (threaded)
+            decodeCompressedImage(&format, dst.data(), dst_pitch, dst.size(), src.data(), src_pitch, src.size(), SIZE,
+                                  SIZE, 1);
+        else
+            decodeCompressedBlocks(&format, dst.data(), dst_pitch, src.data(), src_pitch, SIZE, SIZE);
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * dst.size());
+}
+
+static void BM_DecodeBlocks(benchmark::State &state)
+{
+    runDecode(state, false);
+}
+
+static void BM_DecodeImage(benchmark::State &state)
+{
+    runDecode(state, true);
+}
+
+static void decodeArgs(benchmark::internal::Benchmark *b)
+{
+    b->ArgName("format");
+    b->Arg(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
+    b->Arg(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+    b->Arg(GL_COMPRESSED_RG_RGTC2);
+    b->Arg(GL_COMPRESSED_RGB8_ETC2);
+    b->Arg(GL_COMPRESSED_RGBA8_ETC2_EAC);
+    b->Arg(GL_COMPRESSED_RG11_EAC);
+    b->UseRealTime();
+}
+
+BENCHMARK(BM_DecodeBlocks)->Apply(decodeArgs);
+BENCHMARK(BM_DecodeImage)->Apply(decodeArgs);
@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) Michael Larson on 1/6/2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * texture_compression_test.cpp
+ * MGL
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+extern "C"
+{
+#include "texture_compression.h"
+}
+
+// etc blocks are built bit by bit, big endian like the format
+struct BlockBits
+{
+    uint64_t v = 0;
+
+    void set(int hi, int lo, uint64_t value)
+    {
+        uint64_t mask = ((1ull << (hi - lo + 1)) - 1) << lo;
+
+        v = (v & ~mask) | ((value << lo) & mask);
+    }
+
+    // etc texel indices go down the columns, msb in the upper half
+    void index(int x, int y, int i)
+    {
+        int k = x * 4 + y;
+
+        set(k + 16, k + 16, (i >> 1) & 1);
+        set(k, k, i & 1);
+    }
+
+    void write(uint8_t *b) const
+    {
+        for (int i = 0; i < 8; i++)
+            b[i] = (uint8_t)(v >> (56 - 8 * i));
+    }
+};
+
+static void decodeOne(GLenum internalformat, const uint8_t *block, uint8_t *texels)
+{
+    CompressedFormat format;
+
+    ASSERT_TRUE(getCompressedFormat(internalformat, &format));
+    ASSERT_TRUE(decodeCompressedBlocks(&format, texels, 4 * format.decoded_size, block, format.block_size, 4, 4));
+}
+
+TEST(TextureCompression, Formats)
+{
+    CompressedFormat format;
+
+    ASSERT_TRUE(getCompressedFormat(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, &format));
+    EXPECT_EQ(format.block_size, 8u);
+    EXPECT_EQ(format.decoded_format, (GLenum)GL_RGBA8);
+    EXPECT_EQ(getCompressedRowSize(&format, 5), 16u);
+    EXPECT_EQ(getCompressedImageSize(&format, 5, 5, 1), 32u);
+    EXPECT_EQ(getCompressedImageSize(&format, 1, 1, 3), 24u);
+
+    ASSERT_TRUE(getCompressedFormat(GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, &format));
+    EXPECT_TRUE(format.srgb);
+    EXPECT_EQ(format.block_size, 16u);
+    EXPECT_EQ(format.decoded_format, (GLenum)GL_SRGB8_ALPHA8);
+
+    ASSERT_TRUE(getCompressedFormat(GL_COMPRESSED_SIGNED_RG11_EAC, &format));
+    EXPECT_EQ(format.decoded_format, (GLenum)GL_RG16_SNORM);
+    EXPECT_EQ(format.decoded_size, 4u);
+
+    // astc and bptc are passed through, no decoder
+    ASSERT_TRUE(getCompressedFormat(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x8_KHR, &format));
+    EXPECT_EQ(format.blocks, COMPRESSED_BLOCKS_ASTC);
+    EXPECT_EQ(format.block_width, 10u);
+    EXPECT_EQ(format.block_height, 8u);
+    EXPECT_TRUE(format.srgb);
+    EXPECT_EQ(format.decoded_format, 0u);
+    EXPECT_EQ(getCompressedImageSize(&format, 21, 8, 1), 48u);
+
+    ASSERT_TRUE(getCompressedFormat(GL_COMPRESSED_RGBA_BPTC_UNORM, &format));
+    EXPECT_EQ(format.decoded_format, 0u);
+
+    uint8_t block[16] = {}, texels[64];
+    EXPECT_FALSE(decodeCompressedBlocks(&format, texels, 16, block, 16, 4, 4));
+
+    EXPECT_FALSE(getCompressedFormat(GL_RGBA8, &format));
+    EXPECT_FALSE(getCompressedFormat(GL_COMPRESSED_RGBA, &format));
+}
+
+TEST(TextureCompression, BC1)
+{
+    // red and blue end points, the first row walks the 4 indices
+    uint8_t block[8] = {0x00, 0xf8, 0x1f, 0x00, 0xe4, 0x00, 0x00, 0x00};
+    uint8_t texels[64];
+
+    decodeOne(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, block, texels);
+
+    const uint8_t row[16] = {255, 0, 0, 255, 0, 0, 255, 255, 170, 0, 85, 255, 85, 0, 170, 255};
+    EXPECT_EQ(memcmp(texels, row, 16), 0);
+
+    // the rest are index 0
+    for (int i = 4; i < 16; i++)
+        EXPECT_EQ(texels[i * 4], 255);
+
+    // swapped end points are the 3 color mode, index 3 is black
+    uint8_t three[8] = {0x1f, 0x00, 0x00, 0xf8, 0xe4, 0x00, 0x00, 0x00};
+
+    decodeOne(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, three, texels);
+
+    const uint8_t clear[16] = {0, 0, 255, 255, 255, 0, 0, 255, 128, 0, 128, 255, 0, 0, 0, 0};
+    EXPECT_EQ(memcmp(texels, clear, 16), 0);
+
+    decodeOne(GL_COMPRESSED_RGB_S3TC_DXT1_EXT, three, texels);
+    EXPECT_EQ(texels[15], 255);
+}
+
+TEST(TextureCompression, BC2AndBC3Alpha)
+{
+    uint8_t block[16] = {}, texels[64];
+
+    // 4 bit alpha, texel 1 is 0xf and texel 2 is 0x8
+    block[0] = 0xf0;
+    block[1] = 0x08;
+
+    // scaled by 17
+    decodeOne(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, block, texels);
+    EXPECT_EQ(texels[3], 0);
+    EXPECT_EQ(texels[7], 255);
+    EXPECT_EQ(texels[11], 136);
+    EXPECT_EQ(texels[15], 0);
+
+    // bc3 alpha 255 to 0 in the 8 value mode, texel 1 takes index 2
+    memset(block, 0, sizeof(block));
+    block[0] = 255;
+    block[1] = 0;
+    block[2] = 2 << 3;
+
+    decodeOne(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, block, texels);
+    EXPECT_EQ(texels[3], 255);
+    EXPECT_EQ(texels[7], 219); // 6/7 of 255
+
+    // the 6 value mode has 0 and 255 at 6 and 7
+    block[0] = 0;
+    block[1] = 255;
+    block[2] = 0xc0 | (2 << 3) | 6;
+    block[3] = 1; // texel 2's index straddles into the next byte
+
+    decodeOne(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, block, texels);
+    EXPECT_EQ(texels[3], 0);
+    EXPECT_EQ(texels[7], 51);
+    EXPECT_EQ(texels[11], 255);
+}
+
+TEST(TextureCompression, BC4AndBC5)
+{
+    uint8_t block[16] = {}, texels[32];
+
+    // -128 is read as -127, index 1 for texel 1 is the other end point
+    block[0] = 0x80;
+    block[1] = 100;
+    block[2] = 1 << 3;
+
+    decodeOne(GL_COMPRESSED_SIGNED_RED_RGTC1, block, texels);
+    EXPECT_EQ((int8_t)texels[0], -127);
+    EXPECT_EQ((int8_t)texels[1], 100);
+
+    // signed 6 value mode, the extremes are -127 and 127
+    block[0] = (uint8_t)-20;
+    block[1] = 20;
+    block[2] = 0xc0 | (6 << 3) | 2;
+    block[3] = 1;
+
+    decodeOne(GL_COMPRESSED_SIGNED_RED_RGTC1, block, texels);
+    EXPECT_EQ((int8_t)texels[0], -12); // 4/5 -20 + 1/5 20
+    EXPECT_EQ((int8_t)texels[1], -127);
+    EXPECT_EQ((int8_t)texels[2], 127);
+
+    // two unorm channels interleaved
+    memset(block, 0, sizeof(block));
+    block[0] = 10;
+    block[1] = 10;
+    block[8] = 200;
+    block[9] = 200;
+
+    decodeOne(GL_COMPRESSED_RG_RGTC2, block, texels);
+
+    for (int i = 0; i < 16; i++)
+    {
+        EXPECT_EQ(texels[i * 2], 10);
+        EXPECT_EQ(texels[i * 2 + 1], 200);
+    }
+}
+
+TEST(TextureCompression, ETC2Individual)
+{
+    BlockBits bits;
+    uint8_t block[8], texels[64];
+
+    // left half base (8, 4, 2), right half (1, 15, 0), tables 0 and 7, no flip
+    bits.set(63, 60, 8);
+    bits.set(59, 56, 1);
+    bits.set(55, 52, 4);
+    bits.set(51, 48, 15);
+    bits.set(47, 44, 2);
+    bits.set(43, 40, 0);
+    bits.set(39, 37, 0);
+    bits.set(36, 34, 7);
+
+    bits.index(0, 0, 1); // +8
+    bits.index(1, 0, 3); // -8
+    bits.index(2, 0, 0); // +47
+    bits.index(3, 3, 3); // -183
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_RGB8_ETC2, block, texels);
+
+    const uint8_t first[16] = {144, 76, 42, 255, 128, 60, 26, 255, 64, 255, 47, 255, 64, 255, 47, 255};
+    EXPECT_EQ(memcmp(texels, first, 16), 0);
+
+    const uint8_t last[4] = {0, 72, 0, 255};
+    EXPECT_EQ(memcmp(texels + 15 * 4, last, 4), 0);
+
+    // flipped the second half is the bottom two rows
+    bits.set(32, 32, 1);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_RGB8_ETC2, block, texels);
+    EXPECT_EQ(texels[2 * 4], 138);     // (2, 0) is on top, 136 + 2
+    EXPECT_EQ(texels[(2 * 4) * 4], 64); // (0, 2) is below, 17 + 47
+}
+
+TEST(TextureCompression, ETC2Differential)
+{
+    BlockBits bits;
+    uint8_t block[8], texels[64];
+
+    // red 16 - 1, green 8 + 3, blue 0 + 0, both tables 0
+    bits.set(33, 33, 1);
+    bits.set(63, 59, 16);
+    bits.set(58, 56, 7);
+    bits.set(55, 51, 8);
+    bits.set(50, 48, 3);
+    bits.set(47, 43, 0);
+    bits.set(42, 40, 0);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_SRGB8_ETC2, block, texels);
+
+    const uint8_t left[4] = {134, 68, 2, 255}, right[4] = {125, 92, 2, 255};
+    EXPECT_EQ(memcmp(texels, left, 4), 0);
+    EXPECT_EQ(memcmp(texels + 3 * 4, right, 4), 0);
+}
+
+TEST(TextureCompression, ETC2Modes)
+{
+    BlockBits bits;
+    uint8_t block[8], texels[64];
+
+    // t mode, red overflows: 31 + 1. the first color is (13, 2, 3), the second
+    // (4, 5, 6) with a distance of 32
+    bits.set(33, 33, 1);
+    bits.set(63, 59, 31);
+    bits.set(58, 56, 1);
+    bits.set(55, 52, 2);
+    bits.set(51, 48, 3);
+    bits.set(47, 44, 4);
+    bits.set(43, 40, 5);
+    bits.set(39, 36, 6);
+    bits.set(35, 34, 2);
+    bits.set(32, 32, 1);
+    bits.index(0, 0, 0);
+    bits.index(1, 0, 1);
+    bits.index(2, 0, 2);
+    bits.index(3, 0, 3);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_RGB8_ETC2, block, texels);
+
+    const uint8_t t[16] = {221, 34, 51, 255, 100, 117, 134, 255, 68, 85, 102, 255, 36, 53, 70, 255};
+    EXPECT_EQ(memcmp(texels, t, 16), 0);
+
+    // the same block with punchthrough and no opaque bit, index 2 is clear
+    bits.set(33, 33, 0);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, block, texels);
+
+    const uint8_t clear[4] = {0, 0, 0, 0};
+    EXPECT_EQ(memcmp(texels, t, 8), 0);
+    EXPECT_EQ(memcmp(texels + 8, clear, 4), 0);
+
+    // h mode, green overflows: 0 - 4. colors (1, 0, 0) and (1, 0, 0), equal so
+    // the distance index is 1 = 6
+    bits = BlockBits();
+    bits.set(33, 33, 1);
+    bits.set(63, 59, 1);
+    bits.set(58, 56, 0);
+    bits.set(55, 51, 0);
+    bits.set(50, 48, 4);
+    bits.set(46, 43, 1);
+    bits.index(0, 0, 0);
+    bits.index(1, 0, 1);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_RGB8_ETC2, block, texels);
+
+    const uint8_t h[8] = {23, 6, 6, 255, 11, 0, 0, 255};
+    EXPECT_EQ(memcmp(texels, h, 8), 0);
+
+    // planar, blue overflows: 31 + 1. origin red 32, the horizontal red 36 and
+    // vertical red 16 so red steps 1 to the right and -4 down
+    bits = BlockBits();
+    bits.set(33, 33, 1);
+    bits.set(47, 43, 31);
+    bits.set(42, 40, 1);
+    bits.set(62, 57, 8);   // 32 >> 2
+    bits.set(38, 34, 4);   // 36 >> 2 is 9, 4 << 1 | 1
+    bits.set(32, 32, 1);
+    bits.set(18, 13, 4);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_RGB8_ETC2, block, texels);
+
+    EXPECT_EQ(texels[0], 32);
+    EXPECT_EQ(texels[3 * 4], 35);
+    EXPECT_EQ(texels[(3 * 4) * 4], 20);
+    EXPECT_EQ(texels[3], 255);
+}
+
+TEST(TextureCompression, EAC)
+{
+    BlockBits bits;
+    uint8_t block[16], texels[64];
+
+    // rgba8: alpha base 100, multiplier 3, table 0, texel (1, 0) index 7 (+14)
+    bits.set(63, 56, 100);
+    bits.set(55, 52, 3);
+    bits.set(51, 48, 0);
+    bits.set(45 - 3 * 4 + 2, 45 - 3 * 4, 7);
+    bits.write(block);
+    memset(block + 8, 0, 8);
+
+    decodeOne(GL_COMPRESSED_RGBA8_ETC2_EAC, block, texels);
+    EXPECT_EQ(texels[3], 91);  // index 0 is -3
+    EXPECT_EQ(texels[7], 142);
+
+    // r11: base 128, multiplier 1, index 4 (+2) everywhere
+    bits = BlockBits();
+    bits.set(63, 56, 128);
+    bits.set(55, 52, 1);
+    for (int k = 0; k < 16; k++)
+        bits.set(47 - 3 * k, 45 - 3 * k, 4);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_R11_EAC, block, texels);
+
+    uint16_t r;
+    memcpy(&r, texels, 2);
+    EXPECT_EQ(r, (1044 << 5) | (1044 >> 6));
+
+    // signed, base -10 multiplier 0 takes the modifier once: -80 + 2
+    bits.set(63, 56, (uint8_t)-10);
+    bits.set(55, 52, 0);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_SIGNED_R11_EAC, block, texels);
+
+    int16_t s;
+    memcpy(&s, texels, 2);
+    EXPECT_EQ(s, -((78 << 5) | (78 >> 5)));
+
+    // the extremes map to the ends of the 16 bit range
+    bits.set(63, 56, 127);
+    bits.set(55, 52, 15);
+    bits.write(block);
+
+    decodeOne(GL_COMPRESSED_SIGNED_R11_EAC, block, texels);
+    memcpy(&s, texels, 2);
+    EXPECT_EQ(s, 32767);
+}
+
+// threads and the edge blocks give what decoding one image at a time gives
+TEST(TextureCompression, ImagesMatchBlocks)
+{
+    srand(1357);
+
+    for (GLenum internalformat : {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RGB8_ETC2, GL_COMPRESSED_RG11_EAC})
+    {
+        CompressedFormat format;
+
+        ASSERT_TRUE(getCompressedFormat(internalformat, &format));
+
+        for (size_t size : {13, 512})
+        {
+            size_t width = size, height = size / 2 + 1, depth = 3;
+            size_t src_pitch = getCompressedRowSize(&format, width);
+            size_t src_image = getCompressedImageSize(&format, width, height, 1);
+            size_t dst_pitch = width * format.decoded_size + 8, dst_image = dst_pitch * height;
+            std::vector<uint8_t> src(src_image * depth), expect(dst_image * depth, 0xcd), got(expect.size(), 0xcd);
+
+            for (auto &b : src)
+                b = (uint8_t)rand();
+
+            for (size_t z = 0; z < depth; z++)
+            {
+                ASSERT_TRUE(decodeCompressedBlocks(&format, expect.data() + z * dst_image, dst_pitch,
+                                                   src.data() + z * src_image, src_pitch, width, height));
+            }
+
+            ASSERT_TRUE(decodeCompressedImage(&format, got.data(), dst_pitch, dst_image, src.data(), src_pitch,
+                                              src_image, width, height, depth));
+
+            EXPECT_EQ(memcmp(expect.data(), got.data(), got.size()), 0) << internalformat << " " << size;
+
+            // the row padding isn't written
+            for (size_t y = 0; y < height * depth; y++)
+                ASSERT_EQ(got[y * dst_pitch + width * format.decoded_size], 0xcd);
+        }
+    }
+}
@@ -1468,6 +1468,76 @@ TEST_F(MGLTest, Texture2D)
     glDeleteTextures(1, &tex);
 }
 
+TEST_F(MGLTest, RenderToTextureGetTexImage)
+{
+    const GLsizei size = 64;
+    std::vector<GLubyte> pixels(size * size * 4);
+
+    // no pixels, its shadow is deferred until the cpu needs it
+    GLuint tex = createTexture(GL_TEXTURE_2D, size, size);
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+    EXPECT_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), GL_FRAMEBUFFER_COMPLETE);
+
+    glViewport(0, 0, size, size);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glClearColor(1.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // no glFinish, reading it back has to wait for the clear
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    for (GLsizei i = 0; i < size * size; i++)
+    {
+        ASSERT_EQ(pixels[i * 4 + 0], 255) << "texel " << i;
+        ASSERT_EQ(pixels[i * 4 + 1], 0) << "texel " << i;
+        ASSERT_EQ(pixels[i * 4 + 2], 0) << "texel " << i;
+        ASSERT_EQ(pixels[i * 4 + 3], 255) << "texel " << i;
+    }
+
+    // a cpu write backs the shadow with what was rendered, the rest of the level keeps it
+    GLubyte green[4 * 4 * 4];
+    for (int i = 0; i < 4 * 4; i++)
+    {
+        green[i * 4 + 0] = 0;
+        green[i * 4 + 1] = 255;
+        green[i * 4 + 2] = 0;
+        green[i * 4 + 3] = 255;
+    }
+
+    glClearColor(0.0, 0.0, 1.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, 4, GL_RGBA, GL_UNSIGNED_BYTE, green);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    for (GLsizei y = 0; y < size; y++)
+    {
+        for (GLsizei x = 0; x < size; x++)
+        {
+            GLubyte *texel = &pixels[(y * size + x) * 4];
+            bool in_green = (x < 4 && y < 4);
+
+            ASSERT_EQ(texel[0], 0) << x << ", " << y;
+            ASSERT_EQ(texel[1], in_green ? 255 : 0) << x << ", " << y;
+            ASSERT_EQ(texel[2], in_green ? 0 : 255) << x << ", " << y;
+            ASSERT_EQ(texel[3], 255) << x << ", " << y;
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDrawBuffer(GL_FRONT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, wscaled, hscaled);
+
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &tex);
+}
+
 TEST_F(MGLTest, Texture3D)
 {
     GLuint vbo = 0, tex_vbo = 0, mat_ubo = 0;